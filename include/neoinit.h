@@ -0,0 +1,23 @@
+/**
+ * @file neoinit.h
+ * @brief Umbrella header for the Neoinit manager
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Pulls in the core definitions and logging that every part of the manager
+ * uses. Subsystems have their own headers under neoinit/.
+ */
+
+#ifndef NEOINIT_H
+#define NEOINIT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "neoinit/core.h"
+#include "neoinit/log.h"
+
+#endif /* NEOINIT_H */
@@ -0,0 +1,105 @@
+/**
+ * @file admission.h
+ * @brief Pressure-aware spawn admission control for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Every unit launch goes through this controller, which caps the number of
+ * starts in flight. A start is in flight from fork until the unit counts as
+ * ready: a notify unit when it reports readiness, a oneshot unit when it
+ * exits, and any other unit as soon as it has been spawned. A notify or
+ * oneshot unit still in flight after its timeout_start_usec is failed and
+ * sent SIGTERM, which frees its slot. Queued units are released in class
+ * order and FIFO within a class. A unit is never released before all of
+ * its dependencies are running.
+ *
+ * The cap adapts AIMD style. It is halved when a PSI trigger on
+ * /proc/pressure/{cpu,memory,io} fires, and grows by one each quiet tick
+ * back up to the maximum. If triggers cannot be armed (older kernels,
+ * missing privileges), the controller reads avg10 on each tick instead.
+ * Entering pressure raises NEOINIT_EVENT_RESOURCE_HIGH_CPU,
+ * NEOINIT_EVENT_RESOURCE_LOW_MEMORY or NEOINIT_EVENT_RESOURCE_HIGH_IO.
+ *
+ * Every entry point must run on the event loop thread.
+ */
+
+#ifndef NEOINIT_ADMISSION_H
+#define NEOINIT_ADMISSION_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "neoinit/core.h"
+#include "neoinit/service.h"
+
+#define NEOINIT_ADMISSION_MIN              2        // Cap never drops below this
+#define NEOINIT_ADMISSION_PER_CPU          4        // Maximum cap per online CPU
+#define NEOINIT_ADMISSION_TICK_MS          250      // Recovery and polling interval
+#define NEOINIT_ADMISSION_IDLE_DELAY_MS    1000     // Quiet time before idle units run
+#define NEOINIT_ADMISSION_PSI_STALL_USEC   200000   // Trigger: stall time per window
+#define NEOINIT_ADMISSION_PSI_WINDOW_USEC  2000000  // Unprivileged triggers need 2s multiples
+#define NEOINIT_ADMISSION_PSI_AVG10        10.0     // Polling threshold, percent
+
+/**
+ * @brief Launch order; lower classes are released first
+ */
+typedef enum {
+    NEOINIT_ADMISSION_CLASS_EARLY = 0,  // NEOINIT_FLAG_ESSENTIAL or NEOINIT_FLAG_EARLY
+    NEOINIT_ADMISSION_CLASS_NORMAL,
+    NEOINIT_ADMISSION_CLASS_LATE,       // NEOINIT_FLAG_LATE
+    NEOINIT_ADMISSION_CLASS_IDLE,       // NEOINIT_SERVICE_TYPE_IDLE, only once the system is idle
+    NEOINIT_ADMISSION_CLASS_MAX
+} neoinit_admission_class_t;
+
+/**
+ * @brief Where a unit is in admission; stored in neoinit_unit_t
+ */
+typedef enum {
+    NEOINIT_ADMISSION_NONE = 0,
+    NEOINIT_ADMISSION_QUEUED,
+    NEOINIT_ADMISSION_IN_FLIGHT,
+} neoinit_admission_state_t;
+
+/**
+ * @brief PSI resources watched by the controller
+ */
+typedef enum {
+    NEOINIT_PRESSURE_CPU = 0,
+    NEOINIT_PRESSURE_MEMORY,
+    NEOINIT_PRESSURE_IO,
+    NEOINIT_PRESSURE_MAX
+} neoinit_pressure_t;
+
+/**
+ * @brief Launches one admitted unit; nonzero marks the unit failed
+ */
+typedef int (*neoinit_admission_launch_fn)(neoinit_unit_t *unit);
+
+/**
+ * @brief Controller snapshot
+ */
+typedef struct {
+    uint32_t limit;                 // Current cap on starts in flight
+    uint32_t max_limit;
+    uint32_t in_flight;
+    uint32_t queued[NEOINIT_ADMISSION_CLASS_MAX];
+    uint64_t admitted;
+    uint64_t deferred;              // Starts that had to wait in the queue
+    uint64_t pressure_events;
+    bool pressure[NEOINIT_PRESSURE_MAX];
+    bool triggers;                  // PSI triggers armed, rather than polling
+} neoinit_admission_stats_t;
+
+int neoinit_admission_init(neoinit_admission_launch_fn launch);
+void neoinit_admission_cleanup(void);
+
+int neoinit_admission_submit(neoinit_unit_t *unit);
+void neoinit_admission_ready(neoinit_unit_t *unit);
+void neoinit_admission_cancel(neoinit_unit_t *unit);
+
+neoinit_admission_class_t neoinit_admission_class(const neoinit_unit_t *unit);
+int neoinit_admission_get_stats(neoinit_admission_stats_t *stats);
+
+#endif /* NEOINIT_ADMISSION_H */
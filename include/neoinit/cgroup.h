@@ -0,0 +1,59 @@
+/**
+ * @file cgroup.h
+ * @brief cgroup v2 process-tree lifecycle for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Every unit runs in its own cgroup, "<base>/<unit>.unit". The base is the
+ * manager's own cgroup on the unified hierarchy plus NEOINIT_CGROUP_SUBTREE,
+ * or NEOINIT_CGROUP_ROOT_ENV if it is set. Children are created directly in
+ * the unit's cgroup with clone3(CLONE_INTO_CGROUP), so there is no window
+ * in which a freshly forked process can escape. On kernels without clone3,
+ * the child writes itself into cgroup.procs before it execs.
+ *
+ * Stopping a KillMode unit sends SIGTERM to its whole tree. The SIGKILL
+ * escalation, and the sweep of whatever the main process left behind, go
+ * through cgroup.kill. That cost does not depend on how many processes the
+ * unit forked, and daemons that double-forked away from their main pid die
+ * as well. Each unit's
+ * cgroup.events is watched with EPOLLPRI. When the tree empties, the
+ * callback fires and the cgroup is removed. cgroup.freeze suspends a unit
+ * for maintenance through the "freeze" and "thaw" control verbs.
+ *
+ * Without a writable unified hierarchy every call degrades to a no-op, and
+ * units fall back to pid-based signalling.
+ */
+
+#ifndef NEOINIT_CGROUP_H
+#define NEOINIT_CGROUP_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include "neoinit/core.h"
+#include "neoinit/service.h"
+
+#define NEOINIT_CGROUP_SUBTREE    "neoinit"
+#define NEOINIT_CGROUP_SUFFIX     ".unit"
+#define NEOINIT_CGROUP_ROOT_ENV   "NEOINIT_CGROUP_ROOT"   // Overrides the base directory
+
+/**
+ * @brief Called on the event loop thread once a unit's cgroup has no processes left
+ */
+typedef void (*neoinit_cgroup_empty_fn)(neoinit_unit_t *unit);
+
+int neoinit_cgroup_init(neoinit_cgroup_empty_fn on_empty);
+void neoinit_cgroup_cleanup(void);
+bool neoinit_cgroup_enabled(void);
+const char *neoinit_cgroup_base(void);
+
+int neoinit_cgroup_open(neoinit_unit_t *unit);
+void neoinit_cgroup_close(neoinit_unit_t *unit);
+pid_t neoinit_cgroup_fork(neoinit_unit_t *unit);
+int neoinit_cgroup_kill(neoinit_unit_t *unit, int sig);
+int neoinit_cgroup_freeze(neoinit_unit_t *unit, bool frozen);
+bool neoinit_cgroup_populated(const neoinit_unit_t *unit);
+
+#endif /* NEOINIT_CGROUP_H */
@@ -69,10 +69,13 @@ extern "C" {
 #define NEOINIT_TARGETS_DIR      NEOINIT_CONF_DIR "/targets"
 #define NEOINIT_SOCKETS_DIR      NEOINIT_CONF_DIR "/sockets"
 #define NEOINIT_TIMERS_DIR       NEOINIT_CONF_DIR "/timers"
+#define NEOINIT_PATHS_DIR        NEOINIT_CONF_DIR "/paths"
+#define NEOINIT_DEVICES_DIR      NEOINIT_CONF_DIR "/devices"
 #define NEOINIT_RUN_DIR         "/run/neoinit"
 #define NEOINIT_CACHE_DIR       "/var/cache/neoinit"
 #define NEOINIT_LOG_DIR         "/var/log/neoinit"
 #define NEOINIT_LIB_DIR         "/var/lib/neoinit"
+#define NEOINIT_JOURNAL_DIR     NEOINIT_LIB_DIR "/journal"
 #define NEOINIT_CONTROL_SOCKET  NEOINIT_RUN_DIR "/control.sock"
 #define NEOINIT_PID_FILE        NEOINIT_RUN_DIR "/neoinit.pid"
 #define NEOINIT_STATE_FILE      NEOINIT_RUN_DIR "/state.dat"
@@ -84,13 +87,16 @@ enum {
     NEOINIT_MAX_NAME_LEN = 256,
     NEOINIT_MAX_PATH_LEN = PATH_MAX,
     NEOINIT_MAX_CMD_LEN = 4096,
+    NEOINIT_MAX_NAME_LENGTH = NEOINIT_MAX_NAME_LEN,  // Older spellings of the above
+    NEOINIT_MAX_PATH_LENGTH = NEOINIT_MAX_PATH_LEN,
+    NEOINIT_MAX_CMD_LENGTH = NEOINIT_MAX_CMD_LEN,
     NEOINIT_MAX_LINE_LEN = 1024,
     NEOINIT_MAX_ARGS = 128,
     NEOINIT_MAX_ENV = 128,
-    NEOINIT_MAX_DEPS = 64,
+    NEOINIT_MAX_DEPS = 64, // Allocation hint, dependency lists grow on demand
     NEOINIT_MAX_FDS = 1024,
     NEOINIT_MAX_RETRIES = 10,
-    NEOINIT_MAX_SERVICES = 1024,
+    NEOINIT_MAX_SERVICES = 1024, // Initial registry capacity, grows on demand
     NEOINIT_MAX_SOCKETS = 64,
     NEOINIT_MAX_TIMERS = 64,
     NEOINIT_MAX_TARGETS = 32,
@@ -226,7 +232,7 @@ typedef enum {
     NEOINIT_DEP_REQUIRED_BY = (1 << 9),   // Reverse requires
     NEOINIT_DEP_WANTED_BY = (1 << 10),    // Reverse wants
     NEOINIT_DEP_BOUND_BY = (1 << 11),     // Reverse binds
-}
+} neoinit_dep_type_t;
 
 /**
  * @brief Service runtime statistics
@@ -287,6 +293,11 @@ typedef struct {
     uint32_t file_limit_hits;      // Times file limit was hit
 } neoinit_service_stats_t;
 
+/**
+ * @brief Parsed service configuration; the template defined in service.h
+ */
+typedef struct neoinit_template neoinit_service_config_t;
+
 /**
  * @brief Complete service runtime state
  */
@@ -301,7 +312,7 @@ typedef struct {
     char state_message[NEOINIT_MAX_CMD_LENGTH];  // Current state message
 
     // Configuration
-    neoinit_service_config_t config;
+    neoinit_service_config_t *config;
     bool config_valid;             // Is configuration valid?
     time_t config_mtime;          // Last config modification time
 
@@ -393,8 +404,11 @@ typedef struct {
 // Initialization and shutdown
 int neoinit_core_init(void);
 int neoinit_core_shutdown(void);
+int neoinit_core_run(void);
 int neoinit_core_reload(void);
 int neoinit_core_emergency(void);
+void initialize_system(void);
+void emergency_shutdown(void);
 
 // Service management
 int neoinit_service_create(const char *name, neoinit_service_t **service);
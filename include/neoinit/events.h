@@ -244,6 +244,11 @@ typedef struct {
     } config;
 } neoinit_event_source_config_t;
 
+/**
+ * @brief File descriptor handler, called from the dispatching thread
+ */
+typedef int (*neoinit_fd_handler_fn)(int fd, uint32_t events, void *user_data);
+
 /**
  * @brief Event system functions
  */
@@ -274,6 +279,11 @@ int neoinit_events_dispatch(void);
 int neoinit_events_dispatch_once(int timeout_ms);
 int neoinit_events_stop(void);
 
+// File descriptor watches
+int neoinit_events_watch(int fd, uint32_t events, neoinit_fd_handler_fn handler, void *user_data);
+int neoinit_events_modify(int fd, uint32_t events);
+int neoinit_events_unwatch(int fd);
+
 // Event queue management
 int neoinit_queue_flush(void);
 size_t neoinit_queue_size(void);
@@ -286,6 +296,7 @@ int neoinit_filter_clear(void);
 
 // Utility functions
 const char *neoinit_event_type_to_string(neoinit_event_type_t type);
+int neoinit_event_type_from_string(const char *name);
 const char *neoinit_priority_to_string(neoinit_event_priority_t priority);
 uint64_t neoinit_event_get_current_id(void);
 
@@ -295,4 +306,4 @@ int neoinit_events_get_stats(char *buf, size_t size);
 void neoinit_events_debug_enable(void);
 void neoinit_events_debug_disable(void);
 
-#endif /* NEOINIT
\ No newline at end of file
+#endif /* NEOINIT_EVENTS_H */
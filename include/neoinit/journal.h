@@ -0,0 +1,119 @@
+/**
+ * @file journal.h
+ * @brief Persistent event journal for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Every event passed to neoinit_event_emit() or neoinit_event_broadcast()
+ * is encoded into a compact binary record and appended to a journal under
+ * NEOINIT_JOURNAL_DIR, so it is still there after a failed boot. The
+ * emitting thread only copies the record into a ring. A background writer
+ * moves records in batches into memory-mapped segment files of
+ * NEOINIT_JOURNAL_SEGMENT_SIZE bytes. The writer sleeps until the ring
+ * goes from empty to non-empty or fills past half. Errors and worse also
+ * wake it, and are msync()ed to disk as soon as they are appended.
+ *
+ * Each segment carries a sparse index with one entry per
+ * NEOINIT_JOURNAL_BLOCK_SIZE bytes of records. An entry holds the block's
+ * time range, a bitmask of event types and a small Bloom filter of service
+ * ids, and the segment header holds the same summary for the whole file.
+ * A query by time, type or unit reads only the segments and blocks whose
+ * summaries can match. Service ids are hashes of the unit name, so they
+ * stay valid across boots.
+ *
+ * A new segment is started on every manager start and whenever the current
+ * one fills up. Finished segments are trimmed to their used size. The
+ * oldest segments are deleted once the journal exceeds its size cap.
+ * Queries are served over the control socket:
+ *
+ *   journal [type=<event-type>] [unit=<name>] [since=<span>] [until=<span>] [limit=<n>]
+ *   journal stats
+ *
+ * since= and until= take a timespan such as "1h" or "90s", counted back
+ * from now.
+ */
+
+#ifndef NEOINIT_JOURNAL_H
+#define NEOINIT_JOURNAL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "neoinit/core.h"
+#include "neoinit/events.h"
+
+#define NEOINIT_JOURNAL_SEGMENT_SIZE (4 * 1024 * 1024)
+#define NEOINIT_JOURNAL_BLOCK_SIZE   4096               // Record bytes per index entry
+#define NEOINIT_JOURNAL_MAX_SIZE     (64ULL * 1024 * 1024)  // Default disk cap
+#define NEOINIT_JOURNAL_RING_SIZE    (256 * 1024)       // Producer ring, power of two
+#define NEOINIT_JOURNAL_DATA_MAX     256                // Event payload bytes kept
+
+/**
+ * @brief On-disk record; name, service and data follow, none NUL-terminated
+ */
+typedef struct {
+    uint64_t seq;                   // Event id; restarts with the manager
+    uint64_t usec;                  // CLOCK_REALTIME
+    uint32_t service_id;            // neoinit_journal_service_id(), 0 without a target
+    int32_t pid;
+    uint16_t size;                  // Header plus strings, 8-byte aligned
+    uint16_t type;                  // neoinit_event_type_t
+    uint16_t data_len;
+    uint16_t flags;                 // neoinit_event_flags_t
+    uint8_t priority;               // neoinit_event_priority_t
+    uint8_t name_len;
+    uint8_t service_len;
+    uint8_t source;                 // neoinit_event_source_type_t
+    uint8_t reserved[4];
+} neoinit_journal_record_t;
+
+static inline const char *neoinit_journal_record_name(const neoinit_journal_record_t *rec) {
+    return (const char *)(rec + 1);
+}
+
+static inline const char *neoinit_journal_record_service(const neoinit_journal_record_t *rec) {
+    return neoinit_journal_record_name(rec) + rec->name_len;
+}
+
+static inline const char *neoinit_journal_record_data(const neoinit_journal_record_t *rec) {
+    return neoinit_journal_record_service(rec) + rec->service_len;
+}
+
+/**
+ * @brief Query filter; zero fields match everything
+ */
+typedef struct {
+    int type;                       // neoinit_event_type_t, or -1 for any
+    const char *unit;               // Target unit name
+    uint64_t since_usec;            // CLOCK_REALTIME bounds, inclusive
+    uint64_t until_usec;
+    size_t limit;                   // Stop after this many matches
+} neoinit_journal_query_t;
+
+/**
+ * @brief Called for each match, oldest first; a non-zero return stops the query
+ */
+typedef int (*neoinit_journal_match_fn)(const neoinit_journal_record_t *rec, void *user_data);
+
+/**
+ * @brief Journal counters
+ */
+typedef struct {
+    uint64_t records;               // Appended since init
+    uint64_t dropped;               // Lost to a full ring or a failed segment
+    uint32_t segments;
+    uint64_t disk_bytes;
+    uint64_t blocks_scanned;        // Index blocks read by queries
+    uint64_t blocks_skipped;        // Index blocks ruled out by their summary
+} neoinit_journal_stats_t;
+
+int neoinit_journal_init(const char *dir, uint64_t max_bytes);
+void neoinit_journal_cleanup(void);
+void neoinit_journal_flush(void);
+int neoinit_journal_query(const neoinit_journal_query_t *query, neoinit_journal_match_fn fn, void *user_data);
+int neoinit_journal_get_stats(neoinit_journal_stats_t *stats);
+uint32_t neoinit_journal_service_id(const char *name);
+
+#endif /* NEOINIT_JOURNAL_H */
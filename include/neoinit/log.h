@@ -1 +1,87 @@
-Извините, у меня интернет говно и ничего не грузит, работать над Neoinit буду завтра т.к. не могу сделать коммит больше этого
\ No newline at end of file
+/**
+ * @file log.h
+ * @brief Asynchronous logging for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Each thread that logs gets its own single-producer ring of binary
+ * records. A record holds a timestamp, the level, the format string pointer
+ * and the raw arguments; strings are copied, but nothing is formatted on the
+ * calling thread. A background writer drains all rings in batches and
+ * formats the records. It appends them to NEOINIT_LOG_DIR and rotates at
+ * NEOINIT_MAX_LOG_SIZE. The writer sleeps until a ring goes from empty to
+ * non-empty, fills past half, or takes an error, so an idle system never
+ * wakes it.
+ *
+ * The LOG_* macros test the level before evaluating any argument, so a
+ * disabled level costs one load and a predicted branch. Levels above
+ * NEOINIT_LOG_MAX_LEVEL are removed at compile time.
+ *
+ * Before neoinit_log_init() and after neoinit_log_cleanup(), messages are
+ * formatted synchronously to stderr.
+ */
+
+#ifndef NEOINIT_LOG_H
+#define NEOINIT_LOG_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_LOG_FILE         "neoinit.log"
+#define NEOINIT_LOG_RING_SIZE    (256 * 1024)   // Bytes per thread, power of two
+#define NEOINIT_LOG_MAX_RECORD   2048           // Longer string arguments are truncated
+#define NEOINIT_LOG_ROTATE_COUNT 4              // neoinit.log.1 .. neoinit.log.N
+
+#ifndef NEOINIT_LOG_MAX_LEVEL
+#define NEOINIT_LOG_MAX_LEVEL NEOINIT_LOG_TRACE
+#endif
+
+/**
+ * @brief Record header; packed arguments follow, each in 8-byte slots
+ */
+typedef struct {
+    uint64_t timestamp;             // CLOCK_REALTIME, ns
+    const char *fmt;                // NULL marks padding up to the ring end
+    uint32_t size;                  // Header plus arguments, 8-byte aligned
+    uint8_t level;                  // neoinit_log_level_t
+    uint8_t nargs;
+    uint16_t thread;                // Ring index of the logging thread
+} neoinit_log_record_t;
+
+extern volatile int neoinit_log_threshold;
+
+static inline bool neoinit_log_enabled(int level) {
+    return level <= NEOINIT_LOG_MAX_LEVEL && __builtin_expect(level <= neoinit_log_threshold, 0);
+}
+
+#define NEOINIT_LOG(level, fmt, ...)                                    \
+    do {                                                                \
+        if (neoinit_log_enabled(level)) neoinit_log(level, fmt, ##__VA_ARGS__); \
+    } while (0)
+
+#define LOG_EMERG(fmt, ...)   NEOINIT_LOG(NEOINIT_LOG_EMERG, fmt, ##__VA_ARGS__)
+#define LOG_ALERT(fmt, ...)   NEOINIT_LOG(NEOINIT_LOG_ALERT, fmt, ##__VA_ARGS__)
+#define LOG_CRIT(fmt, ...)    NEOINIT_LOG(NEOINIT_LOG_CRIT, fmt, ##__VA_ARGS__)
+#define LOG_ERROR(fmt, ...)   NEOINIT_LOG(NEOINIT_LOG_ERROR, fmt, ##__VA_ARGS__)
+#define LOG_WARNING(fmt, ...) NEOINIT_LOG(NEOINIT_LOG_WARNING, fmt, ##__VA_ARGS__)
+#define LOG_NOTICE(fmt, ...)  NEOINIT_LOG(NEOINIT_LOG_NOTICE, fmt, ##__VA_ARGS__)
+#define LOG_INFO(fmt, ...)    NEOINIT_LOG(NEOINIT_LOG_INFO, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG(fmt, ...)   NEOINIT_LOG(NEOINIT_LOG_DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_TRACE(fmt, ...)   NEOINIT_LOG(NEOINIT_LOG_TRACE, fmt, ##__VA_ARGS__)
+
+int neoinit_log_init(const char *dir);
+void neoinit_log_cleanup(void);
+void neoinit_log_set_level(int level);
+int neoinit_log_get_level(void);
+void neoinit_log_flush(void);
+uint64_t neoinit_log_dropped(void);
+const char *neoinit_log_level_to_string(int level);
+
+void neoinit_vlog(int level, const char *fmt, va_list ap) __attribute__((format(printf, 2, 0)));
+
+#endif /* NEOINIT_LOG_H */
@@ -0,0 +1,84 @@
+/**
+ * @file metrics.h
+ * @brief Manager self-instrumentation: counters and latency histograms
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Each thread updates its own block of counters and histograms, so the hot
+ * path is a couple of uncontended stores. Readers merge all blocks when a
+ * snapshot is requested. Histograms are log-linear (HDR style): every power
+ * of two is split into 2^NEOINIT_METRICS_SUB_BITS buckets, which keeps the
+ * relative error of any reported quantile under 12.5%.
+ */
+
+#ifndef NEOINIT_METRICS_H
+#define NEOINIT_METRICS_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_METRICS_SUB_BITS 3
+#define NEOINIT_METRICS_BUCKETS  (64 << NEOINIT_METRICS_SUB_BITS)
+
+/**
+ * @brief Monotonic event counters
+ */
+typedef enum {
+    NEOINIT_COUNTER_EPOLL_WAKEUPS = 0,
+    NEOINIT_COUNTER_EVENTS_DISPATCHED,
+    NEOINIT_COUNTER_FORKS,
+    NEOINIT_COUNTER_FORK_FAILURES,
+    NEOINIT_COUNTER_REAPS,
+    NEOINIT_COUNTER_CONTROL_REQUESTS,
+    NEOINIT_COUNTER_CONTROL_ERRORS,
+    NEOINIT_COUNTER_CONFIG_RELOADS,
+    NEOINIT_COUNTER_ADMISSION_DEFERRED,
+    NEOINIT_COUNTER_PRESSURE_EVENTS,
+    NEOINIT_COUNTER_MAX
+} neoinit_counter_t;
+
+/**
+ * @brief Latency and depth histograms (values in ns unless noted)
+ */
+typedef enum {
+    NEOINIT_HIST_DISPATCH_LATENCY = 0,  // One fd handler invocation
+    NEOINIT_HIST_QUEUE_DEPTH,           // Ready events per wakeup (count)
+    NEOINIT_HIST_FORK_EXEC_LATENCY,     // fork() until the parent resumes
+    NEOINIT_HIST_REAP_LATENCY,          // SIGCHLD wakeup until state updated
+    NEOINIT_HIST_CONTROL_LATENCY,       // Control request parse to reply
+    NEOINIT_HIST_CONFIG_RELOAD,         // Full configuration reload
+    NEOINIT_HIST_ADMISSION_WAIT,        // Start queued until admitted
+    NEOINIT_HIST_MAX
+} neoinit_histogram_t;
+
+/**
+ * @brief Merged view of one histogram
+ */
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t min;
+    uint64_t max;
+    uint64_t p50;
+    uint64_t p90;
+    uint64_t p99;
+    uint64_t p999;
+} neoinit_histogram_summary_t;
+
+void neoinit_metrics_inc(neoinit_counter_t counter);
+void neoinit_metrics_add(neoinit_counter_t counter, uint64_t value);
+void neoinit_metrics_observe(neoinit_histogram_t hist, uint64_t value);
+
+uint64_t neoinit_metrics_counter(neoinit_counter_t counter);
+int neoinit_metrics_summary(neoinit_histogram_t hist, neoinit_histogram_summary_t *summary);
+void neoinit_metrics_reset(void);
+
+const char *neoinit_counter_to_string(neoinit_counter_t counter);
+const char *neoinit_histogram_to_string(neoinit_histogram_t hist);
+int neoinit_metrics_format_json(char *buf, size_t size);
+
+#endif /* NEOINIT_METRICS_H */
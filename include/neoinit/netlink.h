@@ -0,0 +1,97 @@
+/**
+ * @file netlink.h
+ * @brief Netlink device and link events for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Two netlink sockets feed the event loop. The first carries kernel
+ * kobject uevents and becomes NEOINIT_EVENT_HW_ADDED and
+ * NEOINIT_EVENT_HW_REMOVED. The second is rtnetlink link notifications,
+ * which become NEOINIT_EVENT_NETWORK_UP and NEOINIT_EVENT_NETWORK_DOWN when
+ * an interface's operational state changes. Both sockets get a receive
+ * buffer of NEOINIT_NETLINK_RCVBUF bytes, forced past rmem_max where the
+ * manager is allowed to. Every wakeup drains them with recvmmsg() in
+ * batches of NEOINIT_NETLINK_BATCH datagrams, so a coldplug burst of
+ * thousands of uevents costs a few dozen system calls. A receive buffer
+ * overrun is counted and logged, never ignored silently.
+ *
+ * Device rules in NEOINIT_DEVICES_DIR start a unit when a device or link
+ * shows up. Each "*.device" file holds one rule, written as "Key=Value"
+ * lines:
+ *
+ *   Unit=         unit to start, defaults to the file name without ".device"
+ *   Subsystem=    uevent SUBSYSTEM
+ *   DevType=      uevent DEVTYPE
+ *   Action=       add (default), remove, change, bind, unbind, move, online, offline or any
+ *   Property=     KEY=pattern, any other uevent property; may repeat
+ *   Interface=    link name; makes this a link rule
+ *   State=        up (default) or down, for link rules
+ *
+ * Values are fnmatch() patterns. Rules are compiled once after loading.
+ * Every property a rule mentions gets a fixed slot. Rules are bucketed by
+ * source, action and literal subsystem, and a crowded bucket is split
+ * again on the literal property most of its rules share. As a result each
+ * uevent is split into slots in a single pass and checked only against
+ * rules that could match it. A rule fires at most once per batch. Devices
+ * and links present before the manager started are matched once, from
+ * sysfs and from an RTM_GETLINK dump.
+ *
+ * neoinit_netlink_adopt() swaps a source's kernel socket for any datagram
+ * fd, for example one end of a socketpair carrying a recorded stream.
+ * Counters are served over the control socket by the "devices" verb.
+ * Every entry point must run on the event loop thread, or before it starts.
+ */
+
+#ifndef NEOINIT_NETLINK_H
+#define NEOINIT_NETLINK_H
+
+#include <stdint.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_NETLINK_RCVBUF       (8 * 1024 * 1024)  // Socket receive buffer
+#define NEOINIT_NETLINK_BATCH        64                 // Datagrams per recvmmsg()
+#define NEOINIT_NETLINK_MSG_SIZE     8192               // Largest datagram kept whole
+#define NEOINIT_NETLINK_MAX_PROPS    8                  // Property= lines per rule
+#define NEOINIT_NETLINK_MAX_KEYS     64                 // Distinct property keys across rules
+#define NEOINIT_NETLINK_SPLIT_MIN    8                  // Rules in a subsystem bucket before it is split
+
+/**
+ * @brief Netlink sources
+ */
+typedef enum {
+    NEOINIT_NETLINK_UEVENT = 0,     // Kernel kobject uevents
+    NEOINIT_NETLINK_ROUTE,          // rtnetlink link notifications
+    NEOINIT_NETLINK_SOURCE_MAX
+} neoinit_netlink_source_t;
+
+/**
+ * @brief Starts the unit a rule is bound to; runs on the event loop thread
+ */
+typedef int (*neoinit_netlink_activate_fn)(const char *unit, void *user_data);
+
+/**
+ * @brief Engine counters
+ */
+typedef struct {
+    uint32_t rules;
+    uint64_t messages;              // Datagrams read, both sources
+    uint64_t batches;               // recvmmsg() calls that returned data
+    uint64_t overflows;             // ENOBUFS: the kernel dropped messages
+    uint64_t rejected;              // Malformed, truncated or from a user-space sender
+    uint64_t uevents;
+    uint64_t links;                 // Link state transitions
+    uint64_t candidates;            // Rules tested after bucketing
+    uint64_t matches;               // Rule activations
+} neoinit_netlink_stats_t;
+
+int neoinit_netlink_init(neoinit_netlink_activate_fn activate, void *user_data);
+void neoinit_netlink_cleanup(void);
+int neoinit_netlink_load(const char *dir);
+int neoinit_netlink_coldplug(void);
+int neoinit_netlink_adopt(neoinit_netlink_source_t source, int fd);
+int neoinit_netlink_get_stats(neoinit_netlink_stats_t *stats);
+
+#endif /* NEOINIT_NETLINK_H */
@@ -0,0 +1,51 @@
+/**
+ * @file output.h
+ * @brief Zero-copy capture of unit stdout/stderr for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Each active unit writes stdout and stderr into one pipe. The manager
+ * moves the data with splice() into "<logs_dir>/<unit>.log" and rotates
+ * the file at NEOINIT_MAX_LOG_SIZE. Live followers attached through the
+ * control socket ("follow <unit>") each get a copy through tee() into
+ * their own pipe, spliced on to the socket. Service output never passes
+ * through a userspace buffer in the manager.
+ *
+ * A per-unit token bucket bounds how many bytes per second reach the
+ * file. Output over budget is spliced into /dev/null and replaced by a
+ * single "suppressed" marker once the bucket refills.
+ */
+
+#ifndef NEOINIT_OUTPUT_H
+#define NEOINIT_OUTPUT_H
+
+#include <stdint.h>
+#include "neoinit/core.h"
+#include "neoinit/service.h"
+
+#define NEOINIT_OUTPUT_RATE          (256 * 1024)   // Default bytes per second
+#define NEOINIT_OUTPUT_BURST         (4 * 1024 * 1024)
+#define NEOINIT_OUTPUT_PIPE_SIZE     (256 * 1024)
+#define NEOINIT_OUTPUT_MAX_FOLLOWERS 8
+
+/**
+ * @brief Capture counters for one unit
+ */
+typedef struct {
+    uint64_t written;               // Bytes spliced into the log file
+    uint64_t suppressed;            // Bytes discarded by the rate limit
+    uint32_t followers;
+} neoinit_output_stats_t;
+
+int neoinit_output_init(void);
+int neoinit_output_open(neoinit_unit_t *unit, int *child_fd);
+void neoinit_output_close(neoinit_unit_t *unit);
+int neoinit_output_adopt(neoinit_unit_t *unit, int fd);
+int neoinit_output_fd(const neoinit_unit_t *unit);
+int neoinit_output_follow(neoinit_unit_t *unit, int sock);
+int neoinit_output_get_stats(const neoinit_unit_t *unit, neoinit_output_stats_t *stats);
+
+#endif /* NEOINIT_OUTPUT_H */
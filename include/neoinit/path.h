@@ -0,0 +1,103 @@
+/**
+ * @file path.h
+ * @brief Path units: filesystem-triggered activation for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * A path unit starts a unit when a file exists, when it changes (is
+ * written and closed, created, moved or removed), or when a directory
+ * becomes non-empty.
+ *
+ * Every condition is served by a watch on a directory, never on the file
+ * itself. All watches live on one inotify instance and use one fixed mask,
+ * so units that watch the same directory share a watch descriptor and a
+ * single event is fanned out to all of them. A missing directory is
+ * handled by watching its closest existing ancestor until the next path
+ * component appears. The mask carries IN_CLOSE_WRITE rather than
+ * IN_MODIFY, so a writer produces one event per file and not one per
+ * write. After a read that returned events, the inotify fd is parked for
+ * NEOINIT_PATH_BATCH_USEC. A steady stream of events therefore costs one
+ * wakeup per interval rather than one per event.
+ *
+ * A matching event only marks the path pending. One timerfd fires after
+ * the debounce window, and the path activates once if its condition still
+ * holds, however many events arrived in the window. Level conditions
+ * (exists, non-empty) are checked again when the activated unit goes
+ * inactive, so work that arrived while it ran is not lost.
+ *
+ * Path files in NEOINIT_PATHS_DIR hold one "Key=Value" per line: Unit=,
+ * PathExists=, PathChanged=, DirectoryNotEmpty= and DebounceSec=. Every
+ * entry point must run on the event loop thread, or before it starts.
+ */
+
+#ifndef NEOINIT_PATH_H
+#define NEOINIT_PATH_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_PATH_MAX_SPECS       8              // Conditions per path unit
+#define NEOINIT_PATH_DEBOUNCE_USEC   100000ULL      // Default burst window
+#define NEOINIT_PATH_READ_BUFFER     65536          // Events drained per read()
+#define NEOINIT_PATH_BATCH_USEC      10000ULL       // Minimum gap between inotify reads
+
+/**
+ * @brief Path conditions
+ */
+typedef enum {
+    NEOINIT_PATH_EXISTS = 0,
+    NEOINIT_PATH_CHANGED,
+    NEOINIT_PATH_DIRECTORY_NOT_EMPTY,
+    NEOINIT_PATH_KIND_MAX
+} neoinit_path_kind_t;
+
+/**
+ * @brief Starts the unit a path is bound to; runs on the event loop thread
+ */
+typedef int (*neoinit_path_activate_fn)(const char *unit, void *user_data);
+
+typedef struct neoinit_path neoinit_path_t;
+
+/**
+ * @brief Path unit snapshot
+ */
+typedef struct {
+    bool armed;
+    bool pending;                   // Inside its debounce window
+    uint64_t events;                // Matching inotify events
+    uint64_t triggers;              // Activations
+} neoinit_path_info_t;
+
+/**
+ * @brief Engine snapshot
+ */
+typedef struct {
+    uint32_t paths;
+    uint32_t watches;               // Directory watches, shared between paths
+    uint64_t events;                // inotify events read
+    uint64_t wakeups;               // inotify reads plus debounce expiries
+    uint64_t triggers;
+    uint64_t overflows;             // IN_Q_OVERFLOW, answered with a full re-check
+} neoinit_path_stats_t;
+
+// Engine
+int neoinit_path_init(neoinit_path_activate_fn activate, void *user_data);
+void neoinit_path_cleanup(void);
+int neoinit_path_load(const char *dir);
+void neoinit_path_unit_inactive(const char *unit);
+
+// Paths
+neoinit_path_t *neoinit_path_create(const char *name, const char *unit);
+neoinit_path_t *neoinit_path_lookup(const char *name);
+int neoinit_path_add(neoinit_path_t *path, neoinit_path_kind_t kind, const char *file);
+int neoinit_path_set_debounce(neoinit_path_t *path, uint64_t usec);
+int neoinit_path_arm(neoinit_path_t *path);
+int neoinit_path_disarm(neoinit_path_t *path);
+int neoinit_path_get_info(const neoinit_path_t *path, neoinit_path_info_t *info);
+int neoinit_path_get_stats(neoinit_path_stats_t *stats);
+
+#endif /* NEOINIT_PATH_H */
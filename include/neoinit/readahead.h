@@ -0,0 +1,63 @@
+/**
+ * @file readahead.h
+ * @brief Boot file profiler and page cache prefetch for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * On the first boot after the unit configuration changes, and only if the
+ * pack directory is writable, a low-priority profiler thread samples
+ * /proc/<pid>/maps and /proc/<pid>/fd of every process and records the
+ * files boot touches, in first-use order. The list is stored as a compact
+ * pack per target under NEOINIT_CACHE_DIR. On later boots a low-priority
+ * thread replays the pack with readahead() before units are
+ * scheduled, so their binaries and libraries are already in the page cache.
+ */
+
+#ifndef NEOINIT_READAHEAD_H
+#define NEOINIT_READAHEAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_READAHEAD_DIR         NEOINIT_CACHE_DIR "/readahead"
+#define NEOINIT_READAHEAD_MAGIC       0x3141524eU   // "NRA1"
+#define NEOINIT_READAHEAD_VERSION     1
+#define NEOINIT_READAHEAD_MAX_FILES   16384
+#define NEOINIT_READAHEAD_MAX_EXTENT  (32ULL * 1024 * 1024)
+#define NEOINIT_READAHEAD_SAMPLE_MS   50
+#define NEOINIT_READAHEAD_PROFILE_SEC 60
+
+/**
+ * @brief What the readahead subsystem is doing this boot
+ */
+typedef enum {
+    NEOINIT_READAHEAD_IDLE = 0,
+    NEOINIT_READAHEAD_PROFILE,      // No valid pack: recording
+    NEOINIT_READAHEAD_REPLAY,       // Prefetching from a pack
+} neoinit_readahead_mode_t;
+
+/**
+ * @brief On-disk pack header, followed by @c count entries
+ *
+ * Each entry is a little-endian uint64 extent length, a uint16 path length
+ * and the path bytes without a terminator. Entries are in replay order.
+ */
+typedef struct __attribute__((packed)) {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t flags;
+    uint64_t fingerprint;           // Configuration the pack was recorded for
+    uint32_t count;
+    uint32_t reserved;
+} neoinit_readahead_header_t;
+
+int neoinit_readahead_start(const char *target, uint64_t fingerprint);
+int neoinit_readahead_stop(void);
+neoinit_readahead_mode_t neoinit_readahead_mode(void);
+uint64_t neoinit_readahead_fingerprint(const char *dir);
+
+#endif /* NEOINIT_READAHEAD_H */
@@ -0,0 +1,152 @@
+/**
+ * @file service.h
+ * @brief Unit registry, templates and dependency graph for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * The registry has no compile-time unit limit. Units live in fixed-size
+ * slabs so their addresses never move, names are indexed by an open
+ * addressing hash table, and dependency edges are stored in both
+ * directions so start, stop and lookup never scan the whole unit set.
+ *
+ * Templated units ("name@") hold the parsed configuration once; every
+ * instance ("name@instance") only carries its runtime state and a pointer
+ * to the shared template.
+ */
+
+#ifndef NEOINIT_SERVICE_H
+#define NEOINIT_SERVICE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_UNIT_INSTANCE_CHAR   '@'
+#define NEOINIT_UNIT_INSTANCE_SPEC   "%i"
+#define NEOINIT_UNIT_ID_INVALID      UINT32_MAX
+
+/**
+ * @brief Parsed unit configuration, shared by all instances of a template
+ */
+typedef struct neoinit_template {
+    char *name;                     // "foo" for plain units, "foo@" for templates
+    uint32_t id;                    // Template index
+    uint32_t refs;                  // Number of units using this template
+    neoinit_service_type_t type;
+    uint32_t flags;                 // neoinit_service_flags_t
+
+    char **exec_argv;               // NULL terminated, may contain "%i"
+    char *working_directory;
+    char **environment;
+    uint32_t env_count;
+
+    char **deps;                    // Required units, may contain "%i"
+    uint32_t dep_count;
+    char **wants;
+    uint32_t wants_count;
+    char **conflicts;
+    uint32_t conflicts_count;
+
+    int restart_delay;
+    int watchdog_usec;
+    int timeout_start_usec;
+    int timeout_stop_usec;
+
+    char *logs_dir;                 // Output capture directory, NULL for NEOINIT_LOG_DIR
+    uint64_t output_rate;           // Captured bytes per second, 0 = unlimited
+    uint64_t output_burst;          // Token bucket depth in bytes
+
+    bool has_specifiers;            // Any dep or argv refers to the instance
+    bool deps_resolved;             // dep_ids below is valid
+    uint32_t *dep_ids;              // Shared resolved deps when !has_specifiers
+} neoinit_template_t;
+
+/**
+ * @brief Runtime state of a single unit or template instance
+ *
+ * Kept deliberately small: configuration lives in the template and
+ * per-unit fds (such as the notification eventfd) are only opened while
+ * the unit is active.
+ */
+typedef struct neoinit_unit {
+    char *name;                     // Full unit name ("foo" or "foo@bar")
+    const char *instance;           // Points into name after '@', or NULL
+    neoinit_template_t *tmpl;
+    uint32_t id;                    // Dense index, stable for the unit lifetime
+    uint32_t hash;
+
+    neoinit_service_state_t state;
+    pid_t pid;
+    int exit_code;
+    int notification_fd;            // -1 while inactive
+    int stop_timer_fd;              // SIGKILL escalation while stopping, -1 otherwise
+    struct neoinit_output *output;  // stdout/stderr capture, NULL while inactive
+    struct neoinit_cgroup *cgroup;  // Process-tree cgroup, NULL without cgroup v2
+    uint32_t restart_attempts;
+    uint8_t admission;              // neoinit_admission_state_t
+    uint64_t queued_at;             // When the start was queued, then launched, ns
+    bool enabled;
+    bool linked;                    // dep_ids/rdep edges are in place
+    bool owns_dep_ids;
+    bool stop_pending;              // Stop once no reverse dependency is still stopping
+    bool start_pending;             // Start again once the current stop completes
+    time_t start_time;
+    time_t stop_time;
+    pthread_mutex_t lock;
+
+    uint32_t *dep_ids;              // Resolved required units
+    uint32_t dep_count;
+    uint32_t *rdep_ids;             // Units that require this one
+    uint32_t rdep_count;
+    uint32_t rdep_cap;
+
+    uint32_t visit_epoch;           // Graph walk bookkeeping
+} neoinit_unit_t;
+
+/**
+ * @brief Registry statistics
+ */
+typedef struct {
+    size_t unit_count;
+    size_t template_count;
+    size_t edge_count;
+    size_t index_capacity;
+    size_t memory_bytes;            // Approximate heap footprint
+} neoinit_registry_stats_t;
+
+// Registry lifecycle
+int neoinit_registry_init(size_t capacity_hint);
+void neoinit_registry_cleanup(void);
+size_t neoinit_registry_count(void);
+int neoinit_registry_get_stats(neoinit_registry_stats_t *stats);
+
+// Templates
+neoinit_template_t *neoinit_template_create(const char *name);
+neoinit_template_t *neoinit_template_lookup(const char *name);
+neoinit_template_t *neoinit_template_get(uint32_t id);
+int neoinit_template_add_dep(neoinit_template_t *tmpl, const char *dep);
+int neoinit_template_set_exec(neoinit_template_t *tmpl, char *const argv[]);
+
+// Units
+int neoinit_unit_add(const char *name, neoinit_template_t *tmpl, neoinit_unit_t **unit);
+neoinit_unit_t *neoinit_unit_get(uint32_t id);
+neoinit_unit_t *neoinit_unit_lookup(const char *name);
+neoinit_unit_t *neoinit_unit_instantiate(const char *name);
+int neoinit_unit_expand(const neoinit_unit_t *unit, const char *in, char *out, size_t size);
+int neoinit_unit_set_pid(neoinit_unit_t *unit, pid_t pid);
+neoinit_unit_t *neoinit_unit_by_pid(pid_t pid);
+
+// Dependency graph
+int neoinit_unit_link(neoinit_unit_t *unit);
+int neoinit_registry_link(void);
+int neoinit_registry_order(uint32_t *order, size_t *count);
+uint32_t neoinit_registry_next_epoch(void);
+
+#endif /* NEOINIT_SERVICE_H */
@@ -0,0 +1,64 @@
+/**
+ * @file shutdown.h
+ * @brief Dependency-ordered parallel shutdown engine for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Units are stopped in waves over the reverse dependency graph: every unit
+ * nothing else depends on is sent SIGTERM at once, and a unit is released
+ * for stopping as soon as the last unit requiring it has exited. Children
+ * are reaped asynchronously, each unit is escalated to SIGKILL after its own
+ * stop timeout, and a global deadline bounds the whole phase.
+ */
+
+#ifndef NEOINIT_SHUTDOWN_H
+#define NEOINIT_SHUTDOWN_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_SHUTDOWN_DEADLINE_USEC   (90ULL * 1000000ULL)
+#define NEOINIT_SHUTDOWN_FINAL_KILL_USEC (5ULL * 1000000ULL)
+
+/**
+ * @brief What to do once all units have stopped
+ */
+typedef enum {
+    NEOINIT_SHUTDOWN_NONE = 0,      // Stop units and return
+    NEOINIT_SHUTDOWN_HALT,
+    NEOINIT_SHUTDOWN_POWEROFF,
+    NEOINIT_SHUTDOWN_REBOOT,
+} neoinit_shutdown_action_t;
+
+/**
+ * @brief Shutdown parameters
+ */
+typedef struct {
+    neoinit_shutdown_action_t action;
+    uint64_t deadline_usec;         // Global budget for stopping units, 0 = default
+    bool kill_remaining;            // SIGTERM/SIGKILL processes outside any unit
+    bool unmount;                   // Unmount or remount read-only before reboot()
+} neoinit_shutdown_config_t;
+
+/**
+ * @brief Outcome of a shutdown run
+ */
+typedef struct {
+    uint32_t units_stopped;         // Units signalled and reaped
+    uint32_t units_killed;          // Units escalated to SIGKILL
+    uint32_t waves;                 // Number of dependency waves
+    uint64_t elapsed_usec;
+    bool deadline_hit;
+} neoinit_shutdown_result_t;
+
+int neoinit_shutdown_run(const neoinit_shutdown_config_t *config, neoinit_shutdown_result_t *result);
+int neoinit_shutdown_unmount_all(void);
+
+// Stops the manager's event loop, then runs the engine (src/neoinit.c)
+int shutdown_system(const neoinit_shutdown_config_t *config, neoinit_shutdown_result_t *result);
+
+#endif /* NEOINIT_SHUTDOWN_H */
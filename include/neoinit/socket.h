@@ -0,0 +1,51 @@
+/**
+ * @file socket.h
+ * @brief Control socket protocol for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Clients send one request per line: a verb followed by space separated
+ * arguments. Every reply is framed as "<status> <length>\n" followed by
+ * exactly <length> bytes of body, where status is a neoinit_error_t.
+ * Subsystems add verbs with neoinit_control_register().
+ */
+
+#ifndef NEOINIT_SOCKET_H
+#define NEOINIT_SOCKET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_CONTROL_MAX_REQUEST 4096
+#define NEOINIT_CONTROL_MAX_ARGS    16
+#define NEOINIT_CONTROL_MAX_VERBS   64
+
+// Overrides the manager's socket path, e.g. for unprivileged benchmark runs
+#define NEOINIT_CONTROL_SOCKET_ENV "NEOINIT_CONTROL_SOCKET"
+
+typedef struct neoinit_control_conn neoinit_control_conn_t;
+
+/**
+ * @brief Verb handler; the return value becomes the reply status
+ */
+typedef int (*neoinit_control_handler_fn)(neoinit_control_conn_t *conn, int argc, char **argv,
+                                          void *user_data);
+
+int neoinit_control_init(const char *path);
+int neoinit_control_adopt(int fd, const char *path);
+void neoinit_control_cleanup(void);
+int neoinit_control_fd(void);
+const char *neoinit_control_path(void);
+int neoinit_control_register(const char *verb, neoinit_control_handler_fn handler, void *user_data);
+
+int neoinit_control_write(neoinit_control_conn_t *conn, const void *buf, size_t len);
+int neoinit_control_printf(neoinit_control_conn_t *conn, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+int neoinit_control_write_fd(neoinit_control_conn_t *conn, int fd);
+int neoinit_control_detach(neoinit_control_conn_t *conn);
+
+#endif /* NEOINIT_SOCKET_H */
@@ -0,0 +1,72 @@
+/**
+ * @file state.h
+ * @brief Runtime state serialization and re-exec for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Lets the manager replace its own binary without touching running units.
+ * The registry is written into a sealed memfd as one versioned binary image:
+ * a fixed header, every template, then every unit with its pid, state,
+ * counters, timestamps and open descriptors. Descriptors are not copied.
+ * They are kept open across execve() by clearing FD_CLOEXEC, and the image
+ * records their numbers. The new binary finds the image through
+ * NEOINIT_STATE_FD_ENV, rebuilds the registry with the same unit ids, and
+ * adopts the descriptors. Children are never signalled or waited on during
+ * the handover; SIGCHLD stays blocked across the exec and is picked up by
+ * the new signalfd.
+ *
+ * If memfd_create() is unavailable, the image goes to NEOINIT_STATE_FILE
+ * instead.
+ */
+
+#ifndef NEOINIT_STATE_H
+#define NEOINIT_STATE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_STATE_MAGIC      0x5453494eu    // "NIST"
+#define NEOINIT_STATE_VERSION    2              // Bumped on any incompatible layout change
+#define NEOINIT_STATE_FD_ENV     "NEOINIT_STATE_FD"
+
+#define NEOINIT_STATE_FLAG_FILE  (1u << 0)      // Image lives in NEOINIT_STATE_FILE
+
+/**
+ * @brief Image header; the payload follows immediately
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;           // sizeof(neoinit_state_header_t) of the writer
+    uint32_t flags;
+    uint32_t template_count;
+    uint32_t unit_count;
+    int32_t control_fd;             // Listening control socket, -1 if none
+    uint64_t payload_size;
+    uint64_t checksum;              // FNV-1a over the payload
+    uint64_t created;               // Monotonic ns, survives the exec
+} neoinit_state_header_t;
+
+/**
+ * @brief What a serialize or restore pass handled
+ */
+typedef struct {
+    uint64_t bytes;
+    uint32_t templates;
+    uint32_t units;
+    uint32_t fds;                   // Descriptors carried across the exec
+    uint64_t elapsed_usec;          // Serialize time, or image age on restore
+} neoinit_state_stats_t;
+
+int neoinit_state_serialize(int fd, uint32_t flags, neoinit_state_stats_t *stats);
+int neoinit_state_deserialize(int fd, neoinit_state_stats_t *stats);
+
+bool neoinit_state_pending(void);
+int neoinit_state_restore(neoinit_state_stats_t *stats);
+int neoinit_state_reexec(const char *path);
+
+#endif /* NEOINIT_STATE_H */
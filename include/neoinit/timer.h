@@ -0,0 +1,108 @@
+/**
+ * @file timer.h
+ * @brief Timer units: calendar and monotonic activation for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * A timer starts a unit when one of its expressions elapses. Calendar
+ * expressions use the systemd syntax, e.g. "Mon..Fri *-*-* 09:30" or
+ * "hourly". They are compiled once into per-field bitmasks, so computing
+ * the next elapse jumps straight to the next set bit of each field rather
+ * than stepping through time. Monotonic expressions count from boot, from
+ * arming, or from the last trigger.
+ *
+ * All timers share one timerfd ordered by a min-heap of deadlines. Each
+ * timer has an accuracy window: the timerfd is armed at the latest moment
+ * that is still inside the window of every due timer, so nearby deadlines
+ * share one wakeup. A randomized delay spreads timers that would otherwise
+ * fire together. The delay is derived from a hash of the timer name and a
+ * per-host seed, so a given job always lands at the same offset.
+ *
+ * Calendar deadlines are converted to the monotonic clock when they are
+ * armed and checked against wall time again when they fire.
+ *
+ * Timer files in NEOINIT_TIMERS_DIR hold one "Key=Value" per line: Unit=,
+ * OnCalendar=, OnBootSec=, OnActiveSec=, OnUnitActiveSec=, AccuracySec=
+ * and RandomizedDelaySec=. Every entry point must run on the event loop
+ * thread, or before it starts.
+ */
+
+#ifndef NEOINIT_TIMER_H
+#define NEOINIT_TIMER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_TIMER_ACCURACY_USEC  1000000ULL     // Default coalescing window
+#define NEOINIT_TIMER_MAX_SPECS      8              // Expressions per timer
+#define NEOINIT_TIMER_SEED_FILE      "/etc/machine-id"
+
+/**
+ * @brief What a monotonic expression counts from
+ */
+typedef enum {
+    NEOINIT_TIMER_ON_BOOT = 0,      // Boot, fires once
+    NEOINIT_TIMER_ON_ARMED,         // Arming of the timer, fires once
+    NEOINIT_TIMER_ON_ACTIVE,        // Last trigger, repeats
+    NEOINIT_TIMER_CALENDAR,
+} neoinit_timer_base_t;
+
+/**
+ * @brief Compiled calendar expression; bit n set means value n matches
+ */
+typedef struct {
+    uint64_t seconds;               // 0..59
+    uint64_t minutes;               // 0..59
+    uint32_t hours;                 // 0..23
+    uint32_t mdays;                 // 1..31
+    uint16_t months;                // 1..12
+    uint8_t wdays;                  // 0..6, Sunday is 0
+    bool utc;
+} neoinit_calendar_t;
+
+/**
+ * @brief Starts the unit a timer is bound to; runs on the event loop thread
+ */
+typedef int (*neoinit_timer_activate_fn)(const char *unit, void *user_data);
+
+typedef struct neoinit_timer neoinit_timer_t;
+
+/**
+ * @brief Timer snapshot
+ */
+typedef struct {
+    bool armed;
+    time_t next;                    // Wall clock of the next elapse, 0 if none
+    time_t last;                    // Wall clock of the last trigger, 0 if never
+    uint64_t triggers;
+    uint64_t delay_usec;            // This timer's share of the randomized delay
+} neoinit_timer_info_t;
+
+// Expressions
+int neoinit_calendar_parse(const char *expr, neoinit_calendar_t *cal);
+int neoinit_calendar_next(const neoinit_calendar_t *cal, time_t after, time_t *next);
+int neoinit_timespan_parse(const char *span, uint64_t *usec);
+
+// Engine
+int neoinit_timer_init(neoinit_timer_activate_fn activate, void *user_data);
+void neoinit_timer_cleanup(void);
+int neoinit_timer_load(const char *dir);
+
+// Timers
+neoinit_timer_t *neoinit_timer_create(const char *name, const char *unit);
+neoinit_timer_t *neoinit_timer_lookup(const char *name);
+int neoinit_timer_add_calendar(neoinit_timer_t *timer, const char *expr);
+int neoinit_timer_add_monotonic(neoinit_timer_t *timer, neoinit_timer_base_t base, uint64_t usec);
+int neoinit_timer_set_accuracy(neoinit_timer_t *timer, uint64_t usec);
+int neoinit_timer_set_randomized_delay(neoinit_timer_t *timer, uint64_t usec);
+int neoinit_timer_arm(neoinit_timer_t *timer);
+int neoinit_timer_disarm(neoinit_timer_t *timer);
+int neoinit_timer_get_info(const neoinit_timer_t *timer, neoinit_timer_info_t *info);
+uint64_t neoinit_timer_wakeups(void);
+
+#endif /* NEOINIT_TIMER_H */
@@ -0,0 +1,68 @@
+/**
+ * @file trace.h
+ * @brief Boot timeline tracer for Neoinit
+ * @author NurOS Team
+ * @date 2026-10-18
+ * @version 1.0.0-dev
+ *
+ * @copyright Copyright (c) 2024 Nuros Linux. Licensed under GPL-3.0.
+ *
+ * Every thread that records a phase gets its own single-producer ring of
+ * fixed-size records, so recording is a timestamp read and a store with no
+ * lock or shared cache line. A collector drains all rings on demand and
+ * builds per-unit timelines for the Chrome trace-event exporter and the
+ * critical-path report.
+ */
+
+#ifndef NEOINIT_TRACE_H
+#define NEOINIT_TRACE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "neoinit/core.h"
+
+#define NEOINIT_TRACE_RING_SIZE 8192    // Records per thread, power of two
+
+/**
+ * @brief Unit lifecycle phases, in the order they normally occur
+ */
+typedef enum {
+    NEOINIT_TRACE_QUEUED = 0,       // Start requested
+    NEOINIT_TRACE_DEPS_SATISFIED,   // All dependencies running
+    NEOINIT_TRACE_FORK,             // About to fork()
+    NEOINIT_TRACE_EXEC,             // Child about to execve()
+    NEOINIT_TRACE_READY,            // Readiness notification received
+    NEOINIT_TRACE_RUNNING,          // Marked running by the manager
+    NEOINIT_TRACE_PHASE_MAX
+} neoinit_trace_phase_t;
+
+/**
+ * @brief One trace record
+ */
+typedef struct {
+    uint64_t timestamp;             // neoinit_get_monotonic_time(), ns
+    uint32_t unit_id;
+    uint16_t phase;                 // neoinit_trace_phase_t
+    uint16_t thread;                // Ring index of the recording thread
+} neoinit_trace_record_t;
+
+extern volatile bool neoinit_trace_active;
+
+static inline bool neoinit_trace_enabled(void) {
+    return __builtin_expect(neoinit_trace_active, 0);
+}
+
+void neoinit_trace_enable(bool enable);
+void neoinit_trace_record_at(uint32_t unit_id, neoinit_trace_phase_t phase, uint64_t timestamp);
+void neoinit_trace_record(uint32_t unit_id, neoinit_trace_phase_t phase);
+
+size_t neoinit_trace_drain(void);
+void neoinit_trace_reset(void);
+uint64_t neoinit_trace_dropped(void);
+const char *neoinit_trace_phase_to_string(neoinit_trace_phase_t phase);
+
+int neoinit_trace_export_chrome(int fd);
+int neoinit_trace_report_critical_path(int fd);
+
+#endif /* NEOINIT_TRACE_H */
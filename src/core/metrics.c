@@ -0,0 +1,198 @@
+#include "neoinit/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define SUB_COUNT (1u << NEOINIT_METRICS_SUB_BITS)
+
+typedef struct metrics_block {
+    uint64_t counters[NEOINIT_COUNTER_MAX];
+    uint64_t buckets[NEOINIT_HIST_MAX][NEOINIT_METRICS_BUCKETS];
+    uint64_t sum[NEOINIT_HIST_MAX];
+    uint64_t min[NEOINIT_HIST_MAX];
+    uint64_t max[NEOINIT_HIST_MAX];
+    struct metrics_block *next;
+} metrics_block_t;
+
+static __thread metrics_block_t *thread_block;
+static metrics_block_t *blocks;
+
+static const char *const counter_names[NEOINIT_COUNTER_MAX] = {
+    [NEOINIT_COUNTER_EPOLL_WAKEUPS] = "epoll_wakeups",
+    [NEOINIT_COUNTER_EVENTS_DISPATCHED] = "events_dispatched",
+    [NEOINIT_COUNTER_FORKS] = "forks",
+    [NEOINIT_COUNTER_FORK_FAILURES] = "fork_failures",
+    [NEOINIT_COUNTER_REAPS] = "reaps",
+    [NEOINIT_COUNTER_CONTROL_REQUESTS] = "control_requests",
+    [NEOINIT_COUNTER_CONTROL_ERRORS] = "control_errors",
+    [NEOINIT_COUNTER_CONFIG_RELOADS] = "config_reloads",
+    [NEOINIT_COUNTER_ADMISSION_DEFERRED] = "admission_deferred",
+    [NEOINIT_COUNTER_PRESSURE_EVENTS] = "pressure_events",
+};
+
+static const char *const hist_names[NEOINIT_HIST_MAX] = {
+    [NEOINIT_HIST_DISPATCH_LATENCY] = "dispatch_latency_ns",
+    [NEOINIT_HIST_QUEUE_DEPTH] = "queue_depth",
+    [NEOINIT_HIST_FORK_EXEC_LATENCY] = "fork_exec_latency_ns",
+    [NEOINIT_HIST_REAP_LATENCY] = "reap_latency_ns",
+    [NEOINIT_HIST_CONTROL_LATENCY] = "control_latency_ns",
+    [NEOINIT_HIST_CONFIG_RELOAD] = "config_reload_ns",
+    [NEOINIT_HIST_ADMISSION_WAIT] = "admission_wait_ns",
+};
+
+const char *neoinit_counter_to_string(neoinit_counter_t counter) {
+    return counter < NEOINIT_COUNTER_MAX ? counter_names[counter] : "unknown";
+}
+
+const char *neoinit_histogram_to_string(neoinit_histogram_t hist) {
+    return hist < NEOINIT_HIST_MAX ? hist_names[hist] : "unknown";
+}
+
+static metrics_block_t *block_get(void) {
+    metrics_block_t *block = thread_block;
+    if (__builtin_expect(block != NULL, 1)) return block;
+
+    if (!(block = calloc(1, sizeof(*block)))) return NULL;
+    for (int h = 0; h < NEOINIT_HIST_MAX; h++) block->min[h] = UINT64_MAX;
+
+    // Blocks outlive their threads so totals never go backwards
+    block->next = __atomic_load_n(&blocks, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&blocks, &block->next, block, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return thread_block = block;
+}
+
+/*
+ * Values below SUB_COUNT map one to one; above that, the bucket is the
+ * exponent followed by the SUB_BITS bits right after the leading one.
+ */
+static unsigned bucket_of(uint64_t v) {
+    if (v < SUB_COUNT) return (unsigned)v;
+    unsigned msb = 63u - (unsigned)__builtin_clzll(v);
+    unsigned shift = msb - NEOINIT_METRICS_SUB_BITS;
+    return ((shift + 1) << NEOINIT_METRICS_SUB_BITS) + (unsigned)((v >> shift) & (SUB_COUNT - 1));
+}
+
+static uint64_t bucket_upper(unsigned b) {
+    if (b < SUB_COUNT) return b;
+    unsigned shift = (b >> NEOINIT_METRICS_SUB_BITS) - 1;
+    uint64_t base = (uint64_t)(SUB_COUNT + (b & (SUB_COUNT - 1))) << shift;
+    return base + ((1ULL << shift) - 1);
+}
+
+// Single writer per block: relaxed load/store keeps readers tear-free
+static inline void bump(uint64_t *p, uint64_t v) {
+    __atomic_store_n(p, __atomic_load_n(p, __ATOMIC_RELAXED) + v, __ATOMIC_RELAXED);
+}
+
+void neoinit_metrics_add(neoinit_counter_t counter, uint64_t value) {
+    metrics_block_t *block = block_get();
+    if (block && counter < NEOINIT_COUNTER_MAX) bump(&block->counters[counter], value);
+}
+
+void neoinit_metrics_inc(neoinit_counter_t counter) {
+    neoinit_metrics_add(counter, 1);
+}
+
+void neoinit_metrics_observe(neoinit_histogram_t hist, uint64_t value) {
+    metrics_block_t *block = block_get();
+    if (!block || hist >= NEOINIT_HIST_MAX) return;
+
+    bump(&block->buckets[hist][bucket_of(value)], 1);
+    bump(&block->sum[hist], value);
+    if (value < block->min[hist]) __atomic_store_n(&block->min[hist], value, __ATOMIC_RELAXED);
+    if (value > block->max[hist]) __atomic_store_n(&block->max[hist], value, __ATOMIC_RELAXED);
+}
+
+uint64_t neoinit_metrics_counter(neoinit_counter_t counter) {
+    if (counter >= NEOINIT_COUNTER_MAX) return 0;
+
+    uint64_t total = 0;
+    for (metrics_block_t *b = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); b; b = b->next)
+        total += __atomic_load_n(&b->counters[counter], __ATOMIC_RELAXED);
+    return total;
+}
+
+int neoinit_metrics_summary(neoinit_histogram_t hist, neoinit_histogram_summary_t *summary) {
+    if (hist >= NEOINIT_HIST_MAX || !summary) return NEOINIT_ERROR_INVALID_ARG;
+
+    uint64_t *merged = calloc(NEOINIT_METRICS_BUCKETS, sizeof(*merged));
+    if (!merged) return NEOINIT_ERROR_NO_MEMORY;
+
+    memset(summary, 0, sizeof(*summary));
+    summary->min = UINT64_MAX;
+    for (metrics_block_t *b = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); b; b = b->next) {
+        for (unsigned i = 0; i < NEOINIT_METRICS_BUCKETS; i++) {
+            uint64_t n = __atomic_load_n(&b->buckets[hist][i], __ATOMIC_RELAXED);
+            merged[i] += n;
+            summary->count += n;
+        }
+        summary->sum += __atomic_load_n(&b->sum[hist], __ATOMIC_RELAXED);
+        uint64_t lo = __atomic_load_n(&b->min[hist], __ATOMIC_RELAXED);
+        uint64_t hi = __atomic_load_n(&b->max[hist], __ATOMIC_RELAXED);
+        if (lo < summary->min) summary->min = lo;
+        if (hi > summary->max) summary->max = hi;
+    }
+    if (!summary->count) summary->min = 0;
+
+    static const uint64_t per_mille[] = { 500, 900, 990, 999 };
+    uint64_t *out[] = { &summary->p50, &summary->p90, &summary->p99, &summary->p999 };
+    uint64_t seen = 0;
+    size_t q = 0;
+    for (unsigned i = 0; i < NEOINIT_METRICS_BUCKETS && q < 4; i++) {
+        seen += merged[i];
+        while (q < 4 && summary->count && seen * 1000 >= summary->count * per_mille[q]) {
+            uint64_t upper = bucket_upper(i);
+            *out[q++] = upper < summary->max ? upper : summary->max;
+        }
+    }
+
+    free(merged);
+    return NEOINIT_OK;
+}
+
+void neoinit_metrics_reset(void) {
+    for (metrics_block_t *b = __atomic_load_n(&blocks, __ATOMIC_ACQUIRE); b; b = b->next) {
+        for (int c = 0; c < NEOINIT_COUNTER_MAX; c++) __atomic_store_n(&b->counters[c], 0, __ATOMIC_RELAXED);
+        for (int h = 0; h < NEOINIT_HIST_MAX; h++) {
+            for (unsigned i = 0; i < NEOINIT_METRICS_BUCKETS; i++)
+                __atomic_store_n(&b->buckets[h][i], 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&b->sum[h], 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&b->min[h], UINT64_MAX, __ATOMIC_RELAXED);
+            __atomic_store_n(&b->max[h], 0, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+int neoinit_metrics_format_json(char *buf, size_t size) {
+    if (!buf || !size) return NEOINIT_ERROR_INVALID_ARG;
+
+    size_t len = 0;
+#define APPEND(...)                                                          \
+    do {                                                                     \
+        int n_ = snprintf(buf + len, size - len, __VA_ARGS__);               \
+        if (n_ < 0 || (size_t)n_ >= size - len) return NEOINIT_ERROR_RESOURCE; \
+        len += (size_t)n_;                                                   \
+    } while (0)
+
+    APPEND("{\"counters\":{");
+    for (int c = 0; c < NEOINIT_COUNTER_MAX; c++) {
+        APPEND("%s\"%s\":%llu", c ? "," : "", counter_names[c],
+               (unsigned long long)neoinit_metrics_counter((neoinit_counter_t)c));
+    }
+    APPEND("},\"histograms\":{");
+    for (int h = 0; h < NEOINIT_HIST_MAX; h++) {
+        neoinit_histogram_summary_t s;
+        neoinit_metrics_summary((neoinit_histogram_t)h, &s);
+        APPEND("%s\"%s\":{\"count\":%llu,\"sum\":%llu,\"min\":%llu,\"max\":%llu,"
+               "\"p50\":%llu,\"p90\":%llu,\"p99\":%llu,\"p999\":%llu}",
+               h ? "," : "", hist_names[h], (unsigned long long)s.count, (unsigned long long)s.sum,
+               (unsigned long long)s.min, (unsigned long long)s.max, (unsigned long long)s.p50,
+               (unsigned long long)s.p90, (unsigned long long)s.p99, (unsigned long long)s.p999);
+    }
+    APPEND("}}");
+#undef APPEND
+
+    return (int)len;
+}
@@ -0,0 +1,429 @@
+#define _GNU_SOURCE
+#include "neoinit/readahead.h"
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
+
+#define IOPRIO_CLASS_BE 2
+#define IOPRIO_CLASS_SHIFT 13
+#define IOPRIO_WHO_PROCESS 1
+#define READAHEAD_LOW_NICE 19
+#define READAHEAD_LOW_IOPRIO 7
+
+typedef struct {
+    char *path;
+    uint32_t hash;
+    uint32_t seq;                   // Sample in which the file was first seen
+    uint64_t extent;                // Bytes worth prefetching
+    dev_t dev;
+    ino_t ino;
+} ra_entry_t;
+
+typedef struct {
+    ra_entry_t *entries;
+    size_t count;
+    size_t cap;
+    uint32_t *slots;                // (entry index + 1), 0 means empty
+    size_t slot_cap;
+} ra_table_t;
+
+static neoinit_readahead_mode_t mode = NEOINIT_READAHEAD_IDLE;
+static pthread_t worker;
+static pthread_mutex_t worker_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t worker_cond;
+static bool worker_stop;
+static char pack_path[NEOINIT_MAX_PATH_LEN];
+static uint64_t pack_fingerprint;
+static void *pack_map;
+static size_t pack_size;
+static ra_table_t table;
+
+static uint32_t hash_path(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool skip_path(const char *path) {
+    return path[0] != '/' || strncmp(path, "/proc/", 6) == 0 || strncmp(path, "/sys/", 5) == 0 ||
+           strncmp(path, "/dev/", 5) == 0 || strstr(path, " (deleted)") != NULL;
+}
+
+static int table_grow_slots(ra_table_t *t) {
+    size_t cap = t->slot_cap ? t->slot_cap * 2 : 1024;
+    uint32_t *slots = calloc(cap, sizeof(*slots));
+    if (!slots) return NEOINIT_ERROR_NO_MEMORY;
+
+    for (size_t i = 0; i < t->count; i++) {
+        size_t pos = t->entries[i].hash & (cap - 1);
+        while (slots[pos]) pos = (pos + 1) & (cap - 1);
+        slots[pos] = (uint32_t)i + 1;
+    }
+    free(t->slots);
+    t->slots = slots;
+    t->slot_cap = cap;
+    return NEOINIT_OK;
+}
+
+static void table_record(ra_table_t *t, const char *path, uint64_t extent, uint32_t seq) {
+    if (skip_path(path)) return;
+    if (extent > NEOINIT_READAHEAD_MAX_EXTENT) extent = NEOINIT_READAHEAD_MAX_EXTENT;
+
+    uint32_t hash = hash_path(path);
+    if (t->slot_cap) {
+        size_t pos = hash & (t->slot_cap - 1);
+        while (t->slots[pos]) {
+            ra_entry_t *e = &t->entries[t->slots[pos] - 1];
+            if (e->hash == hash && strcmp(e->path, path) == 0) {
+                if (extent > e->extent) e->extent = extent;
+                return;
+            }
+            pos = (pos + 1) & (t->slot_cap - 1);
+        }
+    }
+
+    if (t->count >= NEOINIT_READAHEAD_MAX_FILES) return;
+    if ((t->count + 1) * 2 > t->slot_cap && table_grow_slots(t) != NEOINIT_OK) return;
+    if (t->count == t->cap) {
+        size_t cap = t->cap ? t->cap * 2 : 256;
+        ra_entry_t *grown = realloc(t->entries, cap * sizeof(*grown));
+        if (!grown) return;
+        t->entries = grown;
+        t->cap = cap;
+    }
+
+    ra_entry_t *e = &t->entries[t->count];
+    if (!(e->path = strdup(path))) return;
+    e->hash = hash;
+    e->seq = seq;
+    e->extent = extent;
+
+    size_t pos = hash & (t->slot_cap - 1);
+    while (t->slots[pos]) pos = (pos + 1) & (t->slot_cap - 1);
+    t->slots[pos] = (uint32_t)++t->count;
+}
+
+static void table_free(ra_table_t *t) {
+    for (size_t i = 0; i < t->count; i++) free(t->entries[i].path);
+    free(t->entries);
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+static void sample_maps(const char *pid, uint32_t seq) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%s/maps", pid);
+    FILE *f = fopen(path, "re");
+    if (!f) return;
+
+    char line[NEOINIT_MAX_LINE_LEN + NEOINIT_MAX_PATH_LEN];
+    while (fgets(line, sizeof(line), f)) {
+        unsigned long start, end, offset;
+        int name_at = 0;
+        if (sscanf(line, "%lx-%lx %*s %lx %*s %*s %n", &start, &end, &offset, &name_at) < 3 || !name_at)
+            continue;
+
+        char *name = line + name_at;
+        name[strcspn(name, "\n")] = '\0';
+        table_record(&table, name, offset + (end - start), seq);
+    }
+    fclose(f);
+}
+
+static void sample_fds(const char *pid, uint32_t seq) {
+    char dir_path[64];
+    snprintf(dir_path, sizeof(dir_path), "/proc/%s/fd", pid);
+    DIR *dir = opendir(dir_path);
+    if (!dir) return;
+
+    struct dirent *de;
+    while ((de = readdir(dir))) {
+        if (de->d_name[0] == '.') continue;
+
+        char link[NEOINIT_MAX_PATH_LEN];
+        ssize_t len = readlinkat(dirfd(dir), de->d_name, link, sizeof(link) - 1);
+        if (len <= 0 || link[0] != '/') continue;
+        link[len] = '\0';
+
+        struct stat st;
+        if (skip_path(link) || stat(link, &st) == -1 || !S_ISREG(st.st_mode)) continue;
+        table_record(&table, link, (uint64_t)st.st_size, seq);
+    }
+    closedir(dir);
+}
+
+static void sample_all(uint32_t seq) {
+    DIR *proc = opendir("/proc");
+    if (!proc) return;
+
+    pid_t self = getpid();
+    struct dirent *de;
+    while ((de = readdir(proc))) {
+        if (de->d_name[0] < '0' || de->d_name[0] > '9') continue;
+        if (atoi(de->d_name) == self) continue;
+        sample_maps(de->d_name, seq);
+        sample_fds(de->d_name, seq);
+    }
+    closedir(proc);
+}
+
+static int entry_cmp(const void *a, const void *b) {
+    const ra_entry_t *x = a, *y = b;
+
+    // First use order across samples; inode order within one for disk locality
+    if (x->seq != y->seq) return x->seq < y->seq ? -1 : 1;
+    if (x->dev != y->dev) return x->dev < y->dev ? -1 : 1;
+    if (x->ino != y->ino) return x->ino < y->ino ? -1 : 1;
+    return 0;
+}
+
+static int pack_write(void) {
+    size_t kept = 0;
+    for (size_t i = 0; i < table.count; i++) {
+        ra_entry_t *e = &table.entries[i];
+        struct stat st;
+        if (stat(e->path, &st) == -1 || !S_ISREG(st.st_mode) || !e->extent) {
+            free(e->path);
+            continue;
+        }
+        e->dev = st.st_dev;
+        e->ino = st.st_ino;
+        if (e->extent > (uint64_t)st.st_size) e->extent = (uint64_t)st.st_size;
+        table.entries[kept++] = *e;
+    }
+    table.count = kept;
+    qsort(table.entries, table.count, sizeof(*table.entries), entry_cmp);
+
+    mkdir(NEOINIT_CACHE_DIR, 0755);
+    mkdir(NEOINIT_READAHEAD_DIR, 0755);
+
+    char tmp[NEOINIT_MAX_PATH_LEN + sizeof(".tmp")];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", pack_path);
+    FILE *f = fopen(tmp, "we");
+    if (!f) return NEOINIT_ERROR_IO;
+
+    neoinit_readahead_header_t hdr = {
+        .magic = NEOINIT_READAHEAD_MAGIC,
+        .version = NEOINIT_READAHEAD_VERSION,
+        .fingerprint = pack_fingerprint,
+        .count = (uint32_t)table.count,
+    };
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    for (size_t i = 0; ok && i < table.count; i++) {
+        uint64_t extent = table.entries[i].extent;
+        uint16_t len = (uint16_t)strlen(table.entries[i].path);
+        ok = fwrite(&extent, sizeof(extent), 1, f) == 1 && fwrite(&len, sizeof(len), 1, f) == 1 &&
+             fwrite(table.entries[i].path, 1, len, f) == len;
+    }
+    ok = fflush(f) == 0 && fsync(fileno(f)) == 0 && ok;
+    fclose(f);
+
+    if (!ok || rename(tmp, pack_path) == -1) {
+        unlink(tmp);
+        return NEOINIT_ERROR_IO;
+    }
+    return NEOINIT_OK;
+}
+
+static bool wait_or_stop(uint64_t ms) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    ts.tv_sec += (time_t)(ms / 1000);
+    ts.tv_nsec += (long)(ms % 1000) * 1000000L;
+    if (ts.tv_nsec >= 1000000000L) {
+        ts.tv_sec++;
+        ts.tv_nsec -= 1000000000L;
+    }
+
+    pthread_mutex_lock(&worker_lock);
+    while (!worker_stop && pthread_cond_timedwait(&worker_cond, &worker_lock, &ts) != ETIMEDOUT) {
+    }
+    bool stop = worker_stop;
+    pthread_mutex_unlock(&worker_lock);
+    return stop;
+}
+
+static bool should_stop(void) {
+    return __atomic_load_n(&worker_stop, __ATOMIC_RELAXED);
+}
+
+static void lower_priority(void) {
+    pid_t tid = (pid_t)syscall(SYS_gettid);
+    setpriority(PRIO_PROCESS, (id_t)tid, READAHEAD_LOW_NICE);
+    syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, tid,
+            (IOPRIO_CLASS_BE << IOPRIO_CLASS_SHIFT) | READAHEAD_LOW_IOPRIO);
+}
+
+static void *profile_thread(void *arg) {
+    (void)arg;
+    lower_priority();
+    uint64_t deadline = neoinit_get_monotonic_time() + NEOINIT_READAHEAD_PROFILE_SEC * 1000000000ULL;
+    uint32_t seq = 0;
+
+    do {
+        sample_all(seq++);
+    } while (neoinit_get_monotonic_time() < deadline && !wait_or_stop(NEOINIT_READAHEAD_SAMPLE_MS));
+
+    if (pack_write() != NEOINIT_OK)
+        LOG_WARNING("Failed to write readahead pack %s", pack_path);
+    else
+        LOG_INFO("Recorded %zu boot files to %s", table.count, pack_path);
+    table_free(&table);
+    return NULL;
+}
+
+static void *replay_thread(void *arg) {
+    (void)arg;
+    lower_priority();
+
+    const uint8_t *p = (const uint8_t *)pack_map + sizeof(neoinit_readahead_header_t);
+    const uint8_t *end = (const uint8_t *)pack_map + pack_size;
+    uint32_t count = ((const neoinit_readahead_header_t *)pack_map)->count;
+    uint32_t done = 0;
+    char path[NEOINIT_MAX_PATH_LEN];
+
+    for (; done < count && !should_stop(); done++) {
+        uint64_t extent;
+        uint16_t len;
+        if ((size_t)(end - p) < sizeof(extent) + sizeof(len)) break;
+        memcpy(&extent, p, sizeof(extent));
+        memcpy(&len, p + sizeof(extent), sizeof(len));
+        p += sizeof(extent) + sizeof(len);
+        if ((size_t)(end - p) < len || len >= sizeof(path)) break;
+        memcpy(path, p, len);
+        path[len] = '\0';
+        p += len;
+
+        int fd = open(path, O_RDONLY | O_CLOEXEC | O_NOATIME);
+        if (fd == -1 && errno == EPERM) fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) continue;
+        if (readahead(fd, 0, (size_t)extent) == -1)
+            posix_fadvise(fd, 0, (off_t)extent, POSIX_FADV_WILLNEED);
+        close(fd);
+    }
+
+    LOG_DEBUG("Prefetched %u of %u boot files", done, count);
+    munmap(pack_map, pack_size);
+    pack_map = NULL;
+    return NULL;
+}
+
+static bool pack_open(void) {
+    int fd = open(pack_path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return false;
+
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(neoinit_readahead_header_t);
+    if (ok) {
+        pack_size = (size_t)st.st_size;
+        pack_map = mmap(NULL, pack_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+        ok = pack_map != MAP_FAILED;
+        if (!ok) pack_map = NULL;
+    }
+    close(fd);
+    if (!ok) return false;
+
+    const neoinit_readahead_header_t *hdr = pack_map;
+    if (hdr->magic != NEOINIT_READAHEAD_MAGIC || hdr->version != NEOINIT_READAHEAD_VERSION ||
+        hdr->fingerprint != pack_fingerprint) {
+        munmap(pack_map, pack_size);
+        pack_map = NULL;
+        return false;
+    }
+    return true;
+}
+
+// Sixty seconds of sampling is wasted if the pack cannot be stored at the end
+static bool cache_writable(void) {
+    mkdir(NEOINIT_CACHE_DIR, 0755);
+    mkdir(NEOINIT_READAHEAD_DIR, 0755);
+    return access(NEOINIT_READAHEAD_DIR, W_OK) == 0;
+}
+
+int neoinit_readahead_start(const char *target, uint64_t fingerprint) {
+    if (!target || !*target || strchr(target, '/')) return NEOINIT_ERROR_INVALID_ARG;
+    if (mode != NEOINIT_READAHEAD_IDLE) return NEOINIT_ERROR_BUSY;
+
+    int n = snprintf(pack_path, sizeof(pack_path), "%s/%s.pack", NEOINIT_READAHEAD_DIR, target);
+    if (n < 0 || (size_t)n >= sizeof(pack_path)) return NEOINIT_ERROR_INVALID_ARG;
+    pack_fingerprint = fingerprint;
+    worker_stop = false;
+
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&worker_cond, &attr);
+    pthread_condattr_destroy(&attr);
+
+    if (pack_open()) {
+        mode = NEOINIT_READAHEAD_REPLAY;
+    } else if (cache_writable()) {
+        mode = NEOINIT_READAHEAD_PROFILE;
+    } else {
+        LOG_INFO("%s is not writable, not profiling boot files", NEOINIT_READAHEAD_DIR);
+        return NEOINIT_ERROR_PERMISSION;
+    }
+    void *(*fn)(void *) = mode == NEOINIT_READAHEAD_REPLAY ? replay_thread : profile_thread;
+    if (pthread_create(&worker, NULL, fn, NULL) != 0) {
+        if (pack_map) munmap(pack_map, pack_size);
+        pack_map = NULL;
+        mode = NEOINIT_READAHEAD_IDLE;
+        return NEOINIT_ERROR_RESOURCE;
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_readahead_stop(void) {
+    if (mode == NEOINIT_READAHEAD_IDLE) return NEOINIT_OK;
+
+    pthread_mutex_lock(&worker_lock);
+    __atomic_store_n(&worker_stop, true, __ATOMIC_RELAXED);
+    pthread_cond_broadcast(&worker_cond);
+    pthread_mutex_unlock(&worker_lock);
+
+    pthread_join(worker, NULL);
+    pthread_cond_destroy(&worker_cond);
+    mode = NEOINIT_READAHEAD_IDLE;
+    return NEOINIT_OK;
+}
+
+neoinit_readahead_mode_t neoinit_readahead_mode(void) {
+    return mode;
+}
+
+uint64_t neoinit_readahead_fingerprint(const char *dir) {
+    DIR *d = dir ? opendir(dir) : NULL;
+    if (!d) return 0;
+
+    // Order-independent: readdir order is not stable across boots
+    uint64_t sum = 0;
+    struct dirent *de;
+    while ((de = readdir(d))) {
+        struct stat st;
+        if (de->d_name[0] == '.' || fstatat(dirfd(d), de->d_name, &st, 0) == -1) continue;
+
+        uint64_t h = 14695981039346656037ULL;
+        for (const char *s = de->d_name; *s; s++) {
+            h ^= (unsigned char)*s;
+            h *= 1099511628211ULL;
+        }
+        h ^= (uint64_t)st.st_mtime * 1099511628211ULL;
+        h ^= (uint64_t)st.st_size;
+        sum += h * 0x9e3779b97f4a7c15ULL;
+    }
+    closedir(d);
+    return sum;
+}
@@ -0,0 +1,435 @@
+#define _GNU_SOURCE
+#include "neoinit/shutdown.h"
+#include "neoinit/service.h"
+#include "neoinit/cgroup.h"
+#include "neoinit/log.h"
+#include "neoinit/journal.h"
+#include "neoinit/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/wait.h>
+#include <sys/mount.h>
+#include <sys/reboot.h>
+
+#define REAP_POLL_MS 50
+#define UNMOUNT_PASSES 3
+
+enum {
+    PHASE_ACTIVE = 0,
+    PHASE_SIGNALLED,
+    PHASE_KILLED,
+    PHASE_DONE,
+};
+
+typedef struct {
+    uint64_t at;
+    uint32_t id;
+} kill_entry_t;
+
+typedef struct {
+    size_t count;
+    uint32_t *pending;              // Requiring units not yet stopped
+    uint8_t *phase;
+    uint32_t *queue;                // Units released for stopping
+    size_t queue_len;
+    kill_entry_t *heap;             // SIGKILL deadlines, earliest first
+    size_t heap_len;
+    pid_t *pid_keys;                // pid -> unit id, open addressing
+    uint32_t *pid_ids;
+    size_t pid_cap;
+    size_t done;
+    uint32_t in_flight;
+    neoinit_shutdown_result_t *result;
+} shutdown_ctx_t;
+
+static uint64_t now_usec(void) {
+    return neoinit_get_monotonic_time() / 1000;
+}
+
+static bool unit_is_active(const neoinit_unit_t *unit) {
+    if (unit->pid <= 0) return false;
+    switch (unit->state) {
+        case NEOINIT_SERVICE_INACTIVE:
+        case NEOINIT_SERVICE_STOPPED:
+        case NEOINIT_SERVICE_FAILED:
+            return false;
+        default:
+            return true;
+    }
+}
+
+static void heap_push(shutdown_ctx_t *ctx, uint64_t at, uint32_t id) {
+    size_t i = ctx->heap_len++;
+    while (i > 0) {
+        size_t parent = (i - 1) / 2;
+        if (ctx->heap[parent].at <= at) break;
+        ctx->heap[i] = ctx->heap[parent];
+        i = parent;
+    }
+    ctx->heap[i] = (kill_entry_t){ at, id };
+}
+
+static void heap_pop(shutdown_ctx_t *ctx) {
+    kill_entry_t last = ctx->heap[--ctx->heap_len];
+    size_t i = 0;
+    for (;;) {
+        size_t child = i * 2 + 1;
+        if (child >= ctx->heap_len) break;
+        if (child + 1 < ctx->heap_len && ctx->heap[child + 1].at < ctx->heap[child].at) child++;
+        if (last.at <= ctx->heap[child].at) break;
+        ctx->heap[i] = ctx->heap[child];
+        i = child;
+    }
+    if (ctx->heap_len) ctx->heap[i] = last;
+}
+
+static void pid_insert(shutdown_ctx_t *ctx, pid_t pid, uint32_t id) {
+    size_t pos = (size_t)pid & (ctx->pid_cap - 1);
+    while (ctx->pid_keys[pos] && ctx->pid_keys[pos] != pid) pos = (pos + 1) & (ctx->pid_cap - 1);
+    ctx->pid_keys[pos] = pid;
+    ctx->pid_ids[pos] = id;
+}
+
+static uint32_t pid_find(const shutdown_ctx_t *ctx, pid_t pid) {
+    size_t pos = (size_t)pid & (ctx->pid_cap - 1);
+    while (ctx->pid_keys[pos]) {
+        if (ctx->pid_keys[pos] == pid) return ctx->pid_ids[pos];
+        pos = (pos + 1) & (ctx->pid_cap - 1);
+    }
+    return NEOINIT_UNIT_ID_INVALID;
+}
+
+static void unit_done(shutdown_ctx_t *ctx, neoinit_unit_t *unit, int status) {
+    if (ctx->phase[unit->id] == PHASE_DONE) return;
+
+    if (ctx->phase[unit->id] != PHASE_ACTIVE) {
+        ctx->in_flight--;
+        ctx->result->units_stopped++;
+        unit->state = NEOINIT_SERVICE_STOPPED;
+        unit->exit_code = status;
+        unit->stop_time = time(NULL);
+        neoinit_cgroup_kill(unit, SIGKILL);
+        if (unit->notification_fd >= 0) {
+            close(unit->notification_fd);
+            unit->notification_fd = -1;
+        }
+    }
+    ctx->phase[unit->id] = PHASE_DONE;
+    ctx->done++;
+
+    // Release dependencies whose last requiring unit just went away
+    for (uint32_t i = 0; i < unit->dep_count; i++) {
+        uint32_t dep = unit->dep_ids[i];
+        if (ctx->pending[dep] && --ctx->pending[dep] == 0) ctx->queue[ctx->queue_len++] = dep;
+    }
+}
+
+static void unit_signal(shutdown_ctx_t *ctx, neoinit_unit_t *unit, uint64_t now) {
+    if (!unit_is_active(unit)) {
+        // Leftovers of a daemon whose main process already exited
+        neoinit_cgroup_kill(unit, SIGKILL);
+        unit_done(ctx, unit, unit->exit_code);
+        return;
+    }
+
+    unit->state = NEOINIT_SERVICE_STOPPING;
+    ctx->phase[unit->id] = PHASE_SIGNALLED;
+    ctx->in_flight++;
+    pid_insert(ctx, unit->pid, unit->id);
+
+    // A frozen tree cannot act on SIGTERM; KillMode units get it tree-wide
+    neoinit_cgroup_freeze(unit, false);
+    bool tree = (unit->tmpl->flags & NEOINIT_FLAG_KILL_MODE) &&
+                neoinit_cgroup_kill(unit, SIGTERM) == NEOINIT_OK;
+    if (kill(unit->pid, tree ? 0 : SIGTERM) == -1 && errno == ESRCH) {
+        unit_done(ctx, unit, unit->exit_code);
+        return;
+    }
+    kill(unit->pid, SIGCONT);
+
+    uint64_t timeout = unit->tmpl->timeout_stop_usec > 0 ? (uint64_t)unit->tmpl->timeout_stop_usec : 0;
+    heap_push(ctx, now + timeout, unit->id);
+}
+
+static void unit_kill(shutdown_ctx_t *ctx, neoinit_unit_t *unit) {
+    if (ctx->phase[unit->id] != PHASE_SIGNALLED) return;
+
+    ctx->phase[unit->id] = PHASE_KILLED;
+    ctx->result->units_killed++;
+    LOG_WARNING("Unit %s did not stop in time, sending SIGKILL", unit->name);
+    bool tree = neoinit_cgroup_kill(unit, SIGKILL) == NEOINIT_OK;
+    if (kill(unit->pid, tree ? 0 : SIGKILL) == -1 && errno == ESRCH) unit_done(ctx, unit, unit->exit_code);
+}
+
+static void run_queue(shutdown_ctx_t *ctx) {
+    if (!ctx->queue_len) return;
+
+    // Everything released since the last reap goes out as one wave
+    uint64_t now = now_usec();
+    ctx->result->waves++;
+    while (ctx->queue_len) {
+        uint32_t id = ctx->queue[--ctx->queue_len];
+        if (ctx->phase[id] == PHASE_ACTIVE) unit_signal(ctx, neoinit_unit_get(id), now);
+    }
+}
+
+// Collects every exited child; returns false once there are none left at all
+static bool reap(shutdown_ctx_t *ctx) {
+    uint64_t woke = neoinit_get_monotonic_time();
+    int status;
+    pid_t pid;
+
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        neoinit_metrics_inc(NEOINIT_COUNTER_REAPS);
+        uint32_t id = pid_find(ctx, pid);
+        if (id == NEOINIT_UNIT_ID_INVALID) continue;
+        unit_done(ctx, neoinit_unit_get(id), status);
+        neoinit_metrics_observe(NEOINIT_HIST_REAP_LATENCY, neoinit_get_monotonic_time() - woke);
+    }
+    return !(pid == -1 && errno == ECHILD);
+}
+
+static void drain_signalfd(int sfd) {
+    struct signalfd_siginfo info[16];
+    while (read(sfd, info, sizeof(info)) > 0) {
+    }
+}
+
+static void wait_children(int sfd, shutdown_ctx_t *ctx, uint64_t until) {
+    struct pollfd pfd = { .fd = sfd, .events = POLLIN };
+
+    while (ctx->in_flight) {
+        uint64_t now = now_usec();
+        if (now >= until) break;
+        uint64_t wait = (until - now) / 1000 + 1;
+        poll(&pfd, sfd >= 0 ? 1 : 0, wait < REAP_POLL_MS ? (int)wait : REAP_POLL_MS);
+        if (sfd >= 0) drain_signalfd(sfd);
+        reap(ctx);
+    }
+}
+
+static void stop_units(shutdown_ctx_t *ctx, int sfd, uint64_t deadline) {
+    for (uint32_t id = 0; id < ctx->count; id++) {
+        ctx->pending[id] = neoinit_unit_get(id)->rdep_count;
+        if (!ctx->pending[id]) ctx->queue[ctx->queue_len++] = id;
+    }
+    run_queue(ctx);
+
+    struct pollfd pfd = { .fd = sfd, .events = POLLIN };
+    while (ctx->done < ctx->count) {
+        uint64_t now = now_usec();
+
+        if (now >= deadline) {
+            ctx->result->deadline_hit = true;
+            LOG_WARNING("Shutdown deadline reached, killing %zu remaining units",
+                        ctx->count - ctx->done);
+            for (uint32_t id = 0; id < ctx->count; id++) {
+                neoinit_unit_t *unit = neoinit_unit_get(id);
+                if (ctx->phase[id] == PHASE_ACTIVE) unit_signal(ctx, unit, now);
+                unit_kill(ctx, unit);
+            }
+            wait_children(sfd, ctx, now + NEOINIT_SHUTDOWN_FINAL_KILL_USEC);
+            return;
+        }
+
+        while (ctx->heap_len && ctx->heap[0].at <= now) {
+            unit_kill(ctx, neoinit_unit_get(ctx->heap[0].id));
+            heap_pop(ctx);
+        }
+
+        if (!ctx->in_flight && !ctx->queue_len) {
+            // Nothing running yet nothing released: dependency cycle, stop the rest together
+            for (uint32_t id = 0; id < ctx->count; id++) {
+                if (ctx->phase[id] == PHASE_ACTIVE) ctx->queue[ctx->queue_len++] = id;
+            }
+            run_queue(ctx);
+            continue;
+        }
+
+        uint64_t until = deadline;
+        if (ctx->heap_len && ctx->heap[0].at < until) until = ctx->heap[0].at;
+        uint64_t wait = (until - now) / 1000 + 1;
+        poll(&pfd, sfd >= 0 ? 1 : 0, wait < REAP_POLL_MS ? (int)wait : REAP_POLL_MS);
+        if (sfd >= 0) drain_signalfd(sfd);
+        reap(ctx);
+        run_queue(ctx);
+    }
+}
+
+static void kill_remaining(int sfd, shutdown_ctx_t *ctx) {
+    // Only PID 1 may broadcast; kill(-1) from anywhere else hits the caller's session
+    if (getpid() != 1) return;
+
+    kill(-1, SIGTERM);
+    kill(-1, SIGCONT);
+
+    uint64_t until = now_usec() + NEOINIT_SHUTDOWN_FINAL_KILL_USEC;
+    struct pollfd pfd = { .fd = sfd, .events = POLLIN };
+    while (now_usec() < until) {
+        if (!reap(ctx)) return;
+        poll(&pfd, sfd >= 0 ? 1 : 0, REAP_POLL_MS);
+        if (sfd >= 0) drain_signalfd(sfd);
+    }
+
+    kill(-1, SIGKILL);
+    reap(ctx);
+}
+
+static bool is_api_fs(const char *fstype) {
+    static const char *const api[] = {
+        "proc", "sysfs", "devtmpfs", "devpts", "cgroup", "cgroup2", "securityfs",
+        "debugfs", "tracefs", "pstore", "efivarfs", "bpf", "mqueue", "hugetlbfs",
+        "configfs", "fusectl", "autofs", NULL,
+    };
+    for (size_t i = 0; api[i]; i++) {
+        if (strcmp(fstype, api[i]) == 0) return true;
+    }
+    return false;
+}
+
+static void unescape_mount(char *s) {
+    char *out = s;
+    while (*s) {
+        if (s[0] == '\\' && s[1] >= '0' && s[1] <= '7' && s[2] && s[3]) {
+            *out++ = (char)(((s[1] - '0') << 6) | ((s[2] - '0') << 3) | (s[3] - '0'));
+            s += 4;
+        } else {
+            *out++ = *s++;
+        }
+    }
+    *out = '\0';
+}
+
+int neoinit_shutdown_unmount_all(void) {
+    int remaining = 0;
+
+    for (int pass = 0; pass < UNMOUNT_PASSES; pass++) {
+        FILE *f = fopen("/proc/self/mountinfo", "re");
+        if (!f) return NEOINIT_ERROR_IO;
+
+        char **points = NULL;
+        size_t count = 0, cap = 0;
+        char line[NEOINIT_MAX_LINE_LEN * 4];
+
+        while (fgets(line, sizeof(line), f)) {
+            char mnt[NEOINIT_MAX_PATH_LEN];
+            char fstype[64];
+            const char *sep = strstr(line, " - ");
+            if (!sep || sscanf(line, "%*s %*s %*s %*s %4095s", mnt) != 1) continue;
+            if (sscanf(sep + 3, "%63s", fstype) != 1 || is_api_fs(fstype)) continue;
+
+            unescape_mount(mnt);
+            if (strcmp(mnt, "/") == 0) continue;
+
+            if (count == cap) {
+                cap = cap ? cap * 2 : 32;
+                char **grown = realloc(points, cap * sizeof(*grown));
+                if (!grown) break;
+                points = grown;
+            }
+            if ((points[count] = strdup(mnt))) count++;
+        }
+        fclose(f);
+
+        // mountinfo lists parents first, so walk it backwards
+        remaining = 0;
+        for (size_t i = count; i-- > 0;) {
+            if (umount2(points[i], 0) == -1 && umount2(points[i], MNT_DETACH) == -1) {
+                mount(NULL, points[i], NULL, MS_REMOUNT | MS_RDONLY, NULL);
+                remaining++;
+            }
+            free(points[i]);
+        }
+        free(points);
+        if (!remaining) break;
+    }
+
+    mount(NULL, "/", NULL, MS_REMOUNT | MS_RDONLY, NULL);
+    return remaining ? NEOINIT_ERROR_BUSY : NEOINIT_OK;
+}
+
+int neoinit_shutdown_run(const neoinit_shutdown_config_t *config, neoinit_shutdown_result_t *result) {
+    if (!config) return NEOINIT_ERROR_INVALID_ARG;
+
+    neoinit_shutdown_result_t local;
+    if (!result) result = &local;
+    memset(result, 0, sizeof(*result));
+
+    uint64_t start = now_usec();
+    uint64_t budget = config->deadline_usec ? config->deadline_usec : NEOINIT_SHUTDOWN_DEADLINE_USEC;
+
+    shutdown_ctx_t ctx = { .count = neoinit_registry_count(), .result = result };
+    size_t n = ctx.count ? ctx.count : 1;
+    ctx.pid_cap = 64;
+    while (ctx.pid_cap < n * 2) ctx.pid_cap <<= 1;
+
+    ctx.pending = calloc(n, sizeof(*ctx.pending));
+    ctx.phase = calloc(n, sizeof(*ctx.phase));
+    ctx.queue = malloc(n * sizeof(*ctx.queue));
+    ctx.heap = malloc(n * sizeof(*ctx.heap));
+    ctx.pid_keys = calloc(ctx.pid_cap, sizeof(*ctx.pid_keys));
+    ctx.pid_ids = malloc(ctx.pid_cap * sizeof(*ctx.pid_ids));
+
+    int ret = NEOINIT_OK;
+    if (!ctx.pending || !ctx.phase || !ctx.queue || !ctx.heap || !ctx.pid_keys || !ctx.pid_ids) {
+        ret = NEOINIT_ERROR_NO_MEMORY;
+        goto out;
+    }
+
+    sigset_t mask, old_mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &mask, &old_mask);
+    int sfd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+    stop_units(&ctx, sfd, start + budget);
+    if (config->kill_remaining) kill_remaining(sfd, &ctx);
+
+    if (sfd >= 0) close(sfd);
+    pthread_sigmask(SIG_SETMASK, &old_mask, NULL);
+
+    result->elapsed_usec = now_usec() - start;
+    LOG_NOTICE("Stopped %u units in %u waves (%u killed) in %llu ms",
+               result->units_stopped, result->waves, result->units_killed,
+               (unsigned long long)(result->elapsed_usec / 1000));
+
+out:
+    free(ctx.pending);
+    free(ctx.phase);
+    free(ctx.queue);
+    free(ctx.heap);
+    free(ctx.pid_keys);
+    free(ctx.pid_ids);
+
+    if (ret != NEOINIT_OK || config->action == NEOINIT_SHUTDOWN_NONE) return ret;
+
+    // Seal the event journal and close the log file so their filesystems can be unmounted
+    neoinit_journal_cleanup();
+    neoinit_log_cleanup();
+    sync();
+    if (config->unmount) neoinit_shutdown_unmount_all();
+    sync();
+
+    switch (config->action) {
+        case NEOINIT_SHUTDOWN_HALT:
+            reboot(RB_HALT_SYSTEM);
+            break;
+        case NEOINIT_SHUTDOWN_POWEROFF:
+            reboot(RB_POWER_OFF);
+            break;
+        case NEOINIT_SHUTDOWN_REBOOT:
+            reboot(RB_AUTOBOOT);
+            break;
+        default:
+            break;
+    }
+
+    // reboot() only returns on failure
+    return NEOINIT_ERROR_SYSTEM;
+}
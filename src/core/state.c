@@ -0,0 +1,541 @@
+#define _GNU_SOURCE
+#include "neoinit/state.h"
+#include "neoinit/service.h"
+#include "neoinit/output.h"
+#include "neoinit/socket.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define STATE_STR_NULL UINT32_MAX
+#define STATE_EXE_DELETED " (deleted)"
+#define STATE_CMDLINE_MAX (64 * 1024)
+
+extern char **environ;
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+    bool failed;
+} state_writer_t;
+
+typedef struct {
+    const uint8_t *data;
+    size_t len;
+    size_t off;
+    bool failed;
+} state_reader_t;
+
+static uint64_t checksum(const uint8_t *data, size_t len) {
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+static void put(state_writer_t *w, const void *src, size_t len) {
+    if (w->failed) return;
+    if (w->len + len > w->cap) {
+        size_t cap = w->cap ? w->cap : NEOINIT_MAX_STATE_SIZE;
+        while (cap < w->len + len) cap *= 2;
+        uint8_t *grown = realloc(w->data, cap);
+        if (!grown) {
+            w->failed = true;
+            return;
+        }
+        w->data = grown;
+        w->cap = cap;
+    }
+    memcpy(w->data + w->len, src, len);
+    w->len += len;
+}
+
+static void put_u8(state_writer_t *w, uint8_t v) { put(w, &v, sizeof(v)); }
+static void put_u32(state_writer_t *w, uint32_t v) { put(w, &v, sizeof(v)); }
+static void put_i32(state_writer_t *w, int32_t v) { put(w, &v, sizeof(v)); }
+static void put_u64(state_writer_t *w, uint64_t v) { put(w, &v, sizeof(v)); }
+static void put_i64(state_writer_t *w, int64_t v) { put(w, &v, sizeof(v)); }
+
+static void put_str(state_writer_t *w, const char *s) {
+    if (!s) {
+        put_u32(w, STATE_STR_NULL);
+        return;
+    }
+    uint32_t len = (uint32_t)strlen(s);
+    put_u32(w, len);
+    put(w, s, len);
+}
+
+static void put_strv(state_writer_t *w, char *const *v, uint32_t count) {
+    put_u32(w, count);
+    for (uint32_t i = 0; i < count; i++) put_str(w, v[i]);
+}
+
+static const void *get(state_reader_t *r, size_t len) {
+    if (r->failed || r->len - r->off < len) {
+        r->failed = true;
+        return NULL;
+    }
+    const void *p = r->data + r->off;
+    r->off += len;
+    return p;
+}
+
+#define GET_SCALAR(r, type)                                 \
+    ({                                                      \
+        type v_ = 0;                                        \
+        const void *p_ = get(r, sizeof(type));              \
+        if (p_) memcpy(&v_, p_, sizeof(type));              \
+        v_;                                                 \
+    })
+
+static uint8_t get_u8(state_reader_t *r) { return GET_SCALAR(r, uint8_t); }
+static uint32_t get_u32(state_reader_t *r) { return GET_SCALAR(r, uint32_t); }
+static int32_t get_i32(state_reader_t *r) { return GET_SCALAR(r, int32_t); }
+static uint64_t get_u64(state_reader_t *r) { return GET_SCALAR(r, uint64_t); }
+static int64_t get_i64(state_reader_t *r) { return GET_SCALAR(r, int64_t); }
+
+// Returns a heap copy; *present is false for a serialized NULL
+static char *get_str(state_reader_t *r, bool *present) {
+    uint32_t len = get_u32(r);
+    *present = !r->failed && len != STATE_STR_NULL;
+    if (!*present) return NULL;
+
+    const char *src = get(r, len);
+    char *s = src ? strndup(src, len) : NULL;
+    if (src && !s) r->failed = true;
+    return s;
+}
+
+static char **get_strv(state_reader_t *r, uint32_t *count, bool terminate) {
+    uint32_t n = get_u32(r);
+    *count = 0;
+    if (r->failed || !n) return NULL;
+    if (n > r->len - r->off) {
+        r->failed = true;
+        return NULL;
+    }
+
+    char **v = calloc((size_t)n + (terminate ? 1 : 0), sizeof(*v));
+    if (!v) {
+        r->failed = true;
+        return NULL;
+    }
+    for (uint32_t i = 0; i < n && !r->failed; i++) {
+        bool present;
+        v[i] = get_str(r, &present);
+        if (!present) r->failed = true;
+        *count = i + 1;
+    }
+    return v;
+}
+
+static void free_strv(char **v, uint32_t count) {
+    if (!v) return;
+    for (uint32_t i = 0; i < count; i++) free(v[i]);
+    free(v);
+}
+
+static void write_template(state_writer_t *w, const neoinit_template_t *tmpl) {
+    uint32_t argc = 0;
+    while (tmpl->exec_argv && tmpl->exec_argv[argc]) argc++;
+
+    put_str(w, tmpl->name);
+    put_u8(w, (uint8_t)tmpl->type);
+    put_u32(w, tmpl->flags);
+    put_i32(w, tmpl->restart_delay);
+    put_i32(w, tmpl->watchdog_usec);
+    put_i32(w, tmpl->timeout_start_usec);
+    put_i32(w, tmpl->timeout_stop_usec);
+    put_u64(w, tmpl->output_rate);
+    put_u64(w, tmpl->output_burst);
+    put_str(w, tmpl->working_directory);
+    put_str(w, tmpl->logs_dir);
+    put_strv(w, tmpl->exec_argv, argc);
+    put_strv(w, tmpl->environment, tmpl->env_count);
+    put_strv(w, tmpl->deps, tmpl->dep_count);
+    put_strv(w, tmpl->wants, tmpl->wants_count);
+    put_strv(w, tmpl->conflicts, tmpl->conflicts_count);
+}
+
+static void write_unit(state_writer_t *w, const neoinit_unit_t *unit, uint32_t *fds) {
+    int output_fd = neoinit_output_fd(unit);
+
+    put_str(w, unit->name);
+    put_u32(w, unit->tmpl->id);
+    put_u8(w, (uint8_t)unit->state);
+    put_u8(w, unit->enabled);
+    put_u8(w, unit->linked);
+    put_u8(w, unit->stop_pending);
+    put_u8(w, unit->start_pending);
+    put_i32(w, unit->pid);
+    put_i32(w, unit->exit_code);
+    put_u32(w, unit->restart_attempts);
+    put_i64(w, unit->start_time);
+    put_i64(w, unit->stop_time);
+    put_i32(w, unit->notification_fd);
+    put_i32(w, output_fd);
+
+    *fds += (unit->notification_fd >= 0) + (output_fd >= 0);
+}
+
+int neoinit_state_serialize(int fd, uint32_t flags, neoinit_state_stats_t *stats) {
+    if (fd < 0) return NEOINIT_ERROR_INVALID_ARG;
+
+    uint64_t start = neoinit_get_monotonic_time();
+    state_writer_t w = { 0 };
+    neoinit_state_header_t header = {
+        .magic = NEOINIT_STATE_MAGIC,
+        .version = NEOINIT_STATE_VERSION,
+        .header_size = sizeof(header),
+        .flags = flags,
+        .control_fd = neoinit_control_fd(),
+    };
+    uint32_t fds = header.control_fd >= 0;
+
+    // Reserve the header; it is filled in once the payload is known
+    put(&w, &header, sizeof(header));
+    put_str(&w, neoinit_control_path());
+
+    neoinit_template_t *tmpl;
+    while ((tmpl = neoinit_template_get(header.template_count))) {
+        write_template(&w, tmpl);
+        header.template_count++;
+    }
+
+    neoinit_unit_t *unit;
+    while ((unit = neoinit_unit_get(header.unit_count))) {
+        pthread_mutex_lock(&unit->lock);
+        write_unit(&w, unit, &fds);
+        pthread_mutex_unlock(&unit->lock);
+        header.unit_count++;
+    }
+
+    if (w.failed) {
+        free(w.data);
+        return NEOINIT_ERROR_NO_MEMORY;
+    }
+
+    header.payload_size = w.len - sizeof(header);
+    header.checksum = checksum(w.data + sizeof(header), w.len - sizeof(header));
+    header.created = neoinit_get_monotonic_time();
+    memcpy(w.data, &header, sizeof(header));
+
+    int ret = NEOINIT_OK;
+    for (size_t off = 0; off < w.len;) {
+        ssize_t n = pwrite(fd, w.data + off, w.len - off, (off_t)off);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            ret = NEOINIT_ERROR_IO;
+            break;
+        }
+        off += (size_t)n;
+    }
+    if (ret == NEOINIT_OK && ftruncate(fd, (off_t)w.len) == -1) ret = NEOINIT_ERROR_IO;
+
+    if (stats) {
+        stats->bytes = w.len;
+        stats->templates = header.template_count;
+        stats->units = header.unit_count;
+        stats->fds = fds;
+        stats->elapsed_usec = (neoinit_get_monotonic_time() - start) / 1000;
+    }
+    free(w.data);
+    return ret;
+}
+
+static int read_template(state_reader_t *r) {
+    bool present;
+    char *name = get_str(r, &present);
+    neoinit_template_t *tmpl = name ? neoinit_template_create(name) : NULL;
+    free(name);
+    if (!tmpl) return r->failed ? NEOINIT_ERROR_PROTOCOL : NEOINIT_ERROR_NO_MEMORY;
+
+    tmpl->type = (neoinit_service_type_t)get_u8(r);
+    tmpl->flags = get_u32(r);
+    tmpl->restart_delay = get_i32(r);
+    tmpl->watchdog_usec = get_i32(r);
+    tmpl->timeout_start_usec = get_i32(r);
+    tmpl->timeout_stop_usec = get_i32(r);
+    tmpl->output_rate = get_u64(r);
+    tmpl->output_burst = get_u64(r);
+    tmpl->working_directory = get_str(r, &present);
+    tmpl->logs_dir = get_str(r, &present);
+
+    uint32_t argc;
+    tmpl->exec_argv = get_strv(r, &argc, true);
+    tmpl->environment = get_strv(r, &tmpl->env_count, false);
+
+    // Dependencies go through the registry so specifier detection stays in one place
+    uint32_t dep_count;
+    char **deps = get_strv(r, &dep_count, false);
+    for (uint32_t i = 0; i < dep_count && !r->failed; i++) {
+        if (neoinit_template_add_dep(tmpl, deps[i]) != NEOINIT_OK) r->failed = true;
+    }
+    free_strv(deps, dep_count);
+
+    tmpl->wants = get_strv(r, &tmpl->wants_count, false);
+    tmpl->conflicts = get_strv(r, &tmpl->conflicts_count, false);
+    for (uint32_t i = 0; tmpl->exec_argv && i < argc; i++) {
+        if (strstr(tmpl->exec_argv[i], NEOINIT_UNIT_INSTANCE_SPEC)) tmpl->has_specifiers = true;
+    }
+    return r->failed ? NEOINIT_ERROR_PROTOCOL : NEOINIT_OK;
+}
+
+static bool fd_valid(int fd) {
+    return fd >= 0 && fcntl(fd, F_GETFD) != -1;
+}
+
+static int read_unit(state_reader_t *r, uint32_t id, bool *linked, uint32_t *fds) {
+    bool present;
+    char *name = get_str(r, &present);
+    neoinit_template_t *tmpl = neoinit_template_get(get_u32(r));
+    neoinit_unit_t *unit = NULL;
+
+    int ret = r->failed || !name || !tmpl ? NEOINIT_ERROR_PROTOCOL : neoinit_unit_add(name, tmpl, &unit);
+    free(name);
+    if (ret != NEOINIT_OK) return ret;
+    if (unit->id != id) return NEOINIT_ERROR_STATE;
+
+    unit->state = (neoinit_service_state_t)get_u8(r);
+    unit->enabled = get_u8(r);
+    *linked = get_u8(r);
+    unit->stop_pending = get_u8(r);
+    unit->start_pending = get_u8(r);
+    pid_t pid = get_i32(r);
+    unit->exit_code = get_i32(r);
+    unit->restart_attempts = get_u32(r);
+    unit->start_time = (time_t)get_i64(r);
+    unit->stop_time = (time_t)get_i64(r);
+    int notification_fd = get_i32(r);
+    int output_fd = get_i32(r);
+    if (r->failed) return NEOINIT_ERROR_PROTOCOL;
+    if (unit->state >= NEOINIT_SERVICE_STATE_MAX) unit->state = NEOINIT_SERVICE_FAILED;
+
+    // Admission queues are not carried over; a start that was still waiting is dropped
+    if (unit->state == NEOINIT_SERVICE_STARTING && pid <= 0) unit->state = NEOINIT_SERVICE_INACTIVE;
+
+    if (pid > 0) neoinit_unit_set_pid(unit, pid);
+    if (fd_valid(notification_fd)) {
+        fcntl(notification_fd, F_SETFD, FD_CLOEXEC);
+        unit->notification_fd = notification_fd;
+        (*fds)++;
+    }
+    if (fd_valid(output_fd)) {
+        if (neoinit_output_adopt(unit, output_fd) == NEOINIT_OK) (*fds)++;
+        else close(output_fd);
+    }
+    return NEOINIT_OK;
+}
+
+/*
+ * Rebuilds an empty registry from an image. Units get the ids they had
+ * before, so anything that recorded an id (the pid index, trace rings)
+ * still points at the right unit.
+ */
+int neoinit_state_deserialize(int fd, neoinit_state_stats_t *stats) {
+    if (fd < 0) return NEOINIT_ERROR_INVALID_ARG;
+    if (neoinit_registry_count() || neoinit_template_get(0)) return NEOINIT_ERROR_STATE;
+
+    struct stat st;
+    if (fstat(fd, &st) == -1) return NEOINIT_ERROR_IO;
+    if ((size_t)st.st_size < sizeof(neoinit_state_header_t)) return NEOINIT_ERROR_PROTOCOL;
+
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) return NEOINIT_ERROR_IO;
+
+    neoinit_state_header_t header;
+    memcpy(&header, map, sizeof(header));
+    const uint8_t *payload = (const uint8_t *)map + header.header_size;
+
+    int ret = NEOINIT_OK;
+    if (header.magic != NEOINIT_STATE_MAGIC || header.version != NEOINIT_STATE_VERSION ||
+        header.header_size < sizeof(header) || header.header_size > (size_t)st.st_size ||
+        header.payload_size != (uint64_t)st.st_size - header.header_size) {
+        ret = NEOINIT_ERROR_PROTOCOL;
+    } else if (checksum(payload, header.payload_size) != header.checksum) {
+        ret = NEOINIT_ERROR_PROTOCOL;
+    }
+    if (ret != NEOINIT_OK) {
+        munmap(map, (size_t)st.st_size);
+        return ret;
+    }
+
+    state_reader_t r = {
+        .data = payload,
+        .len = header.payload_size,
+    };
+    uint32_t fds = 0;
+
+    bool present;
+    char *control_path = get_str(&r, &present);
+    if (control_path && fd_valid(header.control_fd) &&
+        neoinit_control_adopt(header.control_fd, control_path) == NEOINIT_OK) {
+        fds++;
+    }
+    free(control_path);
+
+    for (uint32_t i = 0; i < header.template_count && ret == NEOINIT_OK; i++) {
+        ret = read_template(&r);
+    }
+    bool *linked = calloc(header.unit_count ? header.unit_count : 1, sizeof(*linked));
+    if (!linked) ret = NEOINIT_ERROR_NO_MEMORY;
+    for (uint32_t i = 0; i < header.unit_count && ret == NEOINIT_OK; i++) {
+        ret = read_unit(&r, i, &linked[i], &fds);
+    }
+    munmap(map, (size_t)st.st_size);
+
+    // Edges are rebuilt only once every id is taken, since linking may instantiate
+    for (uint32_t i = 0; i < header.unit_count && ret == NEOINIT_OK; i++) {
+        if (linked[i]) neoinit_unit_link(neoinit_unit_get(i));
+    }
+    free(linked);
+
+    if (stats) {
+        stats->bytes = (uint64_t)st.st_size;
+        stats->templates = header.template_count;
+        stats->units = header.unit_count;
+        stats->fds = fds;
+        stats->elapsed_usec = (neoinit_get_monotonic_time() - header.created) / 1000;
+    }
+    return ret;
+}
+
+bool neoinit_state_pending(void) {
+    const char *env = getenv(NEOINIT_STATE_FD_ENV);
+    return env && *env;
+}
+
+int neoinit_state_restore(neoinit_state_stats_t *stats) {
+    const char *env = getenv(NEOINIT_STATE_FD_ENV);
+    if (!env || !*env) return NEOINIT_ERROR_NOT_FOUND;
+
+    char *end;
+    long fd = strtol(env, &end, 10);
+    unsetenv(NEOINIT_STATE_FD_ENV);
+    if (*end || fd < 0 || fd > INT32_MAX || !fd_valid((int)fd)) return NEOINIT_ERROR_INVALID_ARG;
+
+    neoinit_state_header_t header = { 0 };
+    bool file = pread((int)fd, &header, sizeof(header), 0) == sizeof(header) &&
+                (header.flags & NEOINIT_STATE_FLAG_FILE);
+
+    int ret = neoinit_state_deserialize((int)fd, stats);
+    close((int)fd);
+    if (file) unlink(NEOINIT_STATE_FILE);
+    return ret;
+}
+
+static int state_open(uint32_t *flags) {
+    int fd = memfd_create("neoinit-state", MFD_ALLOW_SEALING);
+    if (fd >= 0) {
+        *flags = 0;
+        return fd;
+    }
+
+    mkdir(NEOINIT_RUN_DIR, 0755);
+    *flags = NEOINIT_STATE_FLAG_FILE;
+    return open(NEOINIT_STATE_FILE, O_RDWR | O_CREAT | O_TRUNC, 0600);
+}
+
+// Marks every descriptor the image refers to as inherited (or not) by execve()
+static void state_pass_fds(bool pass) {
+    int fd_flags = pass ? 0 : FD_CLOEXEC;
+    if (neoinit_control_fd() >= 0) fcntl(neoinit_control_fd(), F_SETFD, fd_flags);
+
+    neoinit_unit_t *unit;
+    for (uint32_t id = 0; (unit = neoinit_unit_get(id)); id++) {
+        if (unit->notification_fd >= 0) fcntl(unit->notification_fd, F_SETFD, fd_flags);
+        if (neoinit_output_fd(unit) >= 0) fcntl(neoinit_output_fd(unit), F_SETFD, fd_flags);
+    }
+}
+
+// The running image may have been replaced on disk; exec whatever is there now
+static int exe_path(char *buf, size_t size) {
+    ssize_t n = readlink("/proc/self/exe", buf, size - 1);
+    if (n <= 0) return NEOINIT_ERROR_SYSTEM;
+    buf[n] = '\0';
+
+    size_t suffix = strlen(STATE_EXE_DELETED);
+    if ((size_t)n > suffix && strcmp(buf + n - suffix, STATE_EXE_DELETED) == 0) {
+        buf[n - suffix] = '\0';
+    }
+    return NEOINIT_OK;
+}
+
+static char **cmdline_argv(char *buf, size_t size) {
+    int fd = open("/proc/self/cmdline", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return NULL;
+    ssize_t len = read(fd, buf, size - 1);
+    close(fd);
+    if (len <= 0) return NULL;
+    buf[len] = '\0';
+
+    size_t argc = 0;
+    for (ssize_t i = 0; i < len; i++) {
+        if (!buf[i]) argc++;
+    }
+    char **argv = calloc(argc + 2, sizeof(*argv));
+    if (!argv) return NULL;
+
+    argc = 0;
+    for (char *p = buf; p < buf + len; p += strlen(p) + 1) argv[argc++] = p;
+    return argv;
+}
+
+/*
+ * Serializes the registry and replaces the process image. Only returns on
+ * failure, in which case every descriptor is close-on-exec again and the
+ * manager carries on as before. The caller stops its own threads and
+ * flushes the log first; nothing here touches the children.
+ */
+int neoinit_state_reexec(const char *path) {
+    char exe[NEOINIT_MAX_PATH_LEN];
+    if (!path) {
+        if (exe_path(exe, sizeof(exe)) != NEOINIT_OK) return NEOINIT_ERROR_SYSTEM;
+        path = exe;
+    }
+
+    char *cmdline = malloc(STATE_CMDLINE_MAX);
+    char **argv = cmdline ? cmdline_argv(cmdline, STATE_CMDLINE_MAX) : NULL;
+    if (!argv) {
+        free(cmdline);
+        return NEOINIT_ERROR_SYSTEM;
+    }
+
+    uint32_t flags;
+    int fd = state_open(&flags);
+    int ret = fd < 0 ? NEOINIT_ERROR_IO : NEOINIT_OK;
+
+    neoinit_state_stats_t stats;
+    if (ret == NEOINIT_OK) ret = neoinit_state_serialize(fd, flags, &stats);
+    if (ret == NEOINIT_OK && !(flags & NEOINIT_STATE_FLAG_FILE)) {
+        fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_WRITE | F_SEAL_SEAL);
+    }
+
+    if (ret == NEOINIT_OK) {
+        char value[16];
+        snprintf(value, sizeof(value), "%d", fd);
+        setenv(NEOINIT_STATE_FD_ENV, value, 1);
+
+        state_pass_fds(true);
+        execve(path, argv, environ);
+
+        ret = NEOINIT_ERROR_SYSTEM;
+        state_pass_fds(false);
+        unsetenv(NEOINIT_STATE_FD_ENV);
+    }
+
+    if (fd >= 0) close(fd);
+    if (flags & NEOINIT_STATE_FLAG_FILE) unlink(NEOINIT_STATE_FILE);
+    free(argv);
+    free(cmdline);
+    return ret;
+}
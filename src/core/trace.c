@@ -0,0 +1,362 @@
+#include "neoinit/trace.h"
+#include "neoinit/service.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define TRACE_MASK (NEOINIT_TRACE_RING_SIZE - 1)
+#define OUT_BUF_SIZE 65536
+#define NO_TIME UINT64_MAX
+
+_Static_assert((NEOINIT_TRACE_RING_SIZE & TRACE_MASK) == 0, "trace ring size must be a power of two");
+
+typedef struct trace_ring {
+    neoinit_trace_record_t records[NEOINIT_TRACE_RING_SIZE];
+    _Alignas(64) uint64_t head;     // Written by the owning thread only
+    _Alignas(64) uint64_t tail;     // Written by the collector only
+    uint64_t dropped;
+    uint16_t index;
+    struct trace_ring *next;
+} trace_ring_t;
+
+typedef struct {
+    int fd;
+    size_t len;
+    int error;
+    char buf[OUT_BUF_SIZE];
+} trace_out_t;
+
+volatile bool neoinit_trace_active;
+
+static __thread trace_ring_t *thread_ring;
+static trace_ring_t *rings;
+static uint16_t ring_count;
+
+static pthread_mutex_t collect_lock = PTHREAD_MUTEX_INITIALIZER;
+static neoinit_trace_record_t *collected;
+static size_t collected_count;
+static size_t collected_cap;
+
+static const char *const phase_names[NEOINIT_TRACE_PHASE_MAX] = {
+    [NEOINIT_TRACE_QUEUED] = "queued",
+    [NEOINIT_TRACE_DEPS_SATISFIED] = "deps-satisfied",
+    [NEOINIT_TRACE_FORK] = "fork",
+    [NEOINIT_TRACE_EXEC] = "exec",
+    [NEOINIT_TRACE_READY] = "ready",
+    [NEOINIT_TRACE_RUNNING] = "running",
+};
+
+const char *neoinit_trace_phase_to_string(neoinit_trace_phase_t phase) {
+    return phase < NEOINIT_TRACE_PHASE_MAX ? phase_names[phase] : "unknown";
+}
+
+void neoinit_trace_enable(bool enable) {
+    neoinit_trace_active = enable;
+}
+
+static trace_ring_t *ring_create(void) {
+    trace_ring_t *ring = aligned_alloc(64, sizeof(*ring));
+    if (!ring) return NULL;
+    memset(ring, 0, sizeof(*ring));
+    ring->index = __atomic_fetch_add(&ring_count, 1, __ATOMIC_RELAXED);
+
+    // Rings are never freed, so a lock-free push onto the list is enough
+    ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return ring;
+}
+
+void neoinit_trace_record_at(uint32_t unit_id, neoinit_trace_phase_t phase, uint64_t timestamp) {
+    if (!neoinit_trace_enabled()) return;
+
+    trace_ring_t *ring = thread_ring;
+    if (!ring && !(ring = thread_ring = ring_create())) return;
+
+    uint64_t head = ring->head;
+    if (head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) >= NEOINIT_TRACE_RING_SIZE) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return;
+    }
+
+    ring->records[head & TRACE_MASK] = (neoinit_trace_record_t){
+        .timestamp = timestamp,
+        .unit_id = unit_id,
+        .phase = (uint16_t)phase,
+        .thread = ring->index,
+    };
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+}
+
+void neoinit_trace_record(uint32_t unit_id, neoinit_trace_phase_t phase) {
+    if (!neoinit_trace_enabled()) return;
+    neoinit_trace_record_at(unit_id, phase, neoinit_get_monotonic_time());
+}
+
+static size_t drain_locked(void) {
+    size_t moved = 0;
+
+    for (trace_ring_t *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t tail = ring->tail;
+        size_t n = (size_t)(head - tail);
+        if (!n) continue;
+
+        if (collected_count + n > collected_cap) {
+            size_t cap = collected_cap ? collected_cap : NEOINIT_TRACE_RING_SIZE;
+            while (cap < collected_count + n) cap *= 2;
+            neoinit_trace_record_t *grown = realloc(collected, cap * sizeof(*grown));
+            if (!grown) break;
+            collected = grown;
+            collected_cap = cap;
+        }
+
+        for (; tail != head; tail++) collected[collected_count++] = ring->records[tail & TRACE_MASK];
+        __atomic_store_n(&ring->tail, head, __ATOMIC_RELEASE);
+        moved += n;
+    }
+    return moved;
+}
+
+size_t neoinit_trace_drain(void) {
+    pthread_mutex_lock(&collect_lock);
+    size_t moved = drain_locked();
+    pthread_mutex_unlock(&collect_lock);
+    return moved;
+}
+
+void neoinit_trace_reset(void) {
+    pthread_mutex_lock(&collect_lock);
+    drain_locked();
+    collected_count = 0;
+    pthread_mutex_unlock(&collect_lock);
+}
+
+uint64_t neoinit_trace_dropped(void) {
+    uint64_t dropped = 0;
+    for (trace_ring_t *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+        dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    return dropped;
+}
+
+static void out_flush(trace_out_t *out) {
+    size_t off = 0;
+    while (off < out->len && !out->error) {
+        ssize_t n = write(out->fd, out->buf + off, out->len - off);
+        if (n < 0) out->error = 1;
+        else off += (size_t)n;
+    }
+    out->len = 0;
+}
+
+__attribute__((format(printf, 2, 3)))
+static void out_printf(trace_out_t *out, const char *fmt, ...) {
+    va_list ap;
+    for (int attempt = 0; attempt < 2; attempt++) {
+        va_start(ap, fmt);
+        int n = vsnprintf(out->buf + out->len, sizeof(out->buf) - out->len, fmt, ap);
+        va_end(ap);
+        if (n >= 0 && (size_t)n < sizeof(out->buf) - out->len) {
+            out->len += (size_t)n;
+            return;
+        }
+        out_flush(out);
+    }
+}
+
+static void out_json_string(trace_out_t *out, const char *s) {
+    out_printf(out, "\"");
+    for (; *s; s++) {
+        unsigned char c = (unsigned char)*s;
+        if (c == '"' || c == '\\') out_printf(out, "\\%c", c);
+        else if (c < 0x20) out_printf(out, "\\u%04x", c);
+        else out_printf(out, "%c", c);
+    }
+    out_printf(out, "\"");
+}
+
+/*
+ * Collapse the collected records into the first timestamp of each phase
+ * per unit. Returns the table (unit_count * PHASE_MAX entries) and the
+ * earliest timestamp seen.
+ */
+static uint64_t *build_timeline(size_t *unit_count, uint64_t *origin) {
+    size_t n = neoinit_registry_count();
+    uint64_t *tl = malloc((n ? n : 1) * NEOINIT_TRACE_PHASE_MAX * sizeof(*tl));
+    if (!tl) return NULL;
+    for (size_t i = 0; i < n * NEOINIT_TRACE_PHASE_MAX; i++) tl[i] = NO_TIME;
+
+    *origin = NO_TIME;
+    for (size_t i = 0; i < collected_count; i++) {
+        const neoinit_trace_record_t *r = &collected[i];
+        if (r->unit_id >= n || r->phase >= NEOINIT_TRACE_PHASE_MAX) continue;
+        uint64_t *slot = &tl[r->unit_id * NEOINIT_TRACE_PHASE_MAX + r->phase];
+        if (r->timestamp < *slot) *slot = r->timestamp;
+        if (r->timestamp < *origin) *origin = r->timestamp;
+    }
+
+    *unit_count = n;
+    return tl;
+}
+
+int neoinit_trace_export_chrome(int fd) {
+    trace_out_t *out = malloc(sizeof(*out));
+    if (!out) return NEOINIT_ERROR_NO_MEMORY;
+    out->fd = fd;
+    out->len = 0;
+    out->error = 0;
+
+    pthread_mutex_lock(&collect_lock);
+    drain_locked();
+
+    size_t n;
+    uint64_t origin;
+    uint64_t *tl = build_timeline(&n, &origin);
+    if (!tl) {
+        pthread_mutex_unlock(&collect_lock);
+        free(out);
+        return NEOINIT_ERROR_NO_MEMORY;
+    }
+
+    out_printf(out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    out_printf(out, "{\"ph\":\"M\",\"pid\":1,\"name\":\"process_name\",\"args\":{\"name\":\"neoinit boot\"}}");
+
+    for (size_t id = 0; id < n; id++) {
+        const uint64_t *t = &tl[id * NEOINIT_TRACE_PHASE_MAX];
+        int first = -1;
+        for (int p = 0; p < NEOINIT_TRACE_PHASE_MAX && first < 0; p++) {
+            if (t[p] != NO_TIME) first = p;
+        }
+        if (first < 0) continue;
+
+        const neoinit_unit_t *unit = neoinit_unit_get((uint32_t)id);
+        out_printf(out, ",\n{\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"name\":\"thread_name\",\"args\":{\"name\":", id);
+        out_json_string(out, unit->name);
+        out_printf(out, "}}");
+
+        /*
+         * Phases are not always stamped in enum order: a notify unit is ready
+         * after it is marked running, and the exec stamp can arrive late. So
+         * they are sorted by time, ties kept in enum order.
+         */
+        int order[NEOINIT_TRACE_PHASE_MAX];
+        int count = 0;
+        for (int p = first; p < NEOINIT_TRACE_PHASE_MAX; p++) {
+            if (t[p] == NO_TIME) continue;
+            int i = count++;
+            for (; i > 0 && t[order[i - 1]] > t[p]; i--) order[i] = order[i - 1];
+            order[i] = p;
+        }
+
+        // One complete event per phase, lasting until the next recorded phase
+        for (int i = 0; i < count; i++) {
+            bool last = i + 1 == count;
+            uint64_t begin = t[order[i]] - origin;
+            out_printf(out, ",\n{\"ph\":\"%s\",\"pid\":1,\"tid\":%zu,\"name\":\"%s\",\"cat\":\"unit\","
+                       "\"ts\":%.3f", last ? "i" : "X", id, phase_names[order[i]], begin / 1000.0);
+            if (!last) out_printf(out, ",\"dur\":%.3f", (t[order[i + 1]] - t[order[i]]) / 1000.0);
+            else out_printf(out, ",\"s\":\"t\"");
+            out_printf(out, "}");
+        }
+    }
+
+    out_printf(out, "\n],\"otherData\":{\"dropped\":%llu}}\n", (unsigned long long)neoinit_trace_dropped());
+    out_flush(out);
+    pthread_mutex_unlock(&collect_lock);
+
+    int ret = out->error ? NEOINIT_ERROR_IO : NEOINIT_OK;
+    free(tl);
+    free(out);
+    return ret;
+}
+
+// A unit is started once it is both running and, if it got that far, ready
+static uint64_t unit_end(const uint64_t *t) {
+    uint64_t running = t[NEOINIT_TRACE_RUNNING], ready = t[NEOINIT_TRACE_READY];
+    if (running == NO_TIME) return ready;
+    if (ready == NO_TIME) return running;
+    return running > ready ? running : ready;
+}
+
+static double span_ms(uint64_t from, uint64_t to) {
+    return to > from ? (to - from) / 1e6 : 0.0;
+}
+
+int neoinit_trace_report_critical_path(int fd) {
+    trace_out_t *out = malloc(sizeof(*out));
+    if (!out) return NEOINIT_ERROR_NO_MEMORY;
+    out->fd = fd;
+    out->len = 0;
+    out->error = 0;
+
+    pthread_mutex_lock(&collect_lock);
+    drain_locked();
+
+    size_t n;
+    uint64_t origin;
+    uint64_t *tl = build_timeline(&n, &origin);
+    uint32_t *path = malloc((n ? n : 1) * sizeof(*path));
+    if (!tl || !path) {
+        pthread_mutex_unlock(&collect_lock);
+        free(tl);
+        free(path);
+        free(out);
+        return NEOINIT_ERROR_NO_MEMORY;
+    }
+
+    // The unit that became ready last ends the critical path
+    uint32_t last = NEOINIT_UNIT_ID_INVALID;
+    uint64_t last_end = 0;
+    for (size_t id = 0; id < n; id++) {
+        uint64_t end = unit_end(&tl[id * NEOINIT_TRACE_PHASE_MAX]);
+        if (end != NO_TIME && end >= last_end) {
+            last_end = end;
+            last = (uint32_t)id;
+        }
+    }
+
+    // Walk back through whichever dependency each unit waited on longest
+    size_t len = 0;
+    for (uint32_t cur = last; cur != NEOINIT_UNIT_ID_INVALID && len < n;) {
+        path[len++] = cur;
+        const neoinit_unit_t *unit = neoinit_unit_get(cur);
+        uint64_t queued = tl[cur * NEOINIT_TRACE_PHASE_MAX + NEOINIT_TRACE_QUEUED];
+        uint32_t next = NEOINIT_UNIT_ID_INVALID;
+        uint64_t next_end = 0;
+
+        for (uint32_t i = 0; i < unit->dep_count; i++) {
+            uint64_t end = unit_end(&tl[unit->dep_ids[i] * NEOINIT_TRACE_PHASE_MAX]);
+            if (end != NO_TIME && end >= next_end && (queued == NO_TIME || end > queued)) {
+                next_end = end;
+                next = unit->dep_ids[i];
+            }
+        }
+        cur = next;
+    }
+
+    if (!len) {
+        out_printf(out, "critical path: no completed units traced\n");
+    } else {
+        out_printf(out, "critical path: %zu units, %.3f ms\n", len, (last_end - origin) / 1e6);
+        out_printf(out, "%12s %12s %12s  %s\n", "at(ms)", "wait(ms)", "start(ms)", "unit");
+        for (size_t i = len; i-- > 0;) {
+            const uint64_t *t = &tl[path[i] * NEOINIT_TRACE_PHASE_MAX];
+            uint64_t begin = t[NEOINIT_TRACE_QUEUED] != NO_TIME ? t[NEOINIT_TRACE_QUEUED] : unit_end(t);
+            uint64_t deps = t[NEOINIT_TRACE_DEPS_SATISFIED] != NO_TIME ? t[NEOINIT_TRACE_DEPS_SATISFIED] : begin;
+            out_printf(out, "%12.3f %12.3f %12.3f  %s\n", span_ms(origin, begin), span_ms(begin, deps),
+                       span_ms(deps, unit_end(t)), neoinit_unit_get(path[i])->name);
+        }
+    }
+    out_flush(out);
+    pthread_mutex_unlock(&collect_lock);
+
+    int ret = out->error ? NEOINIT_ERROR_IO : NEOINIT_OK;
+    free(tl);
+    free(path);
+    free(out);
+    return ret;
+}
@@ -0,0 +1,201 @@
+#include "neoinit/events.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+typedef struct {
+    neoinit_event_handler_config_t config;
+    bool used;
+    bool enabled;
+} event_handler_t;
+
+static event_handler_t handlers[NEOINIT_MAX_EVENT_HANDLERS];
+static pthread_mutex_t handler_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint64_t event_ids;
+
+static const char *const type_names[] = {
+    [NEOINIT_EVENT_SYSTEM_STARTUP] = "system-startup",
+    [NEOINIT_EVENT_SYSTEM_SHUTDOWN] = "system-shutdown",
+    [NEOINIT_EVENT_SYSTEM_RELOAD] = "system-reload",
+    [NEOINIT_EVENT_SYSTEM_ERROR] = "system-error",
+    [NEOINIT_EVENT_SYSTEM_OOM] = "system-oom",
+    [NEOINIT_EVENT_SYSTEM_CRASH] = "system-crash",
+    [NEOINIT_EVENT_SERVICE_START] = "service-start",
+    [NEOINIT_EVENT_SERVICE_STOP] = "service-stop",
+    [NEOINIT_EVENT_SERVICE_RELOAD] = "service-reload",
+    [NEOINIT_EVENT_SERVICE_RESTART] = "service-restart",
+    [NEOINIT_EVENT_SERVICE_FAIL] = "service-fail",
+    [NEOINIT_EVENT_SERVICE_EXIT] = "service-exit",
+    [NEOINIT_EVENT_SERVICE_WATCHDOG] = "service-watchdog",
+    [NEOINIT_EVENT_SERVICE_THROTTLED] = "service-throttled",
+    [NEOINIT_EVENT_SERVICE_OOM] = "service-oom",
+    [NEOINIT_EVENT_RESOURCE_LOW_MEMORY] = "resource-low-memory",
+    [NEOINIT_EVENT_RESOURCE_HIGH_CPU] = "resource-high-cpu",
+    [NEOINIT_EVENT_RESOURCE_HIGH_IO] = "resource-high-io",
+    [NEOINIT_EVENT_RESOURCE_LIMIT_HIT] = "resource-limit-hit",
+    [NEOINIT_EVENT_NETWORK_UP] = "network-up",
+    [NEOINIT_EVENT_NETWORK_DOWN] = "network-down",
+    [NEOINIT_EVENT_NETWORK_ERROR] = "network-error",
+    [NEOINIT_EVENT_SECURITY_VIOLATION] = "security-violation",
+    [NEOINIT_EVENT_SECURITY_BREACH] = "security-breach",
+    [NEOINIT_EVENT_SECURITY_SELINUX] = "security-selinux",
+    [NEOINIT_EVENT_SECURITY_APPARMOR] = "security-apparmor",
+    [NEOINIT_EVENT_CONFIG_CHANGED] = "config-changed",
+    [NEOINIT_EVENT_CONFIG_ERROR] = "config-error",
+    [NEOINIT_EVENT_CONFIG_RELOAD] = "config-reload",
+    [NEOINIT_EVENT_DEPENDENCY_SATISFIED] = "dependency-satisfied",
+    [NEOINIT_EVENT_DEPENDENCY_FAILED] = "dependency-failed",
+    [NEOINIT_EVENT_DEPENDENCY_TIMEOUT] = "dependency-timeout",
+    [NEOINIT_EVENT_TIMER_TRIGGERED] = "timer-triggered",
+    [NEOINIT_EVENT_TIMER_EXPIRED] = "timer-expired",
+    [NEOINIT_EVENT_TIMER_ERROR] = "timer-error",
+    [NEOINIT_EVENT_SOCKET_ACTIVATED] = "socket-activated",
+    [NEOINIT_EVENT_SOCKET_CLOSED] = "socket-closed",
+    [NEOINIT_EVENT_SOCKET_ERROR] = "socket-error",
+    [NEOINIT_EVENT_FS_FULL] = "fs-full",
+    [NEOINIT_EVENT_FS_ERROR] = "fs-error",
+    [NEOINIT_EVENT_FS_READONLY] = "fs-readonly",
+    [NEOINIT_EVENT_HW_ERROR] = "hw-error",
+    [NEOINIT_EVENT_HW_ADDED] = "hw-added",
+    [NEOINIT_EVENT_HW_REMOVED] = "hw-removed",
+};
+
+static const char *const priority_names[] = {
+    [NEOINIT_EVENT_PRIORITY_EMERGENCY] = "emergency",
+    [NEOINIT_EVENT_PRIORITY_ALERT] = "alert",
+    [NEOINIT_EVENT_PRIORITY_CRITICAL] = "critical",
+    [NEOINIT_EVENT_PRIORITY_ERROR] = "error",
+    [NEOINIT_EVENT_PRIORITY_WARNING] = "warning",
+    [NEOINIT_EVENT_PRIORITY_NOTICE] = "notice",
+    [NEOINIT_EVENT_PRIORITY_INFO] = "info",
+    [NEOINIT_EVENT_PRIORITY_DEBUG] = "debug",
+};
+
+static event_handler_t *handler_find_locked(const char *name) {
+    for (size_t i = 0; i < NEOINIT_MAX_EVENT_HANDLERS; i++) {
+        if (handlers[i].used && strcmp(handlers[i].config.name, name) == 0) return &handlers[i];
+    }
+    return NULL;
+}
+
+/*
+ * Handlers match on the event type. One registered with
+ * NEOINIT_EVENT_FLAG_BROADCAST sees every event instead.
+ */
+int neoinit_handler_register(const neoinit_event_handler_config_t *config) {
+    if (!config || !config->handler || !config->name[0]) return NEOINIT_ERROR_INVALID_ARG;
+
+    pthread_mutex_lock(&handler_lock);
+    int ret = NEOINIT_ERROR_RESOURCE;
+    if (handler_find_locked(config->name)) {
+        ret = NEOINIT_ERROR_EXISTS;
+    } else {
+        for (size_t i = 0; i < NEOINIT_MAX_EVENT_HANDLERS; i++) {
+            if (handlers[i].used) continue;
+            handlers[i].config = *config;
+            handlers[i].config.name[sizeof(handlers[i].config.name) - 1] = '\0';
+            handlers[i].used = true;
+            handlers[i].enabled = true;
+            ret = NEOINIT_OK;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&handler_lock);
+    return ret;
+}
+
+static int handler_update(const char *name, bool used, bool enabled) {
+    if (!name) return NEOINIT_ERROR_INVALID_ARG;
+
+    pthread_mutex_lock(&handler_lock);
+    event_handler_t *h = handler_find_locked(name);
+    if (h) {
+        h->used = used;
+        h->enabled = enabled;
+    }
+    pthread_mutex_unlock(&handler_lock);
+    return h ? NEOINIT_OK : NEOINIT_ERROR_NOT_FOUND;
+}
+
+int neoinit_handler_unregister(const char *name) {
+    return handler_update(name, false, false);
+}
+
+int neoinit_handler_enable(const char *name) {
+    return handler_update(name, true, true);
+}
+
+int neoinit_handler_disable(const char *name) {
+    return handler_update(name, true, false);
+}
+
+static int event_deliver(neoinit_event_t *event, bool broadcast) {
+    event->id = __atomic_add_fetch(&event_ids, 1, __ATOMIC_RELAXED);
+    event->context.sequence = event->id;
+    if (!event->timestamp) event->timestamp = time(NULL);
+
+    // Snapshot the matches so handlers run unlocked and may (un)register
+    struct {
+        neoinit_event_handler_fn fn;
+        void *user_data;
+        neoinit_event_priority_t priority;
+    } matched[NEOINIT_MAX_EVENT_HANDLERS];
+    size_t count = 0;
+
+    pthread_mutex_lock(&handler_lock);
+    for (size_t i = 0; i < NEOINIT_MAX_EVENT_HANDLERS; i++) {
+        const event_handler_t *h = &handlers[i];
+        if (!h->used || !h->enabled) continue;
+        if (!broadcast && h->config.type != event->type && !(h->config.flags & NEOINIT_EVENT_FLAG_BROADCAST))
+            continue;
+
+        // Insertion sort on handler priority; the table is small
+        size_t pos = count++;
+        while (pos && matched[pos - 1].priority > h->config.priority) {
+            matched[pos] = matched[pos - 1];
+            pos--;
+        }
+        matched[pos].fn = h->config.handler;
+        matched[pos].user_data = h->config.user_data;
+        matched[pos].priority = h->config.priority;
+    }
+    pthread_mutex_unlock(&handler_lock);
+
+    for (size_t i = 0; i < count; i++) matched[i].fn(event, matched[i].user_data);
+    return (int)count;
+}
+
+// Runs the matching handlers synchronously and returns how many saw the event
+int neoinit_event_emit(neoinit_event_t *event) {
+    if (!event) return NEOINIT_ERROR_INVALID_ARG;
+    return event_deliver(event, false);
+}
+
+int neoinit_event_broadcast(neoinit_event_t *event) {
+    if (!event) return NEOINIT_ERROR_INVALID_ARG;
+    return event_deliver(event, true);
+}
+
+const char *neoinit_event_type_to_string(neoinit_event_type_t type) {
+    if (type >= NEOINIT_EVENT_CUSTOM_BASE) return "custom";
+    if ((size_t)type >= sizeof(type_names) / sizeof(type_names[0]) || !type_names[type]) return "unknown";
+    return type_names[type];
+}
+
+// Inverse of neoinit_event_type_to_string() for the built-in types; -1 if unknown
+int neoinit_event_type_from_string(const char *name) {
+    if (!name) return -1;
+    for (size_t i = 0; i < sizeof(type_names) / sizeof(type_names[0]); i++) {
+        if (type_names[i] && strcmp(type_names[i], name) == 0) return (int)i;
+    }
+    return -1;
+}
+
+const char *neoinit_priority_to_string(neoinit_event_priority_t priority) {
+    if ((size_t)priority >= sizeof(priority_names) / sizeof(priority_names[0])) return "unknown";
+    return priority_names[priority];
+}
+
+uint64_t neoinit_event_get_current_id(void) {
+    return __atomic_load_n(&event_ids, __ATOMIC_RELAXED);
+}
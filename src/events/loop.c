@@ -0,0 +1,221 @@
+#include "neoinit/events.h"
+#include "neoinit/metrics.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+#define LOOP_BATCH 64
+#define STATS_BUF_SIZE 8192
+
+typedef struct loop_watch {
+    int fd;
+    uint32_t events;
+    neoinit_fd_handler_fn handler;  // NULL once unwatched
+    void *user_data;
+    struct loop_watch *next_dead;
+} loop_watch_t;
+
+static int epoll_fd = -1;
+static int wake_fd = -1;
+static volatile bool loop_running;
+
+static pthread_mutex_t watch_lock = PTHREAD_MUTEX_INITIALIZER;
+static loop_watch_t **watches;      // Indexed by fd
+static size_t watch_cap;
+static size_t watch_count;
+static loop_watch_t *dead_watches;  // Freed before the next epoll_wait
+
+static int on_wake(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    (void)user_data;
+    uint64_t v;
+    while (read(fd, &v, sizeof(v)) > 0) {
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_events_init(void) {
+    if (epoll_fd >= 0) return NEOINIT_OK;
+
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd == -1) return NEOINIT_ERROR_SYSTEM;
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd == -1 || neoinit_events_watch(wake_fd, EPOLLIN, on_wake, NULL) != NEOINIT_OK) {
+        if (wake_fd >= 0) close(wake_fd);
+        close(epoll_fd);
+        epoll_fd = wake_fd = -1;
+        return NEOINIT_ERROR_SYSTEM;
+    }
+    return NEOINIT_OK;
+}
+
+static void free_dead_locked(void) {
+    while (dead_watches) {
+        loop_watch_t *w = dead_watches;
+        dead_watches = w->next_dead;
+        free(w);
+    }
+}
+
+int neoinit_events_cleanup(void) {
+    pthread_mutex_lock(&watch_lock);
+    for (size_t fd = 0; fd < watch_cap; fd++) free(watches[fd]);
+    free(watches);
+    watches = NULL;
+    watch_cap = watch_count = 0;
+    free_dead_locked();
+    pthread_mutex_unlock(&watch_lock);
+
+    if (wake_fd >= 0) close(wake_fd);
+    if (epoll_fd >= 0) close(epoll_fd);
+    epoll_fd = wake_fd = -1;
+    return NEOINIT_OK;
+}
+
+int neoinit_events_watch(int fd, uint32_t events, neoinit_fd_handler_fn handler, void *user_data) {
+    if (fd < 0 || !handler) return NEOINIT_ERROR_INVALID_ARG;
+    if (epoll_fd < 0) return NEOINIT_ERROR_STATE;
+
+    loop_watch_t *w = calloc(1, sizeof(*w));
+    if (!w) return NEOINIT_ERROR_NO_MEMORY;
+    w->fd = fd;
+    w->events = events;
+    w->handler = handler;
+    w->user_data = user_data;
+
+    pthread_mutex_lock(&watch_lock);
+    if ((size_t)fd >= watch_cap) {
+        size_t cap = watch_cap ? watch_cap : 64;
+        while (cap <= (size_t)fd) cap *= 2;
+        loop_watch_t **grown = realloc(watches, cap * sizeof(*grown));
+        if (!grown) {
+            pthread_mutex_unlock(&watch_lock);
+            free(w);
+            return NEOINIT_ERROR_NO_MEMORY;
+        }
+        memset(grown + watch_cap, 0, (cap - watch_cap) * sizeof(*grown));
+        watches = grown;
+        watch_cap = cap;
+    }
+    if (watches[fd]) {
+        pthread_mutex_unlock(&watch_lock);
+        free(w);
+        return NEOINIT_ERROR_EXISTS;
+    }
+
+    struct epoll_event ev = { .events = events, .data.ptr = w };
+    if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        pthread_mutex_unlock(&watch_lock);
+        free(w);
+        return errno == EEXIST ? NEOINIT_ERROR_EXISTS : NEOINIT_ERROR_SYSTEM;
+    }
+    watches[fd] = w;
+    watch_count++;
+    pthread_mutex_unlock(&watch_lock);
+    return NEOINIT_OK;
+}
+
+int neoinit_events_modify(int fd, uint32_t events) {
+    pthread_mutex_lock(&watch_lock);
+    loop_watch_t *w = fd >= 0 && (size_t)fd < watch_cap ? watches[fd] : NULL;
+    int ret = NEOINIT_ERROR_NOT_FOUND;
+    if (w) {
+        struct epoll_event ev = { .events = events, .data.ptr = w };
+        ret = epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &ev) == 0 ? NEOINIT_OK : NEOINIT_ERROR_SYSTEM;
+        if (ret == NEOINIT_OK) w->events = events;
+    }
+    pthread_mutex_unlock(&watch_lock);
+    return ret;
+}
+
+int neoinit_events_unwatch(int fd) {
+    pthread_mutex_lock(&watch_lock);
+    loop_watch_t *w = fd >= 0 && (size_t)fd < watch_cap ? watches[fd] : NULL;
+    if (!w) {
+        pthread_mutex_unlock(&watch_lock);
+        return NEOINIT_ERROR_NOT_FOUND;
+    }
+
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, fd, NULL);
+    watches[fd] = NULL;
+    watch_count--;
+
+    // The current batch may still hold a pointer to it; free after the batch
+    w->handler = NULL;
+    w->next_dead = dead_watches;
+    dead_watches = w;
+    pthread_mutex_unlock(&watch_lock);
+    return NEOINIT_OK;
+}
+
+int neoinit_events_dispatch_once(int timeout_ms) {
+    if (epoll_fd < 0) return NEOINIT_ERROR_STATE;
+
+    pthread_mutex_lock(&watch_lock);
+    free_dead_locked();
+    pthread_mutex_unlock(&watch_lock);
+
+    struct epoll_event events[LOOP_BATCH];
+    int n = epoll_wait(epoll_fd, events, LOOP_BATCH, timeout_ms);
+    if (n < 0) return errno == EINTR ? 0 : NEOINIT_ERROR_SYSTEM;
+
+    neoinit_metrics_inc(NEOINIT_COUNTER_EPOLL_WAKEUPS);
+    neoinit_metrics_observe(NEOINIT_HIST_QUEUE_DEPTH, (uint64_t)n);
+
+    for (int i = 0; i < n; i++) {
+        loop_watch_t *w = events[i].data.ptr;
+        neoinit_fd_handler_fn handler = w->handler;
+        if (!handler) continue;
+
+        uint64_t start = neoinit_get_monotonic_time();
+        handler(w->fd, events[i].events, w->user_data);
+        neoinit_metrics_observe(NEOINIT_HIST_DISPATCH_LATENCY, neoinit_get_monotonic_time() - start);
+        neoinit_metrics_inc(NEOINIT_COUNTER_EVENTS_DISPATCHED);
+    }
+    return n;
+}
+
+int neoinit_events_dispatch(void) {
+    loop_running = true;
+    while (loop_running) {
+        int ret = neoinit_events_dispatch_once(-1);
+        if (ret < 0) return ret;
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_events_stop(void) {
+    loop_running = false;
+    if (wake_fd >= 0) {
+        uint64_t one = 1;
+        if (write(wake_fd, &one, sizeof(one)) != sizeof(one)) return NEOINIT_ERROR_IO;
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_events_get_stats(char *buf, size_t size) {
+    return neoinit_metrics_format_json(buf, size);
+}
+
+int neoinit_events_dump_state(int fd) {
+    char *buf = malloc(STATS_BUF_SIZE);
+    if (!buf) return NEOINIT_ERROR_NO_MEMORY;
+
+    pthread_mutex_lock(&watch_lock);
+    dprintf(fd, "watches: %zu\n", watch_count);
+    for (size_t i = 0; i < watch_cap; i++) {
+        if (watches[i]) dprintf(fd, "  fd %zu events 0x%x\n", i, watches[i]->events);
+    }
+    pthread_mutex_unlock(&watch_lock);
+
+    int ret = neoinit_events_get_stats(buf, STATS_BUF_SIZE);
+    if (ret >= 0) dprintf(fd, "stats: %s\n", buf);
+    free(buf);
+    return ret < 0 ? ret : NEOINIT_OK;
+}
@@ -0,0 +1,1037 @@
+#define _GNU_SOURCE
+#include "neoinit/netlink.h"
+#include "neoinit/events.h"
+#include "neoinit/socket.h"
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <fnmatch.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <net/if.h>
+#include <linux/if.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#define DEVICE_LINE_MAX   (NEOINIT_MAX_PATH_LENGTH + 64)
+#define KEY_TABLE_SIZE    (NEOINIT_NETLINK_MAX_KEYS * 2)   // Open addressing, power of two
+#define MSG_STRIDE        (NEOINIT_NETLINK_MSG_SIZE + 1)   // Room to NUL-terminate a uevent
+#define SYSFS_ROOT        "/sys"
+
+typedef enum {
+    ACTION_ADD = 0,
+    ACTION_REMOVE,
+    ACTION_CHANGE,
+    ACTION_MOVE,
+    ACTION_ONLINE,
+    ACTION_OFFLINE,
+    ACTION_BIND,
+    ACTION_UNBIND,
+    ACTION_MAX
+} device_action_t;
+
+static const char *const action_names[ACTION_MAX] = {
+    "add", "remove", "change", "move", "online", "offline", "bind", "unbind",
+};
+
+// Slots every uevent is split into, before the keys rules ask for
+enum { SLOT_ACTION = 0, SLOT_DEVPATH, SLOT_SUBSYSTEM, SLOT_DEVTYPE, SLOT_FIXED };
+
+static const char *const fixed_keys[SLOT_FIXED] = { "ACTION", "DEVPATH", "SUBSYSTEM", "DEVTYPE" };
+
+typedef struct {
+    char *text;                     // NULL matches anything
+    bool glob;                      // fnmatch() rather than strcmp()
+} pattern_t;
+
+typedef struct {
+    char *name;
+    char *unit;
+    neoinit_netlink_source_t source;
+    uint32_t actions;               // Bit per device_action_t
+    pattern_t subsystem;
+    pattern_t devtype;
+    pattern_t ifname;
+    bool up;                        // Link rules: fire on up, or on down
+    struct {
+        char *key;
+        uint32_t slot;
+        pattern_t value;
+    } props[NEOINIT_NETLINK_MAX_PROPS];
+    uint32_t prop_count;
+    uint64_t fired;                 // Batch this rule last fired in
+    uint64_t matches;
+} device_rule_t;
+
+typedef struct {
+    device_rule_t **rules;
+    size_t count;
+    size_t cap;
+} rule_list_t;
+
+typedef struct {
+    uint32_t tag;                   // Action, or the parent bucket for a property bucket
+    uint32_t hash;
+    const char *text;               // Subsystem or property value, owned by the first rule
+    rule_list_t list;
+    rule_list_t rest;               // Rules without a literal for key_slot
+    int key_slot;                   // Property the bucket is split on, -1 if it is not
+} rule_bucket_t;
+
+typedef struct {
+    rule_bucket_t *entries;
+    size_t count;
+    size_t cap;
+    uint32_t *index;                // Entry position plus one, 0 when empty
+    size_t size;
+} bucket_table_t;
+
+typedef struct {
+    const char *key;
+    size_t len;
+    uint32_t hash;
+    uint32_t slot;
+} key_entry_t;
+
+typedef struct {
+    int index;
+    bool up;
+    char name[IF_NAMESIZE];
+} link_state_t;
+
+typedef struct {
+    neoinit_netlink_source_t kind;
+    const char *name;
+    int fd;
+    bool kernel;                    // A bound netlink socket, so senders are checked
+} nl_source_t;
+
+static neoinit_netlink_activate_fn activate_fn;
+static void *activate_data;
+static neoinit_netlink_stats_t stats;
+static bool initialized;
+
+static nl_source_t sources[NEOINIT_NETLINK_SOURCE_MAX] = {
+    { NEOINIT_NETLINK_UEVENT, "uevent", -1, false },
+    { NEOINIT_NETLINK_ROUTE, "rtnetlink", -1, false },
+};
+
+static device_rule_t **rules;
+static size_t rule_count;
+static size_t rule_cap;
+
+// Compiled matcher
+static key_entry_t key_table[KEY_TABLE_SIZE];
+static uint32_t key_count;
+static bucket_table_t by_subsystem;  // (action, SUBSYSTEM)
+static bucket_table_t by_property;   // (subsystem bucket, value of its key_slot)
+static rule_list_t any_subsystem[ACTION_MAX];
+static rule_list_t link_rules[2];   // Indexed by the state they fire on
+
+static link_state_t *links;
+static size_t link_count;
+static size_t link_cap;
+
+// recvmmsg() batch, shared by both sources
+static char *batch_buf;
+static struct mmsghdr batch_msgs[NEOINIT_NETLINK_BATCH];
+static struct iovec batch_iov[NEOINIT_NETLINK_BATCH];
+static struct sockaddr_nl batch_addr[NEOINIT_NETLINK_BATCH];
+static uint64_t batch_seq;
+static uint32_t dump_seq;
+
+static bool grow(void *array, size_t *cap, size_t len, size_t elem) {
+    if (len < *cap) return true;
+    size_t next = *cap ? *cap * 2 : 16;
+    void *grown = realloc(*(void **)array, next * elem);
+    if (!grown) return false;
+    *(void **)array = grown;
+    *cap = next;
+    return true;
+}
+
+static uint32_t hash_bytes(const char *s, size_t len) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; i++) h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+static bool list_add(rule_list_t *list, device_rule_t *rule) {
+    if (!grow(&list->rules, &list->cap, list->count, sizeof(*list->rules))) return false;
+    list->rules[list->count++] = rule;
+    return true;
+}
+
+static void list_free(rule_list_t *list) {
+    free(list->rules);
+    memset(list, 0, sizeof(*list));
+}
+
+/*
+ * Patterns
+ */
+
+static int pattern_set(pattern_t *pattern, const char *text) {
+    char *copy = strdup(text);
+    if (!copy) return NEOINIT_ERROR_NO_MEMORY;
+    free(pattern->text);
+    pattern->text = copy;
+    pattern->glob = strpbrk(copy, "*?[") != NULL;
+    return NEOINIT_OK;
+}
+
+static bool pattern_match(const pattern_t *pattern, const char *value) {
+    if (!pattern->text) return true;
+    if (!value) return false;
+    return pattern->glob ? fnmatch(pattern->text, value, 0) == 0 : strcmp(pattern->text, value) == 0;
+}
+
+/*
+ * Matcher compilation
+ */
+
+static const key_entry_t *key_find(const char *key, size_t len, uint32_t hash) {
+    for (uint32_t i = hash & (KEY_TABLE_SIZE - 1); key_table[i].key; i = (i + 1) & (KEY_TABLE_SIZE - 1)) {
+        const key_entry_t *entry = &key_table[i];
+        if (entry->hash == hash && entry->len == len && memcmp(entry->key, key, len) == 0) return entry;
+    }
+    return NULL;
+}
+
+// Slot for a property key, shared by every rule that names it; -1 when the table is full
+static int key_intern(const char *key) {
+    size_t len = strlen(key);
+    uint32_t hash = hash_bytes(key, len);
+    const key_entry_t *found = key_find(key, len, hash);
+    if (found) return (int)found->slot;
+    if (key_count == NEOINIT_NETLINK_MAX_KEYS) return -1;
+
+    uint32_t i = hash & (KEY_TABLE_SIZE - 1);
+    while (key_table[i].key) i = (i + 1) & (KEY_TABLE_SIZE - 1);
+    key_table[i] = (key_entry_t){ .key = key, .len = len, .hash = hash, .slot = key_count };
+    return (int)key_count++;
+}
+
+static uint32_t bucket_hash(uint32_t tag, const char *text) {
+    return hash_bytes(text, strlen(text)) ^ (tag * 0x9e3779b1u);
+}
+
+static rule_bucket_t *bucket_find(const bucket_table_t *table, uint32_t tag, const char *text, uint32_t hash) {
+    if (!table->size) return NULL;
+    size_t mask = table->size - 1;
+    for (size_t i = hash & mask; table->index[i]; i = (i + 1) & mask) {
+        rule_bucket_t *bucket = &table->entries[table->index[i] - 1];
+        if (bucket->hash == hash && bucket->tag == tag && strcmp(bucket->text, text) == 0) return bucket;
+    }
+    return NULL;
+}
+
+static void bucket_insert(uint32_t *index, size_t size, uint32_t hash, size_t pos) {
+    size_t i = hash & (size - 1);
+    while (index[i]) i = (i + 1) & (size - 1);
+    index[i] = (uint32_t)pos + 1;
+}
+
+// Kept at most half full, so probes stay short
+static int bucket_reserve(bucket_table_t *table) {
+    if (!grow(&table->entries, &table->cap, table->count, sizeof(*table->entries))) return NEOINIT_ERROR_NO_MEMORY;
+    if ((table->count + 1) * 2 <= table->size) return NEOINIT_OK;
+
+    size_t size = table->size ? table->size * 2 : 16;
+    uint32_t *index = calloc(size, sizeof(*index));
+    if (!index) return NEOINIT_ERROR_NO_MEMORY;
+    for (size_t b = 0; b < table->count; b++) bucket_insert(index, size, table->entries[b].hash, b);
+    free(table->index);
+    table->index = index;
+    table->size = size;
+    return NEOINIT_OK;
+}
+
+static int bucket_add(bucket_table_t *table, uint32_t tag, const char *text, device_rule_t *rule) {
+    uint32_t hash = bucket_hash(tag, text);
+    rule_bucket_t *bucket = bucket_find(table, tag, text, hash);
+    if (!bucket) {
+        int ret = bucket_reserve(table);
+        if (ret != NEOINIT_OK) return ret;
+        bucket = &table->entries[table->count];
+        *bucket = (rule_bucket_t){ .tag = tag, .hash = hash, .text = text, .key_slot = -1 };
+        bucket_insert(table->index, table->size, hash, table->count++);
+    }
+    return list_add(&bucket->list, rule) ? NEOINIT_OK : NEOINIT_ERROR_NO_MEMORY;
+}
+
+static void bucket_table_free(bucket_table_t *table) {
+    for (size_t i = 0; i < table->count; i++) {
+        list_free(&table->entries[i].list);
+        list_free(&table->entries[i].rest);
+    }
+    free(table->entries);
+    free(table->index);
+    memset(table, 0, sizeof(*table));
+}
+
+static const pattern_t *rule_literal(const device_rule_t *rule, uint32_t slot) {
+    for (uint32_t p = 0; p < rule->prop_count; p++) {
+        if (rule->props[p].slot == slot && !rule->props[p].value.glob) return &rule->props[p].value;
+    }
+    return NULL;
+}
+
+/*
+ * Many rules on one subsystem usually differ by a literal property, such
+ * as DEVNAME or INTERFACE. Such a bucket is split again on the property
+ * that most of its rules give literally. A uevent then meets only the
+ * rules for its own value, plus the few that give the property as a
+ * pattern or not at all.
+ */
+static int bucket_split(size_t pos) {
+    rule_bucket_t *bucket = &by_subsystem.entries[pos];
+    if (bucket->list.count < NEOINIT_NETLINK_SPLIT_MIN) return NEOINIT_OK;
+
+    uint32_t best = 0;
+    size_t best_count = 0;
+    for (uint32_t slot = SLOT_FIXED; slot < key_count; slot++) {
+        size_t n = 0;
+        for (size_t r = 0; r < bucket->list.count; r++) n += rule_literal(bucket->list.rules[r], slot) != NULL;
+        if (n > best_count) {
+            best = slot;
+            best_count = n;
+        }
+    }
+    if (best_count * 2 < bucket->list.count) return NEOINIT_OK;
+
+    for (size_t r = 0; r < by_subsystem.entries[pos].list.count; r++) {
+        device_rule_t *rule = by_subsystem.entries[pos].list.rules[r];
+        const pattern_t *value = rule_literal(rule, best);
+        int ret = value ? bucket_add(&by_property, (uint32_t)pos, value->text, rule)
+                        : list_add(&by_subsystem.entries[pos].rest, rule) ? NEOINIT_OK : NEOINIT_ERROR_NO_MEMORY;
+        if (ret != NEOINIT_OK) return ret;
+    }
+    by_subsystem.entries[pos].key_slot = (int)best;
+    return NEOINIT_OK;
+}
+
+static void matcher_reset(void) {
+    bucket_table_free(&by_subsystem);
+    bucket_table_free(&by_property);
+    for (int a = 0; a < ACTION_MAX; a++) list_free(&any_subsystem[a]);
+    list_free(&link_rules[0]);
+    list_free(&link_rules[1]);
+
+    memset(key_table, 0, sizeof(key_table));
+    key_count = 0;
+    for (int s = 0; s < SLOT_FIXED; s++) key_intern(fixed_keys[s]);
+}
+
+/*
+ * Rules are bucketed by (action, literal subsystem), and large buckets are
+ * split by bucket_split(). A rule with a subsystem pattern, or none, goes
+ * on its action's fallback list instead. Property keys become slots, so
+ * matching never looks a key up by name.
+ */
+static int matcher_compile(void) {
+    matcher_reset();
+    for (size_t r = 0; r < rule_count; r++) {
+        device_rule_t *rule = rules[r];
+        int ret = NEOINIT_OK;
+        if (rule->source == NEOINIT_NETLINK_ROUTE) {
+            if (!list_add(&link_rules[rule->up], rule)) ret = NEOINIT_ERROR_NO_MEMORY;
+        } else {
+            for (uint32_t p = 0; p < rule->prop_count && ret == NEOINIT_OK; p++) {
+                int slot = key_intern(rule->props[p].key);
+                if (slot < 0) {
+                    LOG_ERROR("%s: more than %d distinct device properties", rule->name, NEOINIT_NETLINK_MAX_KEYS);
+                    ret = NEOINIT_ERROR_RESOURCE;
+                }
+                rule->props[p].slot = (uint32_t)slot;
+            }
+            for (uint32_t a = 0; a < ACTION_MAX && ret == NEOINIT_OK; a++) {
+                if (!(rule->actions & (1u << a))) continue;
+                if (rule->subsystem.text && !rule->subsystem.glob) {
+                    ret = bucket_add(&by_subsystem, a, rule->subsystem.text, rule);
+                } else if (!list_add(&any_subsystem[a], rule)) {
+                    ret = NEOINIT_ERROR_NO_MEMORY;
+                }
+            }
+        }
+        if (ret != NEOINIT_OK) {
+            matcher_reset();
+            return ret;
+        }
+    }
+    for (size_t b = 0; b < by_subsystem.count; b++) {
+        int ret = bucket_split(b);
+        if (ret != NEOINIT_OK) {
+            matcher_reset();
+            return ret;
+        }
+    }
+    return NEOINIT_OK;
+}
+
+/*
+ * Matching
+ */
+
+static void rule_fire(device_rule_t *rule) {
+    // A coldplug burst that adds the same kind of device many times starts its unit once
+    if (rule->fired == batch_seq) return;
+    rule->fired = batch_seq;
+    rule->matches++;
+    stats.matches++;
+    if (activate_fn(rule->unit, activate_data) != NEOINIT_OK) {
+        LOG_WARNING("Device rule %s failed to start %s", rule->name, rule->unit);
+    }
+}
+
+static bool uevent_rule_matches(const device_rule_t *rule, const char **values) {
+    if (!pattern_match(&rule->subsystem, values[SLOT_SUBSYSTEM])) return false;
+    if (!pattern_match(&rule->devtype, values[SLOT_DEVTYPE])) return false;
+    for (uint32_t p = 0; p < rule->prop_count; p++) {
+        if (!pattern_match(&rule->props[p].value, values[rule->props[p].slot])) return false;
+    }
+    return true;
+}
+
+static void match_list(const rule_list_t *list, const char **values) {
+    for (size_t i = 0; i < list->count; i++) {
+        stats.candidates++;
+        if (uevent_rule_matches(list->rules[i], values)) rule_fire(list->rules[i]);
+    }
+}
+
+static void emit(neoinit_event_type_t type, const char *source, const char *name, const char *data) {
+    neoinit_event_t event = {
+        .type = type,
+        .priority = NEOINIT_EVENT_PRIORITY_INFO,
+        .flags = NEOINIT_EVENT_FLAG_EXTERNAL,
+    };
+    event.source.type = NEOINIT_EVENT_SOURCE_NETLINK;
+    snprintf(event.source.name, sizeof(event.source.name), "%s", source);
+    snprintf(event.name, sizeof(event.name), "%s", name);
+    snprintf(event.data.buf, sizeof(event.data.buf), "%s", data);
+    event.data.size = strlen(event.data.buf);
+    neoinit_event_emit(&event);
+}
+
+/*
+ * A uevent is "action@devpath" followed by NUL-separated KEY=VALUE pairs.
+ * buf must have room for a terminating NUL at buf[len].
+ */
+static void handle_uevent(char *buf, size_t len, bool announce) {
+    const char *values[NEOINIT_NETLINK_MAX_KEYS];
+    memset(values, 0, key_count * sizeof(*values));
+    buf[len] = '\0';
+
+    // udev's own re-broadcasts carry a binary header; only kernel messages are parsed
+    if (len >= 8 && memcmp(buf, "libudev", 8) == 0) {
+        stats.rejected++;
+        return;
+    }
+
+    char *end = buf + len;
+    for (char *p = buf; p < end; p += strlen(p) + 1) {
+        const char *eq = strchr(p, '=');
+        if (!eq) continue;
+        size_t key_len = (size_t)(eq - p);
+        const key_entry_t *entry = key_find(p, key_len, hash_bytes(p, key_len));
+        if (entry) values[entry->slot] = eq + 1;
+    }
+
+    const char *action_name = values[SLOT_ACTION];
+    const char *subsystem = values[SLOT_SUBSYSTEM];
+    if (!action_name || !subsystem || !values[SLOT_DEVPATH]) {
+        stats.rejected++;
+        return;
+    }
+    stats.uevents++;
+
+    uint32_t action = ACTION_MAX;
+    for (uint32_t a = 0; a < ACTION_MAX; a++) {
+        if (strcmp(action_names[a], action_name) == 0) action = a;
+    }
+    if (action == ACTION_MAX) return;
+
+    if (announce && (action == ACTION_ADD || action == ACTION_REMOVE)) {
+        emit(action == ACTION_ADD ? NEOINIT_EVENT_HW_ADDED : NEOINIT_EVENT_HW_REMOVED, "uevent", subsystem,
+             values[SLOT_DEVPATH]);
+    }
+
+    rule_bucket_t *bucket = bucket_find(&by_subsystem, action, subsystem, bucket_hash(action, subsystem));
+    if (bucket && bucket->key_slot < 0) {
+        match_list(&bucket->list, values);
+    } else if (bucket) {
+        uint32_t parent = (uint32_t)(bucket - by_subsystem.entries);
+        const char *value = values[bucket->key_slot];
+        rule_bucket_t *keyed = value ? bucket_find(&by_property, parent, value, bucket_hash(parent, value)) : NULL;
+        if (keyed) match_list(&keyed->list, values);
+        match_list(&bucket->rest, values);
+    }
+    match_list(&any_subsystem[action], values);
+}
+
+static link_state_t *link_find(int index) {
+    for (size_t i = 0; i < link_count; i++) {
+        if (links[i].index == index) return &links[i];
+    }
+    return NULL;
+}
+
+static void link_fire(const char *name, bool up) {
+    const rule_list_t *list = &link_rules[up];
+    for (size_t i = 0; i < list->count; i++) {
+        stats.candidates++;
+        if (pattern_match(&list->rules[i]->ifname, name)) rule_fire(list->rules[i]);
+    }
+}
+
+// Only transitions are reported; the kernel repeats RTM_NEWLINK for every flag or stats change
+static void link_update(int index, const char *name, bool up, bool gone, bool announce) {
+    link_state_t *link = link_find(index);
+    bool was_up = link && link->up;
+    char known[IF_NAMESIZE] = "";
+    if (link) memcpy(known, link->name, sizeof(known));
+    if (!name) name = known;
+
+    if (gone) {
+        if (link) *link = links[--link_count];
+    } else {
+        if (!link) {
+            if (!grow(&links, &link_cap, link_count, sizeof(*links))) return;
+            link = &links[link_count++];
+            link->index = index;
+        }
+        link->up = up;
+        snprintf(link->name, sizeof(link->name), "%s", name);
+    }
+    if (!announce || was_up == up || !*name) return;
+
+    stats.links++;
+    emit(up ? NEOINIT_EVENT_NETWORK_UP : NEOINIT_EVENT_NETWORK_DOWN, "rtnetlink", name, name);
+    link_fire(name, up);
+}
+
+static void handle_route(const char *buf, size_t len, bool announce) {
+    size_t left = len;
+    for (const struct nlmsghdr *nh = (const struct nlmsghdr *)buf; NLMSG_OK(nh, left); nh = NLMSG_NEXT(nh, left)) {
+        if (nh->nlmsg_type != RTM_NEWLINK && nh->nlmsg_type != RTM_DELLINK) continue;
+        if (nh->nlmsg_len < NLMSG_LENGTH(sizeof(struct ifinfomsg))) {
+            stats.rejected++;
+            continue;
+        }
+
+        const struct ifinfomsg *ifi = NLMSG_DATA(nh);
+        const char *name = NULL;
+        int operstate = -1;
+        unsigned attr_len = IFLA_PAYLOAD(nh);
+        for (const struct rtattr *rta = IFLA_RTA(ifi); RTA_OK(rta, attr_len); rta = RTA_NEXT(rta, attr_len)) {
+            if (rta->rta_type == IFLA_IFNAME && RTA_PAYLOAD(rta) > 0 &&
+                memchr(RTA_DATA(rta), '\0', RTA_PAYLOAD(rta))) {
+                name = RTA_DATA(rta);
+            } else if (rta->rta_type == IFLA_OPERSTATE && RTA_PAYLOAD(rta) >= 1) {
+                operstate = *(const uint8_t *)RTA_DATA(rta);
+            }
+        }
+
+        // Drivers without operstate support leave it unknown; fall back to the carrier flag
+        bool gone = nh->nlmsg_type == RTM_DELLINK;
+        bool up = !gone && (operstate == IF_OPER_UP ||
+                            ((operstate < 0 || operstate == IF_OPER_UNKNOWN) && (ifi->ifi_flags & IFF_RUNNING)));
+        link_update(ifi->ifi_index, name, up, gone, announce);
+    }
+}
+
+/*
+ * Intake
+ */
+
+static int request_link_dump(void) {
+    nl_source_t *src = &sources[NEOINIT_NETLINK_ROUTE];
+    if (src->fd < 0 || !src->kernel) return NEOINIT_ERROR_STATE;
+
+    struct {
+        struct nlmsghdr nh;
+        struct ifinfomsg ifi;
+    } req = {
+        .nh = {
+            .nlmsg_len = NLMSG_LENGTH(sizeof(struct ifinfomsg)),
+            .nlmsg_type = RTM_GETLINK,
+            .nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP,
+            .nlmsg_seq = ++dump_seq,
+        },
+        .ifi = { .ifi_family = AF_UNSPEC },
+    };
+    return send(src->fd, &req, req.nh.nlmsg_len, 0) < 0 ? NEOINIT_ERROR_SYSTEM : NEOINIT_OK;
+}
+
+static int coldplug_devices(void);
+
+// The kernel dropped messages; rebuild state from sysfs and a fresh link dump
+static void resync(nl_source_t *src) {
+    stats.overflows++;
+    LOG_WARNING("%s receive buffer overrun, resynchronising", src->name);
+    if (src->kind == NEOINIT_NETLINK_UEVENT) {
+        coldplug_devices();
+    } else {
+        request_link_dump();
+    }
+}
+
+static void source_close(nl_source_t *src) {
+    if (src->fd < 0) return;
+    neoinit_events_unwatch(src->fd);
+    close(src->fd);
+    src->fd = -1;
+    src->kernel = false;
+}
+
+/*
+ * Reads until the socket is empty; returns false once the peer is gone.
+ * An overrun is only noted here: the rescan runs once the queue is empty,
+ * so it neither repeats per ENOBUFS nor races the backlog it replaces.
+ */
+static bool drain(nl_source_t *src, bool announce) {
+    bool overrun = false;
+    for (;;) {
+        for (int i = 0; i < NEOINIT_NETLINK_BATCH; i++) {
+            batch_iov[i] = (struct iovec){ batch_buf + (size_t)i * MSG_STRIDE, NEOINIT_NETLINK_MSG_SIZE };
+            batch_msgs[i].msg_hdr = (struct msghdr){
+                .msg_name = &batch_addr[i],
+                .msg_namelen = sizeof(batch_addr[i]),
+                .msg_iov = &batch_iov[i],
+                .msg_iovlen = 1,
+            };
+        }
+
+        int n = recvmmsg(src->fd, batch_msgs, NEOINIT_NETLINK_BATCH, MSG_DONTWAIT, NULL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno == ENOBUFS) {
+                overrun = true;
+                continue;
+            }
+            break;
+        }
+        if (n == 0) return false;
+
+        stats.batches++;
+        batch_seq++;
+        for (int i = 0; i < n; i++) {
+            const struct msghdr *hdr = &batch_msgs[i].msg_hdr;
+            stats.messages++;
+            // Only the kernel may speak on these groups; anything else is spoofed
+            if ((hdr->msg_flags & MSG_TRUNC) ||
+                (src->kernel && (hdr->msg_namelen < sizeof(struct sockaddr_nl) || batch_addr[i].nl_pid != 0))) {
+                stats.rejected++;
+                continue;
+            }
+            if (src->kind == NEOINIT_NETLINK_UEVENT) {
+                handle_uevent(hdr->msg_iov->iov_base, batch_msgs[i].msg_len, announce);
+            } else {
+                handle_route(hdr->msg_iov->iov_base, batch_msgs[i].msg_len, announce);
+            }
+        }
+        // A short batch means the queue is empty; skip the EAGAIN round trip
+        if (n < NEOINIT_NETLINK_BATCH) break;
+    }
+    if (overrun) resync(src);
+    return true;
+}
+
+static int on_netlink(int fd, uint32_t events, void *user_data) {
+    (void)fd;
+    (void)events;
+    nl_source_t *src = user_data;
+    if (!drain(src, true)) {
+        LOG_WARNING("%s source closed", src->name);
+        source_close(src);
+    }
+    return NEOINIT_OK;
+}
+
+static int source_watch(nl_source_t *src, int fd, bool kernel) {
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) return NEOINIT_ERROR_SYSTEM;
+    if (neoinit_events_watch(fd, EPOLLIN, on_netlink, src) != NEOINIT_OK) return NEOINIT_ERROR_SYSTEM;
+    src->fd = fd;
+    src->kernel = kernel;
+    return NEOINIT_OK;
+}
+
+static int source_open(nl_source_t *src) {
+    int protocol = src->kind == NEOINIT_NETLINK_UEVENT ? NETLINK_KOBJECT_UEVENT : NETLINK_ROUTE;
+    int fd = socket(AF_NETLINK, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, protocol);
+    if (fd < 0) return NEOINIT_ERROR_SYSTEM;
+
+    // A coldplug burst outruns the default buffer; rmem_max only binds without CAP_NET_ADMIN
+    int size = NEOINIT_NETLINK_RCVBUF;
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) < 0) {
+        setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+
+    struct sockaddr_nl addr = {
+        .nl_family = AF_NETLINK,
+        .nl_groups = src->kind == NEOINIT_NETLINK_UEVENT ? 1 : RTMGRP_LINK,
+    };
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 || source_watch(src, fd, true) != NEOINIT_OK) {
+        close(fd);
+        return NEOINIT_ERROR_SYSTEM;
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_netlink_adopt(neoinit_netlink_source_t source, int fd) {
+    if (source >= NEOINIT_NETLINK_SOURCE_MAX || fd < 0) return NEOINIT_ERROR_INVALID_ARG;
+    if (!initialized) return NEOINIT_ERROR_INIT;
+    source_close(&sources[source]);
+    return source_watch(&sources[source], fd, false);
+}
+
+/*
+ * Coldplug
+ */
+
+// Replays one sysfs device as an "add" uevent, without announcing it
+static void coldplug_device(const char *entry, const char *subsystem) {
+    char real[PATH_MAX];
+    if (!realpath(entry, real) || strncmp(real, SYSFS_ROOT "/", sizeof(SYSFS_ROOT)) != 0) return;
+
+    char msg[MSG_STRIDE];
+    int len = snprintf(msg, sizeof(msg), "ACTION=add%cDEVPATH=%s%cSUBSYSTEM=%s%c", '\0',
+                       real + sizeof(SYSFS_ROOT) - 1, '\0', subsystem, '\0');
+    if (len < 0 || (size_t)len >= sizeof(msg)) return;
+
+    char file[PATH_MAX + 8];
+    snprintf(file, sizeof(file), "%s/uevent", real);
+    int fd = open(file, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+    ssize_t n = read(fd, msg + len, sizeof(msg) - 1 - (size_t)len);
+    close(fd);
+    if (n < 0) return;
+
+    for (ssize_t i = 0; i < n; i++) {
+        if (msg[len + i] == '\n') msg[len + i] = '\0';
+    }
+    handle_uevent(msg, (size_t)len + (size_t)n, false);
+}
+
+static void coldplug_dir(const char *dir, const char *subsystem) {
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *entry;
+    char path[PATH_MAX];
+    while ((entry = readdir(d))) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        coldplug_device(path, subsystem);
+    }
+    closedir(d);
+}
+
+static void coldplug_subsystem(const char *subsystem) {
+    char dir[PATH_MAX];
+    snprintf(dir, sizeof(dir), SYSFS_ROOT "/class/%s", subsystem);
+    coldplug_dir(dir, subsystem);
+    snprintf(dir, sizeof(dir), SYSFS_ROOT "/bus/%s/devices", subsystem);
+    coldplug_dir(dir, subsystem);
+}
+
+// Every subsystem under /sys/class or /sys/bus
+static void coldplug_all(const char *top, const char *suffix) {
+    char dir[64];
+    snprintf(dir, sizeof(dir), SYSFS_ROOT "/%s", top);
+    DIR *d = opendir(dir);
+    if (!d) return;
+    struct dirent *entry;
+    char sub[PATH_MAX];
+    while ((entry = readdir(d))) {
+        if (entry->d_name[0] == '.') continue;
+        snprintf(sub, sizeof(sub), "%s/%s%s", dir, entry->d_name, suffix);
+        coldplug_dir(sub, entry->d_name);
+    }
+    closedir(d);
+}
+
+/*
+ * Devices that were there before the manager started never send an "add".
+ * Only the subsystems some add rule names are read from sysfs, unless a
+ * rule leaves the subsystem open. The whole pass counts as one batch.
+ */
+static int coldplug_devices(void) {
+    batch_seq++;
+    if (any_subsystem[ACTION_ADD].count) {
+        coldplug_all("class", "");
+        coldplug_all("bus", "/devices");
+        return NEOINIT_OK;
+    }
+    for (size_t b = 0; b < by_subsystem.count; b++) {
+        if (by_subsystem.entries[b].tag == ACTION_ADD) coldplug_subsystem(by_subsystem.entries[b].text);
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_netlink_coldplug(void) {
+    if (!initialized) return NEOINIT_ERROR_INIT;
+    coldplug_devices();
+    batch_seq++;
+    for (size_t i = 0; i < link_count; i++) {
+        if (links[i].up) link_fire(links[i].name, true);
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_netlink_get_stats(neoinit_netlink_stats_t *out) {
+    if (!out) return NEOINIT_ERROR_INVALID_ARG;
+    *out = stats;
+    out->rules = (uint32_t)rule_count;
+    return NEOINIT_OK;
+}
+
+/*
+ * Device files
+ */
+
+static void rule_free(device_rule_t *rule) {
+    if (!rule) return;
+    free(rule->name);
+    free(rule->unit);
+    free(rule->subsystem.text);
+    free(rule->devtype.text);
+    free(rule->ifname.text);
+    for (uint32_t p = 0; p < rule->prop_count; p++) {
+        free(rule->props[p].key);
+        free(rule->props[p].value.text);
+    }
+    free(rule);
+}
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+    return s;
+}
+
+static int rule_set(device_rule_t *rule, const char *key, const char *value, bool *known) {
+    *known = true;
+    if (strcmp(key, "Unit") == 0) {
+        char *copy = strdup(value);
+        if (!copy) return NEOINIT_ERROR_NO_MEMORY;
+        free(rule->unit);
+        rule->unit = copy;
+        return NEOINIT_OK;
+    }
+    if (strcmp(key, "Subsystem") == 0) return pattern_set(&rule->subsystem, value);
+    if (strcmp(key, "DevType") == 0) return pattern_set(&rule->devtype, value);
+    if (strcmp(key, "Interface") == 0) return pattern_set(&rule->ifname, value);
+    if (strcmp(key, "State") == 0) {
+        if (strcmp(value, "up") != 0 && strcmp(value, "down") != 0) return NEOINIT_ERROR_INVALID_ARG;
+        rule->up = strcmp(value, "up") == 0;
+        return NEOINIT_OK;
+    }
+    if (strcmp(key, "Action") == 0) {
+        if (strcmp(value, "any") == 0) {
+            rule->actions = (1u << ACTION_MAX) - 1;
+            return NEOINIT_OK;
+        }
+        for (uint32_t a = 0; a < ACTION_MAX; a++) {
+            if (strcmp(action_names[a], value) == 0) {
+                rule->actions = 1u << a;
+                return NEOINIT_OK;
+            }
+        }
+        return NEOINIT_ERROR_INVALID_ARG;
+    }
+    if (strcmp(key, "Property") == 0) {
+        const char *eq = strchr(value, '=');
+        if (!eq || eq == value) return NEOINIT_ERROR_INVALID_ARG;
+        if (rule->prop_count == NEOINIT_NETLINK_MAX_PROPS) return NEOINIT_ERROR_RESOURCE;
+        char *prop_key = strndup(value, (size_t)(eq - value));
+        if (!prop_key) return NEOINIT_ERROR_NO_MEMORY;
+        uint32_t p = rule->prop_count;
+        memset(&rule->props[p], 0, sizeof(rule->props[p]));
+        int ret = pattern_set(&rule->props[p].value, trim((char *)eq + 1));
+        if (ret != NEOINIT_OK) {
+            free(prop_key);
+            return ret;
+        }
+        trim(prop_key);
+        rule->props[p].key = prop_key;
+        rule->prop_count++;
+        return NEOINIT_OK;
+    }
+    *known = false;
+    return NEOINIT_OK;
+}
+
+static int rule_validate(device_rule_t *rule) {
+    bool device = rule->subsystem.text || rule->devtype.text || rule->prop_count;
+    if (rule->ifname.text) {
+        // A link rule matches on the interface alone
+        if (device) return NEOINIT_ERROR_INVALID_ARG;
+        rule->source = NEOINIT_NETLINK_ROUTE;
+        return NEOINIT_OK;
+    }
+    return device ? NEOINIT_OK : NEOINIT_ERROR_INVALID_ARG;
+}
+
+static int device_load_file(const char *dir, const char *file) {
+    char filename[NEOINIT_MAX_PATH_LENGTH];
+    snprintf(filename, sizeof(filename), "%s/%s", dir, file);
+    FILE *fp = fopen(filename, "re");
+    if (!fp) return NEOINIT_ERROR_IO;
+
+    for (size_t i = 0; i < rule_count; i++) {
+        if (strcmp(rules[i]->name, file) == 0) {
+            fclose(fp);
+            return NEOINIT_ERROR_EXISTS;
+        }
+    }
+
+    // "nvme-scan.device" starts "nvme-scan" unless Unit= says otherwise
+    char unit[NEOINIT_MAX_NAME_LENGTH];
+    snprintf(unit, sizeof(unit), "%s", file);
+    char *dot = strrchr(unit, '.');
+    if (dot && strcmp(dot, ".device") == 0) *dot = '\0';
+
+    device_rule_t *rule = calloc(1, sizeof(*rule));
+    if (!rule || !(rule->name = strdup(file)) || !(rule->unit = strdup(unit))) {
+        rule_free(rule);
+        fclose(fp);
+        return NEOINIT_ERROR_NO_MEMORY;
+    }
+    rule->source = NEOINIT_NETLINK_UEVENT;
+    rule->actions = 1u << ACTION_ADD;
+    rule->up = true;
+
+    int ret = NEOINIT_OK;
+    unsigned lineno = 0;
+    char line[DEVICE_LINE_MAX];
+    while (ret == NEOINIT_OK && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *key = trim(line);
+        if (!*key || *key == '#' || *key == ';' || *key == '[') continue;
+        char *value = strchr(key, '=');
+        if (!value) {
+            ret = NEOINIT_ERROR_INVALID_ARG;
+            break;
+        }
+        *value++ = '\0';
+        key = trim(key);
+        value = trim(value);
+
+        bool known;
+        ret = rule_set(rule, key, value, &known);
+        if (!known) LOG_WARNING("%s:%u: unknown key %s", filename, lineno, key);
+    }
+    fclose(fp);
+    if (ret == NEOINIT_OK) ret = rule_validate(rule);
+    if (ret == NEOINIT_OK && !grow(&rules, &rule_cap, rule_count, sizeof(*rules))) ret = NEOINIT_ERROR_NO_MEMORY;
+
+    if (ret != NEOINIT_OK) {
+        LOG_ERROR("%s:%u: invalid device rule (%d)", filename, lineno, ret);
+        rule_free(rule);
+        return ret;
+    }
+    rules[rule_count++] = rule;
+    return NEOINIT_OK;
+}
+
+// Loads every *.device file and recompiles the matcher; returns how many rules were added
+int neoinit_netlink_load(const char *dir) {
+    if (!dir) return NEOINIT_ERROR_INVALID_ARG;
+    DIR *d = opendir(dir);
+    if (!d) return errno == ENOENT ? 0 : NEOINIT_ERROR_IO;
+
+    int loaded = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (entry->d_name[0] == '.' || !dot || strcmp(dot, ".device") != 0) continue;
+        if (device_load_file(dir, entry->d_name) == NEOINIT_OK) loaded++;
+    }
+    closedir(d);
+
+    int ret = matcher_compile();
+    return ret == NEOINIT_OK ? loaded : ret;
+}
+
+/*
+ * Engine
+ */
+
+static int cmd_devices(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)argc;
+    (void)argv;
+    (void)user_data;
+    neoinit_control_printf(conn,
+                           "rules %zu messages %llu batches %llu overflows %llu rejected %llu uevents %llu "
+                           "links %llu candidates %llu matches %llu\n",
+                           rule_count, (unsigned long long)stats.messages, (unsigned long long)stats.batches,
+                           (unsigned long long)stats.overflows, (unsigned long long)stats.rejected,
+                           (unsigned long long)stats.uevents, (unsigned long long)stats.links,
+                           (unsigned long long)stats.candidates, (unsigned long long)stats.matches);
+    for (size_t i = 0; i < NEOINIT_NETLINK_SOURCE_MAX; i++) {
+        neoinit_control_printf(conn, "source %s %s\n", sources[i].name,
+                               sources[i].fd < 0 ? "closed" : sources[i].kernel ? "kernel" : "adopted");
+    }
+    for (size_t i = 0; i < link_count; i++) {
+        neoinit_control_printf(conn, "link %s %s\n", links[i].name, links[i].up ? "up" : "down");
+    }
+    for (size_t i = 0; i < rule_count; i++) {
+        const device_rule_t *rule = rules[i];
+        neoinit_control_printf(conn, "%s %s %s matches %llu\n", rule->name, rule->unit,
+                               rule->source == NEOINIT_NETLINK_ROUTE ? "link" : "uevent",
+                               (unsigned long long)rule->matches);
+    }
+    return NEOINIT_OK;
+}
+
+/*
+ * A source that cannot be opened (no netlink in a container, say) only
+ * disables itself. The link table is filled from a dump before returning,
+ * so the first notification after start is compared against real state.
+ */
+int neoinit_netlink_init(neoinit_netlink_activate_fn activate, void *user_data) {
+    if (!activate) return NEOINIT_ERROR_INVALID_ARG;
+    if (initialized) return NEOINIT_ERROR_BUSY;
+
+    batch_buf = malloc((size_t)NEOINIT_NETLINK_BATCH * MSG_STRIDE);
+    if (!batch_buf) return NEOINIT_ERROR_NO_MEMORY;
+    activate_fn = activate;
+    activate_data = user_data;
+    initialized = true;
+    matcher_reset();
+
+    for (int i = 0; i < NEOINIT_NETLINK_SOURCE_MAX; i++) {
+        if (source_open(&sources[i]) != NEOINIT_OK) {
+            LOG_WARNING("%s socket unavailable: %s", sources[i].name, strerror(errno));
+        }
+    }
+    if (request_link_dump() == NEOINIT_OK) drain(&sources[NEOINIT_NETLINK_ROUTE], false);
+
+    neoinit_control_register("devices", cmd_devices, NULL);
+    return NEOINIT_OK;
+}
+
+void neoinit_netlink_cleanup(void) {
+    for (int i = 0; i < NEOINIT_NETLINK_SOURCE_MAX; i++) source_close(&sources[i]);
+    matcher_reset();
+    for (size_t i = 0; i < rule_count; i++) rule_free(rules[i]);
+    free(rules);
+    free(links);
+    free(batch_buf);
+    rules = NULL;
+    links = NULL;
+    batch_buf = NULL;
+    rule_count = rule_cap = link_count = link_cap = 0;
+    memset(&stats, 0, sizeof(stats));
+    initialized = false;
+}
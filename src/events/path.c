@@ -0,0 +1,750 @@
+#define _GNU_SOURCE
+#include "neoinit/path.h"
+#include "neoinit/events.h"
+#include "neoinit/timer.h"
+#include "neoinit/socket.h"
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/timerfd.h>
+
+#define PATH_LINE_MAX  (NEOINIT_MAX_PATH_LENGTH + 64)
+
+/*
+ * One mask for every watch, so a directory shared by several paths never
+ * needs its mask merged or narrowed. No IN_MODIFY: a writer costs one
+ * IN_CLOSE_WRITE per file, not an event per write().
+ */
+#define PATH_WATCH_MASK (IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CLOSE_WRITE | \
+                         IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF | IN_ONLYDIR)
+#define PATH_GONE_MASK  (IN_IGNORED | IN_DELETE_SELF | IN_MOVE_SELF)
+
+typedef struct path_watch path_watch_t;
+
+typedef struct {
+    neoinit_path_t *owner;
+    neoinit_path_kind_t kind;
+    char *file;
+    path_watch_t *watch;            // Directory currently watched, NULL if none
+    char match[NAME_MAX + 1];       // Entry of interest in that directory; empty for any
+    bool waiting;                   // Watching an ancestor until the next component appears
+    bool changed;                   // Saw a change since the last debounce expiry
+    bool stale;                     // Queued for re-attachment
+    size_t sub_index;               // Position in watch->subs
+} path_spec_t;
+
+struct path_watch {
+    int wd;
+    char *dir;
+    path_spec_t **subs;
+    size_t count;
+    size_t cap;
+};
+
+struct neoinit_path {
+    char *name;
+    char *unit;
+    path_spec_t specs[NEOINIT_PATH_MAX_SPECS];
+    uint32_t spec_count;
+    uint64_t debounce;              // ns
+    bool armed;
+    bool pending;
+    uint64_t due;                   // Monotonic, ns, end of the debounce window
+    uint64_t events;
+    uint64_t triggers;
+};
+
+static neoinit_path_activate_fn activate_fn;
+static void *activate_data;
+
+static neoinit_path_t **paths;
+static size_t path_count;
+static size_t path_cap;
+
+// Watches keyed by wd; open addressing with backward-shift deletion
+static path_watch_t **watch_slots;
+static size_t watch_cap;
+static size_t watch_count;
+
+static neoinit_path_t **pending;
+static size_t pending_len;
+static size_t pending_cap;
+
+static path_spec_t **stale;
+static size_t stale_len;
+static size_t stale_cap;
+
+static int inotify_fd = -1;
+static int debounce_fd = -1;
+static uint64_t debounce_at;        // Current timerfd expiry, 0 when disarmed
+static uint64_t resume_at;          // inotify reads parked until, 0 when watching
+static neoinit_path_stats_t stats;
+
+static const char *const kind_names[NEOINIT_PATH_KIND_MAX] = {
+    [NEOINIT_PATH_EXISTS] = "PathExists",
+    [NEOINIT_PATH_CHANGED] = "PathChanged",
+    [NEOINIT_PATH_DIRECTORY_NOT_EMPTY] = "DirectoryNotEmpty",
+};
+
+// Events that count for each condition once the entry name matched
+static const uint32_t kind_masks[NEOINIT_PATH_KIND_MAX] = {
+    [NEOINIT_PATH_EXISTS] = IN_CREATE | IN_MOVED_TO,
+    [NEOINIT_PATH_CHANGED] = IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CLOSE_WRITE | IN_ATTRIB,
+    [NEOINIT_PATH_DIRECTORY_NOT_EMPTY] = IN_CREATE | IN_MOVED_TO,
+};
+
+static bool grow(void *array, size_t *cap, size_t len, size_t elem) {
+    if (len < *cap) return true;
+    size_t next = *cap ? *cap * 2 : 16;
+    void *grown = realloc(*(void **)array, next * elem);
+    if (!grown) return false;
+    *(void **)array = grown;
+    *cap = next;
+    return true;
+}
+
+/*
+ * Watch table
+ */
+
+static size_t watch_slot(int wd) {
+    return ((uint32_t)wd * 2654435761u) & (watch_cap - 1);
+}
+
+static path_watch_t *watch_find(int wd) {
+    if (!watch_cap) return NULL;
+    for (size_t i = watch_slot(wd);; i = (i + 1) & (watch_cap - 1)) {
+        if (!watch_slots[i]) return NULL;
+        if (watch_slots[i]->wd == wd) return watch_slots[i];
+    }
+}
+
+static void watch_place(path_watch_t *watch) {
+    size_t i = watch_slot(watch->wd);
+    while (watch_slots[i]) i = (i + 1) & (watch_cap - 1);
+    watch_slots[i] = watch;
+}
+
+static int watch_insert(path_watch_t *watch) {
+    if ((watch_count + 1) * 2 > watch_cap) {
+        size_t old_cap = watch_cap;
+        path_watch_t **old = watch_slots;
+        size_t cap = watch_cap ? watch_cap * 2 : NEOINIT_MAX_WATCHERS;
+        watch_slots = calloc(cap, sizeof(*watch_slots));
+        if (!watch_slots) {
+            watch_slots = old;
+            return NEOINIT_ERROR_NO_MEMORY;
+        }
+        watch_cap = cap;
+        for (size_t i = 0; i < old_cap; i++) {
+            if (old[i]) watch_place(old[i]);
+        }
+        free(old);
+    }
+    watch_place(watch);
+    watch_count++;
+    return NEOINIT_OK;
+}
+
+static void watch_delete(const path_watch_t *watch) {
+    size_t mask = watch_cap - 1, i = watch_slot(watch->wd);
+    while (watch_slots[i] != watch) i = (i + 1) & mask;
+    watch_slots[i] = NULL;
+    watch_count--;
+
+    // Pull later entries of the probe run back into the hole
+    for (size_t j = (i + 1) & mask; watch_slots[j]; j = (j + 1) & mask) {
+        size_t home = watch_slot(watch_slots[j]->wd);
+        bool movable = i <= j ? (home <= i || home > j) : (home <= i && home > j);
+        if (!movable) continue;
+        watch_slots[i] = watch_slots[j];
+        watch_slots[j] = NULL;
+        i = j;
+    }
+}
+
+static void watch_free(path_watch_t *watch, bool remove_wd) {
+    watch_delete(watch);
+    if (remove_wd) inotify_rm_watch(inotify_fd, watch->wd);
+    free(watch->subs);
+    free(watch->dir);
+    free(watch);
+}
+
+/*
+ * Attaching conditions to directories
+ */
+
+static void spec_detach(path_spec_t *spec) {
+    path_watch_t *watch = spec->watch;
+    if (!watch) return;
+    spec->watch = NULL;
+
+    path_spec_t *last = watch->subs[--watch->count];
+    watch->subs[spec->sub_index] = last;
+    last->sub_index = spec->sub_index;
+    if (!watch->count) watch_free(watch, true);
+}
+
+static void split_last(char *dir, char *name, size_t size) {
+    char *slash = strrchr(dir, '/');
+    snprintf(name, size, "%s", slash + 1);
+    if (slash == dir) slash[1] = '\0';
+    else *slash = '\0';
+}
+
+/*
+ * Existence and non-emptiness watch the directory that holds the entry, or
+ * the directory itself. When it does not exist yet, the closest existing
+ * ancestor is watched for the next component instead.
+ */
+static void spec_attach(path_spec_t *spec) {
+    char dir[NEOINIT_MAX_PATH_LENGTH];
+    snprintf(dir, sizeof(dir), "%s", spec->file);
+    spec->match[0] = '\0';
+    spec->waiting = false;
+
+    struct stat st;
+    bool self = spec->kind == NEOINIT_PATH_DIRECTORY_NOT_EMPTY ||
+        (spec->kind == NEOINIT_PATH_CHANGED && stat(spec->file, &st) == 0 && S_ISDIR(st.st_mode));
+    if (!self) split_last(dir, spec->match, sizeof(spec->match));
+
+    int wd;
+    while ((wd = inotify_add_watch(inotify_fd, dir, PATH_WATCH_MASK)) < 0) {
+        if ((errno != ENOENT && errno != ENOTDIR) || strcmp(dir, "/") == 0) {
+            LOG_WARNING("Path %s: cannot watch %s: %s", spec->owner->name, dir, strerror(errno));
+            return;
+        }
+        split_last(dir, spec->match, sizeof(spec->match));
+        spec->waiting = true;
+    }
+
+    path_watch_t *watch = watch_find(wd);
+    if (!watch) {
+        watch = calloc(1, sizeof(*watch));
+        if (watch) {
+            watch->wd = wd;
+            watch->dir = strdup(dir);
+        }
+        if (!watch || !watch->dir || watch_insert(watch) != NEOINIT_OK) {
+            if (watch) free(watch->dir);
+            free(watch);
+            inotify_rm_watch(inotify_fd, wd);
+            LOG_ERROR("Path %s: out of memory watching %s", spec->owner->name, dir);
+            return;
+        }
+    }
+    if (!grow(&watch->subs, &watch->cap, watch->count, sizeof(*watch->subs))) {
+        if (!watch->count) watch_free(watch, true);
+        return;
+    }
+    spec->sub_index = watch->count;
+    watch->subs[watch->count++] = spec;
+    spec->watch = watch;
+}
+
+static void spec_mark_stale(path_spec_t *spec) {
+    if (spec->stale) return;
+    if (!grow(&stale, &stale_cap, stale_len, sizeof(*stale))) return;
+    spec->stale = true;
+    stale[stale_len++] = spec;
+}
+
+// The directory went away or moved; its conditions look for it again
+static void watch_gone(path_watch_t *watch, uint32_t mask) {
+    for (size_t i = 0; i < watch->count; i++) {
+        watch->subs[i]->watch = NULL;
+        spec_mark_stale(watch->subs[i]);
+    }
+    watch->count = 0;
+    watch_free(watch, !(mask & IN_IGNORED));
+}
+
+/*
+ * Conditions and debouncing
+ */
+
+static bool dir_not_empty(const char *file) {
+    DIR *d = opendir(file);
+    if (!d) return false;
+    struct dirent *entry;
+    bool found = false;
+    while (!found && (entry = readdir(d))) {
+        found = strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0;
+    }
+    closedir(d);
+    return found;
+}
+
+static bool spec_holds(path_spec_t *spec) {
+    switch (spec->kind) {
+    case NEOINIT_PATH_EXISTS:
+        return access(spec->file, F_OK) == 0;
+    case NEOINIT_PATH_DIRECTORY_NOT_EMPTY:
+        return dir_not_empty(spec->file);
+    case NEOINIT_PATH_CHANGED: {
+        bool changed = spec->changed;
+        spec->changed = false;
+        return changed;
+    }
+    default:
+        return false;
+    }
+}
+
+static void debounce_arm(uint64_t at) {
+    if (debounce_fd < 0 || at == debounce_at) return;
+    struct itimerspec its = { 0 };
+    its.it_value.tv_sec = (time_t)(at / 1000000000ULL);
+    its.it_value.tv_nsec = (long)(at % 1000000000ULL);
+    if (timerfd_settime(debounce_fd, TFD_TIMER_ABSTIME, &its, NULL) == 0) debounce_at = at;
+}
+
+static void path_mark_pending(neoinit_path_t *path) {
+    if (!path->armed || path->pending) return;
+    if (!grow(&pending, &pending_cap, pending_len, sizeof(*pending))) return;
+    path->pending = true;
+    path->due = neoinit_get_monotonic_time() + path->debounce;
+    if (!path->due) path->due = 1;
+    pending[pending_len++] = path;
+    if (!debounce_at || path->due < debounce_at) debounce_arm(path->due);
+}
+
+// Queues the path when any level condition already holds
+static void path_check_levels(neoinit_path_t *path) {
+    for (uint32_t i = 0; i < path->spec_count; i++) {
+        path_spec_t *spec = &path->specs[i];
+        if (spec->kind != NEOINIT_PATH_CHANGED && spec_holds(spec)) {
+            path_mark_pending(path);
+            return;
+        }
+    }
+}
+
+static void path_trigger(neoinit_path_t *path) {
+    path->triggers++;
+    stats.triggers++;
+    LOG_DEBUG("Path %s triggered, starting %s", path->name, path->unit);
+    if (activate_fn && activate_fn(path->unit, activate_data) != 0) {
+        LOG_WARNING("Path %s failed to start %s", path->name, path->unit);
+    }
+}
+
+static int on_debounce(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    (void)user_data;
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return NEOINIT_OK;
+    debounce_at = 0;
+    stats.wakeups++;
+
+    // Collect first: activation may disarm paths or queue new ones
+    uint64_t now = neoinit_get_monotonic_time();
+    neoinit_path_t **due = NULL;
+    size_t due_len = 0, due_cap = 0, kept = 0;
+    uint64_t next = 0;
+    for (size_t i = 0; i < pending_len; i++) {
+        neoinit_path_t *path = pending[i];
+        if (!path->pending) continue;
+        if (path->due > now || !grow(&due, &due_cap, due_len, sizeof(*due))) {
+            if (!next || path->due < next) next = path->due;
+            pending[kept++] = path;
+            continue;
+        }
+        path->pending = false;
+        due[due_len++] = path;
+    }
+    pending_len = kept;
+
+    if (resume_at && resume_at <= now) {
+        resume_at = 0;
+        neoinit_events_modify(inotify_fd, EPOLLIN);
+    }
+    if (resume_at && (!next || resume_at < next)) next = resume_at;
+    if (next) debounce_arm(next);
+
+    for (size_t i = 0; i < due_len; i++) {
+        neoinit_path_t *path = due[i];
+        if (!path->armed) continue;
+        bool holds = false;
+        // Evaluate every condition so all change flags are consumed
+        for (uint32_t s = 0; s < path->spec_count; s++) holds |= spec_holds(&path->specs[s]);
+        if (holds) path_trigger(path);
+    }
+    free(due);
+    return NEOINIT_OK;
+}
+
+static void spec_event(path_spec_t *spec, const struct inotify_event *ev) {
+    if (spec->match[0] && (!ev->len || strcmp(ev->name, spec->match) != 0)) return;
+    if (spec->waiting) {
+        spec_mark_stale(spec);
+        return;
+    }
+    if (!(ev->mask & kind_masks[spec->kind])) return;
+    spec->owner->events++;
+    if (spec->kind == NEOINIT_PATH_CHANGED) spec->changed = true;
+    path_mark_pending(spec->owner);
+}
+
+static void reattach_stale(void) {
+    for (size_t i = 0; i < stale_len; i++) {
+        path_spec_t *spec = stale[i];
+        spec->stale = false;
+        if (!spec->owner->armed) continue;
+        spec_detach(spec);
+        spec_attach(spec);
+
+        // The entry may have appeared before the deeper watch existed
+        if (spec->watch && !spec->waiting) {
+            if (spec->kind == NEOINIT_PATH_CHANGED && access(spec->file, F_OK) == 0) {
+                spec->changed = true;
+                path_mark_pending(spec->owner);
+            } else if (spec->kind != NEOINIT_PATH_CHANGED && spec_holds(spec)) {
+                path_mark_pending(spec->owner);
+            }
+        }
+    }
+    stale_len = 0;
+}
+
+static void recheck_all(void) {
+    for (size_t i = 0; i < path_count; i++) {
+        neoinit_path_t *path = paths[i];
+        if (!path->armed) continue;
+        for (uint32_t s = 0; s < path->spec_count; s++) {
+            path_spec_t *spec = &path->specs[s];
+            if (spec->kind == NEOINIT_PATH_CHANGED) spec->changed = true;
+            // Missed events may include a directory appearing or going away
+            spec_mark_stale(spec);
+        }
+        path_mark_pending(path);
+    }
+}
+
+static int on_inotify(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    (void)user_data;
+    char buf[NEOINIT_PATH_READ_BUFFER] __attribute__((aligned(__alignof__(struct inotify_event))));
+    bool overflow = false;
+    stats.wakeups++;
+
+    ssize_t n;
+    bool any = false;
+    while ((n = read(fd, buf, sizeof(buf))) > 0) {
+        any = true;
+        for (char *p = buf; p < buf + n; ) {
+            const struct inotify_event *ev = (const struct inotify_event *)p;
+            p += sizeof(*ev) + ev->len;
+            stats.events++;
+
+            if (ev->mask & IN_Q_OVERFLOW) {
+                overflow = true;
+                continue;
+            }
+            path_watch_t *watch = watch_find(ev->wd);
+            if (!watch) continue;
+            if (ev->mask & PATH_GONE_MASK) {
+                watch_gone(watch, ev->mask);
+                continue;
+            }
+            for (size_t i = 0; i < watch->count; i++) spec_event(watch->subs[i], ev);
+        }
+    }
+
+    if (overflow) {
+        stats.overflows++;
+        LOG_WARNING("inotify queue overflowed, re-checking all path units");
+        recheck_all();
+    }
+    reattach_stale();
+
+    // Let the kernel queue the next burst; the debounce timer resumes reading
+    if (any && neoinit_events_modify(fd, 0) == NEOINIT_OK) {
+        resume_at = neoinit_get_monotonic_time() + NEOINIT_PATH_BATCH_USEC * 1000ULL;
+        if (!debounce_at || resume_at < debounce_at) debounce_arm(resume_at);
+    }
+    return NEOINIT_OK;
+}
+
+/*
+ * Paths
+ */
+
+neoinit_path_t *neoinit_path_lookup(const char *name) {
+    if (!name) return NULL;
+    for (size_t i = 0; i < path_count; i++) {
+        if (strcmp(paths[i]->name, name) == 0) return paths[i];
+    }
+    return NULL;
+}
+
+neoinit_path_t *neoinit_path_create(const char *name, const char *unit) {
+    if (!name || !*name || !unit || !*unit || neoinit_path_lookup(name)) return NULL;
+    if (!grow(&paths, &path_cap, path_count, sizeof(*paths))) return NULL;
+
+    neoinit_path_t *path = calloc(1, sizeof(*path));
+    if (!path) return NULL;
+    path->name = strdup(name);
+    path->unit = strdup(unit);
+    if (!path->name || !path->unit) {
+        free(path->name);
+        free(path->unit);
+        free(path);
+        return NULL;
+    }
+    path->debounce = NEOINIT_PATH_DEBOUNCE_USEC * 1000ULL;
+    paths[path_count++] = path;
+    stats.paths++;
+    return path;
+}
+
+// Absolute paths only; repeated and trailing slashes are dropped
+int neoinit_path_add(neoinit_path_t *path, neoinit_path_kind_t kind, const char *file) {
+    if (!path || !file || file[0] != '/' || kind >= NEOINIT_PATH_KIND_MAX) return NEOINIT_ERROR_INVALID_ARG;
+    if (path->armed) return NEOINIT_ERROR_BUSY;
+    if (path->spec_count == NEOINIT_PATH_MAX_SPECS) return NEOINIT_ERROR_RESOURCE;
+    if (strlen(file) >= NEOINIT_MAX_PATH_LENGTH) return NEOINIT_ERROR_INVALID_ARG;
+
+    char *copy = malloc(strlen(file) + 1);
+    if (!copy) return NEOINIT_ERROR_NO_MEMORY;
+    size_t len = 0;
+    for (const char *p = file; *p; p++) {
+        if (*p == '/' && len && copy[len - 1] == '/') continue;
+        copy[len++] = *p;
+    }
+    while (len > 1 && copy[len - 1] == '/') len--;
+    copy[len] = '\0';
+
+    path_spec_t *spec = &path->specs[path->spec_count++];
+    memset(spec, 0, sizeof(*spec));
+    spec->owner = path;
+    spec->kind = kind;
+    spec->file = copy;
+    return NEOINIT_OK;
+}
+
+int neoinit_path_set_debounce(neoinit_path_t *path, uint64_t usec) {
+    if (!path) return NEOINIT_ERROR_INVALID_ARG;
+    path->debounce = usec * 1000ULL;
+    return NEOINIT_OK;
+}
+
+int neoinit_path_arm(neoinit_path_t *path) {
+    if (!path) return NEOINIT_ERROR_INVALID_ARG;
+    if (!path->spec_count) return NEOINIT_ERROR_STATE;
+    if (inotify_fd < 0) return NEOINIT_ERROR_INIT;
+    if (path->armed) return NEOINIT_OK;
+
+    path->armed = true;
+    for (uint32_t i = 0; i < path->spec_count; i++) {
+        path->specs[i].changed = false;
+        spec_attach(&path->specs[i]);
+    }
+    path_check_levels(path);
+    return NEOINIT_OK;
+}
+
+int neoinit_path_disarm(neoinit_path_t *path) {
+    if (!path) return NEOINIT_ERROR_INVALID_ARG;
+    path->armed = false;
+    path->pending = false;
+    for (uint32_t i = 0; i < path->spec_count; i++) spec_detach(&path->specs[i]);
+    return NEOINIT_OK;
+}
+
+// Work that arrived while the unit ran would otherwise wait for the next event
+void neoinit_path_unit_inactive(const char *unit) {
+    if (!unit) return;
+    for (size_t i = 0; i < path_count; i++) {
+        if (paths[i]->armed && strcmp(paths[i]->unit, unit) == 0) path_check_levels(paths[i]);
+    }
+}
+
+int neoinit_path_get_info(const neoinit_path_t *path, neoinit_path_info_t *info) {
+    if (!path || !info) return NEOINIT_ERROR_INVALID_ARG;
+    info->armed = path->armed;
+    info->pending = path->pending;
+    info->events = path->events;
+    info->triggers = path->triggers;
+    return NEOINIT_OK;
+}
+
+int neoinit_path_get_stats(neoinit_path_stats_t *out) {
+    if (!out) return NEOINIT_ERROR_INVALID_ARG;
+    *out = stats;
+    out->watches = (uint32_t)watch_count;
+    return NEOINIT_OK;
+}
+
+/*
+ * Path files
+ */
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+    return s;
+}
+
+static int path_load_file(const char *dir, const char *file) {
+    char filename[NEOINIT_MAX_PATH_LENGTH];
+    snprintf(filename, sizeof(filename), "%s/%s", dir, file);
+    FILE *fp = fopen(filename, "re");
+    if (!fp) return NEOINIT_ERROR_IO;
+
+    // "spool.path" starts "spool" unless Unit= says otherwise
+    char unit[NEOINIT_MAX_NAME_LENGTH];
+    snprintf(unit, sizeof(unit), "%s", file);
+    char *dot = strrchr(unit, '.');
+    if (dot && strcmp(dot, ".path") == 0) *dot = '\0';
+
+    neoinit_path_t *path = neoinit_path_create(file, unit);
+    if (!path) {
+        fclose(fp);
+        return NEOINIT_ERROR_EXISTS;
+    }
+
+    int ret = NEOINIT_OK;
+    unsigned lineno = 0;
+    char line[PATH_LINE_MAX];
+    while (ret == NEOINIT_OK && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *key = trim(line);
+        if (!*key || *key == '#' || *key == ';' || *key == '[') continue;
+        char *value = strchr(key, '=');
+        if (!value) {
+            ret = NEOINIT_ERROR_INVALID_ARG;
+            break;
+        }
+        *value++ = '\0';
+        key = trim(key);
+        value = trim(value);
+
+        int kind = -1;
+        for (int k = 0; k < NEOINIT_PATH_KIND_MAX; k++) {
+            if (strcmp(key, kind_names[k]) == 0) kind = k;
+        }
+        if (kind >= 0) {
+            ret = neoinit_path_add(path, (neoinit_path_kind_t)kind, value);
+        } else if (strcmp(key, "Unit") == 0) {
+            char *copy = strdup(value);
+            if (!copy) {
+                ret = NEOINIT_ERROR_NO_MEMORY;
+            } else {
+                free(path->unit);
+                path->unit = copy;
+            }
+        } else if (strcmp(key, "DebounceSec") == 0) {
+            uint64_t usec;
+            ret = neoinit_timespan_parse(value, &usec);
+            if (ret == NEOINIT_OK) neoinit_path_set_debounce(path, usec);
+        } else {
+            LOG_WARNING("%s:%u: unknown key %s", filename, lineno, key);
+        }
+    }
+    fclose(fp);
+
+    if (ret != NEOINIT_OK) {
+        LOG_ERROR("%s:%u: invalid path unit (%d)", filename, lineno, ret);
+        return ret;
+    }
+    return neoinit_path_arm(path);
+}
+
+// Loads and arms every *.path file; returns how many were armed
+int neoinit_path_load(const char *dir) {
+    if (!dir) return NEOINIT_ERROR_INVALID_ARG;
+    DIR *d = opendir(dir);
+    if (!d) return errno == ENOENT ? 0 : NEOINIT_ERROR_IO;
+
+    int loaded = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (entry->d_name[0] == '.' || !dot || strcmp(dot, ".path") != 0) continue;
+        if (path_load_file(dir, entry->d_name) == NEOINIT_OK) loaded++;
+    }
+    closedir(d);
+    return loaded;
+}
+
+/*
+ * Engine
+ */
+
+static int cmd_paths(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)argc;
+    (void)argv;
+    (void)user_data;
+    neoinit_control_printf(conn, "paths %u watches %zu events %llu wakeups %llu triggers %llu overflows %llu\n",
+                           stats.paths, watch_count, (unsigned long long)stats.events,
+                           (unsigned long long)stats.wakeups, (unsigned long long)stats.triggers,
+                           (unsigned long long)stats.overflows);
+    for (size_t i = 0; i < path_count; i++) {
+        const neoinit_path_t *path = paths[i];
+        neoinit_control_printf(conn, "%s %s %s%s events %llu triggers %llu\n", path->name, path->unit,
+                               path->armed ? "armed" : "disarmed", path->pending ? " pending" : "",
+                               (unsigned long long)path->events, (unsigned long long)path->triggers);
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_path_init(neoinit_path_activate_fn activate, void *user_data) {
+    if (!activate) return NEOINIT_ERROR_INVALID_ARG;
+    if (inotify_fd >= 0) return NEOINIT_ERROR_BUSY;
+
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    debounce_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (inotify_fd < 0 || debounce_fd < 0 ||
+        neoinit_events_watch(inotify_fd, EPOLLIN, on_inotify, NULL) != NEOINIT_OK ||
+        neoinit_events_watch(debounce_fd, EPOLLIN, on_debounce, NULL) != NEOINIT_OK) {
+        neoinit_path_cleanup();
+        return NEOINIT_ERROR_SYSTEM;
+    }
+
+    activate_fn = activate;
+    activate_data = user_data;
+    neoinit_control_register("paths", cmd_paths, NULL);
+    return NEOINIT_OK;
+}
+
+void neoinit_path_cleanup(void) {
+    for (size_t i = 0; i < path_count; i++) {
+        neoinit_path_disarm(paths[i]);
+        for (uint32_t s = 0; s < paths[i]->spec_count; s++) free(paths[i]->specs[s].file);
+        free(paths[i]->name);
+        free(paths[i]->unit);
+        free(paths[i]);
+    }
+    free(paths);
+    free(watch_slots);
+    free(pending);
+    free(stale);
+    paths = NULL;
+    watch_slots = NULL;
+    pending = NULL;
+    stale = NULL;
+    path_count = path_cap = watch_cap = watch_count = 0;
+    pending_len = pending_cap = stale_len = stale_cap = 0;
+
+    int fds[] = { inotify_fd, debounce_fd };
+    for (size_t i = 0; i < sizeof(fds) / sizeof(fds[0]); i++) {
+        if (fds[i] < 0) continue;
+        neoinit_events_unwatch(fds[i]);
+        close(fds[i]);
+    }
+    inotify_fd = debounce_fd = -1;
+    debounce_at = resume_at = 0;
+    activate_fn = NULL;
+    memset(&stats, 0, sizeof(stats));
+}
@@ -0,0 +1,961 @@
+#define _GNU_SOURCE
+#include "neoinit/timer.h"
+#include "neoinit/events.h"
+#include "neoinit/socket.h"
+#include "neoinit/log.h"
+#include "neoinit/state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <errno.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define TIMER_LINE_MAX   512
+#define CALENDAR_YEARS   8          // Give up on expressions that never match, e.g. Feb 30
+#define NO_DEADLINE      UINT64_MAX
+
+typedef struct {
+    neoinit_timer_base_t base;
+    uint64_t usec;                  // Monotonic offset
+    neoinit_calendar_t cal;
+} timer_spec_t;
+
+struct neoinit_timer {
+    char *name;
+    char *unit;
+    timer_spec_t specs[NEOINIT_TIMER_MAX_SPECS];
+    uint32_t spec_count;
+    uint32_t fired;                 // One-shot specs that already elapsed, by index
+    uint64_t accuracy;              // ns
+    uint64_t delay_range;           // usec
+    uint64_t delay;                 // ns, this timer's fixed share of delay_range
+
+    bool armed;
+    uint64_t armed_at;              // Monotonic, ns
+    uint64_t last_mono;
+    time_t last_real;
+    time_t last_slot;               // Calendar slot of the last trigger
+
+    uint64_t deadline;              // Monotonic, ns, delay included
+    int due_spec;                   // Spec that produced the deadline
+    time_t due_slot;                // Its calendar slot, 0 for monotonic specs
+    time_t next_real;
+    size_t heap_index;
+    uint64_t triggers;
+};
+
+static neoinit_timer_activate_fn activate_fn;
+static void *activate_data;
+static uint64_t host_seed;
+static bool resumed;                // Started from a re-exec image
+
+static neoinit_timer_t **timers;
+static size_t timer_count;
+static size_t timer_cap;
+
+static neoinit_timer_t **heap;
+static size_t heap_len;
+static size_t heap_cap;
+
+static int timer_fd = -1;
+static uint64_t armed_value;        // Current timerfd expiry, 0 when disarmed
+static uint64_t wakeups;
+
+static const char *const wday_names[7] = {
+    "sunday", "monday", "tuesday", "wednesday", "thursday", "friday", "saturday",
+};
+
+static const struct {
+    const char *name;
+    const char *expr;
+} calendar_shortcuts[] = {
+    { "minutely", "*-*-* *:*:00" },
+    { "hourly", "*-*-* *:00:00" },
+    { "daily", "*-*-* 00:00:00" },
+    { "weekly", "Mon *-*-* 00:00:00" },
+    { "monthly", "*-*-01 00:00:00" },
+    { "yearly", "*-01-01 00:00:00" },
+    { "annually", "*-01-01 00:00:00" },
+};
+
+static const struct {
+    const char *suffix;
+    uint64_t usec;
+} timespan_units[] = {
+    { "us", 1ULL }, { "usec", 1ULL },
+    { "ms", 1000ULL }, { "msec", 1000ULL },
+    { "", 1000000ULL }, { "s", 1000000ULL }, { "sec", 1000000ULL },
+    { "m", 60000000ULL }, { "min", 60000000ULL },
+    { "h", 3600000000ULL }, { "hr", 3600000000ULL }, { "hour", 3600000000ULL },
+    { "d", 86400000000ULL }, { "day", 86400000000ULL },
+    { "w", 604800000000ULL }, { "week", 604800000000ULL },
+};
+
+/*
+ * Expressions
+ */
+
+static bool parse_number(const char **p, unsigned *out) {
+    if (!isdigit((unsigned char)**p)) return false;
+    char *end;
+    unsigned long v = strtoul(*p, &end, 10);
+    if (v > 9999) return false;
+    *out = (unsigned)v;
+    *p = end;
+    return true;
+}
+
+// One comma separated field: "*", "*/n", "a", "a..b", "a/n", "a..b/n"
+static int parse_field(const char *s, size_t len, unsigned min, unsigned max, uint64_t *mask) {
+    char buf[64];
+    if (!len || len >= sizeof(buf)) return NEOINIT_ERROR_INVALID_ARG;
+    memcpy(buf, s, len);
+    buf[len] = '\0';
+
+    *mask = 0;
+    char *save = NULL;
+    for (char *item = strtok_r(buf, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+        const char *p = item;
+        unsigned from = min, to = max, step = 1;
+        if (*p == '*') {
+            p++;
+        } else {
+            if (!parse_number(&p, &from)) return NEOINIT_ERROR_INVALID_ARG;
+            to = from;
+            if (p[0] == '.' && p[1] == '.') {
+                p += 2;
+                if (!parse_number(&p, &to)) return NEOINIT_ERROR_INVALID_ARG;
+            }
+        }
+        if (*p == '/') {
+            p++;
+            if (!parse_number(&p, &step) || !step) return NEOINIT_ERROR_INVALID_ARG;
+            if (item[0] != '*' && !strstr(item, "..")) to = max;
+        }
+        if (*p || from < min || to > max || from > to) return NEOINIT_ERROR_INVALID_ARG;
+        for (unsigned v = from; v <= to; v += step) *mask |= 1ULL << v;
+    }
+    return *mask ? NEOINIT_OK : NEOINIT_ERROR_INVALID_ARG;
+}
+
+static int parse_wday(const char *s, size_t len) {
+    for (int d = 0; d < 7; d++) {
+        if ((len == 3 || len == strlen(wday_names[d])) && strncasecmp(s, wday_names[d], len) == 0) return d;
+    }
+    return -1;
+}
+
+static int parse_wdays(const char *s, uint8_t *mask) {
+    *mask = 0;
+    while (*s) {
+        size_t len = strcspn(s, ",.");
+        int from = parse_wday(s, len), to = from;
+        s += len;
+        if (s[0] == '.' && s[1] == '.') {
+            s += 2;
+            len = strcspn(s, ",");
+            to = parse_wday(s, len);
+            s += len;
+        }
+        if (from < 0 || to < 0) return NEOINIT_ERROR_INVALID_ARG;
+        // Ranges may wrap, e.g. Sat..Sun
+        for (int d = from;; d = (d + 1) % 7) {
+            *mask |= (uint8_t)(1u << d);
+            if (d == to) break;
+        }
+        if (*s == ',') s++;
+    }
+    return *mask ? NEOINIT_OK : NEOINIT_ERROR_INVALID_ARG;
+}
+
+static int parse_date(const char *s, neoinit_calendar_t *cal) {
+    const char *parts[3];
+    size_t lens[3];
+    int n = 0;
+    for (const char *p = s;; ) {
+        if (n == 3) return NEOINIT_ERROR_INVALID_ARG;
+        size_t len = strcspn(p, "-");
+        parts[n] = p;
+        lens[n++] = len;
+        if (!p[len]) break;
+        p += len + 1;
+    }
+    if (n < 2) return NEOINIT_ERROR_INVALID_ARG;
+
+    // Yearly recurrence is the only year rule; fixed years are not kept
+    if (n == 3 && !(lens[0] == 1 && parts[0][0] == '*')) return NEOINIT_ERROR_NOT_SUPPORTED;
+
+    uint64_t months, mdays;
+    int ret = parse_field(parts[n - 2], lens[n - 2], 1, 12, &months);
+    if (ret == NEOINIT_OK) ret = parse_field(parts[n - 1], lens[n - 1], 1, 31, &mdays);
+    if (ret != NEOINIT_OK) return ret;
+    cal->months = (uint16_t)months;
+    cal->mdays = (uint32_t)mdays;
+    return NEOINIT_OK;
+}
+
+static int parse_time(const char *s, neoinit_calendar_t *cal) {
+    const char *parts[3];
+    size_t lens[3];
+    int n = 0;
+    for (const char *p = s;; ) {
+        if (n == 3) return NEOINIT_ERROR_INVALID_ARG;
+        size_t len = strcspn(p, ":");
+        parts[n] = p;
+        lens[n++] = len;
+        if (!p[len]) break;
+        p += len + 1;
+    }
+    if (n < 2) return NEOINIT_ERROR_INVALID_ARG;
+
+    uint64_t hours, minutes, seconds = 1;
+    int ret = parse_field(parts[0], lens[0], 0, 23, &hours);
+    if (ret == NEOINIT_OK) ret = parse_field(parts[1], lens[1], 0, 59, &minutes);
+    if (ret == NEOINIT_OK && n == 3) ret = parse_field(parts[2], lens[2], 0, 59, &seconds);
+    if (ret != NEOINIT_OK) return ret;
+    cal->hours = (uint32_t)hours;
+    cal->minutes = minutes;
+    cal->seconds = seconds;
+    return NEOINIT_OK;
+}
+
+/*
+ * "[Weekdays] [*-]Month-Day [Hour:Minute[:Second]] [UTC]", or one of the
+ * shortcuts. A missing date matches every day, a missing time is midnight.
+ */
+int neoinit_calendar_parse(const char *expr, neoinit_calendar_t *cal) {
+    if (!expr || !cal) return NEOINIT_ERROR_INVALID_ARG;
+
+    char buf[TIMER_LINE_MAX];
+    snprintf(buf, sizeof(buf), "%s", expr);
+    char *save = NULL;
+    char *first = strtok_r(buf, " \t", &save);
+    if (!first) return NEOINIT_ERROR_INVALID_ARG;
+
+    for (size_t i = 0; i < sizeof(calendar_shortcuts) / sizeof(calendar_shortcuts[0]); i++) {
+        if (strcasecmp(first, calendar_shortcuts[i].name) != 0) continue;
+        char *rest = strtok_r(NULL, "", &save);
+        char full[TIMER_LINE_MAX];
+        snprintf(full, sizeof(full), "%s%s%s", calendar_shortcuts[i].expr, rest ? " " : "", rest ? rest : "");
+        return neoinit_calendar_parse(full, cal);
+    }
+
+    neoinit_calendar_t c = {
+        .seconds = 1, .minutes = 1, .hours = 1,
+        .mdays = 0xfffffffeu, .months = 0x1ffe, .wdays = 0x7f,
+    };
+    bool have_wdays = false, have_date = false, have_time = false;
+    int ret = NEOINIT_OK;
+
+    for (char *tok = first; tok && ret == NEOINIT_OK; tok = strtok_r(NULL, " \t", &save)) {
+        if (strcasecmp(tok, "UTC") == 0) {
+            c.utc = true;
+        } else if (strchr(tok, ':')) {
+            ret = have_time ? NEOINIT_ERROR_INVALID_ARG : parse_time(tok, &c);
+            have_time = true;
+        } else if (isalpha((unsigned char)tok[0])) {
+            ret = have_wdays || have_date ? NEOINIT_ERROR_INVALID_ARG : parse_wdays(tok, &c.wdays);
+            have_wdays = true;
+        } else {
+            ret = have_date || have_time ? NEOINIT_ERROR_INVALID_ARG : parse_date(tok, &c);
+            have_date = true;
+        }
+    }
+    if (ret != NEOINIT_OK) return ret;
+
+    *cal = c;
+    return NEOINIT_OK;
+}
+
+// Lowest set bit at or above from, or -1
+static int next_bit(uint64_t mask, int from, int max) {
+    if (from > max) return -1;
+    mask &= ~0ULL << from;
+    if (max < 63) mask &= (1ULL << (max + 1)) - 1;
+    return mask ? __builtin_ctzll(mask) : -1;
+}
+
+static time_t calendar_mktime(const neoinit_calendar_t *cal, struct tm *tm) {
+    tm->tm_isdst = -1;
+    time_t t = cal->utc ? timegm(tm) : mktime(tm);
+    if (t != (time_t)-1) {
+        if (cal->utc) gmtime_r(&t, tm);
+        else localtime_r(&t, tm);
+    }
+    return t;
+}
+
+/*
+ * Each pass fixes the coarsest field that does not match by jumping to its
+ * next set bit, resetting the finer fields and carrying into the coarser
+ * one when the field runs out. mktime() normalises day overflow, e.g.
+ * April 31 becomes May 1, and the next pass checks the result again.
+ */
+int neoinit_calendar_next(const neoinit_calendar_t *cal, time_t after, time_t *next) {
+    if (!cal || !next) return NEOINIT_ERROR_INVALID_ARG;
+
+    struct tm tm;
+    time_t t = after + 1;
+    if (cal->utc) gmtime_r(&t, &tm);
+    else localtime_r(&t, &tm);
+    int last_year = tm.tm_year + CALENDAR_YEARS;
+
+    while (tm.tm_year <= last_year) {
+        int v;
+        if (!(cal->months & (1u << (tm.tm_mon + 1)))) {
+            v = next_bit(cal->months, tm.tm_mon + 2, 12);
+            if (v < 0) {
+                tm.tm_year++;
+                v = next_bit(cal->months, 1, 12);
+            }
+            tm.tm_mon = v - 1;
+            tm.tm_mday = 1;
+            tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+        } else if (!(cal->mdays & (1u << tm.tm_mday))) {
+            v = next_bit(cal->mdays, tm.tm_mday + 1, 31);
+            if (v < 0) {
+                tm.tm_mon++;
+                v = 1;
+            }
+            tm.tm_mday = v;
+            tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+        } else if (!(cal->wdays & (1u << tm.tm_wday))) {
+            tm.tm_mday++;
+            tm.tm_hour = tm.tm_min = tm.tm_sec = 0;
+        } else if (!(cal->hours & (1u << tm.tm_hour))) {
+            v = next_bit(cal->hours, tm.tm_hour + 1, 23);
+            if (v < 0) {
+                tm.tm_mday++;
+                v = 0;
+            }
+            tm.tm_hour = v;
+            tm.tm_min = tm.tm_sec = 0;
+        } else if (!(cal->minutes & (1ULL << tm.tm_min))) {
+            v = next_bit(cal->minutes, tm.tm_min + 1, 59);
+            if (v < 0) {
+                tm.tm_hour++;
+                v = 0;
+            }
+            tm.tm_min = v;
+            tm.tm_sec = 0;
+        } else if (!(cal->seconds & (1ULL << tm.tm_sec))) {
+            v = next_bit(cal->seconds, tm.tm_sec + 1, 59);
+            if (v < 0) {
+                tm.tm_min++;
+                v = 0;
+            }
+            tm.tm_sec = v;
+        } else {
+            t = calendar_mktime(cal, &tm);
+            // A slot skipped by a DST change normalises to a time before it
+            if (t == (time_t)-1) return NEOINIT_ERROR_SYSTEM;
+            if (t <= after) {
+                tm.tm_sec++;
+                calendar_mktime(cal, &tm);
+                continue;
+            }
+            *next = t;
+            return NEOINIT_OK;
+        }
+        if (calendar_mktime(cal, &tm) == (time_t)-1) return NEOINIT_ERROR_SYSTEM;
+    }
+    return NEOINIT_ERROR_NOT_FOUND;
+}
+
+// "1h 30min", "90s", "250ms"; a bare number is seconds
+int neoinit_timespan_parse(const char *span, uint64_t *usec) {
+    if (!span || !usec) return NEOINIT_ERROR_INVALID_ARG;
+
+    uint64_t total = 0;
+    const char *p = span;
+    bool any = false;
+    while (*p) {
+        while (isspace((unsigned char)*p)) p++;
+        if (!*p) break;
+        if (!isdigit((unsigned char)*p)) return NEOINIT_ERROR_INVALID_ARG;
+        char *end;
+        unsigned long long v = strtoull(p, &end, 10);
+        p = end;
+        while (isspace((unsigned char)*p)) p++;
+        size_t len = 0;
+        while (isalpha((unsigned char)p[len])) len++;
+
+        size_t i;
+        for (i = 0; i < sizeof(timespan_units) / sizeof(timespan_units[0]); i++) {
+            const char *suffix = timespan_units[i].suffix;
+            if (strlen(suffix) == len && strncasecmp(p, suffix, len) == 0) break;
+        }
+        // Plural forms, e.g. "5 mins", "2 days"
+        if (i == sizeof(timespan_units) / sizeof(timespan_units[0]) && len > 1 && tolower((unsigned char)p[len - 1]) == 's') {
+            for (i = 0; i < sizeof(timespan_units) / sizeof(timespan_units[0]); i++) {
+                const char *suffix = timespan_units[i].suffix;
+                if (strlen(suffix) == len - 1 && strncasecmp(p, suffix, len - 1) == 0) break;
+            }
+        }
+        if (i == sizeof(timespan_units) / sizeof(timespan_units[0])) return NEOINIT_ERROR_INVALID_ARG;
+        total += v * timespan_units[i].usec;
+        p += len;
+        any = true;
+    }
+    if (!any) return NEOINIT_ERROR_INVALID_ARG;
+    *usec = total;
+    return NEOINIT_OK;
+}
+
+/*
+ * Deadline heap
+ */
+
+static void heap_set(size_t i, neoinit_timer_t *timer) {
+    heap[i] = timer;
+    timer->heap_index = i;
+}
+
+static void heap_sift_up(size_t i) {
+    neoinit_timer_t *timer = heap[i];
+    while (i) {
+        size_t parent = (i - 1) / 2;
+        if (heap[parent]->deadline <= timer->deadline) break;
+        heap_set(i, heap[parent]);
+        i = parent;
+    }
+    heap_set(i, timer);
+}
+
+static void heap_sift_down(size_t i) {
+    neoinit_timer_t *timer = heap[i];
+    for (;;) {
+        size_t child = 2 * i + 1;
+        if (child >= heap_len) break;
+        if (child + 1 < heap_len && heap[child + 1]->deadline < heap[child]->deadline) child++;
+        if (heap[child]->deadline >= timer->deadline) break;
+        heap_set(i, heap[child]);
+        i = child;
+    }
+    heap_set(i, timer);
+}
+
+static int heap_push(neoinit_timer_t *timer) {
+    if (heap_len == heap_cap) {
+        size_t cap = heap_cap ? heap_cap * 2 : NEOINIT_MAX_TIMERS;
+        neoinit_timer_t **grown = realloc(heap, cap * sizeof(*heap));
+        if (!grown) return NEOINIT_ERROR_NO_MEMORY;
+        heap = grown;
+        heap_cap = cap;
+    }
+    heap_set(heap_len++, timer);
+    heap_sift_up(timer->heap_index);
+    return NEOINIT_OK;
+}
+
+static void heap_remove(neoinit_timer_t *timer) {
+    size_t i = timer->heap_index;
+    if (i == SIZE_MAX) return;
+    timer->heap_index = SIZE_MAX;
+
+    neoinit_timer_t *last = heap[--heap_len];
+    if (i == heap_len) return;
+    heap_set(i, last);
+    heap_sift_up(i);
+    heap_sift_down(last->heap_index);
+}
+
+/*
+ * The wakeup goes at the end of the earliest window, pulled in by any due
+ * timer whose window closes sooner. The walk only descends into subtrees
+ * whose root falls inside the window, so it touches the timers that will
+ * fire with this wakeup and their direct children.
+ */
+static void timerfd_update(void) {
+    uint64_t at = 0;
+    if (heap_len) {
+        at = heap[0]->deadline + heap[0]->accuracy;
+        size_t stack[64], depth = 0;
+        stack[depth++] = 0;
+        while (depth) {
+            size_t i = stack[--depth];
+            if (i >= heap_len || heap[i]->deadline > at) continue;
+            if (heap[i]->deadline + heap[i]->accuracy < at) at = heap[i]->deadline + heap[i]->accuracy;
+            // Depth-first keeps about one pending node per level
+            if (depth + 2 > sizeof(stack) / sizeof(stack[0])) continue;
+            stack[depth++] = 2 * i + 2;
+            stack[depth++] = 2 * i + 1;
+        }
+        if (!at) at = 1;
+    }
+    if (at == armed_value || timer_fd < 0) return;
+
+    struct itimerspec its = { 0 };
+    its.it_value.tv_sec = (time_t)(at / 1000000000ULL);
+    its.it_value.tv_nsec = (long)(at % 1000000000ULL);
+    if (timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &its, NULL) == 0) armed_value = at;
+}
+
+/*
+ * Scheduling
+ */
+
+static uint64_t fnv1a(const char *s, uint64_t hash) {
+    for (; *s; s++) {
+        hash ^= (unsigned char)*s;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+// splitmix64 finaliser, so names that differ in one byte land far apart
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static void timer_update_delay(neoinit_timer_t *timer) {
+    timer->delay = timer->delay_range
+        ? (mix(fnv1a(timer->name, host_seed)) % (timer->delay_range + 1)) * 1000ULL
+        : 0;
+}
+
+static uint64_t realtime_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+// Earliest elapse over all specs, as a monotonic deadline with the delay added
+static void timer_schedule(neoinit_timer_t *timer, uint64_t now_mono, uint64_t now_real) {
+    timer->deadline = NO_DEADLINE;
+    timer->due_spec = -1;
+    timer->due_slot = 0;
+    timer->next_real = 0;
+
+    for (uint32_t i = 0; i < timer->spec_count; i++) {
+        const timer_spec_t *spec = &timer->specs[i];
+        uint64_t at;
+        time_t slot = 0;
+
+        switch (spec->base) {
+        case NEOINIT_TIMER_ON_BOOT:
+            if (timer->fired & (1u << i)) continue;
+            at = spec->usec * 1000ULL;
+            break;
+        case NEOINIT_TIMER_ON_ARMED:
+            if (timer->fired & (1u << i)) continue;
+            at = timer->armed_at + spec->usec * 1000ULL;
+            break;
+        case NEOINIT_TIMER_ON_ACTIVE:
+            at = (timer->last_mono ? timer->last_mono : timer->armed_at) + spec->usec * 1000ULL;
+            break;
+        case NEOINIT_TIMER_CALENDAR: {
+            time_t after = (time_t)(now_real / 1000000000ULL);
+            if (timer->last_slot > after) after = timer->last_slot;
+            if (neoinit_calendar_next(&spec->cal, after, &slot) != NEOINIT_OK) continue;
+            at = now_mono + ((uint64_t)slot * 1000000000ULL - now_real);
+            break;
+        }
+        default:
+            continue;
+        }
+
+        if (at < timer->deadline) {
+            timer->deadline = at;
+            timer->due_spec = (int)i;
+            timer->due_slot = slot;
+        }
+    }
+
+    if (timer->deadline == NO_DEADLINE) return;
+    timer->deadline += timer->delay;
+    int64_t ahead = (int64_t)(timer->deadline - now_mono);
+    timer->next_real = (time_t)((int64_t)(now_real / 1000000000ULL) + ahead / 1000000000LL);
+}
+
+static void timer_enqueue(neoinit_timer_t *timer, uint64_t now_mono, uint64_t now_real) {
+    timer_schedule(timer, now_mono, now_real);
+    if (timer->deadline == NO_DEADLINE) {
+        LOG_DEBUG("Timer %s has no further elapse", timer->name);
+        return;
+    }
+    if (heap_push(timer) != NEOINIT_OK) {
+        LOG_ERROR("Cannot schedule timer %s", timer->name);
+    }
+}
+
+static void timer_trigger(neoinit_timer_t *timer) {
+    LOG_DEBUG("Timer %s elapsed, starting %s", timer->name, timer->unit);
+
+    neoinit_event_t event = {
+        .type = NEOINIT_EVENT_TIMER_TRIGGERED,
+        .priority = NEOINIT_EVENT_PRIORITY_INFO,
+        .flags = NEOINIT_EVENT_FLAG_INTERNAL,
+    };
+    snprintf(event.name, sizeof(event.name), "%s", timer->name);
+    snprintf(event.target.service, sizeof(event.target.service), "%s", timer->unit);
+    neoinit_event_emit(&event);
+
+    if (activate_fn && activate_fn(timer->unit, activate_data) != 0) {
+        LOG_WARNING("Timer %s failed to start %s", timer->name, timer->unit);
+    }
+}
+
+static int on_timer(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    (void)user_data;
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return NEOINIT_OK;
+    armed_value = 0;
+    wakeups++;
+
+    uint64_t now_mono = neoinit_get_monotonic_time();
+    uint64_t now_real = realtime_ns();
+
+    // Pop everything due first, so activation may re-arm or disarm timers
+    size_t count = 0;
+    neoinit_timer_t **due = NULL;
+    while (heap_len && heap[0]->deadline <= now_mono) {
+        neoinit_timer_t *timer = heap[0];
+        heap_remove(timer);
+
+        // The wall clock was set back since the deadline was computed
+        if (timer->due_slot && (uint64_t)timer->due_slot * 1000000000ULL + timer->delay > now_real) {
+            timer_enqueue(timer, now_mono, now_real);
+            continue;
+        }
+
+        neoinit_timer_t **grown = realloc(due, (count + 1) * sizeof(*due));
+        if (!grown) {
+            timer_enqueue(timer, now_mono, now_real);
+            break;
+        }
+        due = grown;
+        due[count++] = timer;
+
+        timer->triggers++;
+        timer->last_mono = now_mono;
+        timer->last_real = (time_t)(now_real / 1000000000ULL);
+        if (timer->due_slot) timer->last_slot = timer->due_slot;
+        else if (timer->specs[timer->due_spec].base != NEOINIT_TIMER_ON_ACTIVE) timer->fired |= 1u << timer->due_spec;
+    }
+    for (size_t i = 0; i < count; i++) timer_enqueue(due[i], now_mono, now_real);
+    timerfd_update();
+
+    for (size_t i = 0; i < count; i++) {
+        if (due[i]->armed) timer_trigger(due[i]);
+    }
+    free(due);
+    return NEOINIT_OK;
+}
+
+/*
+ * Timers
+ */
+
+neoinit_timer_t *neoinit_timer_lookup(const char *name) {
+    if (!name) return NULL;
+    for (size_t i = 0; i < timer_count; i++) {
+        if (strcmp(timers[i]->name, name) == 0) return timers[i];
+    }
+    return NULL;
+}
+
+neoinit_timer_t *neoinit_timer_create(const char *name, const char *unit) {
+    if (!name || !*name || !unit || !*unit || neoinit_timer_lookup(name)) return NULL;
+
+    if (timer_count == timer_cap) {
+        size_t cap = timer_cap ? timer_cap * 2 : NEOINIT_MAX_TIMERS;
+        neoinit_timer_t **grown = realloc(timers, cap * sizeof(*timers));
+        if (!grown) return NULL;
+        timers = grown;
+        timer_cap = cap;
+    }
+
+    neoinit_timer_t *timer = calloc(1, sizeof(*timer));
+    if (!timer) return NULL;
+    timer->name = strdup(name);
+    timer->unit = strdup(unit);
+    if (!timer->name || !timer->unit) {
+        free(timer->name);
+        free(timer->unit);
+        free(timer);
+        return NULL;
+    }
+    timer->accuracy = NEOINIT_TIMER_ACCURACY_USEC * 1000ULL;
+    timer->deadline = NO_DEADLINE;
+    timer->heap_index = SIZE_MAX;
+    timers[timer_count++] = timer;
+    return timer;
+}
+
+static int timer_add_spec(neoinit_timer_t *timer, const timer_spec_t *spec) {
+    if (timer->spec_count == NEOINIT_TIMER_MAX_SPECS) return NEOINIT_ERROR_RESOURCE;
+    timer->specs[timer->spec_count++] = *spec;
+    return NEOINIT_OK;
+}
+
+int neoinit_timer_add_calendar(neoinit_timer_t *timer, const char *expr) {
+    if (!timer || !expr) return NEOINIT_ERROR_INVALID_ARG;
+    timer_spec_t spec = { .base = NEOINIT_TIMER_CALENDAR };
+    int ret = neoinit_calendar_parse(expr, &spec.cal);
+    return ret == NEOINIT_OK ? timer_add_spec(timer, &spec) : ret;
+}
+
+int neoinit_timer_add_monotonic(neoinit_timer_t *timer, neoinit_timer_base_t base, uint64_t usec) {
+    if (!timer || base >= NEOINIT_TIMER_CALENDAR) return NEOINIT_ERROR_INVALID_ARG;
+    // A zero repeat interval would fire on every wakeup
+    if (base == NEOINIT_TIMER_ON_ACTIVE && !usec) return NEOINIT_ERROR_INVALID_ARG;
+    timer_spec_t spec = { .base = base, .usec = usec };
+    return timer_add_spec(timer, &spec);
+}
+
+int neoinit_timer_set_accuracy(neoinit_timer_t *timer, uint64_t usec) {
+    if (!timer) return NEOINIT_ERROR_INVALID_ARG;
+    timer->accuracy = usec * 1000ULL;
+    if (timer->heap_index != SIZE_MAX) timerfd_update();
+    return NEOINIT_OK;
+}
+
+int neoinit_timer_set_randomized_delay(neoinit_timer_t *timer, uint64_t usec) {
+    if (!timer) return NEOINIT_ERROR_INVALID_ARG;
+    timer->delay_range = usec;
+    timer_update_delay(timer);
+    if (timer->armed) {
+        heap_remove(timer);
+        timer_enqueue(timer, neoinit_get_monotonic_time(), realtime_ns());
+        timerfd_update();
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_timer_arm(neoinit_timer_t *timer) {
+    if (!timer) return NEOINIT_ERROR_INVALID_ARG;
+    if (!timer->spec_count) return NEOINIT_ERROR_STATE;
+    if (timer->armed) return NEOINIT_OK;
+
+    timer->armed = true;
+    timer->armed_at = neoinit_get_monotonic_time();
+    // Re-arming restarts the OnActiveSec= countdowns; boot offsets stay spent
+    for (uint32_t i = 0; i < timer->spec_count; i++) {
+        const timer_spec_t *spec = &timer->specs[i];
+        if (spec->base == NEOINIT_TIMER_ON_ARMED) timer->fired &= ~(1u << i);
+        // The previous image already fired boot offsets that have passed
+        if (spec->base == NEOINIT_TIMER_ON_BOOT && resumed && spec->usec * 1000ULL <= timer->armed_at) {
+            timer->fired |= 1u << i;
+        }
+    }
+    timer_enqueue(timer, timer->armed_at, realtime_ns());
+    timerfd_update();
+    return NEOINIT_OK;
+}
+
+int neoinit_timer_disarm(neoinit_timer_t *timer) {
+    if (!timer) return NEOINIT_ERROR_INVALID_ARG;
+    timer->armed = false;
+    timer->deadline = NO_DEADLINE;
+    timer->next_real = 0;
+    heap_remove(timer);
+    timerfd_update();
+    return NEOINIT_OK;
+}
+
+int neoinit_timer_get_info(const neoinit_timer_t *timer, neoinit_timer_info_t *info) {
+    if (!timer || !info) return NEOINIT_ERROR_INVALID_ARG;
+    info->armed = timer->armed;
+    info->next = timer->next_real;
+    info->last = timer->last_real;
+    info->triggers = timer->triggers;
+    info->delay_usec = timer->delay / 1000ULL;
+    return NEOINIT_OK;
+}
+
+uint64_t neoinit_timer_wakeups(void) {
+    return wakeups;
+}
+
+/*
+ * Timer files
+ */
+
+static char *trim(char *s) {
+    while (isspace((unsigned char)*s)) s++;
+    char *end = s + strlen(s);
+    while (end > s && isspace((unsigned char)end[-1])) *--end = '\0';
+    return s;
+}
+
+static int timer_load_file(const char *dir, const char *file) {
+    char path[NEOINIT_MAX_PATH_LENGTH];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    FILE *fp = fopen(path, "re");
+    if (!fp) return NEOINIT_ERROR_IO;
+
+    // "backup.timer" starts "backup" unless Unit= says otherwise
+    char name[NEOINIT_MAX_NAME_LENGTH];
+    snprintf(name, sizeof(name), "%s", file);
+    char unit[NEOINIT_MAX_NAME_LENGTH];
+    snprintf(unit, sizeof(unit), "%s", file);
+    char *dot = strrchr(unit, '.');
+    if (dot && strcmp(dot, ".timer") == 0) *dot = '\0';
+
+    timer_spec_t specs[NEOINIT_TIMER_MAX_SPECS];
+    uint32_t spec_count = 0;
+    uint64_t accuracy = NEOINIT_TIMER_ACCURACY_USEC, delay = 0;
+    int ret = NEOINIT_OK;
+    unsigned lineno = 0;
+    char line[TIMER_LINE_MAX];
+
+    while (ret == NEOINIT_OK && fgets(line, sizeof(line), fp)) {
+        lineno++;
+        char *key = trim(line);
+        if (!*key || *key == '#' || *key == ';' || *key == '[') continue;
+        char *value = strchr(key, '=');
+        if (!value) {
+            ret = NEOINIT_ERROR_INVALID_ARG;
+            break;
+        }
+        *value++ = '\0';
+        key = trim(key);
+        value = trim(value);
+
+        timer_spec_t spec = { 0 };
+        bool is_spec = true;
+        if (strcmp(key, "Unit") == 0) {
+            snprintf(unit, sizeof(unit), "%s", value);
+            is_spec = false;
+        } else if (strcmp(key, "OnCalendar") == 0) {
+            spec.base = NEOINIT_TIMER_CALENDAR;
+            ret = neoinit_calendar_parse(value, &spec.cal);
+        } else if (strcmp(key, "OnBootSec") == 0) {
+            spec.base = NEOINIT_TIMER_ON_BOOT;
+            ret = neoinit_timespan_parse(value, &spec.usec);
+        } else if (strcmp(key, "OnActiveSec") == 0) {
+            spec.base = NEOINIT_TIMER_ON_ARMED;
+            ret = neoinit_timespan_parse(value, &spec.usec);
+        } else if (strcmp(key, "OnUnitActiveSec") == 0) {
+            spec.base = NEOINIT_TIMER_ON_ACTIVE;
+            ret = neoinit_timespan_parse(value, &spec.usec);
+        } else if (strcmp(key, "AccuracySec") == 0) {
+            ret = neoinit_timespan_parse(value, &accuracy);
+            is_spec = false;
+        } else if (strcmp(key, "RandomizedDelaySec") == 0) {
+            ret = neoinit_timespan_parse(value, &delay);
+            is_spec = false;
+        } else {
+            LOG_WARNING("%s:%u: unknown key %s", path, lineno, key);
+            is_spec = false;
+        }
+        if (ret == NEOINIT_OK && is_spec) {
+            if (spec_count == NEOINIT_TIMER_MAX_SPECS) ret = NEOINIT_ERROR_RESOURCE;
+            else specs[spec_count++] = spec;
+        }
+    }
+    fclose(fp);
+
+    if (ret != NEOINIT_OK) {
+        LOG_ERROR("%s:%u: invalid timer (%d)", path, lineno, ret);
+        return ret;
+    }
+
+    neoinit_timer_t *timer = neoinit_timer_create(name, unit);
+    if (!timer) return NEOINIT_ERROR_EXISTS;
+    for (uint32_t i = 0; i < spec_count; i++) timer_add_spec(timer, &specs[i]);
+    neoinit_timer_set_accuracy(timer, accuracy);
+    neoinit_timer_set_randomized_delay(timer, delay);
+    return neoinit_timer_arm(timer);
+}
+
+// Loads and arms every *.timer file; returns how many were armed
+int neoinit_timer_load(const char *dir) {
+    if (!dir) return NEOINIT_ERROR_INVALID_ARG;
+    DIR *d = opendir(dir);
+    if (!d) return errno == ENOENT ? 0 : NEOINIT_ERROR_IO;
+
+    int loaded = 0;
+    struct dirent *entry;
+    while ((entry = readdir(d))) {
+        const char *dot = strrchr(entry->d_name, '.');
+        if (entry->d_name[0] == '.' || !dot || strcmp(dot, ".timer") != 0) continue;
+        if (timer_load_file(dir, entry->d_name) == NEOINIT_OK) loaded++;
+    }
+    closedir(d);
+    return loaded;
+}
+
+/*
+ * Engine
+ */
+
+static int cmd_timers(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)argc;
+    (void)argv;
+    (void)user_data;
+    neoinit_control_printf(conn, "timers %zu scheduled %zu wakeups %llu\n", timer_count, heap_len,
+                           (unsigned long long)wakeups);
+    for (size_t i = 0; i < timer_count; i++) {
+        const neoinit_timer_t *timer = timers[i];
+        neoinit_control_printf(conn, "%s %s %s next %lld last %lld triggers %llu delay_us %llu\n",
+                               timer->name, timer->unit, timer->armed ? "armed" : "disarmed",
+                               (long long)timer->next_real, (long long)timer->last_real,
+                               (unsigned long long)timer->triggers,
+                               (unsigned long long)(timer->delay / 1000ULL));
+    }
+    return NEOINIT_OK;
+}
+
+// The seed keeps offsets stable per host and different across a fleet
+static uint64_t read_host_seed(void) {
+    char id[64] = { 0 };
+    FILE *fp = fopen(NEOINIT_TIMER_SEED_FILE, "re");
+    if (fp) {
+        if (!fgets(id, sizeof(id), fp)) id[0] = '\0';
+        fclose(fp);
+    }
+    if (!id[0]) gethostname(id, sizeof(id) - 1);
+    return fnv1a(trim(id), 0xcbf29ce484222325ULL);
+}
+
+int neoinit_timer_init(neoinit_timer_activate_fn activate, void *user_data) {
+    if (!activate) return NEOINIT_ERROR_INVALID_ARG;
+    if (timer_fd >= 0) return NEOINIT_ERROR_BUSY;
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0 || neoinit_events_watch(timer_fd, EPOLLIN, on_timer, NULL) != NEOINIT_OK) {
+        if (timer_fd >= 0) close(timer_fd);
+        timer_fd = -1;
+        return NEOINIT_ERROR_SYSTEM;
+    }
+
+    host_seed = read_host_seed();
+    resumed = neoinit_state_pending();
+    activate_fn = activate;
+    activate_data = user_data;
+    armed_value = 0;
+    neoinit_control_register("timers", cmd_timers, NULL);
+    return NEOINIT_OK;
+}
+
+void neoinit_timer_cleanup(void) {
+    if (timer_fd >= 0) {
+        neoinit_events_unwatch(timer_fd);
+        close(timer_fd);
+        timer_fd = -1;
+    }
+    for (size_t i = 0; i < timer_count; i++) {
+        free(timers[i]->name);
+        free(timers[i]->unit);
+        free(timers[i]);
+    }
+    free(timers);
+    free(heap);
+    timers = NULL;
+    heap = NULL;
+    timer_count = timer_cap = heap_len = heap_cap = 0;
+    activate_fn = NULL;
+    armed_value = 0;
+}
@@ -0,0 +1,769 @@
+#define _GNU_SOURCE
+#include "neoinit/journal.h"
+#include "neoinit/socket.h"
+#include "neoinit/timer.h"
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define RING_MASK ((uint64_t)NEOINIT_JOURNAL_RING_SIZE - 1)
+#define SLOT 8
+#define HEADER_SIZE ((uint32_t)sizeof(neoinit_journal_record_t))
+#define RECORD_MAX (HEADER_SIZE + 255 + 255 + NEOINIT_JOURNAL_DATA_MAX + SLOT)
+#define PAGE_ALIGN(n) (((n) + 4095) & ~(size_t)4095)
+
+#define SEGMENT_MAGIC "NEOJRNL1"
+#define SEGMENT_VERSION 1
+#define SEGMENT_SUFFIX ".journal"
+#define SEGMENT_BLOCKS (NEOINIT_JOURNAL_SEGMENT_SIZE / NEOINIT_JOURNAL_BLOCK_SIZE)
+#define INDEX_OFFSET 4096
+#define DATA_OFFSET (INDEX_OFFSET + PAGE_ALIGN(SEGMENT_BLOCKS * sizeof(index_entry_t)))
+#define DATA_CAPACITY (NEOINIT_JOURNAL_SEGMENT_SIZE - DATA_OFFSET)
+#define BLOOM_WORDS 4               // 256-bit service filter per block
+#define QUERY_DEFAULT_LIMIT 1000    // For the control verb; the API has none
+
+_Static_assert((NEOINIT_JOURNAL_RING_SIZE & RING_MASK) == 0, "journal ring size must be a power of two");
+_Static_assert(sizeof(neoinit_journal_record_t) % SLOT == 0, "journal record header must be slot aligned");
+_Static_assert(RECORD_MAX <= UINT16_MAX && RECORD_MAX < NEOINIT_JOURNAL_RING_SIZE / 2, "journal record too large");
+
+/**
+ * Summary of the records that start in one block of a segment. Masks and
+ * filters only ever gain bits, so a summary may match more than its block
+ * holds but never less.
+ */
+typedef struct {
+    uint64_t usec_min;
+    uint64_t usec_max;
+    uint64_t type_mask;             // Bit (type & 63) per event type
+    uint64_t service_bloom[BLOOM_WORDS];  // Two bits per service id
+    uint32_t offset;                // First record starting in the block
+    uint32_t count;
+} index_entry_t;
+
+_Static_assert(sizeof(index_entry_t) == 64, "journal index entry should fill one cache line");
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t blocks;
+    uint64_t data_offset;
+    uint64_t tail;                  // Bytes of complete records, stored last
+    uint64_t records;
+    uint64_t seq_first;
+    uint64_t seq_last;
+    uint64_t usec_min;
+    uint64_t usec_max;
+    uint64_t type_mask;
+    uint64_t service_bloom[BLOOM_WORDS];
+    uint32_t sealed;                // Trimmed to its used size; no further appends
+    char boot_id[40];
+} segment_header_t;
+
+_Static_assert(sizeof(segment_header_t) <= INDEX_OFFSET, "journal segment header too large");
+
+typedef struct {
+    int fd;
+    unsigned char *map;
+    segment_header_t *hdr;
+    index_entry_t *index;
+    unsigned char *data;
+    uint64_t synced;                // Data bytes already msync()ed
+} segment_t;
+
+typedef struct {
+    uint32_t number;
+    uint64_t size;
+} segment_file_t;
+
+// Resolved form of a neoinit_journal_query_t
+typedef struct {
+    const neoinit_journal_query_t *query;
+    uint64_t type_bit;
+    uint64_t service_bits[BLOOM_WORDS];
+    uint32_t service_id;
+    size_t unit_len;
+    size_t matches;
+} query_plan_t;
+
+static unsigned char ring[NEOINIT_JOURNAL_RING_SIZE] __attribute__((aligned(SLOT)));
+static _Alignas(64) uint64_t ring_head;     // Producers, under ring_lock
+static _Alignas(64) uint64_t ring_tail;     // Writer only
+static pthread_mutex_t ring_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static volatile bool writer_active;
+static pthread_t writer_thread;
+static int wake_fd = -1;
+static int dir_fd = -1;
+static uint64_t max_size;
+static uint32_t next_number;
+static char boot_id[40];
+static segment_t active = { .fd = -1 };
+
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t flush_requested;
+static uint64_t flush_done;
+static size_t page_size;
+
+static neoinit_journal_stats_t stats;
+
+static inline uint32_t slot_align(size_t n) {
+    return (uint32_t)((n + SLOT - 1) & ~(size_t)(SLOT - 1));
+}
+
+static inline uint64_t type_bit(uint32_t type) {
+    return 1ULL << (type & 63);
+}
+
+static void service_bits(uint32_t id, uint64_t bloom[BLOOM_WORDS]) {
+    memset(bloom, 0, BLOOM_WORDS * sizeof(*bloom));
+    if (!id) return;
+    uint32_t a = id & 255, b = (id >> 8) & 255;
+    bloom[a >> 6] |= 1ULL << (a & 63);
+    bloom[b >> 6] |= 1ULL << (b & 63);
+}
+
+static uint64_t realtime_usec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000ULL + (uint64_t)ts.tv_nsec / 1000ULL;
+}
+
+// FNV-1a; 0 is kept for "no service"
+uint32_t neoinit_journal_service_id(const char *name) {
+    if (!name || !*name) return 0;
+    uint32_t h = 2166136261u;
+    for (const unsigned char *p = (const unsigned char *)name; *p; p++) h = (h ^ *p) * 16777619u;
+    return h ? h : 1;
+}
+
+static void writer_wake(void) {
+    uint64_t one = 1;
+    if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        // Counter saturated: the writer is already due to run
+    }
+}
+
+static uint32_t encode(const neoinit_event_t *event, unsigned char *buf) {
+    size_t name_len = strnlen(event->name, sizeof(event->name));
+    size_t service_len = strnlen(event->target.service, sizeof(event->target.service));
+    const void *data = event->data.ptr ? event->data.ptr : event->data.buf;
+    size_t data_len = event->data.size;
+    if (name_len > 255) name_len = 255;
+    if (service_len > 255) service_len = 255;
+    if (data_len > NEOINIT_JOURNAL_DATA_MAX) data_len = NEOINIT_JOURNAL_DATA_MAX;
+
+    neoinit_journal_record_t *rec = (neoinit_journal_record_t *)buf;
+    *rec = (neoinit_journal_record_t){
+        .seq = event->id,
+        .usec = realtime_usec(),
+        .service_id = neoinit_journal_service_id(event->target.service),
+        .pid = event->target.pid,
+        .size = (uint16_t)slot_align(HEADER_SIZE + name_len + service_len + data_len),
+        .type = (uint16_t)event->type,
+        .data_len = (uint16_t)data_len,
+        .flags = (uint16_t)event->flags,
+        .priority = (uint8_t)event->priority,
+        .name_len = (uint8_t)name_len,
+        .service_len = (uint8_t)service_len,
+        .source = (uint8_t)event->source.type,
+    };
+    unsigned char *p = buf + HEADER_SIZE;
+    memcpy(p, event->name, name_len);
+    memcpy(p + name_len, event->target.service, service_len);
+    if (data_len) memcpy(p + name_len + service_len, data, data_len);
+    return rec->size;
+}
+
+/*
+ * Same layout rules as the log rings: a record never wraps, and the space
+ * left before the end gets a padding record (seq 0) when one fits.
+ */
+static bool ring_push(const unsigned char *rec, uint32_t size) {
+    uint64_t start = ring_head;
+    uint64_t head = start;
+    uint64_t tail = __atomic_load_n(&ring_tail, __ATOMIC_ACQUIRE);
+    uint64_t off = head & RING_MASK;
+    uint64_t contiguous = NEOINIT_JOURNAL_RING_SIZE - off;
+    uint64_t pad = size > contiguous ? contiguous : 0;
+
+    if (head + pad + size - tail > NEOINIT_JOURNAL_RING_SIZE) {
+        __atomic_fetch_add(&stats.dropped, 1, __ATOMIC_RELAXED);
+        return true;
+    }
+    if (pad && pad >= HEADER_SIZE) {
+        neoinit_journal_record_t skip = { .seq = 0, .size = (uint16_t)pad };
+        memcpy(ring + off, &skip, sizeof(skip));
+    }
+    head += pad;
+
+    memcpy(ring + (head & RING_MASK), rec, size);
+    __atomic_store_n(&ring_head, head + size, __ATOMIC_RELEASE);
+
+    // Pairs with the fence in writer_main, as in the log rings
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring_tail, __ATOMIC_RELAXED) == start) return true;
+    return start - tail <= NEOINIT_JOURNAL_RING_SIZE / 2 && head + size - tail > NEOINIT_JOURNAL_RING_SIZE / 2;
+}
+
+// Runs on the emitting thread: one encode and one copy, no I/O
+static int on_event(const neoinit_event_t *event, void *user_data) {
+    (void)user_data;
+    if (!writer_active) return NEOINIT_OK;
+
+    _Alignas(SLOT) unsigned char buf[RECORD_MAX];
+    uint32_t size = encode(event, buf);
+
+    pthread_mutex_lock(&ring_lock);
+    bool wake = ring_push(buf, size);
+    pthread_mutex_unlock(&ring_lock);
+
+    if (wake || event->priority <= NEOINIT_EVENT_PRIORITY_ERROR) writer_wake();
+    return NEOINIT_OK;
+}
+
+static void segment_name(uint32_t number, char *buf, size_t size) {
+    snprintf(buf, size, "%08u" SEGMENT_SUFFIX, number);
+}
+
+static int segment_cmp(const void *a, const void *b) {
+    const segment_file_t *x = a, *y = b;
+    return x->number < y->number ? -1 : x->number > y->number;
+}
+
+// Segment files in the journal directory, oldest first; the caller frees
+static size_t segment_list(segment_file_t **out) {
+    *out = NULL;
+    int fd = openat(dir_fd, ".", O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    DIR *dir = fd >= 0 ? fdopendir(fd) : NULL;
+    if (!dir) {
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+
+    size_t count = 0, cap = 0;
+    struct dirent *de;
+    while ((de = readdir(dir))) {
+        char *end;
+        unsigned long number = strtoul(de->d_name, &end, 10);
+        if (end == de->d_name || strcmp(end, SEGMENT_SUFFIX) != 0) continue;
+
+        struct stat st;
+        if (fstatat(dir_fd, de->d_name, &st, 0) < 0 || !S_ISREG(st.st_mode)) continue;
+        if (count == cap) {
+            size_t grown_cap = cap ? cap * 2 : 64;
+            segment_file_t *grown = realloc(*out, grown_cap * sizeof(*grown));
+            if (!grown) break;
+            *out = grown;
+            cap = grown_cap;
+        }
+        (*out)[count++] = (segment_file_t){ (uint32_t)number, (uint64_t)st.st_size };
+    }
+    closedir(dir);
+
+    if (count) qsort(*out, count, sizeof(**out), segment_cmp);
+    return count;
+}
+
+static bool header_valid(const segment_header_t *hdr) {
+    return memcmp(hdr->magic, SEGMENT_MAGIC, sizeof(hdr->magic)) == 0 && hdr->version == SEGMENT_VERSION &&
+           hdr->blocks == SEGMENT_BLOCKS && hdr->data_offset == DATA_OFFSET && hdr->tail <= DATA_CAPACITY;
+}
+
+// Trims a finished segment to what it holds; also used for ones a crash left open
+static void segment_trim(int fd, uint64_t tail) {
+    if (ftruncate(fd, (off_t)(DATA_OFFSET + tail)) < 0) {
+        LOG_WARNING("Cannot trim journal segment: %s", strerror(errno));
+    }
+}
+
+static void segment_seal(segment_t *seg) {
+    if (!seg->map) return;
+    uint64_t tail = seg->hdr->tail;
+    seg->hdr->sealed = 1;
+    munmap(seg->map, NEOINIT_JOURNAL_SEGMENT_SIZE);
+    segment_trim(seg->fd, tail);
+    close(seg->fd);
+    *seg = (segment_t){ .fd = -1 };
+}
+
+static int segment_create(segment_t *seg, uint32_t number) {
+    char name[32];
+    segment_name(number, name, sizeof(name));
+    int fd = openat(dir_fd, name, O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0640);
+    if (fd < 0) return NEOINIT_ERROR_IO;
+
+    // Sparse: the unused part of the segment costs nothing until it is written
+    void *map = MAP_FAILED;
+    if (ftruncate(fd, NEOINIT_JOURNAL_SEGMENT_SIZE) == 0) {
+        map = mmap(NULL, NEOINIT_JOURNAL_SEGMENT_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    }
+    if (map == MAP_FAILED) {
+        close(fd);
+        unlinkat(dir_fd, name, 0);
+        return NEOINIT_ERROR_IO;
+    }
+
+    seg->fd = fd;
+    seg->map = map;
+    seg->hdr = map;
+    seg->index = (index_entry_t *)(seg->map + INDEX_OFFSET);
+    seg->data = seg->map + DATA_OFFSET;
+
+    memcpy(seg->hdr->magic, SEGMENT_MAGIC, sizeof(seg->hdr->magic));
+    seg->hdr->version = SEGMENT_VERSION;
+    seg->hdr->blocks = SEGMENT_BLOCKS;
+    seg->hdr->data_offset = DATA_OFFSET;
+    seg->hdr->usec_min = UINT64_MAX;
+    memcpy(seg->hdr->boot_id, boot_id, sizeof(seg->hdr->boot_id));
+    return NEOINIT_OK;
+}
+
+// Deletes the oldest segments until the journal fits under max_size
+static void enforce_cap(void) {
+    segment_file_t *files;
+    size_t count = segment_list(&files);
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; i++) total += files[i].size;
+
+    size_t first = 0;
+    while (total > max_size && first + 1 < count) {
+        char name[32];
+        segment_name(files[first].number, name, sizeof(name));
+        if (unlinkat(dir_fd, name, 0) == 0) total -= files[first].size;
+        first++;
+    }
+    __atomic_store_n(&stats.segments, (uint32_t)(count - first), __ATOMIC_RELAXED);
+    __atomic_store_n(&stats.disk_bytes, total, __ATOMIC_RELAXED);
+    free(files);
+}
+
+static int segment_rotate(void) {
+    segment_seal(&active);
+    int ret = segment_create(&active, next_number++);
+    enforce_cap();
+    return ret;
+}
+
+// Writes the header, the index and the data appended since the last sync through to disk
+static void segment_sync(segment_t *seg) {
+    uint64_t tail = seg->hdr->tail;
+    size_t from = (DATA_OFFSET + seg->synced) & ~(page_size - 1);
+    if (msync(seg->map, DATA_OFFSET, MS_SYNC) < 0 ||
+        msync(seg->map + from, DATA_OFFSET + tail - from, MS_SYNC) < 0) {
+        LOG_WARNING("Cannot sync journal segment: %s", strerror(errno));
+        return;
+    }
+    seg->synced = tail;
+}
+
+static void append(const neoinit_journal_record_t *rec) {
+    if (!active.map || active.hdr->tail + rec->size > DATA_CAPACITY) {
+        if (segment_rotate() != NEOINIT_OK) {
+            __atomic_fetch_add(&stats.dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    segment_header_t *hdr = active.hdr;
+    uint64_t off = hdr->tail;
+    memcpy(active.data + off, rec, rec->size);
+
+    uint64_t tbit = type_bit(rec->type), sbits[BLOOM_WORDS];
+    service_bits(rec->service_id, sbits);
+    index_entry_t *entry = &active.index[off / NEOINIT_JOURNAL_BLOCK_SIZE];
+    if (!entry->count) {
+        entry->offset = (uint32_t)off;
+        entry->usec_min = rec->usec;
+    }
+    entry->count++;
+    if (rec->usec < entry->usec_min) entry->usec_min = rec->usec;
+    if (rec->usec > entry->usec_max) entry->usec_max = rec->usec;
+    entry->type_mask |= tbit;
+    for (int i = 0; i < BLOOM_WORDS; i++) entry->service_bloom[i] |= sbits[i];
+
+    if (!hdr->records) hdr->seq_first = rec->seq;
+    hdr->seq_last = rec->seq;
+    hdr->records++;
+    if (rec->usec < hdr->usec_min) hdr->usec_min = rec->usec;
+    if (rec->usec > hdr->usec_max) hdr->usec_max = rec->usec;
+    hdr->type_mask |= tbit;
+    for (int i = 0; i < BLOOM_WORDS; i++) hdr->service_bloom[i] |= sbits[i];
+
+    // Queries read up to the tail, so it moves only once the record and its summary are in place
+    __atomic_store_n(&hdr->tail, off + rec->size, __ATOMIC_RELEASE);
+    __atomic_fetch_add(&stats.records, 1, __ATOMIC_RELAXED);
+
+    // An error may be the last thing recorded before the machine goes down
+    if (rec->priority <= NEOINIT_EVENT_PRIORITY_ERROR) segment_sync(&active);
+}
+
+static void drain(void) {
+    uint64_t head = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE);
+    uint64_t pos = ring_tail;
+
+    while (pos < head) {
+        uint64_t off = pos & RING_MASK;
+        if (NEOINIT_JOURNAL_RING_SIZE - off < HEADER_SIZE) {
+            pos += NEOINIT_JOURNAL_RING_SIZE - off;
+            continue;
+        }
+        const neoinit_journal_record_t *rec = (const neoinit_journal_record_t *)(ring + off);
+        if (rec->seq) append(rec);
+        pos += rec->size;
+    }
+    __atomic_store_n(&ring_tail, pos, __ATOMIC_RELEASE);
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    struct pollfd pfd = { .fd = wake_fd, .events = POLLIN };
+    bool stopping = false;
+    bool pending = false;
+    while (!stopping) {
+        if (!pending) poll(&pfd, 1, -1);
+        uint64_t v;
+        if (read(wake_fd, &v, sizeof(v)) < 0) {
+            // Nothing signalled: draining what arrived during the last batch
+        }
+        stopping = !writer_active;
+
+        pthread_mutex_lock(&flush_lock);
+        uint64_t target = flush_requested;
+        pthread_mutex_unlock(&flush_lock);
+
+        drain();
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        pending = __atomic_load_n(&ring_head, __ATOMIC_ACQUIRE) != ring_tail;
+
+        pthread_mutex_lock(&flush_lock);
+        flush_done = target;
+        pthread_cond_broadcast(&flush_cond);
+        pthread_mutex_unlock(&flush_lock);
+    }
+    segment_seal(&active);
+    return NULL;
+}
+
+static bool summary_matches(const query_plan_t *plan, uint64_t usec_min, uint64_t usec_max,
+                            uint64_t type_mask, const uint64_t *service_bloom) {
+    const neoinit_journal_query_t *q = plan->query;
+    if (q->since_usec && usec_max < q->since_usec) return false;
+    if (q->until_usec && usec_min > q->until_usec) return false;
+    if (plan->type_bit && !(type_mask & plan->type_bit)) return false;
+    for (int i = 0; i < BLOOM_WORDS; i++) {
+        if ((service_bloom[i] & plan->service_bits[i]) != plan->service_bits[i]) return false;
+    }
+    return true;
+}
+
+static bool record_matches(const query_plan_t *plan, const neoinit_journal_record_t *rec) {
+    const neoinit_journal_query_t *q = plan->query;
+    if (q->since_usec && rec->usec < q->since_usec) return false;
+    if (q->until_usec && rec->usec > q->until_usec) return false;
+    if (q->type >= 0 && rec->type != (uint32_t)q->type) return false;
+    if (!plan->service_id) return true;
+    return rec->service_id == plan->service_id && rec->service_len == plan->unit_len &&
+           memcmp(neoinit_journal_record_service(rec), q->unit, plan->unit_len) == 0;
+}
+
+// Returns true once the query is complete
+static bool scan_block(query_plan_t *plan, const unsigned char *data, uint64_t tail, uint32_t block,
+                       const index_entry_t *entry, neoinit_journal_match_fn fn, void *user_data) {
+    uint64_t off = entry->offset;
+    uint64_t end = (uint64_t)(block + 1) * NEOINIT_JOURNAL_BLOCK_SIZE;
+    while (off < end && off + HEADER_SIZE <= tail) {
+        const neoinit_journal_record_t *rec = (const neoinit_journal_record_t *)(data + off);
+        if (rec->size < HEADER_SIZE || off + rec->size > tail ||
+            HEADER_SIZE + rec->name_len + rec->service_len + rec->data_len > rec->size)
+            return false;
+
+        if (record_matches(plan, rec)) {
+            plan->matches++;
+            if (fn(rec, user_data) != 0) return true;
+            if (plan->query->limit && plan->matches >= plan->query->limit) return true;
+        }
+        off += rec->size;
+    }
+    return false;
+}
+
+// Returns true once the query is complete
+static bool scan_segment(query_plan_t *plan, uint32_t number, neoinit_journal_match_fn fn, void *user_data) {
+    char name[32];
+    segment_name(number, name, sizeof(name));
+    int fd = openat(dir_fd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+
+    segment_header_t hdr;
+    struct stat st;
+    if (pread(fd, &hdr, sizeof(hdr), 0) != sizeof(hdr) || !header_valid(&hdr) || fstat(fd, &st) < 0 ||
+        (uint64_t)st.st_size < DATA_OFFSET) {
+        close(fd);
+        return false;
+    }
+    uint32_t used = (uint32_t)((hdr.tail + NEOINIT_JOURNAL_BLOCK_SIZE - 1) / NEOINIT_JOURNAL_BLOCK_SIZE);
+    if (!hdr.records ||
+        !summary_matches(plan, hdr.usec_min, hdr.usec_max, hdr.type_mask, hdr.service_bloom)) {
+        __atomic_fetch_add(&stats.blocks_skipped, used, __ATOMIC_RELAXED);
+        close(fd);
+        return false;
+    }
+
+    // Sealing trims the file, but never below the tail read here
+    void *map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return false;
+
+    const segment_header_t *live = map;
+    const index_entry_t *index = (const index_entry_t *)((const unsigned char *)map + INDEX_OFFSET);
+    const unsigned char *data = (const unsigned char *)map + DATA_OFFSET;
+    uint64_t tail = __atomic_load_n(&live->tail, __ATOMIC_ACQUIRE);
+    if (tail > (uint64_t)st.st_size - DATA_OFFSET) tail = (uint64_t)st.st_size - DATA_OFFSET;
+    used = (uint32_t)((tail + NEOINIT_JOURNAL_BLOCK_SIZE - 1) / NEOINIT_JOURNAL_BLOCK_SIZE);
+
+    bool done = false;
+    uint64_t scanned = 0, skipped = 0;
+    for (uint32_t b = 0; b < used && !done; b++) {
+        const index_entry_t *entry = &index[b];
+        if (!entry->count || entry->offset >= tail ||
+            !summary_matches(plan, entry->usec_min, entry->usec_max, entry->type_mask, entry->service_bloom)) {
+            skipped++;
+            continue;
+        }
+        scanned++;
+        done = scan_block(plan, data, tail, b, entry, fn, user_data);
+    }
+    munmap(map, (size_t)st.st_size);
+
+    __atomic_fetch_add(&stats.blocks_scanned, scanned, __ATOMIC_RELAXED);
+    __atomic_fetch_add(&stats.blocks_skipped, skipped, __ATOMIC_RELAXED);
+    return done;
+}
+
+/*
+ * Walks the segments oldest first. Records that are still in the ring are
+ * not seen; call neoinit_journal_flush() first when that matters.
+ */
+int neoinit_journal_query(const neoinit_journal_query_t *query, neoinit_journal_match_fn fn, void *user_data) {
+    if (!query || !fn) return NEOINIT_ERROR_INVALID_ARG;
+    if (dir_fd < 0) return NEOINIT_ERROR_STATE;
+
+    query_plan_t plan = {
+        .query = query,
+        .type_bit = query->type >= 0 ? type_bit((uint32_t)query->type) : 0,
+        .service_id = neoinit_journal_service_id(query->unit),
+    };
+    service_bits(plan.service_id, plan.service_bits);
+    plan.unit_len = plan.service_id ? strlen(query->unit) : 0;
+
+    segment_file_t *files;
+    size_t count = segment_list(&files);
+    for (size_t i = 0; i < count; i++) {
+        if (scan_segment(&plan, files[i].number, fn, user_data)) break;
+    }
+    free(files);
+    return NEOINIT_OK;
+}
+
+int neoinit_journal_get_stats(neoinit_journal_stats_t *out) {
+    if (!out) return NEOINIT_ERROR_INVALID_ARG;
+    out->records = __atomic_load_n(&stats.records, __ATOMIC_RELAXED);
+    out->dropped = __atomic_load_n(&stats.dropped, __ATOMIC_RELAXED);
+    out->segments = __atomic_load_n(&stats.segments, __ATOMIC_RELAXED);
+    out->disk_bytes = __atomic_load_n(&stats.disk_bytes, __ATOMIC_RELAXED);
+    out->blocks_scanned = __atomic_load_n(&stats.blocks_scanned, __ATOMIC_RELAXED);
+    out->blocks_skipped = __atomic_load_n(&stats.blocks_skipped, __ATOMIC_RELAXED);
+    return NEOINIT_OK;
+}
+
+static int print_match(const neoinit_journal_record_t *rec, void *user_data) {
+    neoinit_control_conn_t *conn = user_data;
+    const char *data = neoinit_journal_record_data(rec);
+    int data_len = rec->data_len;
+    for (int i = 0; i < data_len; i++) {
+        if (!isprint((unsigned char)data[i])) {
+            data_len = 0;
+            break;
+        }
+    }
+    int ret = neoinit_control_printf(conn, "%llu.%06llu %s %s %.*s %.*s pid %d%s%.*s\n",
+                                     (unsigned long long)(rec->usec / 1000000ULL),
+                                     (unsigned long long)(rec->usec % 1000000ULL),
+                                     neoinit_event_type_to_string(rec->type),
+                                     neoinit_priority_to_string(rec->priority),
+                                     rec->service_len ? (int)rec->service_len : 1,
+                                     rec->service_len ? neoinit_journal_record_service(rec) : "-",
+                                     rec->name_len ? (int)rec->name_len : 1,
+                                     rec->name_len ? neoinit_journal_record_name(rec) : "-",
+                                     (int)rec->pid, data_len ? " " : "", data_len, data);
+    return ret == NEOINIT_OK ? 0 : 1;
+}
+
+static int cmd_journal(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)user_data;
+    if (argc > 1 && strcmp(argv[1], "stats") == 0) {
+        neoinit_journal_stats_t s;
+        neoinit_journal_get_stats(&s);
+        return neoinit_control_printf(conn, "records %llu dropped %llu segments %u disk_bytes %llu "
+                                      "blocks_scanned %llu blocks_skipped %llu\n",
+                                      (unsigned long long)s.records, (unsigned long long)s.dropped,
+                                      s.segments, (unsigned long long)s.disk_bytes,
+                                      (unsigned long long)s.blocks_scanned,
+                                      (unsigned long long)s.blocks_skipped);
+    }
+
+    neoinit_journal_query_t query = { .type = -1, .limit = QUERY_DEFAULT_LIMIT };
+    uint64_t now = realtime_usec();
+    for (int i = 1; i < argc; i++) {
+        char *value = strchr(argv[i], '=');
+        if (!value) return NEOINIT_ERROR_INVALID_ARG;
+        *value++ = '\0';
+
+        uint64_t span;
+        if (strcmp(argv[i], "type") == 0) {
+            query.type = neoinit_event_type_from_string(value);
+            if (query.type < 0) return NEOINIT_ERROR_INVALID_ARG;
+        } else if (strcmp(argv[i], "unit") == 0) {
+            query.unit = value;
+        } else if (strcmp(argv[i], "since") == 0 || strcmp(argv[i], "until") == 0) {
+            if (neoinit_timespan_parse(value, &span) != NEOINIT_OK) return NEOINIT_ERROR_INVALID_ARG;
+            uint64_t at = span < now ? now - span : 1;
+            if (argv[i][0] == 's') query.since_usec = at;
+            else query.until_usec = at;
+        } else if (strcmp(argv[i], "limit") == 0) {
+            query.limit = strtoull(value, NULL, 10);
+        } else {
+            return NEOINIT_ERROR_INVALID_ARG;
+        }
+    }
+
+    // Recent events are likely still in the ring
+    neoinit_journal_flush();
+    return neoinit_journal_query(&query, print_match, conn);
+}
+
+static void read_boot_id(void) {
+    boot_id[0] = '\0';
+    FILE *fp = fopen("/proc/sys/kernel/random/boot_id", "re");
+    if (!fp) return;
+    if (fgets(boot_id, sizeof(boot_id), fp)) boot_id[strcspn(boot_id, "\n")] = '\0';
+    fclose(fp);
+}
+
+static int make_dirs(const char *path) {
+    char buf[NEOINIT_MAX_PATH_LEN];
+    if (snprintf(buf, sizeof(buf), "%s", path) >= (int)sizeof(buf)) return NEOINIT_ERROR_INVALID_ARG;
+    for (char *p = buf + 1; *p; p++) {
+        if (*p != '/') continue;
+        *p = '\0';
+        mkdir(buf, 0755);
+        *p = '/';
+    }
+    return mkdir(buf, 0750) == 0 || errno == EEXIST ? NEOINIT_OK : NEOINIT_ERROR_IO;
+}
+
+// Trims segments a crash left open and picks the next segment number
+static void recover(void) {
+    segment_file_t *files;
+    size_t count = segment_list(&files);
+    for (size_t i = 0; i < count; i++) {
+        char name[32];
+        segment_name(files[i].number, name, sizeof(name));
+        int fd = openat(dir_fd, name, O_RDWR | O_CLOEXEC);
+        segment_header_t hdr;
+        if (fd >= 0 && pread(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr) && header_valid(&hdr) && !hdr.sealed) {
+            hdr.sealed = 1;
+            if (pwrite(fd, &hdr, sizeof(hdr), 0) == sizeof(hdr)) segment_trim(fd, hdr.tail);
+        }
+        if (fd >= 0) close(fd);
+    }
+    next_number = count ? files[count - 1].number + 1 : 0;
+    free(files);
+}
+
+int neoinit_journal_init(const char *dir, uint64_t max_bytes) {
+    if (writer_active) return NEOINIT_ERROR_BUSY;
+    if (!dir) dir = NEOINIT_JOURNAL_DIR;
+    max_size = max_bytes ? max_bytes : NEOINIT_JOURNAL_MAX_SIZE;
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    if (max_size < 2ULL * NEOINIT_JOURNAL_SEGMENT_SIZE) max_size = 2ULL * NEOINIT_JOURNAL_SEGMENT_SIZE;
+
+    int ret = make_dirs(dir);
+    if (ret != NEOINIT_OK) return ret;
+    dir_fd = open(dir, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd < 0) return NEOINIT_ERROR_IO;
+
+    read_boot_id();
+    recover();
+
+    // Every manager start gets a fresh segment
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    ret = wake_fd >= 0 ? segment_create(&active, next_number++) : NEOINIT_ERROR_SYSTEM;
+    if (ret == NEOINIT_OK) enforce_cap();
+
+    neoinit_event_handler_config_t handler = {
+        .handler = on_event,
+        .priority = NEOINIT_EVENT_PRIORITY_EMERGENCY,   // Recorded before any handler acts on it
+        .flags = NEOINIT_EVENT_FLAG_BROADCAST,
+        .name = "journal",
+    };
+    if (ret == NEOINIT_OK) ret = neoinit_handler_register(&handler);
+
+    writer_active = ret == NEOINIT_OK;
+    if (writer_active && pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        writer_active = false;
+        neoinit_handler_unregister("journal");
+        ret = NEOINIT_ERROR_SYSTEM;
+    }
+    if (ret != NEOINIT_OK) {
+        segment_seal(&active);
+        if (wake_fd >= 0) close(wake_fd);
+        close(dir_fd);
+        wake_fd = dir_fd = -1;
+        return ret;
+    }
+
+    neoinit_control_register("journal", cmd_journal, NULL);
+    return NEOINIT_OK;
+}
+
+void neoinit_journal_flush(void) {
+    if (!writer_active) return;
+
+    pthread_mutex_lock(&flush_lock);
+    uint64_t gen = ++flush_requested;
+    writer_wake();
+    while (flush_done < gen && writer_active) pthread_cond_wait(&flush_cond, &flush_lock);
+    pthread_mutex_unlock(&flush_lock);
+}
+
+void neoinit_journal_cleanup(void) {
+    if (!writer_active) return;
+    neoinit_handler_unregister("journal");
+
+    // The writer drains once more after seeing the flag drop, then seals the segment
+    writer_active = false;
+    writer_wake();
+    pthread_join(writer_thread, NULL);
+
+    pthread_mutex_lock(&flush_lock);
+    pthread_cond_broadcast(&flush_cond);
+    pthread_mutex_unlock(&flush_lock);
+
+    close(wake_fd);
+    close(dir_fd);
+    wake_fd = dir_fd = -1;
+}
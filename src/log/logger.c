@@ -0,0 +1,769 @@
+#define _GNU_SOURCE
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#define RING_MASK ((uint64_t)NEOINIT_LOG_RING_SIZE - 1)
+#define SLOT 8
+#define HEADER_SIZE ((uint32_t)sizeof(neoinit_log_record_t))
+#define SPEC_MAX 48
+#define LINE_MAX_LEN 4096
+#define OUT_BUF_SIZE 65536
+
+_Static_assert((NEOINIT_LOG_RING_SIZE & RING_MASK) == 0, "log ring size must be a power of two");
+_Static_assert(sizeof(neoinit_log_record_t) % SLOT == 0, "log record header must be slot aligned");
+
+typedef enum {
+    ARG_INT = 0,
+    ARG_LONG,
+    ARG_LLONG,
+    ARG_SIZE,
+    ARG_INTMAX,
+    ARG_PTRDIFF,
+    ARG_DOUBLE,
+    ARG_LDOUBLE,
+    ARG_PTR,
+    ARG_STR,
+    ARG_ERRNO,                      // %m, captured as a string
+    ARG_BAD,                        // Anything the packer cannot carry
+} arg_kind_t;
+
+typedef struct {
+    const char *start;
+    size_t len;
+    uint8_t stars;                  // '*' width and/or precision arguments
+    arg_kind_t kind;
+} spec_t;
+
+typedef struct log_ring {
+    unsigned char data[NEOINIT_LOG_RING_SIZE];
+    _Alignas(64) uint64_t head;     // Written by the owning thread only
+    _Alignas(64) uint64_t tail;     // Written by the writer only
+    uint64_t dropped;
+    uint64_t drained;               // Writer-private: tail to publish after a batch
+    pid_t tid;
+    uint16_t index;
+    struct log_ring *next;
+} log_ring_t;
+
+typedef struct {
+    const neoinit_log_record_t *rec;
+    const log_ring_t *ring;
+} batch_entry_t;
+
+volatile int neoinit_log_threshold = NEOINIT_LOG_INFO;
+
+static __thread log_ring_t *thread_ring;
+static log_ring_t *rings;
+static uint16_t ring_count;
+
+static volatile bool writer_active;
+static pthread_t writer_thread;
+static int wake_fd = -1;
+static int log_fd = -1;
+static uint64_t log_size;
+static char log_dir[NEOINIT_MAX_PATH_LEN];
+
+static pthread_mutex_t flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t flush_cond = PTHREAD_COND_INITIALIZER;
+static uint64_t flush_requested;
+static uint64_t flush_done;
+
+static const char *const level_names[] = {
+    [NEOINIT_LOG_EMERG] = "emerg",
+    [NEOINIT_LOG_ALERT] = "alert",
+    [NEOINIT_LOG_CRIT] = "crit",
+    [NEOINIT_LOG_ERROR] = "error",
+    [NEOINIT_LOG_WARNING] = "warning",
+    [NEOINIT_LOG_NOTICE] = "notice",
+    [NEOINIT_LOG_INFO] = "info",
+    [NEOINIT_LOG_DEBUG] = "debug",
+    [NEOINIT_LOG_TRACE] = "trace",
+};
+
+const char *neoinit_log_level_to_string(int level) {
+    return level >= NEOINIT_LOG_EMERG && level <= NEOINIT_LOG_TRACE ? level_names[level] : "unknown";
+}
+
+void neoinit_log_set_level(int level) {
+    if (level < NEOINIT_LOG_EMERG) level = NEOINIT_LOG_EMERG;
+    if (level > NEOINIT_LOG_TRACE) level = NEOINIT_LOG_TRACE;
+    neoinit_log_threshold = level;
+}
+
+int neoinit_log_get_level(void) {
+    return neoinit_log_threshold;
+}
+
+uint64_t neoinit_log_dropped(void) {
+    uint64_t dropped = 0;
+    for (log_ring_t *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = ring->next)
+        dropped += __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    return dropped;
+}
+
+static inline uint32_t slot_align(size_t n) {
+    return (uint32_t)((n + SLOT - 1) & ~(size_t)(SLOT - 1));
+}
+
+/*
+ * Returns the position just past the next conversion in a printf format,
+ * or NULL when there are none left. Shared by the packer and the writer so
+ * both walk the arguments identically.
+ */
+static const char *spec_next(const char *p, spec_t *spec) {
+    while ((p = strchr(p, '%'))) {
+        if (p[1] == '%') {
+            p += 2;
+            continue;
+        }
+
+        spec->start = p++;
+        spec->stars = 0;
+        while (*p && strchr("-+ #0'", *p)) p++;
+        if (*p == '*') {
+            spec->stars++;
+            p++;
+        }
+        while (*p >= '0' && *p <= '9') p++;
+        if (*p == '.') {
+            p++;
+            if (*p == '*') {
+                spec->stars++;
+                p++;
+            }
+            while (*p >= '0' && *p <= '9') p++;
+        }
+
+        arg_kind_t width = ARG_INT;
+        bool long_double = false, wide = false;
+        switch (*p) {
+            case 'h':
+                p += p[1] == 'h' ? 2 : 1;
+                break;
+            case 'l':
+                if (p[1] == 'l') {
+                    width = ARG_LLONG;
+                    p += 2;
+                } else {
+                    width = ARG_LONG;
+                    wide = true;
+                    p++;
+                }
+                break;
+            case 'q':
+                width = ARG_LLONG;
+                p++;
+                break;
+            case 'L':
+                long_double = true;
+                width = ARG_LLONG;
+                p++;
+                break;
+            case 'z':
+                width = ARG_SIZE;
+                p++;
+                break;
+            case 'j':
+                width = ARG_INTMAX;
+                p++;
+                break;
+            case 't':
+                width = ARG_PTRDIFF;
+                p++;
+                break;
+            default:
+                break;
+        }
+
+        switch (*p) {
+            case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+                spec->kind = width;
+                break;
+            case 'c':
+                spec->kind = wide ? ARG_BAD : ARG_INT;
+                break;
+            case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+                spec->kind = long_double ? ARG_LDOUBLE : ARG_DOUBLE;
+                break;
+            case 's':
+                spec->kind = wide ? ARG_BAD : ARG_STR;
+                break;
+            case 'p':
+                spec->kind = ARG_PTR;
+                break;
+            case 'm':
+                spec->kind = ARG_ERRNO;
+                break;
+            default:
+                spec->kind = ARG_BAD;
+                break;
+        }
+        if (*p) p++;
+        spec->len = (size_t)(p - spec->start);
+        return p;
+    }
+    return NULL;
+}
+
+static bool pack_bytes(unsigned char *buf, uint32_t *off, const void *src, size_t len) {
+    uint32_t need = slot_align(len);
+    if (*off + need > NEOINIT_LOG_MAX_RECORD) return false;
+    memcpy(buf + *off, src, len);
+    memset(buf + *off + len, 0, need - len);
+    *off += need;
+    return true;
+}
+
+static bool pack_string(unsigned char *buf, uint32_t *off, const char *s) {
+    if (!s) s = "(null)";
+
+    // Length slot, then the bytes; truncate to whatever room is left
+    if (*off + 2 * SLOT > NEOINIT_LOG_MAX_RECORD) return false;
+    size_t room = NEOINIT_LOG_MAX_RECORD - *off - SLOT - 1;
+    size_t len = strnlen(s, room);
+    uint64_t stored = len;
+    pack_bytes(buf, off, &stored, sizeof(stored));
+    memcpy(buf + *off, s, len);
+    memset(buf + *off + len, 0, slot_align(len + 1) - len);
+    *off += slot_align(len + 1);
+    return true;
+}
+
+// Packs the arguments after the header; false if the format cannot be carried
+static bool pack_args(unsigned char *buf, uint32_t *off, uint8_t *nargs, const char *fmt, va_list ap,
+                      int saved_errno) {
+    spec_t spec;
+    const char *p = fmt;
+    *nargs = 0;
+
+    while ((p = spec_next(p, &spec))) {
+        for (uint8_t s = 0; s < spec.stars; s++) {
+            int64_t v = va_arg(ap, int);
+            if (!pack_bytes(buf, off, &v, sizeof(v))) return false;
+        }
+
+        bool ok;
+        switch (spec.kind) {
+            case ARG_INT: {
+                int64_t v = va_arg(ap, int);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_LONG: {
+                int64_t v = va_arg(ap, long);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_LLONG: {
+                int64_t v = va_arg(ap, long long);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_SIZE: {
+                int64_t v = (int64_t)va_arg(ap, size_t);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_INTMAX: {
+                int64_t v = va_arg(ap, intmax_t);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_PTRDIFF: {
+                int64_t v = va_arg(ap, ptrdiff_t);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_DOUBLE: {
+                double v = va_arg(ap, double);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_LDOUBLE: {
+                long double v = va_arg(ap, long double);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_PTR: {
+                void *v = va_arg(ap, void *);
+                ok = pack_bytes(buf, off, &v, sizeof(v));
+                break;
+            }
+            case ARG_STR:
+                ok = pack_string(buf, off, va_arg(ap, const char *));
+                break;
+            case ARG_ERRNO: {
+                char err[128];
+                ok = pack_string(buf, off, strerror_r(saved_errno, err, sizeof(err)));
+                break;
+            }
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) return false;
+        (*nargs)++;
+    }
+    return true;
+}
+
+static log_ring_t *ring_create(void) {
+    log_ring_t *ring = aligned_alloc(64, sizeof(*ring));
+    if (!ring) return NULL;
+    memset(ring, 0, sizeof(*ring));
+    ring->tid = (pid_t)syscall(SYS_gettid);
+    ring->index = __atomic_fetch_add(&ring_count, 1, __ATOMIC_RELAXED);
+
+    // Rings are never freed, so a lock-free push onto the list is enough
+    ring->next = __atomic_load_n(&rings, __ATOMIC_RELAXED);
+    while (!__atomic_compare_exchange_n(&rings, &ring->next, ring, true,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+    return ring;
+}
+
+static void writer_wake(void) {
+    uint64_t one = 1;
+    if (wake_fd >= 0 && write(wake_fd, &one, sizeof(one)) != sizeof(one)) {
+        // Counter saturated: the writer is already due to run
+    }
+}
+
+/*
+ * Copies a record into the ring. A record never wraps: if it does not fit
+ * before the end, the tail of the ring is skipped, with a padding header
+ * when there is room for one.
+ */
+static bool ring_push(log_ring_t *ring, const unsigned char *rec, uint32_t size) {
+    uint64_t start = ring->head;
+    uint64_t head = start;
+    uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    uint64_t off = head & RING_MASK;
+    uint64_t contiguous = NEOINIT_LOG_RING_SIZE - off;
+    uint64_t pad = size > contiguous ? contiguous : 0;
+
+    if (head + pad + size - tail > NEOINIT_LOG_RING_SIZE) {
+        __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+        return false;
+    }
+    if (pad && pad >= HEADER_SIZE) {
+        neoinit_log_record_t skip = { .fmt = NULL, .size = (uint32_t)pad };
+        memcpy(ring->data + off, &skip, sizeof(skip));
+    }
+    head += pad;
+
+    memcpy(ring->data + (head & RING_MASK), rec, size);
+    __atomic_store_n(&ring->head, head + size, __ATOMIC_RELEASE);
+
+    /*
+     * The writer needs a wakeup when this record made the ring non-empty;
+     * otherwise it is already due. The fence pairs with the one in
+     * writer_main: either the writer sees this head, or this sees its tail.
+     */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->tail, __ATOMIC_RELAXED) == start) return true;
+
+    // Wake the writer early when crossing half full so bursts do not drop
+    return start - tail <= NEOINIT_LOG_RING_SIZE / 2 && head + size - tail > NEOINIT_LOG_RING_SIZE / 2;
+}
+
+static void log_sync(int level, const char *fmt, va_list ap) {
+    flockfile(stderr);
+    fprintf(stderr, "neoinit[%s]: ", neoinit_log_level_to_string(level));
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    funlockfile(stderr);
+}
+
+void neoinit_vlog(int level, const char *fmt, va_list ap) {
+    if (!fmt || !neoinit_log_enabled(level)) return;
+    int saved_errno = errno;
+
+    if (!writer_active) {
+        log_sync(level, fmt, ap);
+        errno = saved_errno;
+        return;
+    }
+
+    log_ring_t *ring = thread_ring;
+    if (!ring && !(ring = thread_ring = ring_create())) return;
+
+    _Alignas(8) unsigned char buf[NEOINIT_LOG_MAX_RECORD];
+    neoinit_log_record_t *rec = (neoinit_log_record_t *)buf;
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    *rec = (neoinit_log_record_t){
+        .timestamp = (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec,
+        .fmt = fmt,
+        .level = (uint8_t)level,
+        .thread = ring->index,
+    };
+
+    uint32_t off = HEADER_SIZE;
+    va_list copy;
+    va_copy(copy, ap);
+    if (!pack_args(buf, &off, &rec->nargs, fmt, copy, saved_errno)) {
+        // Unsupported conversion or oversized record: format it here instead
+        char line[NEOINIT_LOG_MAX_RECORD - HEADER_SIZE - SLOT];
+        errno = saved_errno;
+        vsnprintf(line, sizeof(line), fmt, ap);
+        off = HEADER_SIZE;
+        rec->fmt = "%s";
+        rec->nargs = 1;
+        pack_string(buf, &off, line);
+    }
+    va_end(copy);
+    rec->size = off;
+
+    bool wake = ring_push(ring, buf, off);
+    if (wake || level <= NEOINIT_LOG_ERROR) writer_wake();
+    errno = saved_errno;
+}
+
+void neoinit_log(int level, const char *fmt, ...) {
+    if (!neoinit_log_enabled(level)) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    neoinit_vlog(level, fmt, ap);
+    va_end(ap);
+}
+
+void neoinit_debug(const char *fmt, ...) {
+    if (!neoinit_log_enabled(NEOINIT_LOG_DEBUG)) return;
+
+    va_list ap;
+    va_start(ap, fmt);
+    neoinit_vlog(NEOINIT_LOG_DEBUG, fmt, ap);
+    va_end(ap);
+}
+
+static int64_t slot_int(const unsigned char **arg) {
+    int64_t v;
+    memcpy(&v, *arg, sizeof(v));
+    *arg += SLOT;
+    return v;
+}
+
+static const char *slot_string(const unsigned char **arg) {
+    uint64_t len;
+    memcpy(&len, *arg, sizeof(len));
+    const char *s = (const char *)*arg + SLOT;
+    *arg += SLOT + slot_align(len + 1);
+    return s;
+}
+
+static size_t format_record(const neoinit_log_record_t *rec, pid_t tid, char *out, size_t size) {
+    // Only the writer formats, so the per-second prefix can be cached
+    static time_t cached_sec = -1;
+    static char cached[32];
+    static size_t cached_len;
+    time_t sec = (time_t)(rec->timestamp / 1000000000ULL);
+    if (sec != cached_sec) {
+        struct tm tm;
+        localtime_r(&sec, &tm);
+        cached_len = strftime(cached, sizeof(cached), "%Y-%m-%dT%H:%M:%S", &tm);
+        cached_sec = sec;
+    }
+
+    size_t len = cached_len < size ? cached_len : 0;
+    memcpy(out, cached, len);
+    int n = snprintf(out + len, size - len, ".%06llu %s [%d] ",
+                     (unsigned long long)(rec->timestamp % 1000000000ULL / 1000),
+                     neoinit_log_level_to_string(rec->level), (int)tid);
+    if (n > 0) len += (size_t)n < size - len ? (size_t)n : size - len - 1;
+
+    const unsigned char *arg = (const unsigned char *)rec + HEADER_SIZE;
+    const char *p = rec->fmt;
+    spec_t spec;
+    char sp[SPEC_MAX];
+
+    for (;;) {
+        const char *lit = p;
+        const char *next = spec_next(p, &spec);
+        const char *lit_end = next ? spec.start : lit + strlen(lit);
+
+        // Literal text, collapsing "%%"
+        for (const char *c = lit; c < lit_end && len < size - 1; c++) {
+            out[len++] = *c;
+            if (c[0] == '%' && c[1] == '%') c++;
+        }
+        if (!next) break;
+
+        int star[2] = { 0, 0 };
+        for (uint8_t s = 0; s < spec.stars; s++) star[s] = (int)slot_int(&arg);
+
+        if (spec.len >= sizeof(sp)) spec.len = sizeof(sp) - 1;
+        memcpy(sp, spec.start, spec.len);
+        sp[spec.len] = '\0';
+
+        char *o = out + len;
+        size_t room = size - len;
+        n = 0;
+#define EMIT(value)                                                                  \
+    n = spec.stars == 0 ? snprintf(o, room, sp, value)                               \
+      : spec.stars == 1 ? snprintf(o, room, sp, star[0], value)                      \
+                        : snprintf(o, room, sp, star[0], star[1], value)
+        switch (spec.kind) {
+            case ARG_INT:
+                EMIT((int)slot_int(&arg));
+                break;
+            case ARG_LONG:
+                EMIT((long)slot_int(&arg));
+                break;
+            case ARG_LLONG:
+                EMIT((long long)slot_int(&arg));
+                break;
+            case ARG_SIZE:
+                EMIT((size_t)slot_int(&arg));
+                break;
+            case ARG_INTMAX:
+                EMIT((intmax_t)slot_int(&arg));
+                break;
+            case ARG_PTRDIFF:
+                EMIT((ptrdiff_t)slot_int(&arg));
+                break;
+            case ARG_DOUBLE: {
+                double v;
+                memcpy(&v, arg, sizeof(v));
+                arg += SLOT;
+                EMIT(v);
+                break;
+            }
+            case ARG_LDOUBLE: {
+                long double v;
+                memcpy(&v, arg, sizeof(v));
+                arg += slot_align(sizeof(v));
+                EMIT(v);
+                break;
+            }
+            case ARG_PTR: {
+                void *v;
+                memcpy(&v, arg, sizeof(v));
+                arg += SLOT;
+                EMIT(v);
+                break;
+            }
+            case ARG_STR:
+                EMIT(slot_string(&arg));
+                break;
+            case ARG_ERRNO:
+                n = snprintf(o, room, "%s", slot_string(&arg));
+                break;
+            default:
+                break;
+        }
+#undef EMIT
+        if (n > 0) len += (size_t)n < room ? (size_t)n : room - 1;
+        p = next;
+    }
+
+    if (len > size - 2) len = size - 2;
+    out[len++] = '\n';
+    return len;
+}
+
+static void log_open(void) {
+    char path[NEOINIT_MAX_PATH_LEN + sizeof(NEOINIT_LOG_FILE) + 1];
+    snprintf(path, sizeof(path), "%s/%s", log_dir, NEOINIT_LOG_FILE);
+
+    log_fd = open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0640);
+    struct stat st;
+    log_size = log_fd >= 0 && fstat(log_fd, &st) == 0 ? (uint64_t)st.st_size : 0;
+}
+
+static void log_rotate(void) {
+    char from[NEOINIT_MAX_PATH_LEN + sizeof(NEOINIT_LOG_FILE) + 16];
+    char to[sizeof(from)];
+
+    close(log_fd);
+    for (int i = NEOINIT_LOG_ROTATE_COUNT - 1; i >= 0; i--) {
+        if (i) snprintf(from, sizeof(from), "%s/%s.%d", log_dir, NEOINIT_LOG_FILE, i);
+        else snprintf(from, sizeof(from), "%s/%s", log_dir, NEOINIT_LOG_FILE);
+        snprintf(to, sizeof(to), "%s/%s.%d", log_dir, NEOINIT_LOG_FILE, i + 1);
+        rename(from, to);
+    }
+    log_open();
+}
+
+static void log_write(const char *buf, size_t len) {
+    if (!len) return;
+
+    if (log_fd >= 0 && log_size && log_size + len > NEOINIT_MAX_LOG_SIZE) log_rotate();
+    int fd = log_fd >= 0 ? log_fd : STDERR_FILENO;
+
+    while (len) {
+        ssize_t n = write(fd, buf, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return;
+        buf += n;
+        len -= (size_t)n;
+        log_size += (uint64_t)n;
+    }
+}
+
+static int batch_cmp(const void *a, const void *b) {
+    const batch_entry_t *x = a, *y = b;
+    if (x->rec->timestamp != y->rec->timestamp) return x->rec->timestamp < y->rec->timestamp ? -1 : 1;
+    return x->rec->thread < y->rec->thread ? -1 : x->rec->thread > y->rec->thread;
+}
+
+/*
+ * Collects every published record, orders the batch by time across
+ * threads, formats it into large writes, and only then releases the ring
+ * space the records occupied.
+ */
+static void drain(batch_entry_t **batch, size_t *batch_cap, char *out) {
+    size_t count = 0;
+    log_ring_t *first = __atomic_load_n(&rings, __ATOMIC_ACQUIRE);
+    log_ring_t *ring;
+
+    // Rings are pushed at the front, so later ones are simply not seen this round
+    for (ring = first; ring; ring = ring->next) {
+        uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+        uint64_t pos = ring->tail;
+
+        while (pos < head) {
+            uint64_t off = pos & RING_MASK;
+            if (NEOINIT_LOG_RING_SIZE - off < HEADER_SIZE) {
+                pos += NEOINIT_LOG_RING_SIZE - off;
+                continue;
+            }
+            const neoinit_log_record_t *rec = (const neoinit_log_record_t *)(ring->data + off);
+            if (rec->fmt) {
+                if (count == *batch_cap) {
+                    size_t cap = *batch_cap ? *batch_cap * 2 : 1024;
+                    batch_entry_t *grown = realloc(*batch, cap * sizeof(*grown));
+                    if (!grown) break;
+                    *batch = grown;
+                    *batch_cap = cap;
+                }
+                (*batch)[count++] = (batch_entry_t){ rec, ring };
+            }
+            pos += rec->size;
+        }
+        ring->drained = pos;
+    }
+
+    qsort(*batch, count, sizeof(**batch), batch_cmp);
+
+    size_t len = 0;
+    for (size_t i = 0; i < count; i++) {
+        if (OUT_BUF_SIZE - len < LINE_MAX_LEN) {
+            log_write(out, len);
+            len = 0;
+        }
+        len += format_record((*batch)[i].rec, (*batch)[i].ring->tid, out + len, LINE_MAX_LEN);
+    }
+    log_write(out, len);
+
+    for (ring = first; ring; ring = ring->next) __atomic_store_n(&ring->tail, ring->drained, __ATOMIC_RELEASE);
+}
+
+// Records pushed while the last batch was formatted, whose producers saw a busy ring
+static bool rings_pending(void) {
+    for (log_ring_t *ring = __atomic_load_n(&rings, __ATOMIC_ACQUIRE); ring; ring = ring->next) {
+        if (__atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) != ring->tail) return true;
+    }
+    return false;
+}
+
+static void *writer_main(void *arg) {
+    (void)arg;
+    batch_entry_t *batch = NULL;
+    size_t batch_cap = 0;
+    char *out = malloc(OUT_BUF_SIZE);
+    if (!out) return NULL;
+
+    struct pollfd pfd = { .fd = wake_fd, .events = POLLIN };
+    bool stopping = false;
+    bool pending = false;
+    while (!stopping) {
+        if (!pending) poll(&pfd, 1, -1);
+        uint64_t v;
+        if (read(wake_fd, &v, sizeof(v)) < 0) {
+            // Nothing signalled: draining what arrived during the last batch
+        }
+        stopping = !writer_active;
+
+        pthread_mutex_lock(&flush_lock);
+        uint64_t target = flush_requested;
+        pthread_mutex_unlock(&flush_lock);
+
+        drain(&batch, &batch_cap, out);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        pending = rings_pending();
+
+        pthread_mutex_lock(&flush_lock);
+        flush_done = target;
+        pthread_cond_broadcast(&flush_cond);
+        pthread_mutex_unlock(&flush_lock);
+    }
+
+    free(batch);
+    free(out);
+    return NULL;
+}
+
+int neoinit_log_init(const char *dir) {
+    if (writer_active) return NEOINIT_ERROR_BUSY;
+    if (!dir) dir = NEOINIT_LOG_DIR;
+    if (strlen(dir) >= sizeof(log_dir)) return NEOINIT_ERROR_INVALID_ARG;
+    snprintf(log_dir, sizeof(log_dir), "%s", dir);
+
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wake_fd < 0) return NEOINIT_ERROR_SYSTEM;
+
+    // Without a writable log directory, records still go out through stderr
+    mkdir(log_dir, 0755);
+    log_open();
+
+    writer_active = true;
+    if (pthread_create(&writer_thread, NULL, writer_main, NULL) != 0) {
+        writer_active = false;
+        if (log_fd >= 0) close(log_fd);
+        close(wake_fd);
+        log_fd = wake_fd = -1;
+        return NEOINIT_ERROR_SYSTEM;
+    }
+    return NEOINIT_OK;
+}
+
+void neoinit_log_flush(void) {
+    if (!writer_active) return;
+
+    pthread_mutex_lock(&flush_lock);
+    uint64_t gen = ++flush_requested;
+    writer_wake();
+    while (flush_done < gen && writer_active) pthread_cond_wait(&flush_cond, &flush_lock);
+    pthread_mutex_unlock(&flush_lock);
+}
+
+void neoinit_log_cleanup(void) {
+    if (!writer_active) return;
+
+    // The writer drains once more after seeing the flag drop
+    writer_active = false;
+    writer_wake();
+    pthread_join(writer_thread, NULL);
+
+    pthread_mutex_lock(&flush_lock);
+    pthread_cond_broadcast(&flush_cond);
+    pthread_mutex_unlock(&flush_lock);
+
+    if (log_fd >= 0) close(log_fd);
+    close(wake_fd);
+    log_fd = wake_fd = -1;
+}
@@ -0,0 +1,381 @@
+#define _GNU_SOURCE
+#include "neoinit/output.h"
+#include "neoinit/events.h"
+#include "neoinit/socket.h"
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+
+#define SPLICE_CHUNK (64 * 1024)
+#define SPLICES_PER_WAKEUP 16
+
+typedef struct {
+    int sock;
+    int pipe[2];                    // tee() target, spliced on to sock
+} output_follower_t;
+
+struct neoinit_output {
+    neoinit_unit_t *unit;
+    int pipe_fd;                    // Read end of the unit's stdout/stderr
+    int file_fd;
+    loff_t file_off;                // splice() cannot append, so track the offset
+    uint64_t tokens;
+    uint64_t refilled;              // When the bucket was last topped up, ns
+    uint64_t written;
+    uint64_t suppressed;
+    uint64_t unreported;            // Suppressed since the last marker
+    bool throttled;                 // Discarding until the bucket is half full again
+    uint32_t follower_count;
+    output_follower_t followers[NEOINIT_OUTPUT_MAX_FOLLOWERS];
+};
+
+typedef struct neoinit_output neoinit_output_t;
+
+static int null_fd = -1;
+
+static void output_path(const neoinit_unit_t *unit, int generation, char *buf, size_t size) {
+    const char *dir = unit->tmpl->logs_dir ? unit->tmpl->logs_dir : NEOINIT_LOG_DIR;
+    if (generation) snprintf(buf, size, "%s/%s.log.%d", dir, unit->name, generation);
+    else snprintf(buf, size, "%s/%s.log", dir, unit->name);
+
+    // Unit names are flat; keep a stray '/' from escaping the directory
+    size_t dir_len = strlen(dir);
+    if (strlen(buf) <= dir_len) return;
+    for (char *p = buf + dir_len + 1; *p; p++) {
+        if (*p == '/') *p = '_';
+    }
+}
+
+static void file_rotate(neoinit_output_t *out);
+
+static void file_open(neoinit_output_t *out, bool truncate) {
+    char path[NEOINIT_MAX_PATH_LEN];
+    output_path(out->unit, 0, path, sizeof(path));
+    mkdir(out->unit->tmpl->logs_dir ? out->unit->tmpl->logs_dir : NEOINIT_LOG_DIR, 0755);
+
+    out->file_fd = open(path, O_WRONLY | O_CREAT | O_CLOEXEC | (truncate ? O_TRUNC : 0), 0640);
+    if (out->file_fd < 0) {
+        LOG_WARNING("Cannot open %s, discarding output of %s", path, out->unit->name);
+        out->file_fd = null_fd;
+        out->file_off = 0;
+        return;
+    }
+    off_t end = lseek(out->file_fd, 0, SEEK_END);
+    out->file_off = end > 0 ? end : 0;
+    if (out->file_off >= NEOINIT_MAX_LOG_SIZE) file_rotate(out);
+}
+
+static void file_rotate(neoinit_output_t *out) {
+    char from[NEOINIT_MAX_PATH_LEN];
+    char to[NEOINIT_MAX_PATH_LEN];
+
+    if (out->file_fd != null_fd) close(out->file_fd);
+    for (int i = NEOINIT_LOG_ROTATE_COUNT - 1; i >= 0; i--) {
+        output_path(out->unit, i, from, sizeof(from));
+        output_path(out->unit, i + 1, to, sizeof(to));
+        rename(from, to);
+    }
+    file_open(out, true);
+}
+
+static uint64_t budget(neoinit_output_t *out) {
+    uint64_t rate = out->unit->tmpl->output_rate;
+    if (!rate) return UINT64_MAX;
+    uint64_t burst = out->unit->tmpl->output_burst ? out->unit->tmpl->output_burst : rate;
+
+    uint64_t now = neoinit_get_monotonic_time();
+    uint64_t elapsed = now - out->refilled;
+    if (elapsed >= burst * 1000000000ULL / rate) {
+        out->tokens = burst;
+        out->refilled = now;
+    } else {
+        // Advance only by whole bytes so slow trickles are not rounded away
+        uint64_t add = elapsed * rate / 1000000000ULL;
+        out->tokens = out->tokens + add < burst ? out->tokens + add : burst;
+        out->refilled += add * 1000000000ULL / rate;
+    }
+
+    // Hysteresis: one marker per flood instead of one per refilled byte
+    if (!out->tokens) out->throttled = true;
+    else if (out->throttled && out->tokens >= burst / 2) out->throttled = false;
+    return out->throttled ? 0 : out->tokens;
+}
+
+static void report_suppressed(neoinit_output_t *out) {
+    char msg[NEOINIT_MAX_NAME_LEN + 96];
+    int len = snprintf(msg, sizeof(msg), "neoinit: suppressed %llu bytes of output from %s\n",
+                       (unsigned long long)out->unreported, out->unit->name);
+    LOG_NOTICE("Output of %s rate limited, %llu bytes suppressed", out->unit->name,
+               (unsigned long long)out->unreported);
+    out->unreported = 0;
+
+    if (len > 0 && out->file_fd != null_fd) {
+        ssize_t n = pwrite(out->file_fd, msg, (size_t)len, out->file_off);
+        if (n > 0) out->file_off += n;
+    }
+}
+
+static void follower_drop(neoinit_output_t *out, uint32_t i) {
+    output_follower_t *f = &out->followers[i];
+    close(f->sock);
+    close(f->pipe[0]);
+    close(f->pipe[1]);
+    out->followers[i] = out->followers[--out->follower_count];
+}
+
+static void followers_flush(neoinit_output_t *out) {
+    for (uint32_t i = 0; i < out->follower_count;) {
+        ssize_t n;
+        do {
+            n = splice(out->followers[i].pipe[0], NULL, out->followers[i].sock, NULL,
+                       NEOINIT_OUTPUT_PIPE_SIZE, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+        } while (n > 0);
+
+        if (n < 0 && errno != EAGAIN) {
+            follower_drop(out, i);
+            continue;
+        }
+        i++;
+    }
+}
+
+/*
+ * Duplicates up to len bytes into every follower's pipe without consuming
+ * them. The amount actually copied to the first follower caps the rest, so
+ * the file and every follower see the same bytes; a follower whose pipe
+ * cannot take them has fallen behind and is disconnected.
+ */
+static size_t followers_tee(neoinit_output_t *out, size_t len) {
+    for (uint32_t i = 0; i < out->follower_count;) {
+        ssize_t n = tee(out->pipe_fd, out->followers[i].pipe[1], len, SPLICE_F_NONBLOCK);
+        if (n < 0 && errno == EAGAIN) {
+            int pending = 0;
+            if (ioctl(out->pipe_fd, FIONREAD, &pending) == -1 || pending == 0) return len;
+        }
+        if (n <= 0 || (i && (size_t)n < len)) {
+            follower_drop(out, i);
+            continue;
+        }
+        len = (size_t)n;
+        i++;
+    }
+    return len;
+}
+
+static void output_release(neoinit_output_t *out) {
+    if (out->unreported) report_suppressed(out);
+
+    neoinit_events_unwatch(out->pipe_fd);
+    close(out->pipe_fd);
+    if (out->file_fd != null_fd) close(out->file_fd);
+    while (out->follower_count) follower_drop(out, 0);
+
+    if (out->unit->output == out) out->unit->output = NULL;
+    free(out);
+}
+
+static int on_output(int fd, uint32_t events, void *user_data) {
+    neoinit_output_t *out = user_data;
+    (void)events;
+
+    followers_flush(out);
+    for (int i = 0; i < SPLICES_PER_WAKEUP; i++) {
+        uint64_t avail = budget(out);
+        ssize_t n;
+
+        if (!avail) {
+            n = splice(fd, NULL, null_fd, NULL, SPLICE_CHUNK, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                out->suppressed += (uint64_t)n;
+                out->unreported += (uint64_t)n;
+                continue;
+            }
+        } else {
+            if (out->unreported) report_suppressed(out);
+
+            size_t len = avail < SPLICE_CHUNK ? (size_t)avail : SPLICE_CHUNK;
+            if (out->file_fd != null_fd && NEOINIT_MAX_LOG_SIZE - out->file_off < (loff_t)len) {
+                len = (size_t)(NEOINIT_MAX_LOG_SIZE - out->file_off);
+            }
+            if (out->follower_count) len = followers_tee(out, len);
+
+            n = splice(fd, NULL, out->file_fd, out->file_fd == null_fd ? NULL : &out->file_off,
+                       len, SPLICE_F_MOVE | SPLICE_F_NONBLOCK);
+            if (n > 0) {
+                if (out->unit->tmpl->output_rate) out->tokens -= (uint64_t)n;
+                out->written += (uint64_t)n;
+                if (out->file_off >= NEOINIT_MAX_LOG_SIZE) file_rotate(out);
+                continue;
+            }
+        }
+
+        // End of file: the unit and everything it forked have closed the pipe
+        if (n == 0) {
+            output_release(out);
+            return NEOINIT_OK;
+        }
+        break;
+    }
+    followers_flush(out);
+    return NEOINIT_OK;
+}
+
+static int follower_prepare(neoinit_unit_t *unit, int fds[2]) {
+    if (!unit->output) return NEOINIT_ERROR_STATE;
+    if (unit->output->follower_count == NEOINIT_OUTPUT_MAX_FOLLOWERS) return NEOINIT_ERROR_RESOURCE;
+
+    if (pipe2(fds, O_CLOEXEC | O_NONBLOCK) == -1) return NEOINIT_ERROR_SYSTEM;
+    fcntl(fds[0], F_SETPIPE_SZ, NEOINIT_OUTPUT_PIPE_SIZE);
+    return NEOINIT_OK;
+}
+
+static void follower_attach(neoinit_output_t *out, int sock, const int fds[2]) {
+    output_follower_t *f = &out->followers[out->follower_count++];
+    f->sock = sock;
+    f->pipe[0] = fds[0];
+    f->pipe[1] = fds[1];
+}
+
+int neoinit_output_follow(neoinit_unit_t *unit, int sock) {
+    if (!unit || sock < 0) return NEOINIT_ERROR_INVALID_ARG;
+
+    int fds[2];
+    int ret = follower_prepare(unit, fds);
+    if (ret == NEOINIT_OK) follower_attach(unit->output, sock, fds);
+    return ret;
+}
+
+// After the "0 0" reply the connection carries the raw output stream
+static int cmd_follow(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)user_data;
+    if (argc < 2) return NEOINIT_ERROR_INVALID_ARG;
+
+    neoinit_unit_t *unit = neoinit_unit_lookup(argv[1]);
+    if (!unit) return NEOINIT_ERROR_NOT_FOUND;
+
+    // Everything that can fail happens before the socket leaves the control loop
+    int fds[2];
+    int ret = follower_prepare(unit, fds);
+    if (ret == NEOINIT_OK) follower_attach(unit->output, neoinit_control_detach(conn), fds);
+    return ret;
+}
+
+int neoinit_output_init(void) {
+    if (null_fd < 0) {
+        null_fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+        if (null_fd < 0) return NEOINIT_ERROR_SYSTEM;
+    }
+    return neoinit_control_register("follow", cmd_follow, NULL);
+}
+
+// Wraps the read end of a capture pipe; takes ownership of fd only on success
+static neoinit_output_t *output_new(neoinit_unit_t *unit, int fd) {
+    neoinit_output_t *out = calloc(1, sizeof(*out));
+    if (!out) return NULL;
+
+    out->unit = unit;
+    out->pipe_fd = fd;
+    out->tokens = unit->tmpl->output_burst;
+    out->refilled = neoinit_get_monotonic_time();
+    file_open(out, false);
+
+    if (neoinit_events_watch(fd, EPOLLIN, on_output, out) != NEOINIT_OK) {
+        if (out->file_fd != null_fd) close(out->file_fd);
+        free(out);
+        return NULL;
+    }
+    return out;
+}
+
+int neoinit_output_open(neoinit_unit_t *unit, int *child_fd) {
+    if (!unit || !child_fd) return NEOINIT_ERROR_INVALID_ARG;
+    if (null_fd < 0) return NEOINIT_ERROR_STATE;
+
+    // Only the manager's end is non-blocking; the unit's writes block normally
+    int fds[2];
+    if (pipe2(fds, O_CLOEXEC) == -1) return NEOINIT_ERROR_SYSTEM;
+    fcntl(fds[0], F_SETFL, O_NONBLOCK);
+    fcntl(fds[0], F_SETPIPE_SZ, NEOINIT_OUTPUT_PIPE_SIZE);
+
+    /*
+     * A restart keeps its followers. The previous pipe is drained and closed
+     * before the file is reopened, so the new instance appends after the
+     * last words of the old one instead of writing over them.
+     */
+    output_follower_t held[NEOINIT_OUTPUT_MAX_FOLLOWERS];
+    uint32_t held_count = 0;
+    neoinit_output_t *prev = unit->output;
+    if (prev) {
+        held_count = prev->follower_count;
+        memcpy(held, prev->followers, held_count * sizeof(*held));
+        prev->follower_count = 0;
+        on_output(prev->pipe_fd, EPOLLIN, prev);
+        if (unit->output == prev) output_release(prev);
+    }
+
+    neoinit_output_t *out = output_new(unit, fds[0]);
+    if (!out) {
+        close(fds[0]);
+        close(fds[1]);
+        for (uint32_t i = 0; i < held_count; i++) {
+            close(held[i].sock);
+            close(held[i].pipe[0]);
+            close(held[i].pipe[1]);
+        }
+        return NEOINIT_ERROR_SYSTEM;
+    }
+    memcpy(out->followers, held, held_count * sizeof(*held));
+    out->follower_count = held_count;
+
+    unit->output = out;
+    *child_fd = fds[1];
+    return NEOINIT_OK;
+}
+
+/*
+ * Resumes capture from a pipe inherited across a re-exec. Whatever the
+ * unit wrote during the handover is still buffered in the pipe.
+ */
+int neoinit_output_adopt(neoinit_unit_t *unit, int fd) {
+    if (!unit || fd < 0) return NEOINIT_ERROR_INVALID_ARG;
+    if (null_fd < 0) return NEOINIT_ERROR_STATE;
+    if (unit->output) return NEOINIT_ERROR_BUSY;
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+
+    neoinit_output_t *out = output_new(unit, fd);
+    if (!out) return NEOINIT_ERROR_SYSTEM;
+    unit->output = out;
+    return NEOINIT_OK;
+}
+
+int neoinit_output_fd(const neoinit_unit_t *unit) {
+    return unit && unit->output ? unit->output->pipe_fd : -1;
+}
+
+void neoinit_output_close(neoinit_unit_t *unit) {
+    neoinit_output_t *out = unit ? unit->output : NULL;
+    if (!out) return;
+
+    on_output(out->pipe_fd, EPOLLIN, out);
+    if (unit->output == out) output_release(out);
+}
+
+int neoinit_output_get_stats(const neoinit_unit_t *unit, neoinit_output_stats_t *stats) {
+    if (!unit || !stats) return NEOINIT_ERROR_INVALID_ARG;
+    memset(stats, 0, sizeof(*stats));
+    if (!unit->output) return NEOINIT_ERROR_STATE;
+
+    stats->written = unit->output->written;
+    stats->suppressed = unit->output->suppressed;
+    stats->followers = unit->output->follower_count;
+    return NEOINIT_OK;
+}
@@ -0,0 +1,7 @@
+#include "neoinit.h"
+
+// Brings the manager up and runs it until shutdown; as PID 1 this never returns
+int main(void) {
+    initialize_system();
+    return neoinit_core_run();
+}
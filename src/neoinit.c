@@ -1,41 +1,32 @@
+#define _GNU_SOURCE
 #include "neoinit.h"
+#include "neoinit/log.h"
+#include "neoinit/service.h"
+#include "neoinit/shutdown.h"
+#include "neoinit/readahead.h"
+#include "neoinit/trace.h"
+#include "neoinit/events.h"
+#include "neoinit/metrics.h"
+#include "neoinit/socket.h"
+#include "neoinit/output.h"
+#include "neoinit/state.h"
+#include "neoinit/admission.h"
+#include "neoinit/timer.h"
+#include "neoinit/path.h"
+#include "neoinit/netlink.h"
+#include "neoinit/cgroup.h"
+#include "neoinit/journal.h"
 #include <fcntl.h>
 #include <sys/stat.h>
-#include <sys/socket.h>
-#include <sys/un.h>
 #include <errno.h>
 #include <pthread.h>
 #include <sys/eventfd.h>
 #include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
 
-#define MAX_DEPS 32
-#define MAX_EVENTS 64
 #define SOCKET_PATH "/run/neoinit.sock"
 
-typedef struct {
-    char **deps;
-    int dep_count;
-    int wants_count;
-    char **wants;
-    int conflicts_count;
-    char **conflicts;
-    int restart_attempts;
-    time_t start_time;
-    time_t stop_time;
-    pthread_mutex_t lock;
-    int notification_fd;
-    bool enabled;
-    bool critical;
-    int exit_status;
-    char *working_directory;
-    char **environment;
-    int env_count;
-    int restart_delay;
-    int watchdog_usec;
-    int timeout_start_usec;
-    int timeout_stop_usec;
-} service_extra_t;
-
 typedef enum {
     EVENT_NONE = 0,
     EVENT_START,
@@ -45,205 +36,875 @@ typedef enum {
     EVENT_STATUS_CHANGE
 } service_event_t;
 
-static service_extra_t service_extras[MAX_SERVICES];
-static int epoll_fd;
 static pthread_t event_thread;
 static volatile bool running = true;
-static int socket_fd;
+static volatile bool reexec_requested;
+static volatile neoinit_shutdown_action_t shutdown_requested;
+static int signal_fd = -1;
+
+static int start_service_with_deps(const char *service_name);
+static int stop_service_with_deps(const char *service_name);
+static int restart_service_with_deps(const char *service_name);
+static void handle_status_change(neoinit_unit_t *unit);
+static void stop_done(neoinit_unit_t *unit);
+static void stop_timer_disarm(neoinit_unit_t *unit);
+static void reexec_system(void);
+static int final_shutdown(neoinit_shutdown_action_t action);
 
 static void *event_loop(void *arg) {
-    struct epoll_event events[MAX_EVENTS];
-    
-    while (running) {
-        int nfds = epoll_wait(epoll_fd, events, MAX_EVENTS, -1);
-        for (int i = 0; i < nfds; i++) {
-            service_event_t event = events[i].events;
-            int service_idx = events[i].data.u32;
-            
-            pthread_mutex_lock(&service_extras[service_idx].lock);
-            switch (event) {
-                case EVENT_START:
-                    if (service_extras[service_idx].enabled) {
-                        start_service_with_deps(services[service_idx].name);
-                    }
-                    break;
-                case EVENT_STOP:
-                    stop_service_with_deps(services[service_idx].name);
-                    break;
-                case EVENT_RESTART:
-                    restart_service_with_deps(services[service_idx].name);
-                    break;
-                case EVENT_STATUS_CHANGE:
-                    handle_status_change(service_idx);
-                    break;
-            }
-            pthread_mutex_unlock(&service_extras[service_idx].lock);
+    (void)arg;
+    while (neoinit_events_dispatch() == NEOINIT_OK && running) {
+        if (shutdown_requested != NEOINIT_SHUTDOWN_NONE) {
+            final_shutdown(shutdown_requested);
+            break;
         }
+        if (!reexec_requested) break;
+        reexec_requested = false;
+        reexec_system();
     }
     return NULL;
 }
 
-static int init_socket() {
-    socket_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
-    if (socket_fd == -1) return -1;
-
-    struct sockaddr_un addr = {
-        .sun_family = AF_UNIX,
+static void emit_unit_event(const neoinit_unit_t *unit, neoinit_event_type_t type,
+                            neoinit_event_priority_t priority, const char *detail) {
+    neoinit_event_t event = {
+        .type = type,
+        .priority = priority,
+        .flags = NEOINIT_EVENT_FLAG_INTERNAL,
     };
-    strncpy(addr.sun_path, SOCKET_PATH, sizeof(addr.sun_path) - 1);
+    snprintf(event.target.service, sizeof(event.target.service), "%s", unit->name);
+    event.target.pid = unit->pid;
+    event.target.id = unit->id;
+    if (detail) {
+        snprintf(event.data.buf, sizeof(event.data.buf), "%s", detail);
+        event.data.size = strlen(event.data.buf);
+    }
+    neoinit_event_emit(&event);
+}
 
-    unlink(SOCKET_PATH);
-    if (bind(socket_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
-        close(socket_fd);
-        return -1;
+static void release_notification(neoinit_unit_t *unit) {
+    if (unit->notification_fd < 0) return;
+    neoinit_events_unwatch(unit->notification_fd);
+    close(unit->notification_fd);
+    unit->notification_fd = -1;
+}
+
+/*
+ * A unit's notification eventfd carries service_event_t codes written by
+ * the unit or by other parts of the manager.
+ */
+static int on_unit_notify(int fd, uint32_t events, void *user_data) {
+    neoinit_unit_t *unit = user_data;
+    uint64_t value;
+
+    if (!(events & EPOLLIN) || read(fd, &value, sizeof(value)) != sizeof(value)) return 0;
+
+    pthread_mutex_lock(&unit->lock);
+    if (unit->tmpl->type == NEOINIT_SERVICE_TYPE_NOTIFY) {
+        neoinit_trace_record(unit->id, NEOINIT_TRACE_READY);
+        neoinit_admission_ready(unit);
+    }
+    switch ((service_event_t)value) {
+        case EVENT_START:
+            if (unit->enabled) {
+                start_service_with_deps(unit->name);
+            }
+            break;
+        case EVENT_STOP:
+            stop_service_with_deps(unit->name);
+            break;
+        case EVENT_RESTART:
+            restart_service_with_deps(unit->name);
+            break;
+        case EVENT_STATUS_CHANGE:
+            handle_status_change(unit);
+            break;
+        default:
+            break;
     }
+    pthread_mutex_unlock(&unit->lock);
+    return 0;
+}
 
-    if (listen(socket_fd, SOMAXCONN) == -1) {
-        close(socket_fd);
-        return -1;
+// The last process of a unit's tree is gone; daemons may outlive their main pid
+static void on_cgroup_empty(neoinit_unit_t *unit) {
+    if (unit->pid <= 0) neoinit_cgroup_close(unit);
+}
+
+static int on_sigchld(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    (void)user_data;
+    struct signalfd_siginfo info;
+
+    while (read(fd, &info, sizeof(info)) == sizeof(info)) {
     }
+    uint64_t woke = neoinit_get_monotonic_time();
+
+    // Once shutdown starts, the shutdown engine does its own reaping
+    if (!running) return 0;
 
+    int status;
+    pid_t pid;
+    while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        neoinit_metrics_inc(NEOINIT_COUNTER_REAPS);
+        neoinit_unit_t *unit = neoinit_unit_by_pid(pid);
+        if (!unit) continue;
+
+        pthread_mutex_lock(&unit->lock);
+        bool expected = unit->state == NEOINIT_SERVICE_STOPPING;
+        // A live process already marked failed overran its start timeout; its exit code cannot undo that
+        bool timed_out = unit->state == NEOINIT_SERVICE_FAILED;
+        bool clean = !timed_out && WIFEXITED(status) && WEXITSTATUS(status) == 0;
+        bool held = unit->stop_pending;
+
+        char detail[32];
+        if (WIFSIGNALED(status)) snprintf(detail, sizeof(detail), "signal %d", WTERMSIG(status));
+        else snprintf(detail, sizeof(detail), "status %d", WEXITSTATUS(status));
+        emit_unit_event(unit, expected ? NEOINIT_EVENT_SERVICE_STOP :
+                              clean ? NEOINIT_EVENT_SERVICE_EXIT : NEOINIT_EVENT_SERVICE_FAIL,
+                        expected || clean ? NEOINIT_EVENT_PRIORITY_INFO : NEOINIT_EVENT_PRIORITY_ERROR, detail);
+        if (expected) {
+            // Whatever the main process forked off and left behind
+            stop_timer_disarm(unit);
+            neoinit_cgroup_kill(unit, SIGKILL);
+        }
+        unit->stop_pending = false;
+        neoinit_unit_set_pid(unit, 0);
+        release_notification(unit);
+        unit->exit_code = status;
+        unit->stop_time = time(NULL);
+        unit->state = expected || clean ? NEOINIT_SERVICE_STOPPED : NEOINIT_SERVICE_FAILED;
+        neoinit_admission_ready(unit);
+        neoinit_metrics_observe(NEOINIT_HIST_REAP_LATENCY, neoinit_get_monotonic_time() - woke);
+
+        if (!neoinit_cgroup_populated(unit)) neoinit_cgroup_close(unit);
+
+        if (unit->state == NEOINIT_SERVICE_FAILED) {
+            handle_status_change(unit);
+        }
+        bool inactive = unit->state != NEOINIT_SERVICE_RUNNING;
+        pthread_mutex_unlock(&unit->lock);
+
+        if (expected || held) stop_done(unit);
+        if (inactive) neoinit_path_unit_inactive(unit->name);
+    }
     return 0;
 }
 
-static int start_service_with_deps(const char *service_name) {
-    int service_idx = find_service_idx(service_name);
-    if (service_idx == -1) return -1;
+/*
+ * The child may be created with a raw clone3() and must not allocate, so
+ * the unit's environment is merged into a fresh envp in the parent.
+ * Template entries override inherited variables of the same name.
+ */
+static char **build_envp(const neoinit_template_t *tmpl) {
+    size_t inherited = 0;
+    while (environ[inherited]) inherited++;
 
-    service_extra_t *extra = &service_extras[service_idx];
-    
-    for (int i = 0; i < extra->dep_count; i++) {
-        if (start_service_with_deps(extra->deps[i]) != 0) {
-            return -1;
+    char **envp = malloc((inherited + tmpl->env_count + 1) * sizeof(*envp));
+    if (!envp) return NULL;
+
+    size_t n = 0;
+    for (size_t i = 0; i < inherited; i++) {
+        size_t key = strcspn(environ[i], "=");
+        bool overridden = false;
+        for (uint32_t j = 0; j < tmpl->env_count && !overridden; j++) {
+            overridden = strncmp(tmpl->environment[j], environ[i], key) == 0 &&
+                         tmpl->environment[j][key] == '=';
         }
+        if (!overridden) envp[n++] = environ[i];
     }
+    for (uint32_t j = 0; j < tmpl->env_count; j++) envp[n++] = tmpl->environment[j];
+    envp[n] = NULL;
+    return envp;
+}
 
-    if (services[service_idx].status == SERVICE_RUNNING) {
-        return 0;
+// The timestamp arrives just before execve(); a bare hangup means the child died first
+// Startup stamps that follow exec are only taken once the child got that far
+static void trace_started(const neoinit_unit_t *unit) {
+    if (unit->tmpl->type != NEOINIT_SERVICE_TYPE_NOTIFY) {
+        neoinit_trace_record(unit->id, NEOINIT_TRACE_READY);
     }
+    neoinit_trace_record(unit->id, NEOINIT_TRACE_RUNNING);
+}
 
-    pid_t pid = fork();
-    if (pid == 0) {
-        if (extra->working_directory) {
-            chdir(extra->working_directory);
+static int on_trace_pipe(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    uint32_t id = (uint32_t)(uintptr_t)user_data;
+    uint64_t ts;
+    if (read(fd, &ts, sizeof(ts)) == sizeof(ts)) {
+        neoinit_trace_record_at(id, NEOINIT_TRACE_EXEC, ts);
+        const neoinit_unit_t *unit = neoinit_unit_get(id);
+        if (unit) trace_started(unit);
+    }
+    neoinit_events_unwatch(fd);
+    close(fd);
+    return NEOINIT_OK;
+}
+
+static int spawn_unit(neoinit_unit_t *unit) {
+    neoinit_template_t *tmpl = unit->tmpl;
+    char argv_buf[NEOINIT_MAX_ARGS][NEOINIT_MAX_NAME_LEN];
+    char *argv[NEOINIT_MAX_ARGS + 1];
+    int argc = 0;
+
+    if (tmpl->exec_argv) {
+        for (; tmpl->exec_argv[argc] && argc < NEOINIT_MAX_ARGS; argc++) {
+            if (neoinit_unit_expand(unit, tmpl->exec_argv[argc], argv_buf[argc],
+                                    sizeof(argv_buf[argc])) != NEOINIT_OK) {
+                return -1;
+            }
+            argv[argc] = argv_buf[argc];
         }
+    } else {
+        argv[argc++] = unit->name;
+    }
+    argv[argc] = NULL;
+
+    char **envp = tmpl->env_count ? build_envp(tmpl) : environ;
+    if (!envp) return -1;
+
+    unit->notification_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (unit->notification_fd == -1) {
+        if (envp != environ) free(envp);
+        return -1;
+    }
+
+    // Without a cgroup the unit is spawned with fork() and signalled by pid
+    if (neoinit_cgroup_enabled() && neoinit_cgroup_open(unit) != NEOINIT_OK) {
+        LOG_WARNING("Starting %s outside a cgroup", unit->name);
+    }
+
+    // stdout/stderr go to a pipe drained by the manager; /dev/null if that fails
+    int output_fd = -1;
+    if (neoinit_output_open(unit, &output_fd) != NEOINIT_OK) output_fd = -1;
+
+    // The child reports its pre-exec timestamp; the pipe closes on exec
+    int trace_pipe[2] = { -1, -1 };
+    if (neoinit_trace_enabled() && pipe2(trace_pipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+        trace_pipe[0] = trace_pipe[1] = -1;
+    }
 
-        for (int i = 0; i < extra->env_count; i++) {
-            putenv(extra->environment[i]);
+    neoinit_trace_record(unit->id, NEOINIT_TRACE_FORK);
+    uint64_t fork_start = neoinit_get_monotonic_time();
+    pid_t pid = neoinit_cgroup_fork(unit);
+    if (pid == 0) {
+        sigset_t none;
+        sigemptyset(&none);
+        sigprocmask(SIG_SETMASK, &none, NULL);
+        signal(SIGPIPE, SIG_DFL);
+
+        if (tmpl->working_directory) {
+            chdir(tmpl->working_directory);
         }
 
         int null_fd = open("/dev/null", O_RDWR);
         dup2(null_fd, STDIN_FILENO);
-        dup2(null_fd, STDOUT_FILENO);
-        dup2(null_fd, STDERR_FILENO);
+        dup2(output_fd >= 0 ? output_fd : null_fd, STDOUT_FILENO);
+        dup2(output_fd >= 0 ? output_fd : null_fd, STDERR_FILENO);
         close(null_fd);
 
         setsid();
 
-        execlp(service_name, service_name, NULL);
-        exit(EXIT_FAILURE);
-    } else if (pid > 0) {
-        services[service_idx].pid = pid;
-        services[service_idx].status = SERVICE_RUNNING;
-        extra->start_time = time(NULL);
+        if (trace_pipe[1] >= 0) {
+            uint64_t ts = neoinit_get_monotonic_time();
+            write(trace_pipe[1], &ts, sizeof(ts));
+        }
+
+        execvpe(argv[0], argv, envp);
+        _exit(EXIT_FAILURE);
+    }
+
+    if (envp != environ) free(envp);
+    if (output_fd >= 0) close(output_fd);
+
+    // Waiting here would hold the loop until the child is done with chdir() and friends
+    bool traced = false;
+    if (trace_pipe[1] >= 0) {
+        close(trace_pipe[1]);
+        traced = pid > 0 && neoinit_events_watch(trace_pipe[0], EPOLLIN, on_trace_pipe,
+                                                 (void *)(uintptr_t)unit->id) == NEOINIT_OK;
+        if (!traced) close(trace_pipe[0]);
+    }
+
+    if (pid > 0) {
+        neoinit_metrics_inc(NEOINIT_COUNTER_FORKS);
+        neoinit_metrics_observe(NEOINIT_HIST_FORK_EXEC_LATENCY, neoinit_get_monotonic_time() - fork_start);
+        neoinit_unit_set_pid(unit, pid);
+        unit->state = NEOINIT_SERVICE_RUNNING;
+        unit->start_time = time(NULL);
+        if (!traced) trace_started(unit);
+        emit_unit_event(unit, NEOINIT_EVENT_SERVICE_START, NEOINIT_EVENT_PRIORITY_INFO, NULL);
         
-        struct epoll_event ev = {
-            .events = EPOLLIN | EPOLLOUT,
-            .data.u32 = service_idx
-        };
-        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, extra->notification_fd, &ev);
+        neoinit_events_watch(unit->notification_fd, EPOLLIN, on_unit_notify, unit);
         
         return 0;
     }
+
+    neoinit_metrics_inc(NEOINIT_COUNTER_FORK_FAILURES);
+    neoinit_output_close(unit);
+    close(unit->notification_fd);
+    unit->notification_fd = -1;
     return -1;
 }
 
-static int stop_service_with_deps(const char *service_name) {
-    int service_idx = find_service_idx(service_name);
-    if (service_idx == -1) return -1;
+static int start_service_with_deps(const char *service_name) {
+    neoinit_unit_t *unit = neoinit_unit_instantiate(service_name);
+    // A Requires= that cannot be resolved fails the start rather than being skipped
+    if (!unit || neoinit_unit_link(unit) != NEOINIT_OK) return -1;
 
-    service_extra_t *extra = &service_extras[service_idx];
+    /*
+     * Walk the dependency closure iteratively and spawn in post-order.
+     * Each unit is visited once per walk, so shared dependencies are not
+     * re-entered and deep chains cannot overflow the stack.
+     */
+    uint32_t epoch = neoinit_registry_next_epoch();
+    size_t cap = 64, depth = 0;
+    struct { neoinit_unit_t *unit; uint32_t next; } *stack = malloc(cap * sizeof(*stack));
+    if (!stack) return -1;
 
-    for (int i = 0; i < service_count; i++) {
-        service_extra_t *dep_extra = &service_extras[i];
-        for (int j = 0; j < dep_extra->dep_count; j++) {
-            if (strcmp(dep_extra->deps[j], service_name) == 0) {
-                stop_service_with_deps(services[i].name);
+    int ret = 0;
+    unit->visit_epoch = epoch;
+    stack[depth++] = (typeof(*stack)){ unit, 0 };
+    if (unit->state != NEOINIT_SERVICE_RUNNING) {
+        neoinit_trace_record(unit->id, NEOINIT_TRACE_QUEUED);
+    }
+
+    while (depth) {
+        neoinit_unit_t *cur = stack[depth - 1].unit;
+
+        if (stack[depth - 1].next < cur->dep_count) {
+            neoinit_unit_t *dep = neoinit_unit_get(cur->dep_ids[stack[depth - 1].next++]);
+            if (dep->visit_epoch == epoch) continue;
+            dep->visit_epoch = epoch;
+            if (neoinit_unit_link(dep) != NEOINIT_OK) {
+                ret = -1;
+                break;
+            }
+            if (dep->state != NEOINIT_SERVICE_RUNNING) {
+                neoinit_trace_record(dep->id, NEOINIT_TRACE_QUEUED);
+            }
+
+            if (depth == cap) {
+                void *grown = realloc(stack, cap * 2 * sizeof(*stack));
+                if (!grown) {
+                    ret = -1;
+                    break;
+                }
+                stack = grown;
+                cap *= 2;
             }
+            stack[depth++] = (typeof(*stack)){ dep, 0 };
+            continue;
         }
+
+        depth--;
+        if (cur->state == NEOINIT_SERVICE_STOPPING || cur->stop_pending) {
+            // The old process is still going; start_pending picks the start up once it has
+            cur->start_pending = true;
+            continue;
+        }
+        if (cur->state == NEOINIT_SERVICE_RUNNING || cur->admission != NEOINIT_ADMISSION_NONE) continue;
+        if (neoinit_admission_submit(cur) != NEOINIT_OK) {
+            ret = -1;
+            break;
+        }
+    }
+
+    free(stack);
+    return ret;
+}
+
+static bool is_trigger_unit(const neoinit_unit_t *unit) {
+    return unit->tmpl->type == NEOINIT_SERVICE_TYPE_TIMER || unit->tmpl->type == NEOINIT_SERVICE_TYPE_PATH;
+}
+
+// Timer and path units arm or disarm the trigger of the same name
+static int set_trigger(neoinit_unit_t *unit, bool arm) {
+    if (unit->tmpl->type == NEOINIT_SERVICE_TYPE_TIMER) {
+        neoinit_timer_t *timer = neoinit_timer_lookup(unit->name);
+        return arm ? neoinit_timer_arm(timer) : neoinit_timer_disarm(timer);
     }
+    neoinit_path_t *path = neoinit_path_lookup(unit->name);
+    return arm ? neoinit_path_arm(path) : neoinit_path_disarm(path);
+}
 
-    if (services[service_idx].status == SERVICE_STOPPED) {
+// Called by the admission controller once a unit's dependencies are up
+static int launch_unit(neoinit_unit_t *unit) {
+    neoinit_trace_record(unit->id, NEOINIT_TRACE_DEPS_SATISFIED);
+
+    // Starting a trigger unit spawns nothing
+    if (is_trigger_unit(unit)) {
+        if (set_trigger(unit, true) != NEOINIT_OK) return -1;
+        unit->state = NEOINIT_SERVICE_RUNNING;
+        unit->start_time = time(NULL);
+        neoinit_trace_record(unit->id, NEOINIT_TRACE_RUNNING);
         return 0;
     }
+    return spawn_unit(unit);
+}
 
-    if (kill(services[service_idx].pid, SIGTERM) == 0) {
-        alarm(extra->timeout_stop_usec / 1000000);
-        int status;
-        waitpid(services[service_idx].pid, &status, 0);
-        alarm(0);
-        
-        services[service_idx].status = SERVICE_STOPPED;
-        services[service_idx].exit_code = status;
-        extra->stop_time = time(NULL);
-        
-        struct epoll_event ev;
-        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, extra->notification_fd, &ev);
-        
+// Timers, paths and device rules start their target unit through here
+static int activate_unit(const char *unit, void *user_data) {
+    (void)user_data;
+    return start_service_with_deps(unit);
+}
+
+static bool unit_active(const neoinit_unit_t *unit) {
+    return unit->pid > 0 && unit->state != NEOINIT_SERVICE_STOPPED &&
+           unit->state != NEOINIT_SERVICE_INACTIVE && unit->state != NEOINIT_SERVICE_FAILED;
+}
+
+// A unit is only signalled once everything that requires it is gone
+static bool rdeps_stopping(const neoinit_unit_t *unit) {
+    for (uint32_t i = 0; i < unit->rdep_count; i++) {
+        const neoinit_unit_t *rdep = neoinit_unit_get(unit->rdep_ids[i]);
+        if (rdep->state == NEOINIT_SERVICE_STOPPING || rdep->stop_pending) return true;
+    }
+    return false;
+}
+
+static void stop_timer_disarm(neoinit_unit_t *unit) {
+    if (unit->stop_timer_fd < 0) return;
+    neoinit_events_unwatch(unit->stop_timer_fd);
+    close(unit->stop_timer_fd);
+    unit->stop_timer_fd = -1;
+}
+
+static void stop_escalate(neoinit_unit_t *unit) {
+    LOG_WARNING("Unit %s did not stop in time, sending SIGKILL", unit->name);
+    if (neoinit_cgroup_kill(unit, SIGKILL) != NEOINIT_OK) kill(unit->pid, SIGKILL);
+}
+
+static int on_stop_timeout(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    neoinit_unit_t *unit = user_data;
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return NEOINIT_OK;
+
+    stop_timer_disarm(unit);
+    if (unit->state == NEOINIT_SERVICE_STOPPING && unit->pid > 0) stop_escalate(unit);
+    return NEOINIT_OK;
+}
+
+// The SIGKILL deadline; on_sigchld finishes the stop whichever signal ends it
+static void stop_timer_arm(neoinit_unit_t *unit) {
+    uint64_t timeout = unit->tmpl->timeout_stop_usec > 0 ? (uint64_t)unit->tmpl->timeout_stop_usec : 0;
+    struct itimerspec its = {
+        .it_value = { .tv_sec = timeout / 1000000, .tv_nsec = (timeout % 1000000) * 1000 },
+    };
+    if (!timeout) its.it_value.tv_nsec = 1;
+
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0 || timerfd_settime(fd, 0, &its, NULL) < 0 ||
+        neoinit_events_watch(fd, EPOLLIN, on_stop_timeout, unit) != NEOINIT_OK) {
+        if (fd >= 0) close(fd);
+        // Nothing would ever escalate, so do not wait at all
+        stop_escalate(unit);
+        return;
+    }
+    unit->stop_timer_fd = fd;
+}
+
+/*
+ * Sends SIGTERM the way the shutdown engine does: tree-wide for KillMode
+ * units, otherwise to the main process. The stop completes asynchronously
+ * when on_sigchld reaps it.
+ */
+static int stop_signal(neoinit_unit_t *unit) {
+    neoinit_service_state_t prev = unit->state;
+    unit->stop_pending = false;
+    unit->state = NEOINIT_SERVICE_STOPPING;
+
+    // A frozen tree cannot act on SIGTERM
+    neoinit_cgroup_freeze(unit, false);
+    bool tree = (unit->tmpl->flags & NEOINIT_FLAG_KILL_MODE) &&
+                neoinit_cgroup_kill(unit, SIGTERM) == NEOINIT_OK;
+    if (kill(unit->pid, tree ? 0 : SIGTERM) == -1) {
+        unit->state = prev;
+        return -1;
+    }
+    kill(unit->pid, SIGCONT);
+    stop_timer_arm(unit);
+    return 0;
+}
+
+// Releases dependencies held back by this unit, then a start queued behind the stop
+static void stop_done(neoinit_unit_t *unit) {
+    for (uint32_t i = 0; i < unit->dep_count; i++) {
+        neoinit_unit_t *dep = neoinit_unit_get(unit->dep_ids[i]);
+        if (!dep->stop_pending || rdeps_stopping(dep)) continue;
+        if (unit_active(dep)) {
+            stop_signal(dep);
+        } else {
+            dep->stop_pending = false;
+            stop_done(dep);
+        }
+    }
+
+    if (unit->start_pending) {
+        unit->start_pending = false;
+        start_service_with_deps(unit->name);
+    }
+}
+
+static int stop_unit(neoinit_unit_t *unit) {
+    unit->start_pending = false;
+    if (unit->admission == NEOINIT_ADMISSION_QUEUED) {
+        neoinit_admission_cancel(unit);
         return 0;
     }
-    return -1;
+    if (is_trigger_unit(unit) && unit->state == NEOINIT_SERVICE_RUNNING) {
+        set_trigger(unit, false);
+        unit->state = NEOINIT_SERVICE_STOPPED;
+        unit->stop_time = time(NULL);
+        return 0;
+    }
+    if (unit->state == NEOINIT_SERVICE_STOPPING) return 0;
+    if (!unit_active(unit)) {
+        // A daemon that forked away from its main pid leaves its tree behind
+        neoinit_cgroup_kill(unit, SIGKILL);
+        if (unit->stop_pending) {
+            unit->stop_pending = false;
+            stop_done(unit);
+        }
+        return 0;
+    }
+    if (rdeps_stopping(unit)) {
+        unit->stop_pending = true;
+        return 0;
+    }
+    return stop_signal(unit);
 }
 
-static void handle_status_change(int service_idx) {
-    service_extra_t *extra = &service_extras[service_idx];
+static int stop_service_with_deps(const char *service_name) {
+    neoinit_unit_t *unit = neoinit_unit_lookup(service_name);
+    if (!unit) return -1;
+
+    /*
+     * Stop reverse dependencies first. The reverse edges are indexed, so
+     * this only touches units that actually require the one being stopped.
+     */
+    uint32_t epoch = neoinit_registry_next_epoch();
+    size_t cap = 64, depth = 0;
+    struct { neoinit_unit_t *unit; uint32_t next; } *stack = malloc(cap * sizeof(*stack));
+    if (!stack) return -1;
+
+    int ret = 0;
+    unit->visit_epoch = epoch;
+    stack[depth++] = (typeof(*stack)){ unit, 0 };
+
+    while (depth) {
+        neoinit_unit_t *cur = stack[depth - 1].unit;
+
+        if (stack[depth - 1].next < cur->rdep_count) {
+            neoinit_unit_t *rdep = neoinit_unit_get(cur->rdep_ids[stack[depth - 1].next++]);
+            if (rdep->visit_epoch == epoch) continue;
+            rdep->visit_epoch = epoch;
+
+            if (depth == cap) {
+                void *grown = realloc(stack, cap * 2 * sizeof(*stack));
+                if (!grown) {
+                    ret = -1;
+                    break;
+                }
+                stack = grown;
+                cap *= 2;
+            }
+            stack[depth++] = (typeof(*stack)){ rdep, 0 };
+            continue;
+        }
+
+        depth--;
+        if (stop_unit(cur) != 0) ret = -1;
+    }
+
+    free(stack);
+    return ret;
+}
+
+static int restart_service_with_deps(const char *service_name) {
+    if (stop_service_with_deps(service_name) != 0) return -1;
+    return start_service_with_deps(service_name);
+}
+
+static void handle_status_change(neoinit_unit_t *unit) {
+    neoinit_template_t *tmpl = unit->tmpl;
     
-    if (services[service_idx].status == SERVICE_FAILED && extra->critical) {
-        LOG_ERROR("Critical service %s failed, initiating shutdown", 
-                  services[service_idx].name);
+    if (unit->state == NEOINIT_SERVICE_FAILED && (tmpl->flags & NEOINIT_FLAG_CRITICAL)) {
+        LOG_ERROR("Critical service %s failed, initiating shutdown", unit->name);
         emergency_shutdown();
     }
 
-    if (services[service_idx].status == SERVICE_FAILED && 
-        extra->restart_attempts < 3) {
-        extra->restart_attempts++;
-        sleep(extra->restart_delay);
-        start_service_with_deps(services[service_idx].name);
+    if (unit->state == NEOINIT_SERVICE_FAILED && unit->restart_attempts < 3) {
+        unit->restart_attempts++;
+        sleep(tmpl->restart_delay);
+        start_service_with_deps(unit->name);
     }
 }
 
+static int cmd_start(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)conn;
+    (void)user_data;
+    if (argc < 2) return NEOINIT_ERROR_INVALID_ARG;
+    return start_service_with_deps(argv[1]) == 0 ? NEOINIT_OK : NEOINIT_ERROR;
+}
+
+static int cmd_stop(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)conn;
+    (void)user_data;
+    if (argc < 2) return NEOINIT_ERROR_INVALID_ARG;
+    return stop_service_with_deps(argv[1]) == 0 ? NEOINIT_OK : NEOINIT_ERROR;
+}
+
+static int cmd_restart(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)conn;
+    (void)user_data;
+    if (argc < 2) return NEOINIT_ERROR_INVALID_ARG;
+    return restart_service_with_deps(argv[1]) == 0 ? NEOINIT_OK : NEOINIT_ERROR;
+}
+
+static int cmd_status(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)user_data;
+    if (argc < 2) return NEOINIT_ERROR_INVALID_ARG;
+
+    neoinit_unit_t *unit = neoinit_unit_lookup(argv[1]);
+    if (!unit) return NEOINIT_ERROR_NOT_FOUND;
+    return neoinit_control_printf(conn, "%s %s %d\n", unit->name,
+                                  neoinit_state_to_string(unit->state), (int)unit->pid);
+}
+
+// Runs once the reply has been flushed and the loop has returned
+static int cmd_reexec(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)conn;
+    (void)argc;
+    (void)argv;
+    (void)user_data;
+    reexec_requested = true;
+    return neoinit_events_stop();
+}
+
+// "halt", "poweroff" and "reboot"; like reexec, the work starts once the loop has returned
+static int cmd_shutdown(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)conn;
+    (void)argc;
+    (void)argv;
+    shutdown_requested = (neoinit_shutdown_action_t)(uintptr_t)user_data;
+    return neoinit_events_stop();
+}
+
+/*
+ * Replaces the manager binary in place. Units keep running; their pids,
+ * eventfds and output pipes are handed to the new image. Only returns if
+ * the exec failed, with the manager still fully operational.
+ */
+static void reexec_system(void) {
+    LOG_NOTICE("Re-executing manager with %zu units", neoinit_registry_count());
+    neoinit_readahead_stop();
+    neoinit_journal_cleanup();
+    neoinit_log_cleanup();
+
+    int ret = neoinit_state_reexec(NULL);
+
+    neoinit_log_init(NEOINIT_LOG_DIR);
+    neoinit_journal_init(NEOINIT_JOURNAL_DIR, 0);
+    LOG_ERROR("Re-exec failed (%d), continuing with the running image", ret);
+}
+
+static int resume_system(void) {
+    neoinit_state_stats_t stats = { 0 };
+    int ret = neoinit_state_restore(&stats);
+    if (ret != NEOINIT_OK) return ret;
+
+    // The handlers live here, so the eventfds are re-watched by the manager itself
+    neoinit_unit_t *unit;
+    for (uint32_t id = 0; (unit = neoinit_unit_get(id)); id++) {
+        if (unit->notification_fd >= 0) {
+            neoinit_events_watch(unit->notification_fd, EPOLLIN, on_unit_notify, unit);
+        }
+        // Cgroups outlive the old image; reopen them by name
+        if (unit->pid > 0 && neoinit_cgroup_enabled()) neoinit_cgroup_open(unit);
+        // The old image's SIGKILL deadline is gone; a stop in progress gets a fresh one
+        if (unit->state == NEOINIT_SERVICE_STOPPING && unit->pid > 0) stop_timer_arm(unit);
+    }
+
+    // Children that exited during the handover are still waiting to be reaped
+    on_sigchld(signal_fd, EPOLLIN, NULL);
+
+    LOG_NOTICE("Resumed %u units, %u descriptors, %llu bytes of state in %llu us",
+               stats.units, stats.fds, (unsigned long long)stats.bytes,
+               (unsigned long long)stats.elapsed_usec);
+    return NEOINIT_OK;
+}
+
 void initialize_system(void) {
-    epoll_fd = epoll_create1(0);
-    if (epoll_fd == -1) {
+    // Block SIGCHLD before any thread exists so only the signalfd sees it
+    sigset_t mask;
+    sigemptyset(&mask);
+    sigaddset(&mask, SIGCHLD);
+    pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+    // A follower hanging up mid-splice() must cost EPIPE, not the manager
+    signal(SIGPIPE, SIG_IGN);
+
+    if (neoinit_log_init(NEOINIT_LOG_DIR) != NEOINIT_OK) {
+        LOG_WARNING("Log writer unavailable, logging synchronously to stderr");
+    }
+
+    neoinit_trace_enable(true);
+
+    // Warm the page cache before anything is scheduled; pointless after a re-exec
+    bool resuming = neoinit_state_pending();
+    if (!resuming) {
+        neoinit_readahead_start("default", neoinit_readahead_fingerprint(NEOINIT_SERVICES_DIR));
+    }
+
+    if (neoinit_events_init() != NEOINIT_OK) {
         LOG_ERROR("Failed to create epoll instance");
         exit(EXIT_FAILURE);
     }
 
-    if (init_socket() == -1) {
+    signal_fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (signal_fd == -1 || neoinit_events_watch(signal_fd, EPOLLIN, on_sigchld, NULL) != NEOINIT_OK) {
+        LOG_ERROR("Failed to watch SIGCHLD");
+        exit(EXIT_FAILURE);
+    }
+
+    neoinit_control_register("start", cmd_start, NULL);
+    neoinit_control_register("stop", cmd_stop, NULL);
+    neoinit_control_register("restart", cmd_restart, NULL);
+    neoinit_control_register("status", cmd_status, NULL);
+    neoinit_control_register("reexec", cmd_reexec, NULL);
+    neoinit_control_register("halt", cmd_shutdown, (void *)(uintptr_t)NEOINIT_SHUTDOWN_HALT);
+    neoinit_control_register("poweroff", cmd_shutdown, (void *)(uintptr_t)NEOINIT_SHUTDOWN_POWEROFF);
+    neoinit_control_register("reboot", cmd_shutdown, (void *)(uintptr_t)NEOINIT_SHUTDOWN_REBOOT);
+    if (neoinit_output_init() != NEOINIT_OK) {
+        LOG_WARNING("Unit output capture unavailable");
+    }
+    if (neoinit_journal_init(NEOINIT_JOURNAL_DIR, 0) != NEOINIT_OK) {
+        LOG_WARNING("Event journal unavailable under %s", NEOINIT_JOURNAL_DIR);
+    }
+
+    if (neoinit_cgroup_init(on_cgroup_empty) != NEOINIT_OK) {
+        LOG_WARNING("No writable cgroup v2 hierarchy, stopping units by pid");
+    }
+
+    if (neoinit_registry_init(NEOINIT_MAX_SERVICES) != NEOINIT_OK) {
+        LOG_ERROR("Failed to initialize unit registry");
+        exit(EXIT_FAILURE);
+    }
+    if (neoinit_admission_init(launch_unit) != NEOINIT_OK) {
+        LOG_ERROR("Failed to initialize admission control");
+        exit(EXIT_FAILURE);
+    }
+    if (neoinit_timer_init(activate_unit, NULL) != NEOINIT_OK) {
+        LOG_WARNING("Timer engine unavailable, timer units will not fire");
+    } else {
+        int timers = neoinit_timer_load(NEOINIT_TIMERS_DIR);
+        if (timers > 0) LOG_INFO("Armed %d timers from %s", timers, NEOINIT_TIMERS_DIR);
+    }
+    if (neoinit_path_init(activate_unit, NULL) != NEOINIT_OK) {
+        LOG_WARNING("inotify unavailable, path units will not fire");
+    } else {
+        int paths = neoinit_path_load(NEOINIT_PATHS_DIR);
+        if (paths > 0) LOG_INFO("Armed %d path units from %s", paths, NEOINIT_PATHS_DIR);
+    }
+    if (neoinit_netlink_init(activate_unit, NULL) != NEOINIT_OK) {
+        LOG_WARNING("Netlink engine unavailable, device rules will not fire");
+    } else {
+        int rules = neoinit_netlink_load(NEOINIT_DEVICES_DIR);
+        if (rules > 0) LOG_INFO("Loaded %d device rules from %s", rules, NEOINIT_DEVICES_DIR);
+        // Units a resumed manager already started for present devices keep running
+        if (!resuming) neoinit_netlink_coldplug();
+    }
+
+    // A resumed manager keeps the listening socket, so clients never see it missing
+    if (resuming && resume_system() != NEOINIT_OK) {
+        LOG_CRIT("Failed to resume from saved state, running units are unsupervised");
+    }
+
+    const char *socket_path = getenv(NEOINIT_CONTROL_SOCKET_ENV);
+    if (neoinit_control_fd() < 0 &&
+        neoinit_control_init(socket_path && *socket_path ? socket_path : SOCKET_PATH) != NEOINIT_OK) {
         LOG_ERROR("Failed to initialize control socket");
         exit(EXIT_FAILURE);
     }
 
-    for (int i = 0; i < MAX_SERVICES; i++) {
-        pthread_mutex_init(&service_extras[i].lock, NULL);
-        service_extras[i].notification_fd = eventfd(0, EFD_NONBLOCK);
-        service_extras[i].enabled = true;
-        service_extras[i].restart_delay = 1;
-        service_extras[i].timeout_start_usec = 90000000;
-        service_extras[i].timeout_stop_usec = 90000000;
+    if (!resuming) {
+        neoinit_event_t event = {
+            .type = NEOINIT_EVENT_SYSTEM_STARTUP,
+            .priority = NEOINIT_EVENT_PRIORITY_NOTICE,
+            .flags = NEOINIT_EVENT_FLAG_INTERNAL,
+        };
+        neoinit_event_emit(&event);
     }
 
     pthread_create(&event_thread, NULL, event_loop, NULL);
 }
 
-void emergency_shutdown(void) {
+int shutdown_system(const neoinit_shutdown_config_t *config, neoinit_shutdown_result_t *result) {
     running = false;
-    for (int i = service_count - 1; i >= 0; i--) {
-        if (services[i].status == SERVICE_RUNNING) {
-            stop_service_with_deps(services[i].name);
-        }
+    neoinit_events_stop();
+
+    // The engine reaps on its own; make sure the loop is no longer waiting
+    if (!pthread_equal(pthread_self(), event_thread)) {
+        pthread_join(event_thread, NULL);
+    }
+    neoinit_readahead_stop();
+    neoinit_timer_cleanup();
+    neoinit_path_cleanup();
+    neoinit_netlink_cleanup();
+    neoinit_admission_cleanup();
+
+    // The engine signals and escalates units that were already stopping on its own
+    neoinit_unit_t *unit;
+    for (uint32_t id = 0; (unit = neoinit_unit_get(id)); id++) {
+        stop_timer_disarm(unit);
+        unit->stop_pending = unit->start_pending = false;
     }
-    close(socket_fd);
-    unlink(SOCKET_PATH);
+
+    neoinit_event_t event = {
+        .type = NEOINIT_EVENT_SYSTEM_SHUTDOWN,
+        .priority = NEOINIT_EVENT_PRIORITY_NOTICE,
+        .flags = NEOINIT_EVENT_FLAG_INTERNAL,
+    };
+    neoinit_event_emit(&event);
+
+    // With an action set the engine seals the journal itself, since reboot() does not return
+    int ret = neoinit_shutdown_run(config, result);
+    neoinit_cgroup_cleanup();
+    neoinit_journal_cleanup();
+
+    neoinit_control_cleanup();
+    neoinit_log_flush();
+    return ret;
+}
+
+// Stops the units, then syncs, unmounts and calls reboot(); only returns on failure
+static int final_shutdown(neoinit_shutdown_action_t action) {
+    neoinit_shutdown_config_t config = {
+        .action = action,
+        .kill_remaining = true,
+        .unmount = true,
+    };
+    return shutdown_system(&config, NULL);
+}
+
+int neoinit_core_shutdown(void) {
+    return final_shutdown(NEOINIT_SHUTDOWN_POWEROFF);
+}
+
+void emergency_shutdown(void) {
+    // PID 1 exiting panics the kernel; reboot instead
+    final_shutdown(getpid() == 1 ? NEOINIT_SHUTDOWN_REBOOT : NEOINIT_SHUTDOWN_NONE);
     exit(EXIT_FAILURE);
-}
\ No newline at end of file
+}
+
+// Waits for the event thread; a loop that died while the manager was running is fatal
+int neoinit_core_run(void) {
+    pthread_join(event_thread, NULL);
+    if (running) {
+        LOG_CRIT("Event loop stopped unexpectedly");
+        emergency_shutdown();
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,322 @@
+#define _GNU_SOURCE
+#include "neoinit/cgroup.h"
+#include "neoinit/events.h"
+#include "neoinit/socket.h"
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <linux/magic.h>
+#include <linux/sched.h>
+
+#define CGROUP_EVENTS_MAX   256
+#define CGROUP_KILL_PASSES  8       // Fallback without cgroup.kill: re-read until empty
+
+typedef struct neoinit_cgroup {
+    neoinit_unit_t *unit;
+    int dir_fd;                     // O_PATH directory, passed to clone3()
+    int events_fd;                  // cgroup.events, watched with EPOLLPRI
+    bool populated;
+    bool frozen;
+    bool killed;                    // cgroup.kill was written; see neoinit_cgroup_fork()
+} neoinit_cgroup_t;
+
+static char base[NEOINIT_MAX_PATH_LENGTH];
+static int base_fd = -1;
+static bool created_base;
+static bool have_kill;              // cgroup.kill, Linux 5.14
+static bool have_clone3 = true;     // Cleared on the first ENOSYS
+static neoinit_cgroup_empty_fn empty_fn;
+
+static int write_file(int dir_fd, const char *file, const char *value) {
+    int fd = openat(dir_fd, file, O_WRONLY | O_CLOEXEC);
+    if (fd < 0) return NEOINIT_ERROR_IO;
+    ssize_t n = write(fd, value, strlen(value));
+    int err = errno;
+    close(fd);
+    errno = err;
+    return n == (ssize_t)strlen(value) ? NEOINIT_OK : NEOINIT_ERROR_IO;
+}
+
+// Parses "populated N" and "frozen N" out of cgroup.events
+static void read_events(neoinit_cgroup_t *cg) {
+    char buf[CGROUP_EVENTS_MAX];
+    ssize_t n = pread(cg->events_fd, buf, sizeof(buf) - 1, 0);
+    if (n <= 0) return;
+    buf[n] = '\0';
+
+    const char *p = strstr(buf, "populated ");
+    if (p) cg->populated = p[10] == '1';
+    p = strstr(buf, "frozen ");
+    if (p) cg->frozen = p[7] == '1';
+}
+
+static int on_events(int fd, uint32_t events, void *user_data) {
+    (void)fd;
+    (void)events;
+    neoinit_cgroup_t *cg = user_data;
+    bool was = cg->populated;
+    read_events(cg);
+    if (was && !cg->populated && empty_fn) empty_fn(cg->unit);
+    return NEOINIT_OK;
+}
+
+static void cgroup_name(const neoinit_unit_t *unit, char *buf, size_t size) {
+    snprintf(buf, size, "%s" NEOINIT_CGROUP_SUFFIX, unit->name);
+}
+
+int neoinit_cgroup_open(neoinit_unit_t *unit) {
+    if (!unit) return NEOINIT_ERROR_INVALID_ARG;
+    if (base_fd < 0) return NEOINIT_ERROR_NOT_SUPPORTED;
+    if (unit->cgroup) {
+        // A killed cgroup is replaced by a fresh one as soon as it is empty
+        neoinit_cgroup_t *cg = unit->cgroup;
+        if (cg->killed) read_events(cg);
+        if (!cg->killed || cg->populated) return NEOINIT_OK;
+        neoinit_cgroup_close(unit);
+    }
+
+    char name[NEOINIT_MAX_NAME_LENGTH + sizeof(NEOINIT_CGROUP_SUFFIX)];
+    cgroup_name(unit, name, sizeof(name));
+    if (mkdirat(base_fd, name, 0755) < 0 && errno != EEXIST) {
+        LOG_WARNING("Cannot create cgroup %s/%s: %s", base, name, strerror(errno));
+        return NEOINIT_ERROR_IO;
+    }
+
+    neoinit_cgroup_t *cg = calloc(1, sizeof(*cg));
+    if (!cg) return NEOINIT_ERROR_NO_MEMORY;
+    cg->unit = unit;
+    cg->dir_fd = openat(base_fd, name, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    cg->events_fd = cg->dir_fd >= 0 ? openat(cg->dir_fd, "cgroup.events", O_RDONLY | O_CLOEXEC) : -1;
+    if (cg->events_fd < 0 || neoinit_events_watch(cg->events_fd, EPOLLPRI, on_events, cg) != NEOINIT_OK) {
+        if (cg->events_fd >= 0) close(cg->events_fd);
+        if (cg->dir_fd >= 0) close(cg->dir_fd);
+        free(cg);
+        return NEOINIT_ERROR_IO;
+    }
+
+    // A reused cgroup may still hold leftovers of an earlier run
+    read_events(cg);
+    unit->cgroup = cg;
+    return NEOINIT_OK;
+}
+
+// Removal fails while processes remain; the cgroup is then reused on the next start
+void neoinit_cgroup_close(neoinit_unit_t *unit) {
+    neoinit_cgroup_t *cg = unit ? unit->cgroup : NULL;
+    if (!cg) return;
+    unit->cgroup = NULL;
+
+    neoinit_events_unwatch(cg->events_fd);
+    close(cg->events_fd);
+    close(cg->dir_fd);
+    free(cg);
+
+    char name[NEOINIT_MAX_NAME_LENGTH + sizeof(NEOINIT_CGROUP_SUFFIX)];
+    cgroup_name(unit, name, sizeof(name));
+    unlinkat(base_fd, name, AT_REMOVEDIR);
+}
+
+/*
+ * Returns like fork(). The child only makes raw system calls until it
+ * execs: clone3() bypasses glibc's fork handlers, so allocator locks held
+ * by other threads are not reset in the child.
+ *
+ * Some kernels compare a CLONE_INTO_CGROUP child against the parent's
+ * cgroup.kill generation rather than the target's, and kill it at birth
+ * once the target has ever been killed. A cgroup that was killed and could
+ * not be replaced yet is therefore joined the slow way.
+ */
+pid_t neoinit_cgroup_fork(neoinit_unit_t *unit) {
+    neoinit_cgroup_t *cg = unit ? unit->cgroup : NULL;
+    if (!cg) return fork();
+
+    if (have_clone3 && !cg->killed) {
+        struct clone_args args = {
+            .flags = CLONE_INTO_CGROUP,
+            .exit_signal = SIGCHLD,
+            .cgroup = (uint64_t)cg->dir_fd,
+        };
+        long pid = syscall(SYS_clone3, &args, sizeof(args));
+        if (pid >= 0) return (pid_t)pid;
+        if (errno == EAGAIN || errno == ENOMEM) return -1;
+        if (errno == ENOSYS || errno == E2BIG) have_clone3 = false;
+        LOG_DEBUG("clone3 into %s failed (%s), falling back to fork", unit->name, strerror(errno));
+    }
+
+    // The child joins before it runs anything else, so none of its children escape
+    int procs = openat(cg->dir_fd, "cgroup.procs", O_WRONLY | O_CLOEXEC);
+    pid_t pid = fork();
+    if (pid == 0) {
+        if (procs >= 0 && write(procs, "0", 1) != 1) _exit(EXIT_FAILURE);
+        return 0;
+    }
+    if (procs >= 0) close(procs);
+    return pid;
+}
+
+static size_t read_pids(int dir_fd, pid_t **pids) {
+    *pids = NULL;
+    int fd = openat(dir_fd, "cgroup.procs", O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    FILE *fp = fdopen(fd, "r");
+    if (!fp) {
+        close(fd);
+        return 0;
+    }
+
+    size_t count = 0, cap = 0;
+    long pid;
+    while (fscanf(fp, "%ld", &pid) == 1) {
+        if (count == cap) {
+            cap = cap ? cap * 2 : 32;
+            pid_t *grown = realloc(*pids, cap * sizeof(**pids));
+            if (!grown) break;
+            *pids = grown;
+        }
+        (*pids)[count++] = (pid_t)pid;
+    }
+    fclose(fp);
+    return count;
+}
+
+/*
+ * SIGKILL goes through cgroup.kill: one write, whatever the size of the
+ * tree, and the kernel also catches processes forking meanwhile. Other
+ * signals are sent to each member of cgroup.procs.
+ */
+int neoinit_cgroup_kill(neoinit_unit_t *unit, int sig) {
+    neoinit_cgroup_t *cg = unit ? unit->cgroup : NULL;
+    if (!cg) return NEOINIT_ERROR_NOT_SUPPORTED;
+    // The flag lags behind until the loop reads the event; the file does not
+    read_events(cg);
+    if (!cg->populated) return NEOINIT_ERROR_NOT_FOUND;
+
+    if (sig == SIGKILL && have_kill) {
+        cg->killed = true;
+        return write_file(cg->dir_fd, "cgroup.kill", "1");
+    }
+
+    int passes = sig == SIGKILL ? CGROUP_KILL_PASSES : 1;
+    for (int pass = 0; pass < passes; pass++) {
+        pid_t *pids;
+        size_t count = read_pids(cg->dir_fd, &pids);
+        for (size_t i = 0; i < count; i++) kill(pids[i], sig);
+        free(pids);
+        if (!count) break;
+    }
+    // A frozen tree would never act on the signal
+    if (cg->frozen && sig != SIGKILL) neoinit_cgroup_freeze(unit, false);
+    return NEOINIT_OK;
+}
+
+int neoinit_cgroup_freeze(neoinit_unit_t *unit, bool frozen) {
+    neoinit_cgroup_t *cg = unit ? unit->cgroup : NULL;
+    if (!cg) return NEOINIT_ERROR_NOT_SUPPORTED;
+    if (cg->frozen == frozen) return NEOINIT_OK;
+    int ret = write_file(cg->dir_fd, "cgroup.freeze", frozen ? "1" : "0");
+    if (ret == NEOINIT_OK) cg->frozen = frozen;
+    return ret;
+}
+
+bool neoinit_cgroup_populated(const neoinit_unit_t *unit) {
+    return unit && unit->cgroup && unit->cgroup->populated;
+}
+
+bool neoinit_cgroup_enabled(void) {
+    return base_fd >= 0;
+}
+
+const char *neoinit_cgroup_base(void) {
+    return base_fd >= 0 ? base : NULL;
+}
+
+static int cmd_freeze(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)conn;
+    if (argc < 2) return NEOINIT_ERROR_INVALID_ARG;
+    neoinit_unit_t *unit = neoinit_unit_lookup(argv[1]);
+    if (!unit) return NEOINIT_ERROR_NOT_FOUND;
+    return neoinit_cgroup_freeze(unit, user_data != NULL);
+}
+
+// The cgroup2 mount point plus the manager's own cgroup from /proc/self/cgroup
+static int find_base(char *out, size_t size) {
+    char mnt[NEOINIT_MAX_PATH_LENGTH] = "";
+    char line[NEOINIT_MAX_PATH_LENGTH * 2];
+
+    FILE *fp = fopen("/proc/self/mountinfo", "re");
+    if (!fp) return NEOINIT_ERROR_IO;
+    while (!mnt[0] && fgets(line, sizeof(line), fp)) {
+        char point[NEOINIT_MAX_PATH_LENGTH], fstype[64];
+        const char *sep = strstr(line, " - ");
+        if (!sep || sscanf(line, "%*s %*s %*s %*s %4095s", point) != 1) continue;
+        if (sscanf(sep + 3, "%63s", fstype) == 1 && strcmp(fstype, "cgroup2") == 0) {
+            snprintf(mnt, sizeof(mnt), "%s", point);
+        }
+    }
+    fclose(fp);
+    if (!mnt[0]) return NEOINIT_ERROR_NOT_SUPPORTED;
+
+    char self[NEOINIT_MAX_PATH_LENGTH] = "/";
+    fp = fopen("/proc/self/cgroup", "re");
+    if (fp) {
+        while (fgets(line, sizeof(line), fp)) {
+            if (strncmp(line, "0::", 3) != 0) continue;
+            size_t len = strcspn(line + 3, "\n");
+            if (len < sizeof(self)) {
+                memcpy(self, line + 3, len);
+                self[len] = '\0';
+            }
+            break;
+        }
+        fclose(fp);
+    }
+
+    int n = snprintf(out, size, "%s%s/%s", mnt, strcmp(self, "/") == 0 ? "" : self, NEOINIT_CGROUP_SUBTREE);
+    return n > 0 && (size_t)n < size ? NEOINIT_OK : NEOINIT_ERROR_INVALID_ARG;
+}
+
+int neoinit_cgroup_init(neoinit_cgroup_empty_fn on_empty) {
+    if (base_fd >= 0) return NEOINIT_ERROR_BUSY;
+
+    const char *env = getenv(NEOINIT_CGROUP_ROOT_ENV);
+    int ret = NEOINIT_OK;
+    if (env && *env) snprintf(base, sizeof(base), "%s", env);
+    else ret = find_base(base, sizeof(base));
+    if (ret != NEOINIT_OK) return ret;
+
+    created_base = mkdir(base, 0755) == 0;
+    if (!created_base && errno != EEXIST) return NEOINIT_ERROR_PERMISSION;
+    struct statfs fs;
+    if (statfs(base, &fs) < 0 || fs.f_type != CGROUP2_SUPER_MAGIC) return NEOINIT_ERROR_NOT_SUPPORTED;
+
+    base_fd = open(base, O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (base_fd < 0) return NEOINIT_ERROR_IO;
+    have_kill = faccessat(base_fd, "cgroup.kill", F_OK, 0) == 0;
+    empty_fn = on_empty;
+
+    neoinit_control_register("freeze", cmd_freeze, (void *)1);
+    neoinit_control_register("thaw", cmd_freeze, NULL);
+    LOG_INFO("Units run in cgroups under %s%s", base, have_kill ? "" : " (no cgroup.kill)");
+    return NEOINIT_OK;
+}
+
+void neoinit_cgroup_cleanup(void) {
+    neoinit_unit_t *unit;
+    for (uint32_t id = 0; (unit = neoinit_unit_get(id)); id++) neoinit_cgroup_close(unit);
+    if (base_fd >= 0) {
+        close(base_fd);
+        base_fd = -1;
+        // Succeeds only once every unit cgroup is gone
+        if (created_base) rmdir(base);
+    }
+    empty_fn = NULL;
+}
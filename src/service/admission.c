@@ -0,0 +1,518 @@
+#define _GNU_SOURCE
+#include "neoinit/admission.h"
+#include "neoinit/events.h"
+#include "neoinit/metrics.h"
+#include "neoinit/socket.h"
+#include "neoinit/log.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+
+#define PSI_LINE_MAX 256
+
+typedef enum {
+    DEPS_READY = 0,
+    DEPS_WAIT,
+    DEPS_FAILED,
+} deps_status_t;
+
+// FIFO of unit ids; entries that left the queue are dropped lazily by the pump
+typedef struct {
+    uint32_t *ids;
+    size_t len;
+    size_t cap;
+} admission_queue_t;
+
+typedef struct {
+    const char *name;
+    const char *path;
+    neoinit_event_type_t event;
+} pressure_source_t;
+
+static const pressure_source_t pressure_sources[NEOINIT_PRESSURE_MAX] = {
+    [NEOINIT_PRESSURE_CPU] = { "cpu", "/proc/pressure/cpu", NEOINIT_EVENT_RESOURCE_HIGH_CPU },
+    [NEOINIT_PRESSURE_MEMORY] = { "memory", "/proc/pressure/memory", NEOINIT_EVENT_RESOURCE_LOW_MEMORY },
+    [NEOINIT_PRESSURE_IO] = { "io", "/proc/pressure/io", NEOINIT_EVENT_RESOURCE_HIGH_IO },
+};
+
+static const char *const class_names[NEOINIT_ADMISSION_CLASS_MAX] = {
+    [NEOINIT_ADMISSION_CLASS_EARLY] = "early",
+    [NEOINIT_ADMISSION_CLASS_NORMAL] = "normal",
+    [NEOINIT_ADMISSION_CLASS_LATE] = "late",
+    [NEOINIT_ADMISSION_CLASS_IDLE] = "idle",
+};
+
+static neoinit_admission_launch_fn launch_fn;
+static admission_queue_t queues[NEOINIT_ADMISSION_CLASS_MAX];
+static admission_queue_t starting;  // Launched units holding a slot, for the start timeout
+static uint32_t limit;
+static uint32_t max_limit;
+static uint32_t in_flight;
+static uint64_t admitted;
+static uint64_t deferred;
+static uint64_t pressure_events;
+static bool pumping;
+
+static int psi_fds[NEOINIT_PRESSURE_MAX] = { -1, -1, -1 };
+static bool pressure[NEOINIT_PRESSURE_MAX];
+static uint64_t pressure_seen[NEOINIT_PRESSURE_MAX];
+static uint64_t last_decrease;
+static uint64_t last_busy;          // Last launch, or last time a start was in flight
+
+static int timer_fd = -1;
+static bool timer_armed;
+
+static uint64_t ms_to_ns(uint64_t ms) {
+    return ms * 1000000ULL;
+}
+
+neoinit_admission_class_t neoinit_admission_class(const neoinit_unit_t *unit) {
+    const neoinit_template_t *tmpl = unit->tmpl;
+    if (tmpl->type == NEOINIT_SERVICE_TYPE_IDLE) return NEOINIT_ADMISSION_CLASS_IDLE;
+    if (tmpl->flags & (NEOINIT_FLAG_ESSENTIAL | NEOINIT_FLAG_EARLY)) return NEOINIT_ADMISSION_CLASS_EARLY;
+    if (tmpl->flags & NEOINIT_FLAG_LATE) return NEOINIT_ADMISSION_CLASS_LATE;
+    return NEOINIT_ADMISSION_CLASS_NORMAL;
+}
+
+// Only these types have a readiness point after fork; the rest are ready once spawned
+static bool holds_slot(const neoinit_unit_t *unit) {
+    return unit->tmpl->type == NEOINIT_SERVICE_TYPE_NOTIFY || unit->tmpl->type == NEOINIT_SERVICE_TYPE_ONESHOT;
+}
+
+static bool queue_push(admission_queue_t *q, uint32_t id) {
+    if (q->len == q->cap) {
+        size_t cap = q->cap ? q->cap * 2 : 64;
+        uint32_t *grown = realloc(q->ids, cap * sizeof(*grown));
+        if (!grown) return false;
+        q->ids = grown;
+        q->cap = cap;
+    }
+    q->ids[q->len++] = id;
+    return true;
+}
+
+static bool busy(void) {
+    if (in_flight) return true;
+    for (int c = 0; c < NEOINIT_ADMISSION_CLASS_IDLE; c++) {
+        if (queues[c].len) return true;
+    }
+    return false;
+}
+
+static bool under_pressure(void) {
+    for (int r = 0; r < NEOINIT_PRESSURE_MAX; r++) {
+        if (pressure[r]) return true;
+    }
+    return false;
+}
+
+static void timer_update(void) {
+    if (timer_fd < 0) return;
+
+    // Ticking only matters while something can still change; it also polls PSI
+    bool want = limit < max_limit || under_pressure() || busy() || queues[NEOINIT_ADMISSION_CLASS_IDLE].len;
+    if (want == timer_armed) return;
+
+    struct itimerspec its = { 0 };
+    if (want) {
+        its.it_value.tv_nsec = NEOINIT_ADMISSION_TICK_MS * 1000000L;
+        its.it_interval = its.it_value;
+    }
+    if (timerfd_settime(timer_fd, 0, &its, NULL) == 0) timer_armed = want;
+}
+
+/*
+ * A running dependency is enough once it has finished starting, which for
+ * a notify unit means it reported ready. A oneshot has to finish first: it
+ * is satisfied once it has exited cleanly.
+ */
+static deps_status_t deps_status(const neoinit_unit_t *unit, const neoinit_unit_t **blocker) {
+    for (uint32_t i = 0; i < unit->dep_count; i++) {
+        const neoinit_unit_t *dep = neoinit_unit_get(unit->dep_ids[i]);
+        bool oneshot = dep->tmpl->type == NEOINIT_SERVICE_TYPE_ONESHOT;
+
+        if (oneshot && dep->state == NEOINIT_SERVICE_STOPPED && dep->exit_code == 0) continue;
+        if (!oneshot && dep->state == NEOINIT_SERVICE_RUNNING &&
+            dep->admission != NEOINIT_ADMISSION_IN_FLIGHT) continue;
+        *blocker = dep;
+        if (dep->admission != NEOINIT_ADMISSION_NONE || dep->start_pending) return DEPS_WAIT;
+        return dep->state == NEOINIT_SERVICE_RUNNING ? DEPS_WAIT : DEPS_FAILED;
+    }
+    return DEPS_READY;
+}
+
+static void dependency_failed(neoinit_unit_t *unit, const neoinit_unit_t *dep) {
+    LOG_WARNING("Not starting %s: dependency %s is %s", unit->name, dep->name,
+                neoinit_state_to_string(dep->state));
+    unit->state = NEOINIT_SERVICE_FAILED;
+
+    neoinit_event_t event = {
+        .type = NEOINIT_EVENT_DEPENDENCY_FAILED,
+        .priority = NEOINIT_EVENT_PRIORITY_WARNING,
+        .flags = NEOINIT_EVENT_FLAG_INTERNAL,
+    };
+    snprintf(event.name, sizeof(event.name), "%s", dep->name);
+    snprintf(event.target.service, sizeof(event.target.service), "%s", unit->name);
+    event.target.id = unit->id;
+    neoinit_event_emit(&event);
+}
+
+static void launch(neoinit_unit_t *unit) {
+    last_busy = neoinit_get_monotonic_time();
+    unit->admission = NEOINIT_ADMISSION_IN_FLIGHT;
+    unit->queued_at = last_busy;
+    in_flight++;
+    admitted++;
+
+    if (launch_fn(unit) != 0) {
+        unit->state = NEOINIT_SERVICE_FAILED;
+        neoinit_admission_ready(unit);
+        return;
+    }
+    if (!holds_slot(unit) || !queue_push(&starting, unit->id)) neoinit_admission_ready(unit);
+}
+
+/*
+ * Idle units wait for a quiet period with nothing starting. Queued units
+ * that are blocked on dependencies do not count, since they may be waiting
+ * for an idle unit themselves.
+ */
+static bool idle_allowed(uint64_t now) {
+    return !in_flight && !under_pressure() && now - last_busy >= ms_to_ns(NEOINIT_ADMISSION_IDLE_DELAY_MS);
+}
+
+/*
+ * Releases queued units while slots are free. Launching one unit can make
+ * an earlier entry eligible, for example an early unit that requires a
+ * normal one, so passes repeat until nothing moves.
+ */
+static void pump(void) {
+    if (pumping) return;
+    pumping = true;
+
+    uint64_t now = neoinit_get_monotonic_time();
+    bool progress = true;
+    while (progress) {
+        progress = false;
+        for (int c = 0; c < NEOINIT_ADMISSION_CLASS_MAX; c++) {
+            if (c == NEOINIT_ADMISSION_CLASS_IDLE && !idle_allowed(now)) break;
+
+            admission_queue_t *q = &queues[c];
+            size_t keep = 0;
+            for (size_t i = 0; i < q->len; i++) {
+                neoinit_unit_t *unit = neoinit_unit_get(q->ids[i]);
+                if (unit->admission != NEOINIT_ADMISSION_QUEUED) continue;
+
+                const neoinit_unit_t *blocker = NULL;
+                deps_status_t deps = in_flight < limit ? deps_status(unit, &blocker) : DEPS_WAIT;
+                if (deps == DEPS_WAIT) {
+                    q->ids[keep++] = q->ids[i];
+                    continue;
+                }
+
+                unit->admission = NEOINIT_ADMISSION_NONE;
+                progress = true;
+                if (deps == DEPS_FAILED) {
+                    dependency_failed(unit, blocker);
+                    continue;
+                }
+                neoinit_metrics_observe(NEOINIT_HIST_ADMISSION_WAIT, now - unit->queued_at);
+                launch(unit);
+            }
+            q->len = keep;
+        }
+    }
+
+    if (in_flight) last_busy = now;
+    pumping = false;
+    timer_update();
+}
+
+int neoinit_admission_submit(neoinit_unit_t *unit) {
+    if (!unit) return NEOINIT_ERROR_INVALID_ARG;
+    if (!launch_fn) return NEOINIT_ERROR_STATE;
+    if (unit->admission != NEOINIT_ADMISSION_NONE) return NEOINIT_OK;
+
+    neoinit_admission_class_t cls = neoinit_admission_class(unit);
+    const neoinit_unit_t *blocker = NULL;
+    deps_status_t deps = deps_status(unit, &blocker);
+
+    // Fast path: nothing ahead of it, a free slot and its dependencies up
+    if (cls != NEOINIT_ADMISSION_CLASS_IDLE && !pumping && in_flight < limit && deps == DEPS_READY) {
+        bool ahead = false;
+        for (int c = 0; c <= (int)cls && !ahead; c++) ahead = queues[c].len != 0;
+        if (!ahead) {
+            launch(unit);
+            timer_update();
+            return unit->state == NEOINIT_SERVICE_FAILED ? NEOINIT_ERROR : NEOINIT_OK;
+        }
+    }
+    if (deps == DEPS_FAILED) {
+        dependency_failed(unit, blocker);
+        return NEOINIT_ERROR_DEPENDENCY;
+    }
+
+    if (!queue_push(&queues[cls], unit->id)) return NEOINIT_ERROR_NO_MEMORY;
+    unit->admission = NEOINIT_ADMISSION_QUEUED;
+    unit->state = NEOINIT_SERVICE_STARTING;
+    unit->queued_at = neoinit_get_monotonic_time();
+    deferred++;
+    neoinit_metrics_inc(NEOINIT_COUNTER_ADMISSION_DEFERRED);
+
+    pump();
+    return NEOINIT_OK;
+}
+
+// The unit reported readiness, exited or was stopped; its slot is free again
+void neoinit_admission_ready(neoinit_unit_t *unit) {
+    if (!unit || unit->admission != NEOINIT_ADMISSION_IN_FLIGHT) return;
+    unit->admission = NEOINIT_ADMISSION_NONE;
+    in_flight--;
+    pump();
+}
+
+void neoinit_admission_cancel(neoinit_unit_t *unit) {
+    if (!unit) return;
+    if (unit->admission == NEOINIT_ADMISSION_QUEUED) {
+        unit->admission = NEOINIT_ADMISSION_NONE;
+        unit->state = NEOINIT_SERVICE_INACTIVE;
+        timer_update();
+    } else {
+        neoinit_admission_ready(unit);
+    }
+}
+
+static void pressure_enter(neoinit_pressure_t r, const char *detail) {
+    uint64_t now = neoinit_get_monotonic_time();
+    pressure_seen[r] = now;
+
+    // Multiplicative decrease, at most once per tick however often triggers fire
+    if (now - last_decrease >= ms_to_ns(NEOINIT_ADMISSION_TICK_MS)) {
+        limit = limit / 2 > NEOINIT_ADMISSION_MIN ? limit / 2 : NEOINIT_ADMISSION_MIN;
+        last_decrease = now;
+    }
+
+    if (!pressure[r]) {
+        pressure[r] = true;
+        pressure_events++;
+        neoinit_metrics_inc(NEOINIT_COUNTER_PRESSURE_EVENTS);
+        LOG_WARNING("%s pressure, admitting at most %u starts", pressure_sources[r].name, limit);
+
+        neoinit_event_t event = {
+            .type = pressure_sources[r].event,
+            .priority = NEOINIT_EVENT_PRIORITY_WARNING,
+            .flags = NEOINIT_EVENT_FLAG_INTERNAL,
+        };
+        snprintf(event.name, sizeof(event.name), "%s", pressure_sources[r].name);
+        snprintf(event.source.name, sizeof(event.source.name), "%s", pressure_sources[r].path);
+        snprintf(event.data.buf, sizeof(event.data.buf), "%s", detail);
+        event.data.size = strlen(event.data.buf);
+        neoinit_event_emit(&event);
+    }
+    timer_update();
+}
+
+static int on_psi(int fd, uint32_t events, void *user_data) {
+    neoinit_pressure_t r = (neoinit_pressure_t)(uintptr_t)user_data;
+
+    if (events & EPOLLERR) {
+        // The trigger is gone (e.g. the file was unmounted); fall back to polling
+        neoinit_events_unwatch(fd);
+        close(fd);
+        psi_fds[r] = -1;
+        timer_update();
+        return NEOINIT_OK;
+    }
+    if (events & EPOLLPRI) pressure_enter(r, "trigger");
+    return NEOINIT_OK;
+}
+
+static void psi_poll(neoinit_pressure_t r) {
+    int fd = open(pressure_sources[r].path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return;
+
+    char line[PSI_LINE_MAX];
+    ssize_t n = read(fd, line, sizeof(line) - 1);
+    close(fd);
+    if (n <= 0) return;
+    line[n] = '\0';
+
+    double avg10;
+    if (sscanf(line, "some avg10=%lf", &avg10) == 1 && avg10 >= NEOINIT_ADMISSION_PSI_AVG10) {
+        char detail[64];
+        snprintf(detail, sizeof(detail), "avg10=%.2f", avg10);
+        pressure_enter(r, detail);
+    }
+}
+
+/*
+ * A notify unit that never reports readiness, or a oneshot that never
+ * exits, would hold its slot forever. Past the template's start timeout it
+ * is failed and terminated, and the slot is released. Entries whose unit
+ * already left flight are dropped here.
+ */
+static void expire_starts(uint64_t now) {
+    bool nested = pumping;
+    pumping = true;
+
+    size_t keep = 0;
+    for (size_t i = 0; i < starting.len; i++) {
+        neoinit_unit_t *unit = neoinit_unit_get(starting.ids[i]);
+        if (!unit || unit->admission != NEOINIT_ADMISSION_IN_FLIGHT) continue;
+
+        int timeout = unit->tmpl->timeout_start_usec;
+        if (timeout <= 0 || now - unit->queued_at < (uint64_t)timeout * 1000ULL) {
+            starting.ids[keep++] = starting.ids[i];
+            continue;
+        }
+        LOG_WARNING("%s did not finish starting within %d ms, failing it", unit->name, timeout / 1000);
+        unit->state = NEOINIT_SERVICE_FAILED;
+        if (unit->pid > 0) kill(unit->pid, SIGTERM);
+        neoinit_admission_ready(unit);
+    }
+    starting.len = keep;
+    pumping = nested;
+}
+
+static int on_tick(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    (void)user_data;
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) != sizeof(expirations)) return NEOINIT_OK;
+
+    uint64_t now = neoinit_get_monotonic_time();
+    for (int r = 0; r < NEOINIT_PRESSURE_MAX; r++) {
+        if (psi_fds[r] < 0) psi_poll((neoinit_pressure_t)r);
+
+        // A full trigger window without a stall ends the episode
+        if (pressure[r] && now - pressure_seen[r] >= NEOINIT_ADMISSION_PSI_WINDOW_USEC * 1000ULL) {
+            pressure[r] = false;
+            LOG_NOTICE("%s pressure cleared", pressure_sources[r].name);
+        }
+    }
+
+    expire_starts(now);
+
+    // Additive increase while the system keeps up
+    if (!under_pressure() && limit < max_limit) limit++;
+
+    pump();
+    return NEOINIT_OK;
+}
+
+static int cmd_admission(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)argc;
+    (void)argv;
+    (void)user_data;
+    neoinit_admission_stats_t stats;
+    neoinit_admission_get_stats(&stats);
+
+    neoinit_control_printf(conn, "limit %u/%u in_flight %u admitted %llu deferred %llu pressure_events %llu %s\n",
+                           stats.limit, stats.max_limit, stats.in_flight,
+                           (unsigned long long)stats.admitted, (unsigned long long)stats.deferred,
+                           (unsigned long long)stats.pressure_events, stats.triggers ? "triggers" : "polling");
+    for (int c = 0; c < NEOINIT_ADMISSION_CLASS_MAX; c++) {
+        neoinit_control_printf(conn, "queued %s %u\n", class_names[c], stats.queued[c]);
+    }
+    for (int r = 0; r < NEOINIT_PRESSURE_MAX; r++) {
+        neoinit_control_printf(conn, "pressure %s %s\n", pressure_sources[r].name,
+                               stats.pressure[r] ? "high" : "ok");
+    }
+    return NEOINIT_OK;
+}
+
+int neoinit_admission_init(neoinit_admission_launch_fn launch) {
+    if (!launch) return NEOINIT_ERROR_INVALID_ARG;
+    if (launch_fn) return NEOINIT_ERROR_BUSY;
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    max_limit = (uint32_t)(cpus > 0 ? cpus : 1) * NEOINIT_ADMISSION_PER_CPU;
+    if (max_limit < NEOINIT_ADMISSION_MIN) max_limit = NEOINIT_ADMISSION_MIN;
+    limit = max_limit;
+
+    timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (timer_fd < 0 || neoinit_events_watch(timer_fd, EPOLLIN, on_tick, NULL) != NEOINIT_OK) {
+        if (timer_fd >= 0) close(timer_fd);
+        timer_fd = -1;
+        return NEOINIT_ERROR_SYSTEM;
+    }
+
+    char spec[64];
+    snprintf(spec, sizeof(spec), "some %u %u", NEOINIT_ADMISSION_PSI_STALL_USEC,
+             NEOINIT_ADMISSION_PSI_WINDOW_USEC);
+    for (int r = 0; r < NEOINIT_PRESSURE_MAX; r++) {
+        int fd = open(pressure_sources[r].path, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0) continue;
+        if (write(fd, spec, strlen(spec) + 1) < 0 ||
+            neoinit_events_watch(fd, EPOLLPRI, on_psi, (void *)(uintptr_t)r) != NEOINIT_OK) {
+            close(fd);
+            continue;
+        }
+        psi_fds[r] = fd;
+    }
+
+    launch_fn = launch;
+    neoinit_control_register("admission", cmd_admission, NULL);
+    return NEOINIT_OK;
+}
+
+void neoinit_admission_cleanup(void) {
+    for (int r = 0; r < NEOINIT_PRESSURE_MAX; r++) {
+        if (psi_fds[r] < 0) continue;
+        neoinit_events_unwatch(psi_fds[r]);
+        close(psi_fds[r]);
+        psi_fds[r] = -1;
+    }
+    if (timer_fd >= 0) {
+        neoinit_events_unwatch(timer_fd);
+        close(timer_fd);
+        timer_fd = -1;
+    }
+    timer_armed = false;
+
+    for (int c = 0; c < NEOINIT_ADMISSION_CLASS_MAX; c++) {
+        for (size_t i = 0; i < queues[c].len; i++) {
+            neoinit_unit_t *unit = neoinit_unit_get(queues[c].ids[i]);
+            if (unit && unit->admission == NEOINIT_ADMISSION_QUEUED) {
+                unit->admission = NEOINIT_ADMISSION_NONE;
+                unit->state = NEOINIT_SERVICE_INACTIVE;
+            }
+        }
+        free(queues[c].ids);
+        memset(&queues[c], 0, sizeof(queues[c]));
+    }
+    free(starting.ids);
+    memset(&starting, 0, sizeof(starting));
+    launch_fn = NULL;
+    in_flight = 0;
+}
+
+int neoinit_admission_get_stats(neoinit_admission_stats_t *stats) {
+    if (!stats) return NEOINIT_ERROR_INVALID_ARG;
+    memset(stats, 0, sizeof(*stats));
+
+    stats->limit = limit;
+    stats->max_limit = max_limit;
+    stats->in_flight = in_flight;
+    stats->admitted = admitted;
+    stats->deferred = deferred;
+    stats->pressure_events = pressure_events;
+    stats->triggers = true;
+    for (int r = 0; r < NEOINIT_PRESSURE_MAX; r++) {
+        stats->pressure[r] = pressure[r];
+        if (psi_fds[r] < 0) stats->triggers = false;
+    }
+    for (int c = 0; c < NEOINIT_ADMISSION_CLASS_MAX; c++) {
+        for (size_t i = 0; i < queues[c].len; i++) {
+            const neoinit_unit_t *unit = neoinit_unit_get(queues[c].ids[i]);
+            if (unit && unit->admission == NEOINIT_ADMISSION_QUEUED) stats->queued[c]++;
+        }
+    }
+    return NEOINIT_OK;
+}
@@ -0,0 +1,675 @@
+#include "neoinit/service.h"
+#include "neoinit/output.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#define UNIT_SLAB_SHIFT 10
+#define UNIT_SLAB_SIZE (1u << UNIT_SLAB_SHIFT)
+#define UNIT_SLAB_MAX 65536
+#define INDEX_MIN_CAPACITY 64
+#define PID_TOMBSTONE ((pid_t)-1)
+
+/*
+ * Open addressing name index. Slots hold (id + 1) so that zero means empty;
+ * the key and hash are read back from the object itself.
+ */
+typedef struct {
+    uint32_t *slots;
+    size_t capacity;
+    size_t used;
+} name_index_t;
+
+static neoinit_unit_t *unit_slabs[UNIT_SLAB_MAX];
+static uint32_t unit_count;
+
+static neoinit_template_t **templates;
+static uint32_t template_count;
+static uint32_t template_cap;
+
+static name_index_t unit_index;
+static name_index_t template_index;
+
+// pid -> unit id, so SIGCHLD handling never scans the unit set
+static pid_t *pid_keys;
+static uint32_t *pid_ids;
+static size_t pid_cap;
+static size_t pid_used;             // Live entries plus tombstones
+static size_t pid_live;
+static pthread_mutex_t pid_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static pthread_rwlock_t registry_lock = PTHREAD_RWLOCK_INITIALIZER;
+static uint32_t walk_epoch;
+static size_t edge_count;
+
+static uint32_t hash_name(const char *s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h ^= (unsigned char)*s++;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static const char *unit_key(uint32_t id) {
+    return neoinit_unit_get(id)->name;
+}
+
+static const char *template_key(uint32_t id) {
+    return templates[id]->name;
+}
+
+static int index_resize(name_index_t *idx, size_t capacity,
+                        const char *(*key)(uint32_t)) {
+    uint32_t *slots = calloc(capacity, sizeof(*slots));
+    if (!slots) return NEOINIT_ERROR_NO_MEMORY;
+
+    for (size_t i = 0; i < idx->capacity; i++) {
+        if (!idx->slots[i]) continue;
+        size_t pos = hash_name(key(idx->slots[i] - 1)) & (capacity - 1);
+        while (slots[pos]) pos = (pos + 1) & (capacity - 1);
+        slots[pos] = idx->slots[i];
+    }
+
+    free(idx->slots);
+    idx->slots = slots;
+    idx->capacity = capacity;
+    return NEOINIT_OK;
+}
+
+static uint32_t index_find(const name_index_t *idx, const char *name, uint32_t hash,
+                           const char *(*key)(uint32_t)) {
+    if (!idx->capacity) return NEOINIT_UNIT_ID_INVALID;
+
+    size_t pos = hash & (idx->capacity - 1);
+    while (idx->slots[pos]) {
+        uint32_t id = idx->slots[pos] - 1;
+        if (strcmp(key(id), name) == 0) return id;
+        pos = (pos + 1) & (idx->capacity - 1);
+    }
+    return NEOINIT_UNIT_ID_INVALID;
+}
+
+static int index_insert(name_index_t *idx, uint32_t id, uint32_t hash,
+                        const char *(*key)(uint32_t)) {
+    // Keep the load factor under 70% so probe sequences stay short
+    if ((idx->used + 1) * 10 >= idx->capacity * 7) {
+        size_t capacity = idx->capacity ? idx->capacity * 2 : INDEX_MIN_CAPACITY;
+        int ret = index_resize(idx, capacity, key);
+        if (ret != NEOINIT_OK) return ret;
+    }
+
+    size_t pos = hash & (idx->capacity - 1);
+    while (idx->slots[pos]) pos = (pos + 1) & (idx->capacity - 1);
+    idx->slots[pos] = id + 1;
+    idx->used++;
+    return NEOINIT_OK;
+}
+
+static size_t round_pow2(size_t n) {
+    size_t p = INDEX_MIN_CAPACITY;
+    while (p < n) p <<= 1;
+    return p;
+}
+
+int neoinit_registry_init(size_t capacity_hint) {
+    pthread_rwlock_wrlock(&registry_lock);
+    int ret = NEOINIT_OK;
+    if (!unit_index.capacity)
+        ret = index_resize(&unit_index, round_pow2(capacity_hint * 10 / 7 + 1), unit_key);
+    if (ret == NEOINIT_OK && !template_index.capacity)
+        ret = index_resize(&template_index, INDEX_MIN_CAPACITY, template_key);
+    pthread_rwlock_unlock(&registry_lock);
+    return ret;
+}
+
+static void free_strv(char **v, uint32_t count) {
+    if (!v) return;
+    for (uint32_t i = 0; i < count; i++) free(v[i]);
+    free(v);
+}
+
+static void free_argv(char **argv) {
+    if (!argv) return;
+    for (char **p = argv; *p; p++) free(*p);
+    free(argv);
+}
+
+void neoinit_registry_cleanup(void) {
+    pthread_rwlock_wrlock(&registry_lock);
+
+    for (uint32_t id = 0; id < unit_count; id++) {
+        neoinit_unit_t *unit = &unit_slabs[id >> UNIT_SLAB_SHIFT][id & (UNIT_SLAB_SIZE - 1)];
+        if (unit->notification_fd >= 0) close(unit->notification_fd);
+        if (unit->stop_timer_fd >= 0) close(unit->stop_timer_fd);
+        if (unit->owns_dep_ids) free(unit->dep_ids);
+        free(unit->rdep_ids);
+        free(unit->name);
+        pthread_mutex_destroy(&unit->lock);
+    }
+    for (uint32_t s = 0; s < UNIT_SLAB_MAX && unit_slabs[s]; s++) {
+        free(unit_slabs[s]);
+        unit_slabs[s] = NULL;
+    }
+    unit_count = 0;
+
+    for (uint32_t i = 0; i < template_count; i++) {
+        neoinit_template_t *tmpl = templates[i];
+        free(tmpl->name);
+        free_argv(tmpl->exec_argv);
+        free(tmpl->working_directory);
+        free(tmpl->logs_dir);
+        free_strv(tmpl->environment, tmpl->env_count);
+        free_strv(tmpl->deps, tmpl->dep_count);
+        free_strv(tmpl->wants, tmpl->wants_count);
+        free_strv(tmpl->conflicts, tmpl->conflicts_count);
+        free(tmpl->dep_ids);
+        free(tmpl);
+    }
+    free(templates);
+    templates = NULL;
+    template_count = template_cap = 0;
+
+    free(unit_index.slots);
+    free(template_index.slots);
+    memset(&unit_index, 0, sizeof(unit_index));
+    memset(&template_index, 0, sizeof(template_index));
+    edge_count = 0;
+
+    pthread_mutex_lock(&pid_lock);
+    free(pid_keys);
+    free(pid_ids);
+    pid_keys = NULL;
+    pid_ids = NULL;
+    pid_cap = pid_used = pid_live = 0;
+    pthread_mutex_unlock(&pid_lock);
+
+    pthread_rwlock_unlock(&registry_lock);
+}
+
+size_t neoinit_registry_count(void) {
+    return __atomic_load_n(&unit_count, __ATOMIC_ACQUIRE);
+}
+
+int neoinit_registry_get_stats(neoinit_registry_stats_t *stats) {
+    if (!stats) return NEOINIT_ERROR_INVALID_ARG;
+
+    pthread_rwlock_rdlock(&registry_lock);
+    memset(stats, 0, sizeof(*stats));
+    stats->unit_count = unit_count;
+    stats->template_count = template_count;
+    stats->edge_count = edge_count;
+    stats->index_capacity = unit_index.capacity;
+
+    size_t slabs = (unit_count + UNIT_SLAB_SIZE - 1) >> UNIT_SLAB_SHIFT;
+    size_t bytes = slabs * UNIT_SLAB_SIZE * sizeof(neoinit_unit_t);
+    bytes += (unit_index.capacity + template_index.capacity) * sizeof(uint32_t);
+    for (uint32_t id = 0; id < unit_count; id++) {
+        neoinit_unit_t *unit = neoinit_unit_get(id);
+        bytes += strlen(unit->name) + 1;
+        bytes += unit->rdep_cap * sizeof(uint32_t);
+        if (unit->owns_dep_ids) bytes += unit->dep_count * sizeof(uint32_t);
+    }
+    bytes += template_count * sizeof(neoinit_template_t);
+    stats->memory_bytes = bytes;
+    pthread_rwlock_unlock(&registry_lock);
+
+    return NEOINIT_OK;
+}
+
+neoinit_template_t *neoinit_template_create(const char *name) {
+    if (!name || !*name || strlen(name) >= NEOINIT_MAX_NAME_LEN) return NULL;
+
+    pthread_rwlock_wrlock(&registry_lock);
+    uint32_t hash = hash_name(name);
+    if (index_find(&template_index, name, hash, template_key) != NEOINIT_UNIT_ID_INVALID) {
+        pthread_rwlock_unlock(&registry_lock);
+        errno = EEXIST;
+        return NULL;
+    }
+
+    if (template_count == template_cap) {
+        uint32_t cap = template_cap ? template_cap * 2 : 64;
+        neoinit_template_t **grown = realloc(templates, cap * sizeof(*grown));
+        if (!grown) goto fail;
+        templates = grown;
+        template_cap = cap;
+    }
+
+    neoinit_template_t *tmpl = calloc(1, sizeof(*tmpl));
+    if (!tmpl) goto fail;
+    tmpl->name = strdup(name);
+    if (!tmpl->name) {
+        free(tmpl);
+        goto fail;
+    }
+    tmpl->id = template_count;
+    tmpl->restart_delay = 1;
+    tmpl->timeout_start_usec = 90000000;
+    tmpl->timeout_stop_usec = 90000000;
+    tmpl->output_rate = NEOINIT_OUTPUT_RATE;
+    tmpl->output_burst = NEOINIT_OUTPUT_BURST;
+
+    templates[template_count] = tmpl;
+    if (index_insert(&template_index, tmpl->id, hash, template_key) != NEOINIT_OK) {
+        free(tmpl->name);
+        free(tmpl);
+        goto fail;
+    }
+    template_count++;
+    pthread_rwlock_unlock(&registry_lock);
+    return tmpl;
+
+fail:
+    pthread_rwlock_unlock(&registry_lock);
+    errno = ENOMEM;
+    return NULL;
+}
+
+neoinit_template_t *neoinit_template_lookup(const char *name) {
+    if (!name) return NULL;
+
+    pthread_rwlock_rdlock(&registry_lock);
+    uint32_t id = index_find(&template_index, name, hash_name(name), template_key);
+    neoinit_template_t *tmpl = id == NEOINIT_UNIT_ID_INVALID ? NULL : templates[id];
+    pthread_rwlock_unlock(&registry_lock);
+    return tmpl;
+}
+
+neoinit_template_t *neoinit_template_get(uint32_t id) {
+    pthread_rwlock_rdlock(&registry_lock);
+    neoinit_template_t *tmpl = id < template_count ? templates[id] : NULL;
+    pthread_rwlock_unlock(&registry_lock);
+    return tmpl;
+}
+
+int neoinit_template_add_dep(neoinit_template_t *tmpl, const char *dep) {
+    if (!tmpl || !dep || !*dep) return NEOINIT_ERROR_INVALID_ARG;
+
+    char **deps = realloc(tmpl->deps, (tmpl->dep_count + 1) * sizeof(*deps));
+    if (!deps) return NEOINIT_ERROR_NO_MEMORY;
+    tmpl->deps = deps;
+    if (!(deps[tmpl->dep_count] = strdup(dep))) return NEOINIT_ERROR_NO_MEMORY;
+    tmpl->dep_count++;
+
+    if (strstr(dep, NEOINIT_UNIT_INSTANCE_SPEC)) tmpl->has_specifiers = true;
+    return NEOINIT_OK;
+}
+
+int neoinit_template_set_exec(neoinit_template_t *tmpl, char *const argv[]) {
+    if (!tmpl || !argv || !argv[0]) return NEOINIT_ERROR_INVALID_ARG;
+
+    size_t argc = 0;
+    while (argv[argc]) argc++;
+    if (argc >= NEOINIT_MAX_ARGS) return NEOINIT_ERROR_INVALID_ARG;
+
+    char **copy = calloc(argc + 1, sizeof(*copy));
+    if (!copy) return NEOINIT_ERROR_NO_MEMORY;
+    for (size_t i = 0; i < argc; i++) {
+        if (!(copy[i] = strdup(argv[i]))) {
+            free_argv(copy);
+            return NEOINIT_ERROR_NO_MEMORY;
+        }
+    }
+
+    free_argv(tmpl->exec_argv);
+    tmpl->exec_argv = copy;
+    return NEOINIT_OK;
+}
+
+neoinit_unit_t *neoinit_unit_get(uint32_t id) {
+    if (id >= __atomic_load_n(&unit_count, __ATOMIC_ACQUIRE)) return NULL;
+    return &unit_slabs[id >> UNIT_SLAB_SHIFT][id & (UNIT_SLAB_SIZE - 1)];
+}
+
+static int unit_add_locked(const char *name, uint32_t hash, neoinit_template_t *tmpl,
+                           neoinit_unit_t **out) {
+    uint32_t id = unit_count;
+    uint32_t slab = id >> UNIT_SLAB_SHIFT;
+    if (slab >= UNIT_SLAB_MAX) return NEOINIT_ERROR_RESOURCE;
+    if (!unit_slabs[slab]) {
+        unit_slabs[slab] = calloc(UNIT_SLAB_SIZE, sizeof(neoinit_unit_t));
+        if (!unit_slabs[slab]) return NEOINIT_ERROR_NO_MEMORY;
+    }
+
+    neoinit_unit_t *unit = &unit_slabs[slab][id & (UNIT_SLAB_SIZE - 1)];
+    memset(unit, 0, sizeof(*unit));
+    if (!(unit->name = strdup(name))) return NEOINIT_ERROR_NO_MEMORY;
+
+    char *at = strchr(unit->name, NEOINIT_UNIT_INSTANCE_CHAR);
+    unit->instance = at && at[1] ? at + 1 : NULL;
+    unit->tmpl = tmpl;
+    unit->id = id;
+    unit->hash = hash;
+    unit->state = NEOINIT_SERVICE_INACTIVE;
+    unit->notification_fd = -1;
+    unit->stop_timer_fd = -1;
+    unit->enabled = true;
+    pthread_mutex_init(&unit->lock, NULL);
+
+    // Publish the slot before indexing so unit_key() can resolve it
+    __atomic_store_n(&unit_count, id + 1, __ATOMIC_RELEASE);
+    int ret = index_insert(&unit_index, id, hash, unit_key);
+    if (ret != NEOINIT_OK) {
+        __atomic_store_n(&unit_count, id, __ATOMIC_RELEASE);
+        pthread_mutex_destroy(&unit->lock);
+        free(unit->name);
+        return ret;
+    }
+
+    tmpl->refs++;
+    if (out) *out = unit;
+    return NEOINIT_OK;
+}
+
+int neoinit_unit_add(const char *name, neoinit_template_t *tmpl, neoinit_unit_t **unit) {
+    if (!name || !*name || !tmpl || strlen(name) >= NEOINIT_MAX_NAME_LEN)
+        return NEOINIT_ERROR_INVALID_ARG;
+
+    pthread_rwlock_wrlock(&registry_lock);
+    uint32_t hash = hash_name(name);
+    int ret = NEOINIT_ERROR_EXISTS;
+    if (index_find(&unit_index, name, hash, unit_key) == NEOINIT_UNIT_ID_INVALID)
+        ret = unit_add_locked(name, hash, tmpl, unit);
+    pthread_rwlock_unlock(&registry_lock);
+    return ret;
+}
+
+neoinit_unit_t *neoinit_unit_lookup(const char *name) {
+    if (!name) return NULL;
+
+    pthread_rwlock_rdlock(&registry_lock);
+    uint32_t id = index_find(&unit_index, name, hash_name(name), unit_key);
+    pthread_rwlock_unlock(&registry_lock);
+    return id == NEOINIT_UNIT_ID_INVALID ? NULL : neoinit_unit_get(id);
+}
+
+neoinit_unit_t *neoinit_unit_instantiate(const char *name) {
+    neoinit_unit_t *unit = neoinit_unit_lookup(name);
+    if (unit) return unit;
+
+    const char *at = name ? strchr(name, NEOINIT_UNIT_INSTANCE_CHAR) : NULL;
+    if (!at || !at[1] || strlen(name) >= NEOINIT_MAX_NAME_LEN) return NULL;
+
+    char tmpl_name[NEOINIT_MAX_NAME_LEN];
+    size_t len = (size_t)(at - name) + 1;
+    memcpy(tmpl_name, name, len);
+    tmpl_name[len] = '\0';
+
+    neoinit_template_t *tmpl = neoinit_template_lookup(tmpl_name);
+    if (!tmpl) return NULL;
+
+    pthread_rwlock_wrlock(&registry_lock);
+    uint32_t hash = hash_name(name);
+    uint32_t id = index_find(&unit_index, name, hash, unit_key);
+    if (id == NEOINIT_UNIT_ID_INVALID && unit_add_locked(name, hash, tmpl, &unit) == NEOINIT_OK)
+        id = unit->id;
+    pthread_rwlock_unlock(&registry_lock);
+
+    return id == NEOINIT_UNIT_ID_INVALID ? NULL : neoinit_unit_get(id);
+}
+
+int neoinit_unit_expand(const neoinit_unit_t *unit, const char *in, char *out, size_t size) {
+    if (!unit || !in || !out || !size) return NEOINIT_ERROR_INVALID_ARG;
+
+    const char *instance = unit->instance ? unit->instance : "";
+    size_t spec_len = strlen(NEOINIT_UNIT_INSTANCE_SPEC);
+    size_t n = 0;
+
+    while (*in) {
+        if (strncmp(in, NEOINIT_UNIT_INSTANCE_SPEC, spec_len) == 0) {
+            size_t len = strlen(instance);
+            if (n + len >= size) return NEOINIT_ERROR_INVALID_ARG;
+            memcpy(out + n, instance, len);
+            n += len;
+            in += spec_len;
+            continue;
+        }
+        if (n + 1 >= size) return NEOINIT_ERROR_INVALID_ARG;
+        out[n++] = *in++;
+    }
+    out[n] = '\0';
+    return NEOINIT_OK;
+}
+
+static size_t pid_slot(pid_t pid) {
+    return ((uint32_t)pid * 2654435761u) & (pid_cap - 1);
+}
+
+static int pid_rehash(size_t capacity) {
+    pid_t *keys = calloc(capacity, sizeof(*keys));
+    uint32_t *ids = malloc(capacity * sizeof(*ids));
+    if (!keys || !ids) {
+        free(keys);
+        free(ids);
+        return NEOINIT_ERROR_NO_MEMORY;
+    }
+
+    pid_t *old_keys = pid_keys;
+    uint32_t *old_ids = pid_ids;
+    size_t old_cap = pid_cap;
+    pid_keys = keys;
+    pid_ids = ids;
+    pid_cap = capacity;
+    pid_used = 0;
+
+    for (size_t i = 0; i < old_cap; i++) {
+        if (old_keys[i] <= 0) continue;
+        size_t pos = pid_slot(old_keys[i]);
+        while (pid_keys[pos]) pos = (pos + 1) & (pid_cap - 1);
+        pid_keys[pos] = old_keys[i];
+        pid_ids[pos] = old_ids[i];
+        pid_used++;
+    }
+    free(old_keys);
+    free(old_ids);
+    return NEOINIT_OK;
+}
+
+static void pid_remove_locked(pid_t pid, uint32_t id) {
+    if (!pid_cap || pid <= 0) return;
+    size_t pos = pid_slot(pid);
+    while (pid_keys[pos]) {
+        if (pid_keys[pos] == pid && pid_ids[pos] == id) {
+            pid_keys[pos] = PID_TOMBSTONE;
+            pid_live--;
+            return;
+        }
+        pos = (pos + 1) & (pid_cap - 1);
+    }
+}
+
+int neoinit_unit_set_pid(neoinit_unit_t *unit, pid_t pid) {
+    if (!unit || pid < 0) return NEOINIT_ERROR_INVALID_ARG;
+
+    pthread_mutex_lock(&pid_lock);
+    pid_remove_locked(unit->pid, unit->id);
+    unit->pid = pid;
+
+    int ret = NEOINIT_OK;
+    if (pid > 0) {
+        // Restart churn leaves tombstones; the sweep only grows the table once live pids reach half the limit
+        if ((pid_used + 1) * 2 > pid_cap) {
+            size_t capacity = !pid_cap ? INDEX_MIN_CAPACITY :
+                              (pid_live + 1) * 4 > pid_cap ? pid_cap * 2 : pid_cap;
+            ret = pid_rehash(capacity);
+        }
+        if (ret == NEOINIT_OK) {
+            size_t pos = pid_slot(pid);
+            while (pid_keys[pos] > 0) pos = (pos + 1) & (pid_cap - 1);
+            if (!pid_keys[pos]) pid_used++;
+            pid_live++;
+            pid_keys[pos] = pid;
+            pid_ids[pos] = unit->id;
+        }
+    }
+    pthread_mutex_unlock(&pid_lock);
+    return ret;
+}
+
+neoinit_unit_t *neoinit_unit_by_pid(pid_t pid) {
+    if (pid <= 0) return NULL;
+
+    uint32_t id = NEOINIT_UNIT_ID_INVALID;
+    pthread_mutex_lock(&pid_lock);
+    if (pid_cap) {
+        size_t pos = pid_slot(pid);
+        while (pid_keys[pos]) {
+            if (pid_keys[pos] == pid) {
+                id = pid_ids[pos];
+                break;
+            }
+            pos = (pos + 1) & (pid_cap - 1);
+        }
+    }
+    pthread_mutex_unlock(&pid_lock);
+    return id == NEOINIT_UNIT_ID_INVALID ? NULL : neoinit_unit_get(id);
+}
+
+static int rdep_push(neoinit_unit_t *dep, uint32_t id) {
+    if (dep->rdep_count == dep->rdep_cap) {
+        uint32_t cap = dep->rdep_cap ? dep->rdep_cap * 2 : 2;
+        uint32_t *grown = realloc(dep->rdep_ids, cap * sizeof(*grown));
+        if (!grown) return NEOINIT_ERROR_NO_MEMORY;
+        dep->rdep_ids = grown;
+        dep->rdep_cap = cap;
+    }
+    dep->rdep_ids[dep->rdep_count++] = id;
+    return NEOINIT_OK;
+}
+
+static int resolve_deps(neoinit_unit_t *unit, uint32_t **ids_out, uint32_t *count_out) {
+    neoinit_template_t *tmpl = unit->tmpl;
+    uint32_t *ids = tmpl->dep_count ? malloc(tmpl->dep_count * sizeof(*ids)) : NULL;
+    if (tmpl->dep_count && !ids) return NEOINIT_ERROR_NO_MEMORY;
+
+    int ret = NEOINIT_OK;
+    uint32_t count = 0;
+    char name[NEOINIT_MAX_NAME_LEN];
+
+    for (uint32_t i = 0; i < tmpl->dep_count; i++) {
+        if (neoinit_unit_expand(unit, tmpl->deps[i], name, sizeof(name)) != NEOINIT_OK) {
+            ret = NEOINIT_ERROR_DEPENDENCY;
+            continue;
+        }
+        neoinit_unit_t *dep = neoinit_unit_instantiate(name);
+        if (!dep || dep == unit) {
+            ret = NEOINIT_ERROR_DEPENDENCY;
+            continue;
+        }
+        ids[count++] = dep->id;
+    }
+
+    *ids_out = ids;
+    *count_out = count;
+    return ret;
+}
+
+int neoinit_unit_link(neoinit_unit_t *unit) {
+    if (!unit) return NEOINIT_ERROR_INVALID_ARG;
+    if (unit->linked) return NEOINIT_OK;
+
+    neoinit_template_t *tmpl = unit->tmpl;
+    int ret = NEOINIT_OK;
+
+    if (!tmpl->has_specifiers && tmpl->deps_resolved) {
+        unit->dep_ids = tmpl->dep_ids;
+        unit->dep_count = tmpl->dep_count;
+        unit->owns_dep_ids = false;
+    } else {
+        uint32_t *ids;
+        uint32_t count;
+        ret = resolve_deps(unit, &ids, &count);
+        // Stay unlinked, so the edges are resolved again once the dependency exists
+        if (ret != NEOINIT_OK) {
+            free(ids);
+            return ret;
+        }
+
+        // Instances of a specifier-free template all resolve identically
+        if (!tmpl->has_specifiers) {
+            tmpl->dep_ids = ids;
+            tmpl->deps_resolved = true;
+            unit->owns_dep_ids = false;
+        } else {
+            unit->owns_dep_ids = true;
+        }
+        unit->dep_ids = ids;
+        unit->dep_count = count;
+    }
+
+    pthread_rwlock_wrlock(&registry_lock);
+    uint32_t pushed = 0;
+    for (; pushed < unit->dep_count; pushed++) {
+        if (rdep_push(neoinit_unit_get(unit->dep_ids[pushed]), unit->id) != NEOINIT_OK) {
+            ret = NEOINIT_ERROR_NO_MEMORY;
+            break;
+        }
+    }
+    if (ret != NEOINIT_OK) {
+        // Pushes went to the tail of each list, so popping in reverse undoes them exactly
+        while (pushed) neoinit_unit_get(unit->dep_ids[--pushed])->rdep_count--;
+    } else {
+        edge_count += unit->dep_count;
+    }
+    pthread_rwlock_unlock(&registry_lock);
+
+    if (ret != NEOINIT_OK) {
+        if (unit->owns_dep_ids) free(unit->dep_ids);
+        unit->dep_ids = NULL;
+        unit->dep_count = 0;
+        unit->owns_dep_ids = false;
+        return ret;
+    }
+    unit->linked = true;
+    return NEOINIT_OK;
+}
+
+int neoinit_registry_link(void) {
+    int ret = NEOINIT_OK;
+
+    // Linking may instantiate new units, so re-read the count each pass
+    for (uint32_t id = 0; id < neoinit_registry_count(); id++) {
+        int r = neoinit_unit_link(neoinit_unit_get(id));
+        if (r != NEOINIT_OK && ret == NEOINIT_OK) ret = r;
+    }
+    return ret;
+}
+
+int neoinit_registry_order(uint32_t *order, size_t *count) {
+    if (!order || !count) return NEOINIT_ERROR_INVALID_ARG;
+
+    size_t n = neoinit_registry_count();
+    uint32_t *pending = malloc((n ? n : 1) * sizeof(*pending));
+    if (!pending) return NEOINIT_ERROR_NO_MEMORY;
+
+    // Kahn's algorithm; the output array doubles as the work queue
+    size_t head = 0, tail = 0;
+    for (uint32_t id = 0; id < n; id++) {
+        pending[id] = neoinit_unit_get(id)->dep_count;
+        if (!pending[id]) order[tail++] = id;
+    }
+
+    while (head < tail) {
+        neoinit_unit_t *unit = neoinit_unit_get(order[head++]);
+        for (uint32_t i = 0; i < unit->rdep_count; i++) {
+            uint32_t rdep = unit->rdep_ids[i];
+            if (--pending[rdep] == 0) order[tail++] = rdep;
+        }
+    }
+
+    free(pending);
+    *count = tail;
+    return tail == n ? NEOINIT_OK : NEOINIT_ERROR_DEPENDENCY;
+}
+
+uint32_t neoinit_registry_next_epoch(void) {
+    uint32_t epoch = __atomic_add_fetch(&walk_epoch, 1, __ATOMIC_RELAXED);
+    if (epoch == 0) {
+        // Wrapped around: clear stale marks so no unit looks visited
+        for (uint32_t id = 0; id < neoinit_registry_count(); id++)
+            neoinit_unit_get(id)->visit_epoch = 0;
+        epoch = __atomic_add_fetch(&walk_epoch, 1, __ATOMIC_RELAXED);
+    }
+    return epoch;
+}
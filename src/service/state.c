@@ -0,0 +1,19 @@
+#include "neoinit/core.h"
+
+static const char *const state_names[NEOINIT_SERVICE_STATE_MAX] = {
+    [NEOINIT_SERVICE_INACTIVE] = "inactive",
+    [NEOINIT_SERVICE_STARTING] = "starting",
+    [NEOINIT_SERVICE_RUNNING] = "running",
+    [NEOINIT_SERVICE_RELOADING] = "reloading",
+    [NEOINIT_SERVICE_STOPPING] = "stopping",
+    [NEOINIT_SERVICE_STOPPED] = "stopped",
+    [NEOINIT_SERVICE_FAILED] = "failed",
+    [NEOINIT_SERVICE_RESTARTING] = "restarting",
+    [NEOINIT_SERVICE_MAINTENANCE] = "maintenance",
+    [NEOINIT_SERVICE_DEGRADED] = "degraded",
+};
+
+const char *neoinit_state_to_string(neoinit_service_state_t state) {
+    if (state >= NEOINIT_SERVICE_STATE_MAX || !state_names[state]) return "unknown";
+    return state_names[state];
+}
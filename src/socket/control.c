@@ -0,0 +1,373 @@
+#define _GNU_SOURCE
+#include "neoinit/socket.h"
+#include "neoinit/events.h"
+#include "neoinit/metrics.h"
+#include "neoinit/trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#define STATS_BUF_SIZE 8192
+#define REPLY_HEADER_MAX 32
+
+struct neoinit_control_conn {
+    int fd;
+    bool detached;
+    bool closing;
+    size_t in_len;
+    char in[NEOINIT_CONTROL_MAX_REQUEST];
+    char *body;                     // Reply being built by a handler
+    size_t body_len;
+    size_t body_cap;
+    char *out;                      // Framed replies waiting for the socket
+    size_t out_len;
+    size_t out_off;
+    size_t out_cap;
+};
+
+typedef struct {
+    char verb[32];
+    neoinit_control_handler_fn handler;
+    void *user_data;
+} control_verb_t;
+
+static int listen_fd = -1;
+static char listen_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+static control_verb_t verbs[NEOINIT_CONTROL_MAX_VERBS];
+static size_t verb_count;
+static pthread_mutex_t verb_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static int buf_reserve(char **buf, size_t *cap, size_t need) {
+    if (need <= *cap) return NEOINIT_OK;
+    size_t n = *cap ? *cap : 256;
+    while (n < need) n *= 2;
+    char *grown = realloc(*buf, n);
+    if (!grown) return NEOINIT_ERROR_NO_MEMORY;
+    *buf = grown;
+    *cap = n;
+    return NEOINIT_OK;
+}
+
+int neoinit_control_write(neoinit_control_conn_t *conn, const void *buf, size_t len) {
+    if (!conn || (!buf && len)) return NEOINIT_ERROR_INVALID_ARG;
+    if (buf_reserve(&conn->body, &conn->body_cap, conn->body_len + len) != NEOINIT_OK)
+        return NEOINIT_ERROR_NO_MEMORY;
+    memcpy(conn->body + conn->body_len, buf, len);
+    conn->body_len += len;
+    return NEOINIT_OK;
+}
+
+int neoinit_control_printf(neoinit_control_conn_t *conn, const char *fmt, ...) {
+    if (!conn || !fmt) return NEOINIT_ERROR_INVALID_ARG;
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(NULL, 0, fmt, ap);
+    va_end(ap);
+    if (n < 0) return NEOINIT_ERROR_INVALID_ARG;
+
+    if (buf_reserve(&conn->body, &conn->body_cap, conn->body_len + (size_t)n + 1) != NEOINIT_OK)
+        return NEOINIT_ERROR_NO_MEMORY;
+    va_start(ap, fmt);
+    vsnprintf(conn->body + conn->body_len, (size_t)n + 1, fmt, ap);
+    va_end(ap);
+    conn->body_len += (size_t)n;
+    return NEOINIT_OK;
+}
+
+int neoinit_control_write_fd(neoinit_control_conn_t *conn, int fd) {
+    if (!conn || fd < 0) return NEOINIT_ERROR_INVALID_ARG;
+    if (lseek(fd, 0, SEEK_SET) == -1) return NEOINIT_ERROR_IO;
+
+    for (;;) {
+        if (buf_reserve(&conn->body, &conn->body_cap, conn->body_len + 65536) != NEOINIT_OK)
+            return NEOINIT_ERROR_NO_MEMORY;
+        ssize_t n = read(fd, conn->body + conn->body_len, 65536);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0) return NEOINIT_ERROR_IO;
+        if (n == 0) return NEOINIT_OK;
+        conn->body_len += (size_t)n;
+    }
+}
+
+int neoinit_control_detach(neoinit_control_conn_t *conn) {
+    if (!conn) return NEOINIT_ERROR_INVALID_ARG;
+    conn->detached = true;
+    return conn->fd;
+}
+
+int neoinit_control_register(const char *verb, neoinit_control_handler_fn handler, void *user_data) {
+    if (!verb || !*verb || !handler || strlen(verb) >= sizeof(verbs[0].verb))
+        return NEOINIT_ERROR_INVALID_ARG;
+
+    pthread_mutex_lock(&verb_lock);
+    int ret = NEOINIT_OK;
+    size_t i;
+    for (i = 0; i < verb_count && strcmp(verbs[i].verb, verb) != 0; i++) {
+    }
+    if (i == verb_count && verb_count == NEOINIT_CONTROL_MAX_VERBS) {
+        ret = NEOINIT_ERROR_RESOURCE;
+    } else {
+        snprintf(verbs[i].verb, sizeof(verbs[i].verb), "%s", verb);
+        verbs[i].handler = handler;
+        verbs[i].user_data = user_data;
+        if (i == verb_count) verb_count++;
+    }
+    pthread_mutex_unlock(&verb_lock);
+    return ret;
+}
+
+static void conn_free(neoinit_control_conn_t *conn, bool close_fd) {
+    neoinit_events_unwatch(conn->fd);
+    if (close_fd) close(conn->fd);
+    free(conn->body);
+    free(conn->out);
+    free(conn);
+}
+
+static int conn_queue_reply(neoinit_control_conn_t *conn, int status) {
+    char header[REPLY_HEADER_MAX];
+    int hlen = snprintf(header, sizeof(header), "%d %zu\n", status, conn->body_len);
+
+    if (buf_reserve(&conn->out, &conn->out_cap, conn->out_len + (size_t)hlen + conn->body_len) != NEOINIT_OK)
+        return NEOINIT_ERROR_NO_MEMORY;
+    memcpy(conn->out + conn->out_len, header, (size_t)hlen);
+    conn->out_len += (size_t)hlen;
+    if (conn->body_len) memcpy(conn->out + conn->out_len, conn->body, conn->body_len);
+    conn->out_len += conn->body_len;
+    conn->body_len = 0;
+    return NEOINIT_OK;
+}
+
+// Returns true once everything queued has reached the socket
+static bool conn_flush(neoinit_control_conn_t *conn) {
+    while (conn->out_off < conn->out_len) {
+        ssize_t n = send(conn->fd, conn->out + conn->out_off, conn->out_len - conn->out_off, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return false;
+        if (n < 0) {
+            conn->closing = true;
+            conn->out_off = conn->out_len;
+            break;
+        }
+        conn->out_off += (size_t)n;
+    }
+    conn->out_off = conn->out_len = 0;
+    return true;
+}
+
+static void conn_dispatch(neoinit_control_conn_t *conn, char *line) {
+    uint64_t start = neoinit_get_monotonic_time();
+    char *argv[NEOINIT_CONTROL_MAX_ARGS + 1];
+    int argc = 0;
+
+    for (char *save = NULL, *tok = strtok_r(line, " \t\r", &save);
+         tok && argc < NEOINIT_CONTROL_MAX_ARGS; tok = strtok_r(NULL, " \t\r", &save)) {
+        argv[argc++] = tok;
+    }
+    argv[argc] = NULL;
+    if (!argc) return;
+
+    neoinit_control_handler_fn handler = NULL;
+    void *user_data = NULL;
+    pthread_mutex_lock(&verb_lock);
+    for (size_t i = 0; i < verb_count; i++) {
+        if (strcmp(verbs[i].verb, argv[0]) == 0) {
+            handler = verbs[i].handler;
+            user_data = verbs[i].user_data;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&verb_lock);
+
+    int status;
+    if (handler) {
+        status = handler(conn, argc, argv, user_data);
+    } else {
+        status = NEOINIT_ERROR_NOT_SUPPORTED;
+        neoinit_control_printf(conn, "unknown command: %s\n", argv[0]);
+    }
+    if (status < 0) neoinit_metrics_inc(NEOINIT_COUNTER_CONTROL_ERRORS);
+
+    conn_queue_reply(conn, status);
+    neoinit_metrics_inc(NEOINIT_COUNTER_CONTROL_REQUESTS);
+    neoinit_metrics_observe(NEOINIT_HIST_CONTROL_LATENCY, neoinit_get_monotonic_time() - start);
+}
+
+static int on_conn(int fd, uint32_t events, void *user_data) {
+    neoinit_control_conn_t *conn = user_data;
+
+    if (events & EPOLLIN) {
+        for (;;) {
+            ssize_t n = read(fd, conn->in + conn->in_len, sizeof(conn->in) - conn->in_len);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) conn->closing = true;
+                break;
+            }
+            conn->in_len += (size_t)n;
+
+            char *start = conn->in;
+            char *nl;
+            while (!conn->detached && (nl = memchr(start, '\n', conn->in_len - (size_t)(start - conn->in)))) {
+                *nl = '\0';
+                conn_dispatch(conn, start);
+                start = nl + 1;
+            }
+            conn->in_len -= (size_t)(start - conn->in);
+            memmove(conn->in, start, conn->in_len);
+
+            if (conn->in_len == sizeof(conn->in)) {
+                // No newline in a full buffer: refuse the request outright
+                neoinit_control_printf(conn, "request too long\n");
+                conn_queue_reply(conn, NEOINIT_ERROR_INVALID_ARG);
+                conn->closing = true;
+                break;
+            }
+            if (conn->detached) break;
+        }
+    }
+    if (events & (EPOLLHUP | EPOLLERR)) conn->closing = true;
+
+    if (conn->detached) {
+        // The handler now owns the socket; hand over whatever was queued
+        int flags = fcntl(fd, F_GETFL);
+        fcntl(fd, F_SETFL, flags & ~O_NONBLOCK);
+        conn_flush(conn);
+        fcntl(fd, F_SETFL, flags);
+        conn_free(conn, false);
+        return NEOINIT_OK;
+    }
+
+    bool drained = conn_flush(conn);
+    if (conn->closing && drained) {
+        conn_free(conn, true);
+        return NEOINIT_OK;
+    }
+    neoinit_events_modify(fd, drained ? EPOLLIN : EPOLLIN | EPOLLOUT);
+    return NEOINIT_OK;
+}
+
+static int on_accept(int fd, uint32_t events, void *user_data) {
+    (void)events;
+    (void)user_data;
+
+    for (;;) {
+        int cfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) break;
+
+        neoinit_control_conn_t *conn = calloc(1, sizeof(*conn));
+        if (!conn) {
+            close(cfd);
+            continue;
+        }
+        conn->fd = cfd;
+        if (neoinit_events_watch(cfd, EPOLLIN, on_conn, conn) != NEOINIT_OK) {
+            close(cfd);
+            free(conn);
+        }
+    }
+    return NEOINIT_OK;
+}
+
+static int cmd_ping(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)argc;
+    (void)argv;
+    (void)user_data;
+    return neoinit_control_printf(conn, "pong\n");
+}
+
+static int cmd_stats(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)argc;
+    (void)argv;
+    (void)user_data;
+
+    char *buf = malloc(STATS_BUF_SIZE);
+    if (!buf) return NEOINIT_ERROR_NO_MEMORY;
+    int n = neoinit_events_get_stats(buf, STATS_BUF_SIZE);
+    int ret = n < 0 ? n : neoinit_control_write(conn, buf, (size_t)n);
+    if (ret == NEOINIT_OK) ret = neoinit_control_write(conn, "\n", 1);
+    free(buf);
+    return ret;
+}
+
+static int cmd_trace(neoinit_control_conn_t *conn, int argc, char **argv, void *user_data) {
+    (void)user_data;
+    bool critical = argc > 1 && strcmp(argv[1], "critical-path") == 0;
+
+    // Exporters write to an fd; stage through a memfd so the reply stays framed
+    int fd = memfd_create("neoinit-trace", MFD_CLOEXEC);
+    if (fd < 0) return NEOINIT_ERROR_SYSTEM;
+    int ret = critical ? neoinit_trace_report_critical_path(fd) : neoinit_trace_export_chrome(fd);
+    if (ret == NEOINIT_OK) ret = neoinit_control_write_fd(conn, fd);
+    close(fd);
+    return ret;
+}
+
+int neoinit_control_init(const char *path) {
+    if (!path || strlen(path) >= sizeof(listen_path)) return NEOINIT_ERROR_INVALID_ARG;
+    if (listen_fd >= 0) return NEOINIT_ERROR_BUSY;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd == -1) return NEOINIT_ERROR_SYSTEM;
+
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+    strncpy(addr.sun_path, path, sizeof(addr.sun_path) - 1);
+
+    unlink(path);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(fd, SOMAXCONN) == -1) {
+        close(fd);
+        return NEOINIT_ERROR_IO;
+    }
+
+    int ret = neoinit_control_adopt(fd, path);
+    if (ret != NEOINIT_OK) close(fd);
+    return ret;
+}
+
+/*
+ * Takes over a socket that is already bound and listening, e.g. one
+ * inherited across a re-exec. Clients queued in its backlog are accepted
+ * as soon as the loop runs.
+ */
+int neoinit_control_adopt(int fd, const char *path) {
+    if (fd < 0 || !path || strlen(path) >= sizeof(listen_path)) return NEOINIT_ERROR_INVALID_ARG;
+    if (listen_fd >= 0) return NEOINIT_ERROR_BUSY;
+
+    fcntl(fd, F_SETFD, FD_CLOEXEC);
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    if (neoinit_events_watch(fd, EPOLLIN, on_accept, NULL) != NEOINIT_OK) return NEOINIT_ERROR_IO;
+
+    listen_fd = fd;
+    snprintf(listen_path, sizeof(listen_path), "%s", path);
+    neoinit_control_register("ping", cmd_ping, NULL);
+    neoinit_control_register("stats", cmd_stats, NULL);
+    neoinit_control_register("trace", cmd_trace, NULL);
+    return NEOINIT_OK;
+}
+
+int neoinit_control_fd(void) {
+    return listen_fd;
+}
+
+const char *neoinit_control_path(void) {
+    return listen_fd >= 0 ? listen_path : NULL;
+}
+
+void neoinit_control_cleanup(void) {
+    if (listen_fd < 0) return;
+    neoinit_events_unwatch(listen_fd);
+    close(listen_fd);
+    unlink(listen_path);
+    listen_fd = -1;
+}
@@ -0,0 +1,415 @@
+/**
+ * @file bench_manager.c
+ * @brief End-to-end manager benchmark over a synthetic unit graph
+ *
+ * Runs the manager in-process without privileges, either as a child
+ * subreaper or (with -p) as PID 1 of a fresh user and PID namespace. A
+ * layered graph of stub services is generated: each layer is
+ * ceil(units / depth) wide and every unit requires `fanout` units of the
+ * layer below. A target unit requires all of them.
+ *
+ * The graph is then driven through the control socket to measure:
+ * - boot-to-all-ready
+ * - a restart storm
+ * - control-plane throughput
+ * - manager RSS
+ * - dependency-ordered shutdown
+ *
+ * With -x the graph is booted and the manager then re-executes itself
+ * through the "reexec" verb. The new image resumes the running units and
+ * reports the handover time instead of the phases above.
+ *
+ * Results are printed as a single JSON object.
+ *
+ * Usage: bench_manager [-n units] [-d depth] [-f fanout] [-r restarts]
+ *                      [-c control-ops] [-s stub-path] [-p] [-x]
+ */
+
+#define _GNU_SOURCE
+#include "neoinit/core.h"
+#include "neoinit/service.h"
+#include "neoinit/shutdown.h"
+#include "neoinit/socket.h"
+#include "neoinit/metrics.h"
+#include "neoinit/state.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define TARGET_UNIT "bench.target"
+#define PIPELINE_DEPTH 64
+#define REPLY_MAX 65536
+#define METRICS_BUF_SIZE 8192
+#define REEXEC_TIMEOUT_S 30
+#define REEXEC_START_ENV "NEOINIT_BENCH_REEXEC_START"
+
+typedef struct {
+    int fd;
+    char buf[REPLY_MAX];
+    size_t len;
+} ctl_t;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static long proc_status_kb(const char *field) {
+    FILE *f = fopen("/proc/self/status", "r");
+    if (!f) return -1;
+
+    char line[256];
+    long kb = -1;
+    size_t len = strlen(field);
+    while (fgets(line, sizeof(line), f)) {
+        if (strncmp(line, field, len) == 0 && line[len] == ':') {
+            kb = strtol(line + len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(f);
+    return kb;
+}
+
+static int ctl_connect(ctl_t *ctl, const char *path) {
+    struct sockaddr_un addr = {
+        .sun_family = AF_UNIX,
+    };
+    if (strlen(path) >= sizeof(addr.sun_path)) return -1;
+    memcpy(addr.sun_path, path, strlen(path) + 1);
+
+    ctl->len = 0;
+    ctl->fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (ctl->fd < 0) return -1;
+    if (connect(ctl->fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(ctl->fd);
+        return -1;
+    }
+    return 0;
+}
+
+static int ctl_send(ctl_t *ctl, const char *line) {
+    size_t len = strlen(line);
+    while (len) {
+        ssize_t n = write(ctl->fd, line, len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        line += n;
+        len -= (size_t)n;
+    }
+    return 0;
+}
+
+// Reads one framed reply and returns its status; the body is discarded
+static int ctl_recv(ctl_t *ctl, int *status) {
+    for (;;) {
+        char *nl = memchr(ctl->buf, '\n', ctl->len);
+        if (nl) {
+            size_t body = 0;
+            if (sscanf(ctl->buf, "%d %zu", status, &body) != 2) return -1;
+            size_t frame = (size_t)(nl - ctl->buf) + 1 + body;
+            if (frame > sizeof(ctl->buf)) return -1;
+            if (ctl->len >= frame) {
+                memmove(ctl->buf, ctl->buf + frame, ctl->len - frame);
+                ctl->len -= frame;
+                return 0;
+            }
+        }
+        ssize_t n = read(ctl->fd, ctl->buf + ctl->len, sizeof(ctl->buf) - ctl->len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        ctl->len += (size_t)n;
+    }
+}
+
+static int ctl_call(ctl_t *ctl, const char *line) {
+    int status;
+    if (ctl_send(ctl, line) != 0 || ctl_recv(ctl, &status) != 0) return -1;
+    return status;
+}
+
+// Sends `ops` copies of a request, keeping up to PIPELINE_DEPTH in flight
+static int ctl_pipeline(ctl_t *ctl, const char *line, size_t ops) {
+    size_t sent = 0, done = 0;
+    int status;
+    while (done < ops) {
+        while (sent < ops && sent - done < PIPELINE_DEPTH) {
+            if (ctl_send(ctl, line) != 0) return -1;
+            sent++;
+        }
+        if (ctl_recv(ctl, &status) != 0 || status != NEOINIT_OK) return -1;
+        done++;
+    }
+    return 0;
+}
+
+static void unit_name(char *buf, size_t size, size_t layer, size_t pos) {
+    snprintf(buf, size, "bench-%zu-%zu", layer, pos);
+}
+
+static int build_graph(size_t units, size_t depth, size_t fanout, const char *stub) {
+    size_t width = (units + depth - 1) / depth;
+    char name[NEOINIT_MAX_NAME_LEN];
+    char dep[NEOINIT_MAX_NAME_LEN];
+
+    neoinit_template_t *target = neoinit_template_create(TARGET_UNIT);
+    if (!target) return -1;
+
+    for (size_t u = 0; u < units; u++) {
+        size_t layer = u / width, pos = u % width;
+        unit_name(name, sizeof(name), layer, pos);
+
+        neoinit_template_t *tmpl = neoinit_template_create(name);
+        if (!tmpl) return -1;
+        for (size_t k = 0; layer && k < fanout && k < width; k++) {
+            unit_name(dep, sizeof(dep), layer - 1, (pos * fanout + k) % width);
+            neoinit_template_add_dep(tmpl, dep);
+        }
+        char *argv[] = { (char *)stub, name, NULL };
+        if (neoinit_template_set_exec(tmpl, argv) != NEOINIT_OK) return -1;
+        if (neoinit_unit_add(name, tmpl, NULL) != NEOINIT_OK) return -1;
+        neoinit_template_add_dep(target, name);
+    }
+
+    char *argv[] = { (char *)stub, TARGET_UNIT, NULL };
+    if (neoinit_template_set_exec(target, argv) != NEOINIT_OK) return -1;
+    return neoinit_unit_add(TARGET_UNIT, target, NULL) == NEOINIT_OK ? 0 : -1;
+}
+
+static size_t count_running(void) {
+    size_t running = 0, count = neoinit_registry_count();
+    for (uint32_t id = 0; id < count; id++) {
+        neoinit_unit_t *unit = neoinit_unit_get(id);
+        if (unit && unit->state == NEOINIT_SERVICE_RUNNING && unit->pid > 0) running++;
+    }
+    return running;
+}
+
+static void socket_path(char *path, size_t size) {
+    const char *env = getenv(NEOINIT_CONTROL_SOCKET_ENV);
+    if (!env || !*env) {
+        snprintf(path, size, "/tmp/neoinit-bench-%d.sock", (int)getpid());
+        setenv(NEOINIT_CONTROL_SOCKET_ENV, path, 1);
+    } else {
+        snprintf(path, size, "%s", env);
+    }
+}
+
+// Boots the graph and asks the manager to replace itself; never returns on success
+static int run_reexec(ctl_t *ctl, size_t units, double boot_ms, size_t booted) {
+    char value[64];
+    snprintf(value, sizeof(value), "%llu %.3f %zu", (unsigned long long)now_ns(), boot_ms, booted);
+    setenv(REEXEC_START_ENV, value, 1);
+
+    if (ctl_call(ctl, "reexec\n") != NEOINIT_OK) {
+        fprintf(stderr, "bench_manager: reexec refused\n");
+        return EXIT_FAILURE;
+    }
+
+    // The event thread execs; this thread simply disappears with the old image
+    sleep(REEXEC_TIMEOUT_S);
+    fprintf(stderr, "bench_manager: re-exec of %zu units did not happen\n", units);
+    return EXIT_FAILURE;
+}
+
+// Second half of -x, running in the new image
+static int run_resumed(size_t units) {
+    unsigned long long start = 0;
+    double boot_ms = 0;
+    size_t booted = 0;
+    const char *env = getenv(REEXEC_START_ENV);
+    if (!env || sscanf(env, "%llu %lf %zu", &start, &boot_ms, &booted) != 3) return EXIT_FAILURE;
+
+    char path[PATH_MAX];
+    socket_path(path, sizeof(path));
+
+    initialize_system();
+    uint64_t t_resumed = now_ns();
+    size_t resumed = count_running();
+
+    // The listening socket was inherited, so this must not race a rebind
+    ctl_t *ctl = calloc(1, sizeof(*ctl));
+    int ping = ctl && ctl_connect(ctl, path) == 0 ? ctl_call(ctl, "ping\n") : -1;
+    uint64_t t_ping = now_ns();
+    if (ctl && ctl->fd >= 0) close(ctl->fd);
+    free(ctl);
+
+    neoinit_shutdown_config_t config = {
+        .action = NEOINIT_SHUTDOWN_NONE,
+    };
+    neoinit_shutdown_result_t result = { 0 };
+    int shutdown_ret = shutdown_system(&config, &result);
+
+    printf("{\"bench\":\"reexec\",\"units\":%zu,\"boot_ms\":%.3f,\"booted\":%zu,"
+           "\"reexec_ms\":%.3f,\"first_reply_ms\":%.3f,\"resumed\":%zu,\"control_ok\":%s,"
+           "\"shutdown_ms\":%.3f,\"shutdown_stopped\":%u,\"shutdown_killed\":%u}\n",
+           units, boot_ms, booted, (t_resumed - start) / 1e6, (t_ping - start) / 1e6, resumed,
+           ping == NEOINIT_OK ? "true" : "false", result.elapsed_usec / 1e3,
+           result.units_stopped, result.units_killed);
+    fflush(stdout);
+
+    bool ok = resumed == booted && ping == NEOINIT_OK && shutdown_ret == NEOINIT_OK &&
+              result.units_killed == 0;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Runs in-process as the manager; returns the process exit status
+static int run(size_t units, size_t depth, size_t fanout, size_t restarts, size_t ops, const char *stub,
+               bool reexec) {
+    char path[PATH_MAX];
+    socket_path(path, sizeof(path));
+
+    long rss_idle_kb = proc_status_kb("VmRSS");
+    initialize_system();
+
+    uint64_t t0 = now_ns();
+    if (build_graph(units, depth, fanout, stub) != 0) {
+        fprintf(stderr, "bench_manager: failed to build unit graph\n");
+        return EXIT_FAILURE;
+    }
+    uint64_t t_graph = now_ns();
+
+    ctl_t *ctl = calloc(1, sizeof(*ctl));
+    if (!ctl || ctl_connect(ctl, path) != 0) {
+        fprintf(stderr, "bench_manager: cannot connect to %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    // Boot: a single start request pulls in the whole graph
+    int boot_status = ctl_call(ctl, "start " TARGET_UNIT "\n");
+    uint64_t t_boot = now_ns();
+    size_t booted = count_running();
+    long rss_kb = proc_status_kb("VmRSS");
+    if (reexec) return run_reexec(ctl, units, (t_boot - t_graph) / 1e6, booted);
+
+    // Restart storm over the top layer, whose only reverse dependency is the target
+    size_t width = (units + depth - 1) / depth;
+    size_t top = (units - 1) / width;
+    size_t top_width = units - top * width;
+    char line[NEOINIT_MAX_NAME_LEN + 16];
+    char name[NEOINIT_MAX_NAME_LEN];
+    size_t restarted = 0;
+    uint64_t t_storm = now_ns();
+    for (size_t i = 0; i < restarts; i++) {
+        unit_name(name, sizeof(name), top, (i * 2654435761u) % top_width);
+        snprintf(line, sizeof(line), "restart %s\n", name);
+        if (ctl_call(ctl, line) == NEOINIT_OK) restarted++;
+    }
+    uint64_t t_storm_end = now_ns();
+
+    // Control plane: pipelined no-op and status queries
+    int ping_ret = ctl_pipeline(ctl, "ping\n", ops);
+    uint64_t t_ping = now_ns();
+    unit_name(name, sizeof(name), 0, 0);
+    snprintf(line, sizeof(line), "status %s\n", name);
+    int status_ret = ctl_pipeline(ctl, line, ops);
+    uint64_t t_status = now_ns();
+
+    close(ctl->fd);
+    free(ctl);
+
+    size_t active = count_running();
+    neoinit_shutdown_config_t config = {
+        .action = NEOINIT_SHUTDOWN_NONE,
+    };
+    neoinit_shutdown_result_t result = { 0 };
+    int shutdown_ret = shutdown_system(&config, &result);
+    long rss_peak_kb = proc_status_kb("VmHWM");
+
+    char *metrics = malloc(METRICS_BUF_SIZE);
+    if (!metrics || neoinit_metrics_format_json(metrics, METRICS_BUF_SIZE) < 0) {
+        free(metrics);
+        metrics = NULL;
+    }
+
+    double storm_s = (t_storm_end - t_storm) / 1e9;
+    printf("{\"bench\":\"manager\",\"units\":%zu,\"depth\":%zu,\"fanout\":%zu,"
+           "\"graph_ms\":%.3f,\"boot_ms\":%.3f,\"boot_ok\":%s,\"booted\":%zu,"
+           "\"restarts\":%zu,\"restart_storm_ms\":%.3f,\"restarts_per_sec\":%.1f,"
+           "\"ping_ops_per_sec\":%.1f,\"status_ops_per_sec\":%.1f,\"control_ok\":%s,"
+           "\"shutdown_ms\":%.3f,\"shutdown_ok\":%s,\"shutdown_active\":%zu,"
+           "\"shutdown_stopped\":%u,\"shutdown_killed\":%u,\"shutdown_waves\":%u,"
+           "\"rss_idle_kb\":%ld,\"rss_booted_kb\":%ld,\"rss_peak_kb\":%ld,\"metrics\":%s}\n",
+           units, depth, fanout, (t_graph - t0) / 1e6, (t_boot - t_graph) / 1e6,
+           boot_status == NEOINIT_OK ? "true" : "false", booted, restarted,
+           storm_s * 1e3, storm_s > 0 ? restarted / storm_s : 0.0,
+           ops / ((t_ping - t_storm_end) / 1e9), ops / ((t_status - t_ping) / 1e9),
+           ping_ret == 0 && status_ret == 0 ? "true" : "false",
+           result.elapsed_usec / 1e3, shutdown_ret == NEOINIT_OK && !result.deadline_hit ? "true" : "false",
+           active, result.units_stopped, result.units_killed, result.waves,
+           rss_idle_kb, rss_kb, rss_peak_kb, metrics ? metrics : "null");
+    fflush(stdout);
+    free(metrics);
+
+    bool ok = boot_status == NEOINIT_OK && booted == units + 1 && restarted == restarts &&
+              ping_ret == 0 && status_ret == 0 && shutdown_ret == NEOINIT_OK;
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char **argv) {
+    size_t units = 1000, depth = 8, fanout = 3, restarts = 1000, ops = 100000;
+    bool pidns = false, reexec = false;
+    char stub[PATH_MAX] = "";
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) units = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-d") == 0 && i + 1 < argc) depth = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc) fanout = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) restarts = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc) ops = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-s") == 0 && i + 1 < argc) snprintf(stub, sizeof(stub), "%s", argv[++i]);
+        else if (strcmp(argv[i], "-p") == 0) pidns = true;
+        else if (strcmp(argv[i], "-x") == 0) reexec = true;
+        else {
+            fprintf(stderr, "usage: %s [-n units] [-d depth] [-f fanout] [-r restarts] "
+                            "[-c control-ops] [-s stub-path] [-p] [-x]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!units) units = 1;
+    if (!depth) depth = 1;
+    if (depth > units) depth = units;
+    if (!ops) ops = 1;
+
+    // Already in the namespace and subreaper setup of the image that exec'd us
+    if (neoinit_state_pending()) return run_resumed(units);
+
+    // Default to the stub installed next to this binary
+    if (!*stub) {
+        ssize_t n = readlink("/proc/self/exe", stub, sizeof(stub) - 1);
+        if (n < 0) return EXIT_FAILURE;
+        stub[n] = '\0';
+        char *slash = strrchr(stub, '/');
+        snprintf(slash ? slash + 1 : stub, sizeof(stub) - (size_t)(slash ? slash + 1 - stub : 0), "bench_stub");
+    }
+
+    if (pidns) {
+        // Must happen before any thread exists
+        if (unshare(CLONE_NEWUSER | CLONE_NEWPID) == -1) {
+            perror("bench_manager: unshare");
+            return EXIT_FAILURE;
+        }
+        pid_t pid = fork();
+        if (pid < 0) return EXIT_FAILURE;
+        if (pid > 0) {
+            int status;
+            while (waitpid(pid, &status, 0) == -1 && errno == EINTR) {
+            }
+            return WIFEXITED(status) ? WEXITSTATUS(status) : EXIT_FAILURE;
+        }
+    } else if (prctl(PR_SET_CHILD_SUBREAPER, 1) == -1) {
+        perror("bench_manager: PR_SET_CHILD_SUBREAPER");
+        return EXIT_FAILURE;
+    }
+
+    return run(units, depth, fanout, restarts, ops, stub, reexec);
+}
@@ -0,0 +1,26 @@
+/**
+ * @file bench_stub.c
+ * @brief Minimal service used by the benchmark harness
+ *
+ * Sits idle until SIGTERM and then exits cleanly. The harness passes the
+ * unit name as argv[1] purely so the process list stays readable.
+ *
+ * Usage: bench_stub [unit-name]
+ */
+
+#include <signal.h>
+#include <unistd.h>
+
+static void on_term(int sig) {
+    (void)sig;
+    _exit(0);
+}
+
+int main(void) {
+    struct sigaction sa = {
+        .sa_handler = on_term,
+    };
+    sigaction(SIGTERM, &sa, NULL);
+
+    for (;;) pause();
+}
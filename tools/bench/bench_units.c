@@ -0,0 +1,133 @@
+/**
+ * @file bench_units.c
+ * @brief Synthetic unit registry benchmark
+ *
+ * Builds a unit graph of the requested size out of a small base layer and
+ * three templated per-tenant units, then measures instantiation/linking,
+ * boot ordering, name lookup and shutdown wave computation.
+ *
+ * Usage: bench_units [-n units]
+ */
+
+#include "neoinit/service.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#define BASE_UNITS 32
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static neoinit_template_t *make_template(const char *name, const char *dep1, const char *dep2) {
+    neoinit_template_t *tmpl = neoinit_template_create(name);
+    if (!tmpl) {
+        fprintf(stderr, "template %s: failed\n", name);
+        exit(EXIT_FAILURE);
+    }
+    if (dep1) neoinit_template_add_dep(tmpl, dep1);
+    if (dep2) neoinit_template_add_dep(tmpl, dep2);
+    return tmpl;
+}
+
+int main(int argc, char **argv) {
+    size_t target = 100000;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) target = strtoul(argv[++i], NULL, 10);
+    }
+    if (target < BASE_UNITS + 3) target = BASE_UNITS + 3;
+
+    char name[NEOINIT_MAX_NAME_LEN];
+    char dep[NEOINIT_MAX_NAME_LEN];
+
+    uint64_t t0 = now_ns();
+    neoinit_registry_init(target);
+
+    // Base layer: a shallow chain so boot ordering has real depth
+    for (int i = 0; i < BASE_UNITS; i++) {
+        snprintf(name, sizeof(name), "base-%d", i);
+        snprintf(dep, sizeof(dep), "base-%d", i / 2);
+        neoinit_template_t *tmpl = make_template(name, i ? dep : NULL, NULL);
+        neoinit_unit_add(name, tmpl, NULL);
+    }
+
+    make_template("tenant-net@", "base-1", NULL);
+    make_template("tenant-db@", "tenant-net@%i", "base-7");
+    make_template("tenant-app@", "tenant-db@%i", "base-31");
+
+    size_t tenants = (target - BASE_UNITS) / 3;
+    for (size_t i = 0; i < tenants; i++) {
+        snprintf(name, sizeof(name), "tenant-app@%zu", i);
+        neoinit_unit_instantiate(name);
+    }
+    uint64_t t_register = now_ns();
+
+    int link_ret = neoinit_registry_link();
+    uint64_t t_link = now_ns();
+
+    size_t count = neoinit_registry_count();
+    uint32_t *order = malloc(count * sizeof(*order));
+    size_t ordered = 0;
+    int order_ret = neoinit_registry_order(order, &ordered);
+    uint64_t t_order = now_ns();
+
+    // Look every unit up by name in a scrambled order
+    size_t found = 0;
+    for (size_t i = 0; i < count; i++) {
+        neoinit_unit_t *unit = neoinit_unit_get((uint32_t)((i * 2654435761u) % count));
+        if (neoinit_unit_lookup(unit->name) == unit) found++;
+    }
+    uint64_t t_lookup = now_ns();
+
+    // Shutdown waves: a unit can stop once everything requiring it has stopped
+    uint32_t *pending = malloc(count * sizeof(*pending));
+    uint32_t *wave = malloc(count * sizeof(*wave));
+    size_t head = 0, tail = 0, waves = 0, stopped = 0;
+    for (uint32_t id = 0; id < count; id++) {
+        pending[id] = neoinit_unit_get(id)->rdep_count;
+        if (!pending[id]) wave[tail++] = id;
+    }
+    while (head < tail) {
+        size_t end = tail;
+        waves++;
+        for (; head < end; head++) {
+            neoinit_unit_t *unit = neoinit_unit_get(wave[head]);
+            stopped++;
+            for (uint32_t i = 0; i < unit->dep_count; i++) {
+                if (--pending[unit->dep_ids[i]] == 0) wave[tail++] = unit->dep_ids[i];
+            }
+        }
+    }
+    uint64_t t_shutdown = now_ns();
+
+    neoinit_registry_stats_t stats;
+    neoinit_registry_get_stats(&stats);
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+
+    printf("{\"bench\":\"units\",\"units\":%zu,\"templates\":%zu,\"edges\":%zu,"
+           "\"register_ms\":%.3f,\"link_ms\":%.3f,\"link_ok\":%s,"
+           "\"order_ms\":%.3f,\"ordered\":%zu,\"order_ok\":%s,"
+           "\"lookup_ms\":%.3f,\"lookup_ns_per_op\":%.1f,\"found\":%zu,"
+           "\"shutdown_plan_ms\":%.3f,\"shutdown_waves\":%zu,\"stopped\":%zu,"
+           "\"registry_bytes\":%zu,\"bytes_per_unit\":%.1f,\"max_rss_kb\":%ld}\n",
+           stats.unit_count, stats.template_count, stats.edge_count,
+           (t_register - t0) / 1e6, (t_link - t_register) / 1e6,
+           link_ret == NEOINIT_OK ? "true" : "false",
+           (t_order - t_link) / 1e6, ordered, order_ret == NEOINIT_OK ? "true" : "false",
+           (t_lookup - t_order) / 1e6, (double)(t_lookup - t_order) / (double)count, found,
+           (t_shutdown - t_lookup) / 1e6, waves, stopped,
+           stats.memory_bytes, (double)stats.memory_bytes / (double)stats.unit_count,
+           ru.ru_maxrss);
+
+    free(wave);
+    free(pending);
+    free(order);
+    neoinit_registry_cleanup();
+    return (found == count && stopped == count) ? EXIT_SUCCESS : EXIT_FAILURE;
+}